@@ -0,0 +1,285 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "load.h"
+
+#include "axle/buffer_pool.h"
+#include "axle/event.h"
+#include "axle/loop_group.h"
+#include "axle/status.h"
+#include "axle/tcp.h"
+
+namespace {
+
+constexpr int k_default_port = 8084;
+constexpr size_t k_default_connections = 1000000;
+// Stays well inside the default ephemeral port range, which limits connections per server port.
+constexpr size_t k_default_per_port = 20000;
+constexpr size_t k_buf_sz = 4096;
+constexpr size_t k_cached_bufs = 256;
+// Descriptors kept back for the loop, the listeners and the standard streams.
+constexpr rlim_t k_spare_fds = 256;
+constexpr std::chrono::seconds k_accept_timeout{60};
+constexpr std::chrono::milliseconds k_settle_time{200};
+
+// Resident set size of this process in bytes, or 0 if unknown.
+size_t current_rss() {
+#if defined(__linux__)
+    std::ifstream statm{"/proc/self/statm"};
+    size_t pages = 0;
+    size_t resident = 0;
+    statm >> pages >> resident;
+
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#elif defined(__APPLE__)
+    mach_task_basic_info_data_t info{};
+    mach_msg_type_number_t cnt = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(),
+                  MACH_TASK_BASIC_INFO,
+                  reinterpret_cast<task_info_t>(&info), // NOLINT
+                  &cnt) != KERN_SUCCESS) {
+        return 0;
+    }
+
+    return info.resident_size;
+#else
+    return 0;
+#endif
+}
+
+// Raises the descriptor limit as far as allowed and returns how many connections fit in it, both
+// ends of each living in this process.
+size_t max_connections() {
+    struct rlimit limit{};
+    if (getrlimit(RLIMIT_NOFILE, &limit) == -1) {
+        perror("failed to get descriptor limit");
+
+        return 0;
+    }
+
+    limit.rlim_cur = limit.rlim_max;
+    if (setrlimit(RLIMIT_NOFILE, &limit) == -1) {
+        perror("failed to raise descriptor limit");
+        (void)getrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    return limit.rlim_cur > k_spare_fds ? (limit.rlim_cur - k_spare_fds) / 2 : 0;
+}
+
+int connect_to(int port) {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) {
+        return -1;
+    }
+
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == -1) {
+        close(fd);
+
+        return -1;
+    }
+
+    return fd;
+}
+
+class Session {
+  public:
+    explicit Session(axle::BufferPool& pool)
+        : buf_{pool} {}
+
+    std::span<uint8_t> recv_buf(size_t max_len) {
+        return buf_.writable(max_len);
+    }
+
+    void post_recv(std::span<uint8_t> buf) {
+        buf_.commit(buf.size());
+    }
+
+    std::span<const uint8_t> send_buf(size_t max_len) {
+        return buf_.readable(max_len);
+    }
+
+    void post_send(int64_t len) {
+        buf_.consume(len);
+    }
+
+    void end() {}
+
+  private:
+    axle::LazyBuffer buf_;
+};
+
+class IdleServer : public axle::TcpServer<Session> {
+  public:
+    IdleServer(const std::shared_ptr<axle::EventLoop>& event_loop,
+               int port,
+               axle::BufferPool& pool,
+               std::atomic_size_t& accepted)
+        : TcpServer(event_loop, port),
+          pool_{pool},
+          accepted_{accepted} {
+        set_write_on_demand();
+    }
+
+    std::shared_ptr<Session> handle_connection() override {
+        accepted_.fetch_add(1, std::memory_order_relaxed);
+
+        return std::make_shared<Session>(pool_);
+    }
+
+  private:
+    axle::BufferPool& pool_;
+    std::atomic_size_t& accepted_;
+};
+
+bool wait_for(const std::atomic_size_t& accepted, size_t target) {
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + k_accept_timeout;
+    while (accepted.load(std::memory_order_relaxed) < target) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+    std::this_thread::sleep_for(k_settle_time);
+
+    return true;
+}
+
+// Sends one byte on every connection and waits for all of them to come back.
+bool ping_all(const std::vector<int>& fds) {
+    const uint8_t out = 'x';
+    for (const int fd : fds) {
+        if (send(fd, &out, 1, 0) != 1) {
+            return false;
+        }
+    }
+
+    for (const int fd : fds) {
+        uint8_t in = 0;
+        if (recv(fd, &in, 1, 0) != 1) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void print_rss(std::string_view name, size_t rss, size_t base, size_t connections) {
+    std::cout << name << ": rss " << rss / 1024 << " KiB, "
+              << static_cast<double>(rss - std::min(rss, base)) / static_cast<double>(connections)
+              << " bytes per connection\n";
+}
+
+} // namespace
+
+// Opens `--connections=` loopback connections to a server in this process that holds no buffers
+// while a connection is idle, and reports the growth of the resident set per connection: once
+// every connection is established and idle, and again after one round trip on each. The figures
+// cover user space on both ends of each connection (the client end costs one int); kernel socket
+// memory is not part of the resident set. The server listens on as many ports from `--port=` as
+// `--per-port=` requires. The descriptor limit is raised to its hard maximum and the connection
+// count capped to fit.
+int main(int argc, char** argv) {
+    int port = k_default_port;
+    size_t connections = k_default_connections;
+    size_t per_port = k_default_per_port;
+    for (const char* raw : std::span<char*>{argv, static_cast<size_t>(argc)}.subspan(1)) {
+        const std::string_view arg{raw};
+        axle::bench::parse_flag(arg, "--port=", port);
+        axle::bench::parse_flag(arg, "--connections=", connections);
+        axle::bench::parse_flag(arg, "--per-port=", per_port);
+    }
+
+    const size_t fit = max_connections();
+    if (connections > fit) {
+        std::cerr << "descriptor limit allows " << fit << " connections\n";
+        connections = fit;
+    }
+    const size_t ports = std::max<size_t>((connections + per_port - 1) / per_port, 1);
+
+    std::atomic_size_t accepted = 0;
+    axle::BufferPool pool{k_buf_sz, k_cached_bufs};
+    std::vector<std::unique_ptr<IdleServer>> servers;
+    axle::LoopGroup group{{{}}};
+    const axle::Status<axle::None, int> res =
+        group.start([&](size_t, const std::shared_ptr<axle::EventLoop>& loop) {
+            for (size_t i = 0; i < ports; ++i) {
+                servers.push_back(std::make_unique<IdleServer>(
+                    loop, port + static_cast<int>(i), pool, accepted));
+                servers.back()->start();
+            }
+        });
+    if (res.is_err()) {
+        std::cerr << "failed to start event loop\n";
+
+        return 1;
+    }
+
+    std::vector<int> fds(connections, -1);
+    const size_t base = current_rss();
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < connections; ++i) {
+        fds[i] = connect_to(port + static_cast<int>(i % ports));
+        if (fds[i] == -1) {
+            perror("failed to connect");
+            fds.resize(i);
+            break;
+        }
+    }
+    connections = fds.size();
+
+    int status = 0;
+    if (!wait_for(accepted, connections)) {
+        std::cerr << "only " << accepted.load() << " of " << connections << " accepted\n";
+        status = 1;
+    } else {
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "connections=" << connections << " ports=" << ports << " established in "
+                  << elapsed.count() << " s\n";
+        print_rss("idle", current_rss(), base, connections);
+
+        if (ping_all(fds)) {
+            std::this_thread::sleep_for(k_settle_time);
+            print_rss("after echo", current_rss(), base, connections);
+        } else {
+            std::cerr << "echo round failed\n";
+            status = 1;
+        }
+    }
+
+    for (const int fd : fds) {
+        close(fd);
+    }
+    group.stop();
+    std::cout << "buffers in use " << pool.in_use() << ", cached " << pool.cached() << "\n";
+
+    return status;
+}
@@ -0,0 +1,237 @@
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "hotpath.h"
+#include "load.h"
+
+#include "axle/event.h"
+#include "axle/loop_group.h"
+#include "axle/status.h"
+#include "axle/tcp.h"
+
+namespace {
+
+constexpr int k_default_port = 8087;
+constexpr size_t k_msg_sz = 64;
+
+// Echoes whatever arrives.
+class Session {
+  public:
+    std::span<uint8_t> recv_buf(size_t max_len) {
+        return std::span<uint8_t>{buf_}.subspan(tail_, std::min(buf_.size() - tail_, max_len));
+    }
+
+    void post_recv(std::span<uint8_t> buf) {
+        tail_ += buf.size();
+    }
+
+    std::span<const uint8_t> send_buf(size_t max_len) {
+        return std::span<const uint8_t>{buf_}.subspan(head_, std::min(tail_ - head_, max_len));
+    }
+
+    void post_send(int64_t len) {
+        head_ += len;
+        if (head_ == tail_) {
+            head_ = 0;
+            tail_ = 0;
+        }
+    }
+
+    void end() {}
+
+  private:
+    std::array<uint8_t, 4096> buf_{};
+    size_t head_ = 0;
+    size_t tail_ = 0;
+};
+
+// Makes its sessions through the virtual `handle_connection`.
+class VirtualServer : public axle::TcpServer<Session> {
+  public:
+    VirtualServer(const std::shared_ptr<axle::EventLoop>& event_loop, int port)
+        : TcpServer(event_loop, port) {
+        set_write_on_demand();
+    }
+
+    std::shared_ptr<Session> handle_connection() override {
+        return std::make_shared<Session>();
+    }
+};
+
+// Makes its sessions through a direct call.
+class StaticServer : public axle::TcpServer<Session, StaticServer> {
+  public:
+    StaticServer(const std::shared_ptr<axle::EventLoop>& event_loop, int port)
+        : TcpServer(event_loop, port) {
+        set_write_on_demand();
+    }
+
+    std::shared_ptr<Session> handle_connection() {
+        return std::make_shared<Session>();
+    }
+};
+
+// Counts the user-space instructions retired by the thread that opened it, on Linux where the
+// kernel lets the process use hardware counters.
+class InstructionCounter {
+  public:
+    InstructionCounter(const InstructionCounter&) = delete;
+    InstructionCounter& operator=(const InstructionCounter&) = delete;
+    InstructionCounter(InstructionCounter&&) = delete;
+    InstructionCounter& operator=(InstructionCounter&&) = delete;
+
+    InstructionCounter() {
+#if defined(__linux__)
+        struct perf_event_attr attr{};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+
+    ~InstructionCounter() {
+        if (fd_ >= 0) {
+            (void)close(fd_);
+        }
+    }
+
+    bool available() const {
+        return fd_ >= 0;
+    }
+
+    uint64_t read() const {
+        uint64_t cnt = 0;
+        if (fd_ < 0 || ::read(fd_, &cnt, sizeof(cnt)) != sizeof(cnt)) {
+            return 0;
+        }
+
+        return cnt;
+    }
+
+  private:
+    int fd_ = -1;
+};
+
+// What the thread running a loop has used so far.
+struct Usage {
+    uint64_t instructions = 0;
+    std::chrono::nanoseconds cpu{0};
+    axle::bench::HotPathCounts counts;
+};
+
+Usage loop_usage(const std::shared_ptr<axle::EventLoop>& loop, const InstructionCounter* counter) {
+    std::promise<Usage> usage;
+    (void)loop->post([&usage, counter] {
+        struct timespec ts{};
+        (void)clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        usage.set_value({counter != nullptr ? counter->read() : 0,
+                         std::chrono::seconds{ts.tv_sec} + std::chrono::nanoseconds{ts.tv_nsec},
+                         axle::bench::thread_counts()});
+    });
+
+    return usage.get_future().get();
+}
+
+struct Target {
+    std::string_view name;
+    size_t loop;
+};
+
+} // namespace
+
+// Measures what a `TcpServer` spends per echo round trip depending on how it makes its sessions:
+// through the virtual `handle_connection`, or through a direct call with the server passed as
+// `ServerT`. Each kind runs on a loop of its own, on `--port=` and the port after it, and is
+// loaded with small messages using the usual load flags. The report gives the user-space
+// instructions the loop thread retired per round trip where hardware counters are available, and
+// its CPU time, allocations and system calls per round trip in any case.
+int main(int argc, char** argv) {
+    std::vector<std::string_view> rest;
+    axle::bench::LoadConfig config = axle::bench::parse_args(argc, argv, rest);
+    if (config.port == 0) {
+        config.port = k_default_port;
+    }
+
+    std::unique_ptr<VirtualServer> virtual_server;
+    std::unique_ptr<StaticServer> static_server;
+    std::array<std::unique_ptr<InstructionCounter>, 2> counters;
+    axle::LoopGroup group{{{}, {}}};
+    const axle::Status<axle::None, int> res =
+        group.start([&](size_t idx, const std::shared_ptr<axle::EventLoop>& loop) {
+            // Opened here to count the loop thread.
+            counters.at(idx) = std::make_unique<InstructionCounter>();
+            if (idx == 0) {
+                virtual_server = std::make_unique<VirtualServer>(loop, config.port);
+                virtual_server->start();
+            } else {
+                static_server = std::make_unique<StaticServer>(loop, config.port + 1);
+                static_server->start();
+            }
+        });
+    if (res.is_err()) {
+        std::cerr << "failed to start event loops\n";
+
+        return 1;
+    }
+
+    const std::vector<Target> targets{{"virtual", 0}, {"static", 1}};
+    const std::string msg(k_msg_sz, 'x');
+    for (const Target& target : targets) {
+        axle::bench::LoadConfig target_config = config;
+        target_config.port = config.port + static_cast<int>(target.loop);
+
+        const std::shared_ptr<axle::EventLoop>& loop = group.loop(target.loop);
+        const InstructionCounter* counter = counters.at(target.loop).get();
+        const Usage before = loop_usage(loop, counter);
+        const axle::bench::LoadReport report = axle::bench::run_load(
+            target_config,
+            [&msg](size_t, uint64_t, std::string& out) { out += msg; },
+            [](std::span<const uint8_t> buf, size_t& consumed) {
+                const size_t cnt = buf.size() / k_msg_sz;
+                consumed = cnt * k_msg_sz;
+
+                return cnt;
+            });
+        const Usage after = loop_usage(loop, counter);
+
+        const std::string name{target.name};
+        axle::bench::print_report(name, report);
+        if (report.requests == 0) {
+            continue;
+        }
+        const auto requests = static_cast<double>(report.requests);
+        std::cout << name << ": ";
+        if (counter->available()) {
+            std::cout << static_cast<double>(after.instructions - before.instructions) / requests
+                      << " instructions, ";
+        }
+        const axle::bench::HotPathCounts counts = after.counts - before.counts;
+        std::cout << static_cast<double>((after.cpu - before.cpu).count()) / requests
+                  << " ns cpu, " << static_cast<double>(counts.allocations) / requests
+                  << " allocations, " << static_cast<double>(counts.syscalls) / requests
+                  << " syscalls per round trip\n";
+    }
+
+    group.stop();
+}
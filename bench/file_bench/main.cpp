@@ -0,0 +1,254 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "load.h"
+
+#include "axle/event.h"
+#include "axle/file.h"
+#include "axle/loop_group.h"
+#include "axle/status.h"
+#include "axle/tcp.h"
+#include "axle/worker_pool.h"
+
+namespace {
+
+constexpr int k_default_port = 8086;
+constexpr uint64_t k_log_timer_id = 1;
+constexpr double k_bytes_per_mb = 1024.0 * 1024.0;
+// Writes allowed in flight before the logger skips a tick, as a real one would shed or batch.
+constexpr size_t k_max_pending_writes = 8;
+
+// Answers every line with `ok`.
+class Session {
+  public:
+    std::span<uint8_t> recv_buf(size_t max_len) {
+        return std::span<uint8_t>{buf_}.first(std::min(buf_.size(), max_len));
+    }
+
+    void post_recv(std::span<uint8_t> buf) {
+        for (const uint8_t byte : buf) {
+            if (byte == '\n') {
+                out_.append("ok\n");
+            }
+        }
+    }
+
+    std::span<const uint8_t> send_buf(size_t max_len) {
+        const size_t len = std::min<size_t>(out_.size() - sent_, max_len);
+
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return std::span<const uint8_t>{reinterpret_cast<const uint8_t*>(out_.data()), out_.size()}
+            .subspan(sent_, len);
+    }
+
+    void post_send(int64_t len) {
+        sent_ += len;
+        if (sent_ == out_.size()) {
+            out_.clear();
+            sent_ = 0;
+        }
+    }
+
+    void end() {}
+
+  private:
+    static constexpr size_t k_buf_sz = 4096;
+
+    std::array<uint8_t, k_buf_sz> buf_{};
+    std::string out_;
+    size_t sent_ = 0;
+};
+
+class PingServer : public axle::TcpServer<Session> {
+  public:
+    PingServer(const std::shared_ptr<axle::EventLoop>& event_loop, int port)
+        : TcpServer(event_loop, port) {
+        set_write_coalescing();
+    }
+
+    std::shared_ptr<Session> handle_connection() override {
+        return std::make_shared<Session>();
+    }
+};
+
+// Appends a chunk to a file on every tick of a timer and syncs it every `sync_every` chunks,
+// either straight from the loop or through an `AsyncFile`.
+class Logger {
+  public:
+    Logger(const std::shared_ptr<axle::EventLoop>& loop,
+           axle::WorkerPool* pool,
+           int fd,
+           size_t chunk_sz,
+           size_t sync_every)
+        : fd_{fd},
+          chunk_(chunk_sz, 'x'),
+          sync_every_{std::max<size_t>(sync_every, 1)} {
+        if (pool != nullptr) {
+            file_ = std::make_unique<axle::AsyncFile>(*pool, loop, fd);
+        }
+    }
+
+    ~Logger() {
+        if (file_ == nullptr) {
+            (void)close(fd_);
+        }
+    }
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+    Logger(Logger&&) = delete;
+    Logger& operator=(Logger&&) = delete;
+
+    void tick() {
+        const bool sync = (chunks_ + 1) % sync_every_ == 0;
+        if (file_ == nullptr) {
+            if (pwrite(fd_, chunk_.data(), chunk_.size(), static_cast<off_t>(offset_)) == -1 ||
+                (sync && fsync(fd_) == -1)) {
+                perror("failed to write log");
+            }
+            written_ += chunk_.size();
+        } else {
+            if (file_->pending() >= k_max_pending_writes) {
+                ++skipped_;
+
+                return;
+            }
+            file_->write_at(offset_, chunk_, [this](axle::Status<size_t, int> res) {
+                if (res.is_ok()) {
+                    written_ += res.ok();
+                }
+            });
+            if (sync) {
+                file_->fsync([](axle::Status<axle::None, int>) {});
+            }
+        }
+        offset_ += chunk_.size();
+        ++chunks_;
+    }
+
+    size_t written() const {
+        return written_;
+    }
+
+    size_t skipped() const {
+        return skipped_;
+    }
+
+  private:
+    int fd_;
+    std::vector<uint8_t> chunk_;
+    size_t sync_every_;
+    std::unique_ptr<axle::AsyncFile> file_;
+    uint64_t offset_ = 0;
+    size_t chunks_ = 0;
+    size_t written_ = 0;
+    size_t skipped_ = 0;
+};
+
+size_t count_lines(std::span<const uint8_t> buf, size_t& consumed) {
+    size_t cnt = 0;
+    consumed = 0;
+    for (size_t i = 0; i < buf.size(); ++i) {
+        if (buf[i] == '\n') {
+            ++cnt;
+            consumed = i + 1;
+        }
+    }
+
+    return cnt;
+}
+
+} // namespace
+
+// Measures how a loop serving small requests holds up while the same loop writes a file: every
+// `--interval-us=` it appends a `--chunk-kb=` chunk to `--path=` and syncs every `--sync-every=`
+// chunks. With `--workers=0` the writes block the loop thread; otherwise they go through an
+// `AsyncFile` on a worker pool of that size. Compare the request latency between the two. The
+// usual load flags drive the requests.
+int main(int argc, char** argv) {
+    std::vector<std::string_view> rest;
+    axle::bench::LoadConfig config = axle::bench::parse_args(argc, argv, rest);
+    if (config.port == 0) {
+        config.port = k_default_port;
+    }
+
+    size_t workers = 2;
+    size_t chunk_kb = 256;
+    size_t sync_every = 4;
+    int64_t interval_us = 1000;
+    std::string path = "/tmp/axle-file-bench.dat";
+    for (const std::string_view arg : rest) {
+        axle::bench::parse_flag(arg, "--workers=", workers);
+        axle::bench::parse_flag(arg, "--chunk-kb=", chunk_kb);
+        axle::bench::parse_flag(arg, "--sync-every=", sync_every);
+        axle::bench::parse_flag(arg, "--interval-us=", interval_us);
+        if (arg.starts_with("--path=")) {
+            path = arg.substr(arg.find('=') + 1);
+        }
+    }
+
+    const int fd = open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd == -1) {
+        perror("failed to open file");
+
+        return 1;
+    }
+
+    std::unique_ptr<axle::WorkerPool> pool;
+    if (workers > 0) {
+        pool = std::make_unique<axle::WorkerPool>(workers);
+    }
+
+    std::unique_ptr<PingServer> server;
+    std::unique_ptr<Logger> logger;
+    axle::LoopGroup group{{{}}};
+    const axle::Status<axle::None, int> res =
+        group.start([&](size_t, const std::shared_ptr<axle::EventLoop>& loop) {
+            server = std::make_unique<PingServer>(loop, config.port);
+            server->start();
+
+            logger = std::make_unique<Logger>(loop, pool.get(), fd, chunk_kb * 1024, sync_every);
+            (void)loop->register_timer(k_log_timer_id,
+                                       interval_us * 1000,
+                                       true,
+                                       [&](uint64_t, axle::Status<axle::None, int64_t>) {
+                                           logger->tick();
+                                       });
+        });
+    if (res.is_err()) {
+        std::cerr << "failed to start event loop\n";
+
+        return 1;
+    }
+
+    const axle::bench::LoadReport report = axle::bench::run_load(
+        config, [](size_t, uint64_t, std::string& out) { out += "ping\n"; }, count_lines);
+
+    group.stop();
+    const std::string mode = " workers=" + std::to_string(workers);
+    axle::bench::print_report("ping" + mode, report);
+    std::cout << "file" << mode << ": "
+              << static_cast<double>(logger->written()) / k_bytes_per_mb / report.seconds
+              << " MiB/s written, " << logger->skipped() << " ticks skipped\n";
+
+    logger.reset();
+    server.reset();
+    pool.reset();
+    (void)unlink(path.c_str());
+}
@@ -0,0 +1,228 @@
+#include "hotpath.h"
+
+#include <dlfcn.h>
+#include <sys/event.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <new>
+
+#include "axle/event.h"
+
+namespace axle::bench {
+
+namespace {
+
+// Constant-initialized, so touching it from a new thread allocates nothing.
+thread_local HotPathCounts t_counts;
+
+void* counted_alloc(size_t sz) {
+    ++t_counts.allocations;
+    t_counts.allocated_bytes += sz;
+
+    return std::malloc(sz == 0 ? 1 : sz); // NOLINT(*-no-malloc)
+}
+
+void* counted_aligned_alloc(size_t sz, std::align_val_t align) {
+    ++t_counts.allocations;
+    t_counts.allocated_bytes += sz;
+
+    void* ptr = nullptr;
+    const auto alignment = std::max(static_cast<size_t>(align), sizeof(void*));
+    if (posix_memalign(&ptr, alignment, sz == 0 ? 1 : sz) != 0) {
+        return nullptr;
+    }
+
+    return ptr;
+}
+
+// The libc function that `name` names beyond this binary's own definition of it.
+template <typename Fn>
+Fn* next(const char* name) {
+    return reinterpret_cast<Fn*>(dlsym(RTLD_NEXT, name)); // NOLINT(*-reinterpret-cast)
+}
+
+} // namespace
+
+HotPathCounts HotPathCounts::operator-(const HotPathCounts& other) const {
+    return {allocations - other.allocations,
+            allocated_bytes - other.allocated_bytes,
+            syscalls - other.syscalls};
+}
+
+HotPathCounts thread_counts() {
+    return t_counts;
+}
+
+HotPathCounts loop_counts(const std::shared_ptr<EventLoop>& loop) {
+    std::promise<HotPathCounts> counts;
+    (void)loop->post([&counts] { counts.set_value(thread_counts()); });
+
+    return counts.get_future().get();
+}
+
+} // namespace axle::bench
+
+// NOLINTBEGIN(misc-new-delete-overloads,cppcoreguidelines-no-malloc)
+
+void* operator new(size_t sz) {
+    void* ptr = axle::bench::counted_alloc(sz);
+    if (ptr == nullptr) {
+        throw std::bad_alloc{};
+    }
+
+    return ptr;
+}
+
+void* operator new[](size_t sz) {
+    return operator new(sz);
+}
+
+void* operator new(size_t sz, const std::nothrow_t&) noexcept {
+    return axle::bench::counted_alloc(sz);
+}
+
+void* operator new[](size_t sz, const std::nothrow_t&) noexcept {
+    return axle::bench::counted_alloc(sz);
+}
+
+void* operator new(size_t sz, std::align_val_t align) {
+    void* ptr = axle::bench::counted_aligned_alloc(sz, align);
+    if (ptr == nullptr) {
+        throw std::bad_alloc{};
+    }
+
+    return ptr;
+}
+
+void* operator new[](size_t sz, std::align_val_t align) {
+    return operator new(sz, align);
+}
+
+void* operator new(size_t sz, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return axle::bench::counted_aligned_alloc(sz, align);
+}
+
+void* operator new[](size_t sz, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return axle::bench::counted_aligned_alloc(sz, align);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+// NOLINTEND(misc-new-delete-overloads,cppcoreguidelines-no-malloc)
+
+// Calls from this binary, the library included, bind to these definitions, which count the call
+// and forward it to libc.
+#define AXLE_COUNTED_SYSCALL(ret, name, params, args)                                          \
+    extern "C" ret name params {                                                               \
+        static auto* const real = axle::bench::next<decltype(name)>(#name);                    \
+        ++axle::bench::t_counts.syscalls;                                                      \
+        return real args;                                                                      \
+    }
+
+// NOLINTBEGIN(cppcoreguidelines-macro-usage,bugprone-macro-parentheses)
+
+AXLE_COUNTED_SYSCALL(int,
+                     kevent,
+                     (int kq,
+                      const struct kevent* changes,
+                      int nchanges,
+                      struct kevent* events,
+                      int nevents,
+                      const struct timespec* timeout),
+                     (kq, changes, nchanges, events, nevents, timeout))
+AXLE_COUNTED_SYSCALL(ssize_t, read, (int fd, void* buf, size_t len), (fd, buf, len))
+AXLE_COUNTED_SYSCALL(ssize_t, write, (int fd, const void* buf, size_t len), (fd, buf, len))
+AXLE_COUNTED_SYSCALL(ssize_t,
+                     readv,
+                     (int fd, const struct iovec* iov, int iovcnt),
+                     (fd, iov, iovcnt))
+AXLE_COUNTED_SYSCALL(ssize_t,
+                     writev,
+                     (int fd, const struct iovec* iov, int iovcnt),
+                     (fd, iov, iovcnt))
+AXLE_COUNTED_SYSCALL(ssize_t,
+                     pread,
+                     (int fd, void* buf, size_t len, off_t off),
+                     (fd, buf, len, off))
+AXLE_COUNTED_SYSCALL(ssize_t,
+                     pwrite,
+                     (int fd, const void* buf, size_t len, off_t off),
+                     (fd, buf, len, off))
+AXLE_COUNTED_SYSCALL(ssize_t,
+                     recv,
+                     (int fd, void* buf, size_t len, int flags),
+                     (fd, buf, len, flags))
+AXLE_COUNTED_SYSCALL(ssize_t,
+                     send,
+                     (int fd, const void* buf, size_t len, int flags),
+                     (fd, buf, len, flags))
+AXLE_COUNTED_SYSCALL(ssize_t,
+                     recvmsg,
+                     (int fd, struct msghdr* msg, int flags),
+                     (fd, msg, flags))
+AXLE_COUNTED_SYSCALL(ssize_t,
+                     sendmsg,
+                     (int fd, const struct msghdr* msg, int flags),
+                     (fd, msg, flags))
+AXLE_COUNTED_SYSCALL(int,
+                     accept,
+                     (int fd, struct sockaddr* addr, socklen_t* addr_len),
+                     (fd, addr, addr_len))
+AXLE_COUNTED_SYSCALL(int, close, (int fd), (fd))
+AXLE_COUNTED_SYSCALL(int, fsync, (int fd), (fd))
+#ifdef __linux__
+AXLE_COUNTED_SYSCALL(ssize_t,
+                     splice,
+                     (int fd_in, loff_t* off_in, int fd_out, loff_t* off_out, size_t len,
+                      unsigned int flags),
+                     (fd_in, off_in, fd_out, off_out, len, flags))
+#endif
+
+// NOLINTEND(cppcoreguidelines-macro-usage,bugprone-macro-parentheses)
+
+#undef AXLE_COUNTED_SYSCALL
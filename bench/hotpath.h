@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+#include <memory>
+
+#include "axle/event.h"
+
+namespace axle::bench {
+
+// What a thread has done since it started, as counted by the replacements of the global
+// `operator new` and of the libc system call wrappers that linking `hotpath.cpp` into a binary
+// installs. Allocations are those made through `operator new` in any of its forms, which covers
+// containers, `std::function` and `shared_ptr`; the system calls are the I/O, polling and
+// descriptor calls the library makes, each counted once per call whether or not it fails.
+struct HotPathCounts {
+    uint64_t allocations = 0;
+    uint64_t allocated_bytes = 0;
+    uint64_t syscalls = 0;
+
+    HotPathCounts operator-(const HotPathCounts& other) const;
+};
+
+// The calling thread's counts.
+HotPathCounts thread_counts();
+
+// The counts of the thread running `loop`, read from a callback posted to it. Posting wakes the
+// loop, which costs it a system call or two of its own, so take the difference of two readings
+// over many operations rather than one. Must not be called from the loop thread.
+HotPathCounts loop_counts(const std::shared_ptr<EventLoop>& loop);
+
+} // namespace axle::bench
@@ -0,0 +1,71 @@
+#include <cstddef>
+#include <cstdint>
+
+#include <charconv>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "load.h"
+
+namespace {
+
+constexpr int k_default_port = 8082;
+
+// Counts complete responses, relying on the server always sending a Content-Length.
+size_t count_responses(std::span<const uint8_t> buf, size_t& consumed) {
+    constexpr std::string_view k_content_length = "Content-Length: ";
+    constexpr std::string_view k_head_end = "\r\n\r\n";
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    const std::string_view data{reinterpret_cast<const char*>(buf.data()), buf.size()};
+    size_t cnt = 0;
+    consumed = 0;
+
+    for (;;) {
+        const size_t head_end = data.find(k_head_end, consumed);
+        if (head_end == std::string_view::npos) {
+            break;
+        }
+
+        const size_t field = data.find(k_content_length, consumed);
+        size_t body_len = 0;
+        if (field != std::string_view::npos && field < head_end) {
+            const char* first = data.data() + field + k_content_length.size();
+            (void)std::from_chars(first, data.data() + head_end, body_len);
+        }
+
+        const size_t len = head_end + k_head_end.size() + body_len;
+        if (len > data.size()) {
+            break;
+        }
+        consumed = len;
+        ++cnt;
+    }
+
+    return cnt;
+}
+
+} // namespace
+
+// Drives the http_server example. Accepts the load options understood by `parse_args` plus an
+// optional request path, e.g. `http_bench --connections=32 --pipeline=16 /api/stats`.
+int main(int argc, char** argv) {
+    std::vector<std::string_view> rest;
+    axle::bench::LoadConfig config = axle::bench::parse_args(argc, argv, rest);
+    if (config.port == 0) {
+        config.port = k_default_port;
+    }
+
+    const std::string path{rest.empty() ? "/health" : rest.front()};
+    const std::string request = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+    const axle::bench::LoadReport report = axle::bench::run_load(
+        config,
+        [&](size_t, uint64_t, std::string& out) { out += request; },
+        count_responses);
+
+    axle::bench::print_report("GET " + path + " pipeline=" + std::to_string(config.pipeline),
+                              report);
+}
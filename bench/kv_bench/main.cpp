@@ -0,0 +1,103 @@
+#include <cstddef>
+#include <cstdint>
+
+#include <charconv>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "load.h"
+
+namespace {
+
+constexpr int k_default_port = 11211;
+constexpr uint64_t k_mix_mul = 0x9e3779b97f4a7c15;
+constexpr size_t k_mix_shift = 29;
+constexpr uint64_t k_ratio_scale = 1000;
+
+uint64_t mix(uint64_t val) {
+    val *= k_mix_mul;
+
+    return val ^ (val >> k_mix_shift);
+}
+
+// Counts complete replies. A get reply ends with `END` after any number of `VALUE` blocks; every
+// other command replies with a single line.
+size_t count_responses(std::span<const uint8_t> buf, size_t& consumed) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    const std::string_view data{reinterpret_cast<const char*>(buf.data()), buf.size()};
+    size_t cnt = 0;
+    size_t pos = 0;
+    consumed = 0;
+
+    for (;;) {
+        const size_t eol = data.find("\r\n", pos);
+        if (eol == std::string_view::npos) {
+            break;
+        }
+
+        const std::string_view line = data.substr(pos, eol - pos);
+        pos = eol + 2;
+        if (line.starts_with("VALUE ")) {
+            size_t len = 0;
+            const std::string_view len_field = line.substr(line.rfind(' ') + 1);
+            (void)std::from_chars(len_field.data(), len_field.data() + len_field.size(), len);
+            pos += len + 2;
+            if (pos > data.size()) {
+                break;
+            }
+            continue;
+        }
+
+        consumed = pos;
+        ++cnt;
+    }
+
+    return cnt;
+}
+
+} // namespace
+
+// Drives the kv_server example with a mix of `get` and `set` over a fixed key space. Accepts the
+// load options understood by `parse_args` plus `--keys=`, `--value-size=` and `--set-ratio=`, e.g.
+// `kv_bench --ports=4 --connections=64 --pipeline=8 --keys=100000 --set-ratio=0.1`.
+int main(int argc, char** argv) {
+    std::vector<std::string_view> rest;
+    axle::bench::LoadConfig config = axle::bench::parse_args(argc, argv, rest);
+    if (config.port == 0) {
+        config.port = k_default_port;
+    }
+
+    uint64_t keys = 10000;
+    size_t value_sz = 100;
+    double set_ratio = 0.1;
+    for (const std::string_view arg : rest) {
+        axle::bench::parse_flag(arg, "--keys=", keys);
+        axle::bench::parse_flag(arg, "--value-size=", value_sz);
+        axle::bench::parse_flag(arg, "--set-ratio=", set_ratio);
+    }
+
+    const std::string value(value_sz, 'x');
+    const std::string set_tail = " 0 0 " + std::to_string(value_sz) + "\r\n" + value + "\r\n";
+    const auto set_threshold = static_cast<uint64_t>(set_ratio * k_ratio_scale);
+
+    const axle::bench::LoadReport report = axle::bench::run_load(
+        config,
+        [&](size_t conn, uint64_t seq, std::string& out) {
+            const uint64_t rnd = mix((static_cast<uint64_t>(conn) << 32) ^ seq);
+            const std::string key = "key:" + std::to_string(rnd % keys);
+            if ((rnd >> 32) % k_ratio_scale < set_threshold) {
+                out.append("set ").append(key).append(set_tail);
+            } else {
+                out.append("get ").append(key).append("\r\n");
+            }
+        },
+        count_responses);
+
+    axle::bench::print_report("kv keys=" + std::to_string(keys) +
+                                  " value-size=" + std::to_string(value_sz) +
+                                  " set-ratio=" + std::to_string(set_ratio) +
+                                  " pipeline=" + std::to_string(config.pipeline),
+                              report);
+}
@@ -0,0 +1,184 @@
+#include "load.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "axle/socket.h"
+#include "axle/status.h"
+
+namespace axle::bench {
+
+namespace {
+
+constexpr size_t k_recv_buf_sz = 64 * 1024;
+constexpr double k_ns_per_us = 1e3;
+constexpr double k_pct_max = 100.0;
+
+using Clock = std::chrono::steady_clock;
+
+struct ConnResult {
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    std::vector<uint64_t> latencies_ns;
+};
+
+ConnResult drive_connection(const LoadConfig& config,
+                            size_t conn,
+                            Clock::time_point deadline,
+                            const RequestWriter& writer,
+                            const ResponseCounter& counter) {
+    ConnResult result;
+
+    ClientSocket socket{};
+    const int port = config.port + static_cast<int>(conn % std::max<size_t>(config.ports, 1));
+    if (socket.connect(config.address, port).is_err()) {
+        ++result.errors;
+
+        return result;
+    }
+
+    std::string out;
+    std::vector<uint8_t> in(k_recv_buf_sz);
+    size_t in_len = 0;
+    uint64_t seq = 0;
+
+    while (Clock::now() < deadline) {
+        out.clear();
+        for (size_t i = 0; i < config.pipeline; ++i) {
+            writer(conn, seq++, out);
+        }
+
+        const Clock::time_point start = Clock::now();
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        const auto* req = reinterpret_cast<const uint8_t*>(out.data());
+        if (socket.send_all(std::span<const uint8_t>{req, out.size()}).is_err()) {
+            ++result.errors;
+            break;
+        }
+
+        size_t outstanding = config.pipeline;
+        while (outstanding > 0) {
+            if (in_len == in.size()) {
+                in.resize(2 * in.size());
+            }
+
+            Status<std::span<uint8_t>, int> res =
+                socket.recv_some(std::span<uint8_t>{in}.subspan(in_len));
+            if (res.is_err() || res.ok().empty()) {
+                ++result.errors;
+
+                return result;
+            }
+            in_len += res.ok().size();
+
+            size_t consumed = 0;
+            const std::span<const uint8_t> received = std::span<const uint8_t>{in}.first(in_len);
+            const size_t cnt = std::min(counter(received, consumed), outstanding);
+            const auto latency = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+            result.latencies_ns.insert(result.latencies_ns.end(), cnt, latency);
+            result.requests += cnt;
+            outstanding -= cnt;
+
+            std::copy(in.begin() + consumed, in.begin() + in_len, in.begin());
+            in_len -= consumed;
+        }
+    }
+
+    return result;
+}
+
+} // namespace
+
+double LoadReport::rps() const {
+    return seconds > 0 ? static_cast<double>(requests) / seconds : 0;
+}
+
+uint64_t LoadReport::percentile(double pct) const {
+    if (latencies_ns.empty()) {
+        return 0;
+    }
+
+    const auto idx = static_cast<size_t>(
+        std::ceil(pct / k_pct_max * static_cast<double>(latencies_ns.size())));
+
+    return latencies_ns.at(std::clamp<size_t>(idx, 1, latencies_ns.size()) - 1);
+}
+
+LoadReport run_load(const LoadConfig& config,
+                    const RequestWriter& writer,
+                    const ResponseCounter& counter) {
+    LoadReport report;
+    std::mutex mtx;
+    std::vector<std::thread> threads;
+    threads.reserve(config.connections);
+
+    const Clock::time_point start = Clock::now();
+    const Clock::time_point deadline = start + config.duration;
+    for (size_t conn = 0; conn < config.connections; ++conn) {
+        threads.emplace_back([&, conn] {
+            ConnResult result = drive_connection(config, conn, deadline, writer, counter);
+
+            const std::lock_guard<std::mutex> lock{mtx};
+            report.requests += result.requests;
+            report.errors += result.errors;
+            report.latencies_ns.insert(
+                report.latencies_ns.end(), result.latencies_ns.begin(), result.latencies_ns.end());
+        });
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::sort(report.latencies_ns.begin(), report.latencies_ns.end());
+
+    return report;
+}
+
+void print_report(std::string_view name, const LoadReport& report) {
+    const auto us = [&](double pct) {
+        return static_cast<double>(report.percentile(pct)) / k_ns_per_us;
+    };
+
+    std::cout << name << ": " << report.requests << " requests in " << report.seconds << " s, "
+              << static_cast<uint64_t>(report.rps()) << " req/s, p50 " << us(50) << " us, p99 "
+              << us(99) << " us, p99.9 " << us(99.9) << " us, max " << us(k_pct_max)
+              << " us, errors " << report.errors << "\n";
+}
+
+LoadConfig parse_args(int argc, char** argv, std::vector<std::string_view>& rest) {
+    LoadConfig config;
+    const std::span<char*> args{argv, static_cast<size_t>(argc)};
+
+    for (const char* raw : args.subspan(1)) {
+        const std::string_view arg{raw};
+        int64_t duration_ms = 0;
+        if (parse_flag(arg, "--port=", config.port) || parse_flag(arg, "--ports=", config.ports) ||
+            parse_flag(arg, "--connections=", config.connections) ||
+            parse_flag(arg, "--pipeline=", config.pipeline)) {
+            continue;
+        }
+        if (parse_flag(arg, "--duration-ms=", duration_ms)) {
+            config.duration = std::chrono::milliseconds{duration_ms};
+            continue;
+        }
+        rest.push_back(arg);
+    }
+
+    return config;
+}
+
+} // namespace axle::bench
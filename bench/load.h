@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <charconv>
+#include <chrono>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace axle::bench {
+
+struct LoadConfig {
+    std::string address = "127.0.0.1";
+    int port = 0;
+    // Connections are spread round-robin over this many consecutive ports starting at `port`.
+    size_t ports = 1;
+    size_t connections = 16;
+    // Requests written back-to-back before waiting for their responses.
+    size_t pipeline = 1;
+    std::chrono::milliseconds duration{5000};
+};
+
+// Appends the bytes of request number `seq` on connection `conn` to `out`.
+using RequestWriter = std::function<void(size_t conn, uint64_t seq, std::string& out)>;
+
+// Returns the number of complete responses at the front of `buf` and sets `consumed` to their
+// total length.
+using ResponseCounter = std::function<size_t(std::span<const uint8_t> buf, size_t& consumed)>;
+
+struct LoadReport {
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    double seconds = 0;
+    // Sorted per-request latencies in nanoseconds.
+    std::vector<uint64_t> latencies_ns;
+
+    double rps() const;
+    uint64_t percentile(double pct) const;
+};
+
+// Opens `config.connections` connections to the server and drives them closed-loop, each from its
+// own thread, for `config.duration`.
+LoadReport run_load(const LoadConfig& config,
+                    const RequestWriter& writer,
+                    const ResponseCounter& counter);
+
+void print_report(std::string_view name, const LoadReport& report);
+
+// Reads the number in `arg` if it is the flag `name`, e.g. `--keys=` in `--keys=1000`. False if
+// it is some other flag or the number does not parse.
+template <typename T>
+bool parse_flag(std::string_view arg, std::string_view name, T& val) {
+    if (!arg.starts_with(name)) {
+        return false;
+    }
+    arg.remove_prefix(name.size());
+    const char* end = arg.data() + arg.size();
+    const std::from_chars_result res = std::from_chars(arg.data(), end, val);
+
+    return res.ec == std::errc{} && res.ptr == end;
+}
+
+// Parses `--port=`, `--ports=`, `--connections=`, `--pipeline=` and `--duration-ms=` from the
+// command line. Unrecognized arguments are left for the caller in `rest`.
+LoadConfig parse_args(int argc, char** argv, std::vector<std::string_view>& rest);
+
+} // namespace axle::bench
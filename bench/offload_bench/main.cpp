@@ -0,0 +1,257 @@
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "load.h"
+
+#include "axle/event.h"
+#include "axle/loop_group.h"
+#include "axle/status.h"
+#include "axle/tcp.h"
+#include "axle/trace.h"
+#include "axle/worker_pool.h"
+
+namespace {
+
+constexpr int k_default_port = 8083;
+constexpr uint64_t k_fnv_offset = 0xcbf29ce484222325;
+constexpr uint64_t k_fnv_prime = 0x100000001b3;
+constexpr size_t k_burn_batch = 1024;
+constexpr size_t k_trace_records = 1 << 20;
+
+// Stands in for compression or encoding: hashes for `duration` of CPU time.
+uint64_t burn(std::chrono::microseconds duration) {
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + duration;
+    uint64_t hash = k_fnv_offset;
+    do {
+        for (size_t i = 0; i < k_burn_batch; ++i) {
+            hash = (hash ^ i) * k_fnv_prime;
+        }
+    } while (std::chrono::steady_clock::now() < deadline);
+
+    return hash;
+}
+
+// Line protocol: `io` is answered straight away, `cpu` after `burn`. Replies are one line each and
+// come back in request order.
+class Session {
+  public:
+    Session(axle::WorkerPool* pool,
+            const std::shared_ptr<axle::EventLoop>& loop,
+            std::chrono::microseconds cpu_time)
+        : cpu_time_{cpu_time} {
+        if (pool != nullptr) {
+            queue_ = std::make_unique<axle::WorkQueue>(*pool, loop);
+        }
+    }
+
+    std::span<uint8_t> recv_buf(size_t max_len) {
+        return std::span<uint8_t>{buf_}.subspan(len_, std::min(buf_.size() - len_, max_len));
+    }
+
+    void post_recv(std::span<uint8_t> buf) {
+        len_ += buf.size();
+
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        std::string_view data{reinterpret_cast<const char*>(buf_.data()), len_};
+        for (size_t eol = data.find('\n'); eol != std::string_view::npos; eol = data.find('\n')) {
+            handle(data.substr(0, eol));
+            data.remove_prefix(eol + 1);
+        }
+
+        std::copy(data.begin(), data.end(), buf_.begin());
+        len_ = data.size() == buf_.size() ? 0 : data.size();
+    }
+
+    std::span<const uint8_t> send_buf(size_t max_len) {
+        const size_t len = std::min<size_t>(out_.size() - sent_, max_len);
+
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return std::span<const uint8_t>{reinterpret_cast<const uint8_t*>(out_.data()), out_.size()}
+            .subspan(sent_, len);
+    }
+
+    void post_send(int64_t len) {
+        sent_ += len;
+        if (sent_ == out_.size()) {
+            out_.clear();
+            sent_ = 0;
+        }
+    }
+
+    void end() {
+        queue_.reset();
+    }
+
+  private:
+    static constexpr size_t k_buf_sz = 4096;
+
+    std::chrono::microseconds cpu_time_;
+    std::unique_ptr<axle::WorkQueue> queue_;
+    std::array<uint8_t, k_buf_sz> buf_{};
+    size_t len_ = 0;
+    std::string out_;
+    size_t sent_ = 0;
+
+    void handle(std::string_view line) {
+        if (line != "cpu") {
+            if (queue_ != nullptr) {
+                queue_->then([this] { out_.append("ok\n"); });
+            } else {
+                out_.append("ok\n");
+            }
+
+            return;
+        }
+
+        if (queue_ != nullptr) {
+            queue_->submit([cpu_time = cpu_time_] { return burn(cpu_time); },
+                           [this](uint64_t hash) { reply_hash(hash); });
+        } else {
+            reply_hash(burn(cpu_time_));
+        }
+    }
+
+    void reply_hash(uint64_t hash) {
+        out_.append(hash % 2 == 0 ? "ok even\n" : "ok odd\n");
+    }
+};
+
+class OffloadServer : public axle::TcpServer<Session> {
+  public:
+    OffloadServer(const std::shared_ptr<axle::EventLoop>& event_loop,
+                  int port,
+                  axle::WorkerPool* pool,
+                  std::chrono::microseconds cpu_time)
+        : TcpServer(event_loop, port),
+          event_loop_{event_loop},
+          pool_{pool},
+          cpu_time_{cpu_time} {}
+
+    std::shared_ptr<Session> handle_connection() override {
+        return std::make_shared<Session>(pool_, event_loop_, cpu_time_);
+    }
+
+  private:
+    std::shared_ptr<axle::EventLoop> event_loop_;
+    axle::WorkerPool* pool_;
+    std::chrono::microseconds cpu_time_;
+};
+
+// Writes the loop's trace to `path`: Chrome trace JSON for a `.json` file, Perfetto protobuf
+// otherwise.
+bool write_trace(const std::string& path, const axle::TraceBuffer& trace) {
+    const std::vector<axle::TraceThread> threads{{1, "loop", trace.records()}};
+    if (path.ends_with(".json")) {
+        std::ofstream out{path};
+        axle::write_chrome_trace(out, threads);
+
+        return out.good();
+    }
+
+    std::ofstream out{path, std::ios::binary};
+    axle::write_perfetto_trace(out, threads);
+
+    return out.good();
+}
+
+size_t count_lines(std::span<const uint8_t> buf, size_t& consumed) {
+    size_t cnt = 0;
+    consumed = 0;
+    for (size_t i = 0; i < buf.size(); ++i) {
+        if (buf[i] == '\n') {
+            ++cnt;
+            consumed = i + 1;
+        }
+    }
+
+    return cnt;
+}
+
+} // namespace
+
+// Serves a mix of cheap and CPU-heavy requests from a single event loop and measures both classes
+// of request at once. `--connections=` clients send only `io` requests and `--cpu-connections=`
+// clients send only `cpu` requests costing `--cpu-us=` each. With `--workers=0` the heavy work runs
+// on the loop thread; otherwise it is offloaded to a worker pool of that size. Compare the `io`
+// tail latency between the two, e.g. `offload_bench --workers=0` and `offload_bench --workers=4`.
+// `--trace=<file>` records the loop's activity, showing which callbacks held it up.
+int main(int argc, char** argv) {
+    std::vector<std::string_view> rest;
+    axle::bench::LoadConfig io_config = axle::bench::parse_args(argc, argv, rest);
+    if (io_config.port == 0) {
+        io_config.port = k_default_port;
+    }
+
+    size_t workers = std::max<size_t>(std::thread::hardware_concurrency(), 2) - 1;
+    size_t cpu_connections = 2;
+    int64_t cpu_us = 500;
+    std::string trace_path;
+    for (const std::string_view arg : rest) {
+        axle::bench::parse_flag(arg, "--workers=", workers);
+        axle::bench::parse_flag(arg, "--cpu-connections=", cpu_connections);
+        axle::bench::parse_flag(arg, "--cpu-us=", cpu_us);
+        if (arg.starts_with("--trace=")) {
+            trace_path = arg.substr(arg.find('=') + 1);
+        }
+    }
+    const std::chrono::microseconds cpu_time{cpu_us};
+
+    std::unique_ptr<axle::WorkerPool> pool;
+    if (workers > 0) {
+        pool = std::make_unique<axle::WorkerPool>(workers);
+    }
+
+    std::unique_ptr<OffloadServer> server;
+    axle::LoopGroup group{{{}}};
+    const axle::Status<axle::None, int> res =
+        group.start([&](size_t, const std::shared_ptr<axle::EventLoop>& loop) {
+            if (!trace_path.empty() && loop->set_tracing(k_trace_records).is_err()) {
+                std::cerr << "tracing is not compiled in\n";
+            }
+            server = std::make_unique<OffloadServer>(loop, io_config.port, pool.get(), cpu_time);
+            server->start();
+        });
+    if (res.is_err()) {
+        std::cerr << "failed to start event loop\n";
+
+        return 1;
+    }
+
+    axle::bench::LoadConfig cpu_config = io_config;
+    cpu_config.connections = cpu_connections;
+    cpu_config.pipeline = 1;
+
+    axle::bench::LoadReport cpu_report;
+    std::thread cpu_thread{[&] {
+        cpu_report = axle::bench::run_load(
+            cpu_config, [](size_t, uint64_t, std::string& out) { out += "cpu\n"; }, count_lines);
+    }};
+    const axle::bench::LoadReport io_report = axle::bench::run_load(
+        io_config, [](size_t, uint64_t, std::string& out) { out += "io\n"; }, count_lines);
+    cpu_thread.join();
+
+    group.stop();
+    // The loop has stopped, so its trace can be read from here.
+    const axle::TraceBuffer* trace = group.loop(0)->trace();
+    if (trace != nullptr && !write_trace(trace_path, *trace)) {
+        std::cerr << "failed to write trace to " << trace_path << "\n";
+    }
+
+    const std::string mode = " workers=" + std::to_string(workers);
+    axle::bench::print_report("io" + mode, io_report);
+    axle::bench::print_report("cpu" + mode + " cpu-us=" + std::to_string(cpu_us), cpu_report);
+}
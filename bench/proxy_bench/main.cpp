@@ -0,0 +1,193 @@
+#include <time.h>
+
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "load.h"
+
+#include "axle/event.h"
+#include "axle/loop_group.h"
+#include "axle/proxy.h"
+#include "axle/status.h"
+#include "axle/tcp.h"
+
+namespace {
+
+constexpr int k_default_port = 8100;
+constexpr size_t k_buf_sz = 256 * 1024;
+constexpr size_t k_default_bulk_kb = 256;
+constexpr double k_bytes_per_mb = 1024.0 * 1024.0;
+constexpr double k_ns_per_ms = 1e6;
+
+// Echoes whatever arrives.
+class Session {
+  public:
+    std::span<uint8_t> recv_buf(size_t max_len) {
+        return std::span<uint8_t>{buf_}.subspan(tail_, std::min(buf_.size() - tail_, max_len));
+    }
+
+    void post_recv(std::span<uint8_t> buf) {
+        tail_ += buf.size();
+    }
+
+    std::span<const uint8_t> send_buf(size_t max_len) {
+        return std::span<const uint8_t>{buf_}.subspan(head_, std::min(tail_ - head_, max_len));
+    }
+
+    void post_send(int64_t len) {
+        head_ += len;
+        if (head_ == tail_) {
+            head_ = 0;
+            tail_ = 0;
+        }
+    }
+
+    void end() {}
+
+  private:
+    std::vector<uint8_t> buf_ = std::vector<uint8_t>(k_buf_sz);
+    size_t head_ = 0;
+    size_t tail_ = 0;
+};
+
+class EchoServer : public axle::TcpServer<Session> {
+  public:
+    EchoServer(const std::shared_ptr<axle::EventLoop>& event_loop, int port)
+        : TcpServer(event_loop, port) {
+        set_write_on_demand();
+    }
+
+    std::shared_ptr<Session> handle_connection() override {
+        return std::make_shared<Session>();
+    }
+};
+
+struct Target {
+    std::string_view name;
+    int port;
+};
+
+// CPU time used so far by the thread running `loop`.
+std::chrono::nanoseconds loop_cpu_time(const std::shared_ptr<axle::EventLoop>& loop) {
+    std::promise<std::chrono::nanoseconds> cpu;
+    (void)loop->post([&cpu] {
+        struct timespec ts{};
+        (void)clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        cpu.set_value(std::chrono::seconds{ts.tv_sec} + std::chrono::nanoseconds{ts.tv_nsec});
+    });
+
+    return cpu.get_future().get();
+}
+
+axle::bench::ResponseCounter count_messages(size_t msg_sz) {
+    return [msg_sz](std::span<const uint8_t> buf, size_t& consumed) {
+        const size_t cnt = buf.size() / msg_sz;
+        consumed = cnt * msg_sz;
+
+        return cnt;
+    };
+}
+
+} // namespace
+
+// Measures the cost of relaying through a `ProxyServer`. An echo server runs on one loop and two
+// proxies in front of it on another, one copying through a buffer and, where `splice` exists, one
+// splicing through pipes (`--pipe-kb=` sizes them). Each target, the echo server itself first as
+// the baseline, is loaded with `--bulk-kb=` messages using the usual load flags; the report gives
+// the throughput and the CPU time the proxy loop spent per GiB relayed. The echo server listens on
+// `--port=`, the proxies on the two ports after it.
+int main(int argc, char** argv) {
+    std::vector<std::string_view> rest;
+    axle::bench::LoadConfig config = axle::bench::parse_args(argc, argv, rest);
+    if (config.port == 0) {
+        config.port = k_default_port;
+    }
+
+    size_t bulk_kb = k_default_bulk_kb;
+    size_t pipe_kb = 0;
+    for (const std::string_view arg : rest) {
+        axle::bench::parse_flag(arg, "--bulk-kb=", bulk_kb);
+        axle::bench::parse_flag(arg, "--pipe-kb=", pipe_kb);
+    }
+    const size_t bulk_sz = std::min(bulk_kb * 1024, k_buf_sz);
+
+    (void)std::signal(SIGPIPE, SIG_IGN);
+
+    std::unique_ptr<EchoServer> echo;
+    std::vector<std::unique_ptr<axle::ProxyServer>> proxies;
+    axle::LoopGroup group{{{}, {}}};
+    const axle::Status<axle::None, int> res =
+        group.start([&](size_t idx, const std::shared_ptr<axle::EventLoop>& loop) {
+            if (idx == 0) {
+                echo = std::make_unique<EchoServer>(loop, config.port);
+                echo->start();
+
+                return;
+            }
+
+            for (const axle::RelayMode mode : {axle::RelayMode::COPY, axle::RelayMode::SPLICE}) {
+                if (mode == axle::RelayMode::SPLICE && !axle::splice_supported()) {
+                    continue;
+                }
+                proxies.push_back(std::make_unique<axle::ProxyServer>(
+                    loop,
+                    config.port + 1 + static_cast<int>(proxies.size()),
+                    "127.0.0.1",
+                    config.port,
+                    mode,
+                    pipe_kb * 1024));
+                proxies.back()->start();
+            }
+        });
+    if (res.is_err()) {
+        std::cerr << "failed to start event loops\n";
+
+        return 1;
+    }
+
+    std::vector<Target> targets{
+        {"direct", config.port},
+        {"copy", config.port + 1},
+    };
+    if (axle::splice_supported()) {
+        targets.push_back({"splice", config.port + 2});
+    }
+
+    const std::string msg(bulk_sz, 'x');
+    for (const Target& target : targets) {
+        axle::bench::LoadConfig target_config = config;
+        target_config.port = target.port;
+
+        const std::chrono::nanoseconds cpu_before = loop_cpu_time(group.loop(1));
+        const axle::bench::LoadReport report = axle::bench::run_load(
+            target_config,
+            [&msg](size_t, uint64_t, std::string& out) { out += msg; },
+            count_messages(bulk_sz));
+        const std::chrono::nanoseconds cpu = loop_cpu_time(group.loop(1)) - cpu_before;
+
+        const std::string name{target.name};
+        axle::bench::print_report(name, report);
+        // Every message crosses the proxy twice, there and back.
+        const double mb = static_cast<double>(report.requests * bulk_sz) / k_bytes_per_mb;
+        std::cout << name << ": " << mb / report.seconds << " MiB/s echoed";
+        if (target.name != "direct" && mb > 0) {
+            std::cout << ", proxy cpu "
+                      << static_cast<double>(cpu.count()) / k_ns_per_ms / (2 * mb / 1024)
+                      << " ms/GiB relayed";
+        }
+        std::cout << "\n";
+    }
+
+    group.stop();
+}
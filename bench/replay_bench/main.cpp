@@ -0,0 +1,424 @@
+#include <sys/uio.h>
+
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <latch>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "load.h"
+
+#include "axle/capture.h"
+#include "axle/event.h"
+#include "axle/loop_group.h"
+#include "axle/socket.h"
+#include "axle/status.h"
+
+namespace {
+
+constexpr int k_default_port = 8081;
+constexpr size_t k_recv_buf_sz = 64 * 1024;
+constexpr double k_bytes_per_mb = 1024.0 * 1024.0;
+
+// Bytes a connection sent, and when, relative to the start of its capture.
+struct Segment {
+    std::chrono::nanoseconds offset;
+    std::span<const uint8_t> data;
+};
+
+// One captured connection.
+struct Stream {
+    std::chrono::nanoseconds open{0};
+    std::vector<Segment> segments;
+    // When the client closed, if the capture saw it.
+    std::optional<std::chrono::nanoseconds> close;
+};
+
+// Groups the records of a capture into streams, in the order they opened. Their data points into
+// `reader`'s mapping of the file.
+std::vector<Stream> load_streams(axle::CaptureReader& reader) {
+    std::vector<Stream> streams;
+    std::unordered_map<uint32_t, size_t> by_number;
+    while (std::optional<axle::CaptureRecord> record = reader.next()) {
+        if (record->kind == axle::CaptureKind::OPEN) {
+            by_number[record->stream] = streams.size();
+            streams.push_back({record->offset, {}, std::nullopt});
+            continue;
+        }
+
+        const auto found = by_number.find(record->stream);
+        if (found == by_number.end()) {
+            continue;
+        }
+        Stream& stream = streams[found->second];
+        if (record->kind == axle::CaptureKind::DATA) {
+            stream.segments.push_back({record->offset, record->data});
+        } else {
+            stream.close = record->offset;
+        }
+    }
+
+    return streams;
+}
+
+struct ReplayStats {
+    uint64_t connections = 0;
+    uint64_t failed = 0;
+    uint64_t segments = 0;
+    uint64_t sent_bytes = 0;
+    uint64_t received_bytes = 0;
+};
+
+// Replays streams against a server over connections of its own, all on one loop. Paced, each
+// connection opens, sends and closes as long after `start` as its capture did after it began;
+// otherwise each sends as fast as the server takes it. Whatever the server sends back is read
+// and counted. A connection is done once the server has closed it after its half-close.
+class Replayer {
+  public:
+    Replayer() = delete;
+    Replayer(const Replayer&) = delete;
+    Replayer& operator=(const Replayer&) = delete;
+    Replayer(Replayer&&) = delete;
+    Replayer& operator=(Replayer&&) = delete;
+
+    Replayer(std::shared_ptr<axle::EventLoop> loop,
+             std::string address,
+             int port,
+             bool paced,
+             std::function<void()> done)
+        : loop_{std::move(loop)},
+          address_{std::move(address)},
+          port_{port},
+          paced_{paced},
+          done_{std::move(done)} {}
+
+    ~Replayer() = default;
+
+    void add(const Stream* stream) {
+        auto conn = std::make_unique<Conn>();
+        conn->stream = stream;
+        conn->timer_id = loop_->make_timer_id();
+        conns_.push_back(std::move(conn));
+    }
+
+    void start(std::chrono::steady_clock::time_point epoch) {
+        epoch_ = epoch;
+        remaining_ = conns_.size();
+        if (remaining_ == 0) {
+            done_();
+
+            return;
+        }
+
+        for (const std::unique_ptr<Conn>& owned : conns_) {
+            Conn& conn = *owned;
+            if (!wait_until(conn, conn.stream->open, [this, &conn] { open(conn); })) {
+                open(conn);
+            }
+        }
+    }
+
+    const ReplayStats& stats() const {
+        return stats_;
+    }
+
+  private:
+    struct Conn {
+        const Stream* stream = nullptr;
+        axle::ClientSocket socket;
+        // The segment being sent, and how much of it has gone.
+        size_t segment = 0;
+        size_t sent = 0;
+        uint64_t timer_id = 0;
+        bool timing = false;
+        bool writing = false;
+        bool shut = false;
+        bool finished = false;
+    };
+
+    std::shared_ptr<axle::EventLoop> loop_;
+    std::string address_;
+    int port_;
+    bool paced_;
+    std::function<void()> done_;
+    std::vector<std::unique_ptr<Conn>> conns_;
+    std::chrono::steady_clock::time_point epoch_;
+    size_t remaining_ = 0;
+    ReplayStats stats_;
+    std::array<uint8_t, k_recv_buf_sz> buf_{};
+
+    // Arms the connection's timer to run `cb` at `offset` into the replay and returns true, or
+    // returns false if that time has come or pacing is off.
+    bool wait_until(Conn& conn, std::chrono::nanoseconds offset, const axle::PostedCb& cb) {
+        if (!paced_) {
+            return false;
+        }
+
+        const std::chrono::nanoseconds wait = epoch_ + offset - std::chrono::steady_clock::now();
+        if (wait.count() <= 0) {
+            return false;
+        }
+
+        auto fire = [&conn, cb](uint64_t, axle::Status<axle::None, int64_t>) {
+            conn.timing = false;
+            cb();
+        };
+        conn.timing =
+            loop_->register_timer(conn.timer_id, static_cast<uint64_t>(wait.count()), false, fire)
+                .is_ok();
+
+        return conn.timing;
+    }
+
+    void open(Conn& conn) {
+        if (conn.socket.connect(address_, port_).is_err() ||
+            conn.socket.set_non_blocking().is_err()) {
+            finish(conn, true);
+
+            return;
+        }
+        ++stats_.connections;
+
+        const axle::Status<axle::None, int> res = loop_->register_fd_read(
+            conn.socket.get_fd(),
+            [this, &conn](uint64_t, axle::Status<int64_t, uint32_t>) { on_readable(conn); });
+        if (res.is_err()) {
+            finish(conn, true);
+
+            return;
+        }
+
+        advance(conn);
+    }
+
+    // Sends what is due, then waits for the next segment to come due or for the socket to take
+    // more.
+    void advance(Conn& conn) {
+        const std::vector<Segment>& segments = conn.stream->segments;
+        while (conn.segment < segments.size()) {
+            const Segment& segment = segments[conn.segment];
+            if (conn.sent == 0 && wait_until(conn, segment.offset, [this, &conn] {
+                    advance(conn);
+                })) {
+                watch_write(conn, false);
+
+                return;
+            }
+
+            const std::span<const uint8_t> rest = segment.data.subspan(conn.sent);
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+            const struct iovec iov{const_cast<uint8_t*>(rest.data()), rest.size()};
+            axle::Status<size_t, int> res = conn.socket.send_some({&iov, 1});
+            if (res.is_err()) {
+                finish(conn, true);
+
+                return;
+            }
+            conn.sent += res.ok();
+            stats_.sent_bytes += res.ok();
+            if (conn.sent < segment.data.size()) {
+                watch_write(conn, true);
+
+                return;
+            }
+
+            ++stats_.segments;
+            ++conn.segment;
+            conn.sent = 0;
+        }
+        watch_write(conn, false);
+
+        if (!conn.shut) {
+            const std::chrono::nanoseconds close_at =
+                conn.stream->close.value_or(std::chrono::nanoseconds{0});
+            if (wait_until(conn, close_at, [this, &conn] { advance(conn); })) {
+                return;
+            }
+            conn.shut = true;
+            if (conn.socket.shutdown_write().is_err()) {
+                finish(conn, true);
+            }
+        }
+    }
+
+    void watch_write(Conn& conn, bool on) {
+        if (on == conn.writing) {
+            return;
+        }
+
+        const int fd = conn.socket.get_fd();
+        if (on) {
+            conn.writing =
+                loop_
+                    ->register_fd_write(fd,
+                                        [this, &conn](uint64_t, axle::Status<int64_t, uint32_t>) {
+                                            advance(conn);
+                                        })
+                    .is_ok();
+        } else {
+            (void)loop_->remove_fd_write(fd);
+            conn.writing = false;
+        }
+    }
+
+    void on_readable(Conn& conn) {
+        axle::Status<std::span<uint8_t>, int> res = conn.socket.recv_some(buf_);
+        if (res.is_err()) {
+            // A server that closes on seeing the half-close, with the last of the input unread,
+            // resets the connection.
+            finish(conn, !conn.shut);
+
+            return;
+        }
+        if (res.ok().empty()) {
+            // Closed by the server, early if there was more to send.
+            finish(conn, !conn.shut);
+
+            return;
+        }
+        stats_.received_bytes += res.ok().size();
+    }
+
+    void finish(Conn& conn, bool failed) {
+        if (conn.finished) {
+            return;
+        }
+        conn.finished = true;
+        if (failed) {
+            ++stats_.failed;
+        }
+
+        watch_write(conn, false);
+        if (conn.timing) {
+            (void)loop_->remove_timer(conn.timer_id);
+        }
+        (void)loop_->remove_fd_read(conn.socket.get_fd());
+        (void)conn.socket.close();
+
+        if (--remaining_ == 0) {
+            done_();
+        }
+    }
+};
+
+} // namespace
+
+// Replays the traffic in capture files, as written by `TcpServer::set_capture`, against a server
+// at `--address=` and `--port=` (127.0.0.1:8081 by default). Every captured connection becomes a
+// connection of its own that sends what the original sent, at the original pacing or, with
+// `--fast`, as fast as the server takes it. `--copies=` replays each connection that many times
+// over, and `--loops=` spreads the connections over that many loops. Reports the bytes sent and
+// received and how long the replay took against the span of the capture.
+//
+// Usage: replay_bench [--address=127.0.0.1] [--port=8081] [--fast] [--copies=1] [--loops=1]
+//                     capture...
+int main(int argc, char** argv) {
+    std::string address = "127.0.0.1";
+    int port = k_default_port;
+    bool paced = true;
+    size_t copies = 1;
+    size_t loops = 1;
+    std::vector<std::string> paths;
+    for (const char* raw : std::span<char*>{argv, static_cast<size_t>(argc)}.subspan(1)) {
+        const std::string_view arg{raw};
+        if (arg.starts_with("--address=")) {
+            address = arg.substr(arg.find('=') + 1);
+        } else if (arg == "--fast") {
+            paced = false;
+        } else if (arg.starts_with("--")) {
+            axle::bench::parse_flag(arg, "--port=", port);
+            axle::bench::parse_flag(arg, "--copies=", copies);
+            axle::bench::parse_flag(arg, "--loops=", loops);
+        } else {
+            paths.emplace_back(arg);
+        }
+    }
+    if (paths.empty() || loops == 0) {
+        std::cerr << "usage: replay_bench [--address=] [--port=] [--fast] [--copies=] [--loops=] "
+                     "capture...\n";
+
+        return 1;
+    }
+
+    // A server that goes away fails the write with `EPIPE` instead of killing the replay.
+    (void)std::signal(SIGPIPE, SIG_IGN);
+
+    try {
+        std::vector<std::unique_ptr<axle::CaptureReader>> readers;
+        std::vector<Stream> streams;
+        std::chrono::nanoseconds span{0};
+        for (const std::string& path : paths) {
+            readers.push_back(std::make_unique<axle::CaptureReader>(path));
+            for (Stream& stream : load_streams(*readers.back())) {
+                if (!stream.segments.empty()) {
+                    span = std::max(span, stream.segments.back().offset);
+                }
+                span = std::max(span, stream.close.value_or(stream.open));
+                streams.push_back(std::move(stream));
+            }
+        }
+
+        std::vector<std::unique_ptr<Replayer>> replayers(loops);
+        std::latch done{static_cast<std::ptrdiff_t>(loops)};
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        axle::LoopGroup group{std::vector<std::vector<int>>(loops)};
+        axle::Status<axle::None, int> res =
+            group.start([&](size_t idx, const std::shared_ptr<axle::EventLoop>& loop) {
+                replayers[idx] = std::make_unique<Replayer>(
+                    loop, address, port, paced, [&done] { done.count_down(); });
+                for (size_t i = idx; i < streams.size() * copies; i += loops) {
+                    replayers[idx]->add(&streams[i % streams.size()]);
+                }
+                replayers[idx]->start(start);
+            });
+        if (res.is_err()) {
+            std::cerr << "failed to start event loops: " << res.err() << "\n";
+
+            return 1;
+        }
+
+        done.wait();
+        const double seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        group.stop();
+
+        ReplayStats total;
+        for (const std::unique_ptr<Replayer>& replayer : replayers) {
+            const ReplayStats& stats = replayer->stats();
+            total.connections += stats.connections;
+            total.failed += stats.failed;
+            total.segments += stats.segments;
+            total.sent_bytes += stats.sent_bytes;
+            total.received_bytes += stats.received_bytes;
+        }
+
+        const double sent_mb = static_cast<double>(total.sent_bytes) / k_bytes_per_mb;
+        std::cout << streams.size() * copies << " streams, " << total.connections
+                  << " connected, " << total.failed << " failed\n"
+                  << total.segments << " segments, " << sent_mb << " MiB sent, "
+                  << static_cast<double>(total.received_bytes) / k_bytes_per_mb
+                  << " MiB received\n"
+                  << seconds << " s against a capture span of "
+                  << std::chrono::duration<double>(span).count() << " s, "
+                  << static_cast<double>(total.segments) / seconds << " segments/s, "
+                  << sent_mb / seconds << " MiB/s sent\n";
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+
+        return 1;
+    }
+}
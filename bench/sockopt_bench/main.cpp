@@ -0,0 +1,152 @@
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "load.h"
+
+#include "axle/event.h"
+#include "axle/loop_group.h"
+#include "axle/socket.h"
+#include "axle/status.h"
+#include "axle/tcp.h"
+
+namespace {
+
+constexpr int k_default_port = 8085;
+constexpr size_t k_buf_sz = 256 * 1024;
+constexpr size_t k_rpc_msg_sz = 64;
+constexpr size_t k_default_bulk_kb = 256;
+constexpr double k_bytes_per_mb = 1024.0 * 1024.0;
+
+// Echoes whatever arrives.
+class Session {
+  public:
+    std::span<uint8_t> recv_buf(size_t max_len) {
+        return std::span<uint8_t>{buf_}.subspan(tail_, std::min(buf_.size() - tail_, max_len));
+    }
+
+    void post_recv(std::span<uint8_t> buf) {
+        tail_ += buf.size();
+    }
+
+    std::span<const uint8_t> send_buf(size_t max_len) {
+        return std::span<const uint8_t>{buf_}.subspan(head_, std::min(tail_ - head_, max_len));
+    }
+
+    void post_send(int64_t len) {
+        head_ += len;
+        if (head_ == tail_) {
+            head_ = 0;
+            tail_ = 0;
+        }
+    }
+
+    void end() {}
+
+  private:
+    std::vector<uint8_t> buf_ = std::vector<uint8_t>(k_buf_sz);
+    size_t head_ = 0;
+    size_t tail_ = 0;
+};
+
+class EchoServer : public axle::TcpServer<Session> {
+  public:
+    EchoServer(const std::shared_ptr<axle::EventLoop>& event_loop,
+               int port,
+               const axle::SocketOptions& options)
+        : TcpServer(event_loop, port) {
+        set_write_on_demand();
+        set_socket_options(options);
+    }
+
+    std::shared_ptr<Session> handle_connection() override {
+        return std::make_shared<Session>();
+    }
+};
+
+struct Profile {
+    std::string_view name;
+    axle::SocketOptions options;
+};
+
+// Counts echoed messages of `msg_sz` bytes.
+axle::bench::ResponseCounter count_messages(size_t msg_sz) {
+    return [msg_sz](std::span<const uint8_t> buf, size_t& consumed) {
+        const size_t cnt = buf.size() / msg_sz;
+        consumed = cnt * msg_sz;
+
+        return cnt;
+    };
+}
+
+axle::bench::RequestWriter write_messages(size_t msg_sz) {
+    return [msg_sz](size_t, uint64_t, std::string& out) { out.append(msg_sz, 'x'); };
+}
+
+} // namespace
+
+// Runs an echo server per socket tuning profile and measures each on loopback under two loads:
+// small request/response messages (`rpc`, latency) and large payloads (`bulk`, throughput, sized
+// by `--bulk-kb=`). The usual load flags apply to both; each profile gets its own port counting
+// up from `--port=`.
+int main(int argc, char** argv) {
+    std::vector<std::string_view> rest;
+    axle::bench::LoadConfig config = axle::bench::parse_args(argc, argv, rest);
+    if (config.port == 0) {
+        config.port = k_default_port;
+    }
+
+    size_t bulk_kb = k_default_bulk_kb;
+    for (const std::string_view arg : rest) {
+        axle::bench::parse_flag(arg, "--bulk-kb=", bulk_kb);
+    }
+    const size_t bulk_sz = std::min(bulk_kb * 1024, k_buf_sz);
+
+    const std::vector<Profile> profiles{
+        {"default", axle::SocketOptions{}},
+        {"low-latency", axle::SocketOptions::low_latency()},
+        {"bulk", axle::SocketOptions::bulk()},
+    };
+
+    std::vector<std::unique_ptr<EchoServer>> servers;
+    axle::LoopGroup group{{{}}};
+    const axle::Status<axle::None, int> res =
+        group.start([&](size_t, const std::shared_ptr<axle::EventLoop>& loop) {
+            for (size_t i = 0; i < profiles.size(); ++i) {
+                servers.push_back(std::make_unique<EchoServer>(
+                    loop, config.port + static_cast<int>(i), profiles[i].options));
+                servers.back()->start();
+            }
+        });
+    if (res.is_err()) {
+        std::cerr << "failed to start event loop\n";
+
+        return 1;
+    }
+
+    for (size_t i = 0; i < profiles.size(); ++i) {
+        axle::bench::LoadConfig profile_config = config;
+        profile_config.port = config.port + static_cast<int>(i);
+        const std::string name{profiles[i].name};
+
+        const axle::bench::LoadReport rpc = axle::bench::run_load(
+            profile_config, write_messages(k_rpc_msg_sz), count_messages(k_rpc_msg_sz));
+        axle::bench::print_report("rpc " + name, rpc);
+
+        const axle::bench::LoadReport bulk =
+            axle::bench::run_load(profile_config, write_messages(bulk_sz), count_messages(bulk_sz));
+        axle::bench::print_report("bulk " + name, bulk);
+        std::cout << "bulk " << name << ": "
+                  << static_cast<double>(bulk.requests * bulk_sz) / k_bytes_per_mb / bulk.seconds
+                  << " MiB/s echoed\n";
+    }
+
+    group.stop();
+}
@@ -0,0 +1,212 @@
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "load.h"
+
+#include "axle/broadcast.h"
+#include "axle/event.h"
+#include "axle/loop_group.h"
+#include "axle/status.h"
+#include "axle/tcp.h"
+#include "axle/websocket.h"
+
+namespace {
+
+constexpr int k_default_port = 8108;
+constexpr size_t k_default_msg_sz = 64;
+constexpr axle::WsMask k_mask{0x12, 0x34, 0x56, 0x78};
+constexpr double k_bytes_per_mb = 1024.0 * 1024.0;
+
+constexpr std::string_view k_upgrade = "GET /bench HTTP/1.1\r\n"
+                                       "Host: localhost\r\n"
+                                       "Upgrade: websocket\r\n"
+                                       "Connection: Upgrade\r\n"
+                                       "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                                       "Sec-WebSocket-Version: 13\r\n\r\n";
+
+// Answers every message with a frame carrying the same shared payload.
+class Session {
+  public:
+    explicit Session(axle::SharedBuffer reply)
+        : reply_{std::move(reply)},
+          ws_{axle::WsConfig{}, [this](axle::WsOpcode opcode, std::span<const uint8_t> payload) {
+                  (void)payload;
+                  (void)ws_.send(opcode, reply_);
+              }} {}
+
+    std::span<uint8_t> recv_buf(size_t max_len) {
+        return ws_.recv_buf(max_len);
+    }
+
+    void post_recv(std::span<uint8_t> buf) {
+        (void)ws_.post_recv(buf);
+    }
+
+    std::span<const uint8_t> send_buf(size_t max_len) {
+        return ws_.send_buf(max_len);
+    }
+
+    size_t send_bufs(std::span<struct iovec> bufs, size_t max_len) {
+        return ws_.send_bufs(bufs, max_len);
+    }
+
+    void post_send(int64_t len) {
+        ws_.post_send(len);
+    }
+
+    bool closing() const {
+        return ws_.closing();
+    }
+
+    void end() {}
+
+  private:
+    axle::SharedBuffer reply_;
+    axle::WsConnection ws_;
+};
+
+class WsServer : public axle::TcpServer<Session, WsServer> {
+  public:
+    WsServer(const std::shared_ptr<axle::EventLoop>& event_loop, int port, size_t msg_sz)
+        : TcpServer(event_loop, port),
+          reply_{axle::make_shared_buffer(std::vector<uint8_t>(msg_sz, 'r'))} {
+        set_write_coalescing();
+    }
+
+    std::shared_ptr<Session> handle_connection() {
+        return std::make_shared<Session>(reply_);
+    }
+
+  private:
+    axle::SharedBuffer reply_;
+};
+
+// A masked binary frame of `msg_sz` bytes, as a browser would send it.
+std::string client_frame(size_t msg_sz) {
+    std::array<uint8_t, axle::k_ws_max_header_sz> header{};
+    const size_t len =
+        axle::ws_encode_header(axle::WsOpcode::BINARY, true, msg_sz, k_mask, header);
+
+    std::vector<uint8_t> payload(msg_sz, 'x');
+    axle::ws_unmask(payload, k_mask);
+
+    std::string frame{header.begin(), header.begin() + static_cast<ptrdiff_t>(len)};
+    frame.append(payload.begin(), payload.end());
+
+    return frame;
+}
+
+// Counts the handshake response and the frames after it.
+size_t count_frames(std::span<const uint8_t> buf, size_t& consumed) {
+    constexpr uint8_t k_len_bits = 0x7f;
+    constexpr uint8_t k_len16 = 126;
+    constexpr uint8_t k_len64 = 127;
+
+    size_t cnt = 0;
+    consumed = 0;
+    while (consumed < buf.size()) {
+        const std::span<const uint8_t> rest = buf.subspan(consumed);
+        if (rest[0] == 'H') {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+            const std::string_view text{reinterpret_cast<const char*>(rest.data()), rest.size()};
+            const size_t end = text.find("\r\n\r\n");
+            if (end == std::string_view::npos) {
+                break;
+            }
+            consumed += end + 4;
+            ++cnt;
+            continue;
+        }
+
+        if (rest.size() < 2) {
+            break;
+        }
+        size_t header_len = 2;
+        uint64_t payload_len = rest[1] & k_len_bits;
+        if (payload_len == k_len16 || payload_len == k_len64) {
+            const size_t len_sz = payload_len == k_len16 ? 2 : sizeof(uint64_t);
+            if (rest.size() < 2 + len_sz) {
+                break;
+            }
+            payload_len = 0;
+            for (const uint8_t byte : rest.subspan(2, len_sz)) {
+                payload_len = (payload_len << 8) | byte;
+            }
+            header_len += len_sz;
+        }
+        if (rest.size() < header_len + payload_len) {
+            break;
+        }
+        consumed += header_len + payload_len;
+        ++cnt;
+    }
+
+    return cnt;
+}
+
+} // namespace
+
+// Measures WebSocket frames per second through `WsConnection` on a `TcpServer`. The server runs on
+// a loop of its own and answers every binary message of `--msg-bytes=` with one of the same size,
+// sent by reference from a shared buffer. Each load connection upgrades with its first request
+// and then sends masked frames, so every frame the server reads is unmasked; the usual load flags
+// set the connections and how many frames each keeps in flight.
+int main(int argc, char** argv) {
+    std::vector<std::string_view> rest;
+    axle::bench::LoadConfig config = axle::bench::parse_args(argc, argv, rest);
+    if (config.port == 0) {
+        config.port = k_default_port;
+    }
+
+    size_t msg_sz = k_default_msg_sz;
+    for (const std::string_view arg : rest) {
+        axle::bench::parse_flag(arg, "--msg-bytes=", msg_sz);
+    }
+
+    std::unique_ptr<WsServer> server;
+    axle::LoopGroup group{{{}}};
+    const axle::Status<axle::None, int> res =
+        group.start([&](size_t, const std::shared_ptr<axle::EventLoop>& loop) {
+            server = std::make_unique<WsServer>(loop, config.port, msg_sz);
+            server->start();
+        });
+    if (res.is_err()) {
+        std::cerr << "failed to start event loop\n";
+
+        return 1;
+    }
+
+    const std::string frame = client_frame(msg_sz);
+    const axle::bench::LoadReport report = axle::bench::run_load(
+        config,
+        [&frame](size_t, uint64_t seq, std::string& out) {
+            if (seq == 0) {
+                out += k_upgrade;
+            } else {
+                out += frame;
+            }
+        },
+        count_frames);
+
+    axle::bench::print_report("ws", report);
+    if (report.requests > 0) {
+        const double frames = static_cast<double>(report.requests) / report.seconds;
+        std::cout << "ws: " << static_cast<uint64_t>(frames) << " frames/s each way, "
+                  << frames * static_cast<double>(msg_sz) / k_bytes_per_mb
+                  << " MiB/s of payload each way\n";
+    }
+
+    group.stop();
+}
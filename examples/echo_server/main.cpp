@@ -1,88 +1,218 @@
 #include <cstddef>
 #include <cstdint>
 
-#include <algorithm>
-#include <array>
+#include <charconv>
+#include <chrono>
 #include <exception>
 #include <iostream>
-#include <iterator>
 #include <memory>
+#include <optional>
 #include <span>
+#include <string>
+#include <string_view>
 #include <utility>
+#include <vector>
 
+#include "axle/buffer_pool.h"
+#include "axle/capture.h"
 #include "axle/event.h"
+#include "axle/handoff.h"
+#include "axle/loop_group.h"
+#include "axle/rebalance.h"
+#include "axle/status.h"
 #include "axle/tcp.h"
 
+constexpr size_t k_buf_sz = 1024;
+// Returned buffers kept for reuse per loop; beyond this they go back to the allocator.
+constexpr size_t k_cached_bufs = 1024;
+// Space set aside for each loop's capture file; the file is cut to what was used on exit.
+constexpr size_t k_capture_sz = size_t{256} << 20;
+// How long connections get to finish once a replacement has taken over.
+constexpr std::chrono::seconds k_drain_deadline{30};
+
+// Holds a buffer only while it has bytes to echo, so idle connections stay small. A full buffer
+// lends no room to read into, which stops the server reading until the echo has gone out.
 class Session {
   public:
-    std::span<uint8_t> recv_buf(size_t max_len) {
-        if (tail_ == buf_.end()) {
-            return std::span<uint8_t>{};
-        };
+    explicit Session(axle::BufferPool& pool)
+        : buf_{pool} {}
 
-        const size_t len = std::min<size_t>(buf_.end() - tail_, max_len);
-
-        return std::span<uint8_t>{tail_, tail_ + len};
+    std::span<uint8_t> recv_buf(size_t max_len) {
+        return buf_.writable(max_len);
     }
 
     void post_recv(std::span<uint8_t> buf) {
-        std::advance(tail_, buf.size());
+        buf_.commit(buf.size());
     }
 
     std::span<const uint8_t> send_buf(size_t max_len) {
-        if (head_ == tail_) {
-            return std::span<uint8_t>{};
-        }
-
-        const size_t len = std::min<size_t>(tail_ - head_, max_len);
-
-        return std::span<const uint8_t>{head_, head_ + len};
+        return buf_.readable(max_len);
     }
 
     void post_send(int64_t len) {
-        std::advance(head_, len);
-        if (tail_ == buf_.end() && head_ == tail_) {
-            reset();
-        }
+        buf_.consume(len);
     }
 
     void end() {}
 
-    void reset() {
-        head_ = buf_.begin();
-        tail_ = buf_.begin();
+    void set_pool(axle::BufferPool& pool) {
+        buf_.set_pool(pool);
     }
 
   private:
-    static constexpr size_t k_buf_sz = 1024;
-
-    std::array<uint8_t, k_buf_sz> buf_{};
-    std::array<uint8_t, k_buf_sz>::iterator head_{buf_.begin()};
-    std::array<uint8_t, k_buf_sz>::iterator tail_{buf_.begin()};
+    axle::LazyBuffer buf_;
 };
 
-class EchoServer : public axle::TcpServer<Session> {
+// Passes itself to `TcpServer` so that new sessions are made without a virtual call.
+class EchoServer : public axle::TcpServer<Session, EchoServer> {
   public:
-    explicit EchoServer(std::shared_ptr<axle::EventLoop> event_loop, int port)
-        : TcpServer(std::move(event_loop), port) {}
+    EchoServer(std::shared_ptr<axle::EventLoop> event_loop, int port, axle::BufferPool& pool)
+        : TcpServer(std::move(event_loop), port),
+          pool_{pool} {
+        set_write_coalescing();
+    }
 
-    std::shared_ptr<Session> handle_connection() override {
-        return std::make_shared<Session>();
+    EchoServer(std::shared_ptr<axle::EventLoop> event_loop,
+               axle::ServerSocket&& listener,
+               axle::BufferPool& pool)
+        : TcpServer(std::move(event_loop), std::move(listener)),
+          pool_{pool} {
+        set_write_coalescing();
     }
+
+    std::shared_ptr<Session> handle_connection() {
+        return std::make_shared<Session>(pool_);
+    }
+
+    // Pools are per loop.
+    void handle_migrated(axle::ConnHandle, Session& session) override {
+        session.set_pool(pool_);
+    }
+
+  private:
+    axle::BufferPool& pool_;
 };
 
+// Runs one echo server per loop, all on the same port. With `--pin`, loop `i` is pinned to CPU `i`
+// and the kernel hands each server the connections whose packets arrive on its CPU. With
+// `--rebalance`, loops busier than their peers move connections over to them. With
+// `--capture=<path>`, what clients send is recorded for `replay_bench`, in `<path>` or, with
+// several loops, in `<path>.<loop>`.
+//
+// With `--handoff=<path>`, a new instance started while another runs with the same path takes
+// over its listeners, one per loop, without a connection being refused; the old one stops
+// accepting, gives its connections `k_drain_deadline` to finish, and exits.
+//
+// Usage: echo_server [--loops=1] [--pin] [--rebalance] [--capture=<path>] [--handoff=<path>]
 int main(int argc, char** argv) {
-    (void)argc;
-    (void)argv;
-
     constexpr int port = 8081;
 
+    size_t loops = 1;
+    bool pin = false;
+    bool rebalance = false;
+    std::string capture_path;
+    std::string handoff_path;
+    for (const char* raw : std::span<char*>{argv, static_cast<size_t>(argc)}.subspan(1)) {
+        const std::string_view arg{raw};
+        if (arg.starts_with("--loops=")) {
+            (void)std::from_chars(arg.data() + arg.find('=') + 1, arg.data() + arg.size(), loops);
+        } else if (arg == "--pin") {
+            pin = true;
+        } else if (arg == "--rebalance") {
+            rebalance = true;
+        } else if (arg.starts_with("--capture=")) {
+            capture_path = arg.substr(arg.find('=') + 1);
+        } else if (arg.starts_with("--handoff=")) {
+            handoff_path = arg.substr(arg.find('=') + 1);
+        } else {
+            std::cerr << "unknown argument: " << arg << "\n";
+
+            return 1;
+        }
+    }
+
     try {
-        const std::shared_ptr<axle::EventLoop> event_loop = std::make_shared<axle::EventLoop>();
-        EchoServer server{event_loop, port};
+        std::optional<axle::Takeover> takeover;
+        if (!handoff_path.empty()) {
+            axle::Status<axle::Takeover, int> res = axle::take_listeners(handoff_path);
+            if (res.is_ok()) {
+                takeover.emplace(res.ok());
+                // The listeners decide the loops, whatever the flag says.
+                loops = takeover->listeners.size();
+            }
+        }
+
+        // Declared first so that the pools outlive the sessions holding their buffers.
+        std::vector<std::unique_ptr<axle::BufferPool>> pools(loops);
+        std::vector<std::unique_ptr<axle::CaptureWriter>> captures(loops);
+        std::vector<std::unique_ptr<EchoServer>> servers(loops);
+        axle::Rebalancer<EchoServer> rebalancer{loops, axle::RebalanceConfig{}};
+        axle::LoopGroup group{pin ? axle::LoopGroup::one_per_cpu(loops)
+                                  : std::vector<std::vector<int>>(loops)};
+
+        axle::Status<axle::None, int> res =
+            group.start([&](size_t idx, const std::shared_ptr<axle::EventLoop>& event_loop) {
+                pools[idx] = std::make_unique<axle::BufferPool>(k_buf_sz, k_cached_bufs);
+                if (takeover) {
+                    servers[idx] = std::make_unique<EchoServer>(
+                        event_loop, std::move(takeover->listeners[idx]), *pools[idx]);
+                } else {
+                    servers[idx] = std::make_unique<EchoServer>(event_loop, port, *pools[idx]);
+                }
+                if (pin) {
+                    servers[idx]->set_incoming_cpu(group.cpu(idx));
+                } else if (loops > 1) {
+                    servers[idx]->set_reuse_port();
+                }
+                if (!capture_path.empty()) {
+                    captures[idx] = std::make_unique<axle::CaptureWriter>(
+                        loops > 1 ? capture_path + "." + std::to_string(idx) : capture_path,
+                        k_capture_sz);
+                    servers[idx]->set_capture(captures[idx].get());
+                }
+                servers[idx]->start();
+                if (rebalance && rebalancer.join(idx, *servers[idx]).is_err()) {
+                    std::cerr << "failed to start rebalancing loop " << idx << "\n";
+                }
+            });
+        if (res.is_err()) {
+            std::cerr << "failed to start event loops: " << res.err() << "\n";
+
+            return 1;
+        }
+
+        std::unique_ptr<axle::ListenerHandoff> handoff;
+        if (!handoff_path.empty()) {
+            if (takeover && axle::confirm_takeover(*takeover).is_err()) {
+                std::cerr << "failed to confirm the takeover\n";
+            }
+
+            std::vector<int> listeners;
+            for (const std::unique_ptr<EchoServer>& server : servers) {
+                listeners.push_back(server->listener_fd());
+            }
+            // Each server drains on its own loop, and the loop exits once it has.
+            auto drain_all = [&] {
+                for (size_t idx = 0; idx < loops; ++idx) {
+                    const std::shared_ptr<axle::EventLoop>& event_loop = group.loop(idx);
+                    (void)event_loop->post([&server = *servers[idx], event_loop] {
+                        server.drain(k_drain_deadline, [event_loop] {
+                            (void)event_loop->shutdown();
+                        });
+                    });
+                }
+            };
+            (void)group.loop(0)->post([&, listeners, drain_all] {
+                try {
+                    handoff = std::make_unique<axle::ListenerHandoff>(
+                        group.loop(0), handoff_path, listeners, drain_all);
+                } catch (const std::exception& e) {
+                    std::cerr << e.what() << "\n";
+                }
+            });
+        }
 
-        server.start();
-        event_loop->run();
+        group.join();
     } catch (const std::exception& e) {
         std::cerr << e.what() << "\n";
     }
@@ -0,0 +1,279 @@
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "axle/event.h"
+#include "axle/http.h"
+#include "axle/status.h"
+#include "axle/tcp.h"
+
+struct Stats {
+    uint64_t connections = 0;
+    uint64_t requests = 0;
+};
+
+// Serves a health check and a small JSON API. Pipelined requests that arrive in one read are
+// answered with a single batch of responses. Connections stay open until the client closes them,
+// or until the server has answered a malformed request or one that is not keep-alive.
+class Session {
+  public:
+    explicit Session(Stats& stats) : stats_{stats} {
+        ++stats_.connections;
+        out_.reserve(k_buf_sz);
+    }
+
+    std::span<uint8_t> recv_buf(size_t max_len) {
+        if (tail_ == buf_.size() && head_ != 0) {
+            compact();
+        }
+
+        const size_t len = std::min<size_t>(buf_.size() - tail_, max_len);
+
+        return std::span<uint8_t>{buf_}.subspan(tail_, len);
+    }
+
+    void post_recv(std::span<uint8_t> buf) {
+        tail_ += buf.size();
+        process();
+    }
+
+    std::span<const uint8_t> send_buf(size_t max_len) {
+        const size_t len = std::min<size_t>(out_.size() - sent_, max_len);
+
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return std::span<const uint8_t>{reinterpret_cast<const uint8_t*>(out_.data()), out_.size()}
+            .subspan(sent_, len);
+    }
+
+    void post_send(int64_t len) {
+        sent_ += len;
+        if (sent_ == out_.size()) {
+            out_.clear();
+            sent_ = 0;
+        }
+    }
+
+    void end() {
+        --stats_.connections;
+    }
+
+    bool closing() const {
+        return state_ == State::CLOSING;
+    }
+
+  private:
+    enum class State : uint8_t {
+        HEAD,
+        BODY,
+        CHUNKED,
+        // The last response is queued. Input is dropped until the connection closes.
+        CLOSING,
+    };
+
+    static constexpr size_t k_buf_sz = 64 * 1024;
+
+    Stats& stats_;
+    std::array<uint8_t, k_buf_sz> buf_{};
+    size_t head_ = 0;
+    size_t tail_ = 0;
+    std::string out_;
+    size_t sent_ = 0;
+
+    State state_ = State::HEAD;
+    axle::HttpRequestParser parser_;
+    axle::ChunkedDecoder decoder_;
+    size_t head_len_ = 0;
+    size_t chunked_len_ = 0;
+    std::string chunked_body_;
+
+    // Moves the unprocessed bytes to the front of the buffer. The parsed request points into the
+    // old location, so a request that is still waiting for its body gets parsed again.
+    void compact() {
+        std::copy(buf_.begin() + head_, buf_.begin() + tail_, buf_.begin());
+        tail_ -= head_;
+        head_ = 0;
+        if (state_ != State::CLOSING) {
+            parser_.reset();
+            decoder_.reset();
+            chunked_body_.clear();
+            chunked_len_ = 0;
+            state_ = State::HEAD;
+        }
+    }
+
+    void process() {
+        for (;;) {
+            const std::span<const uint8_t> data =
+                std::span<const uint8_t>{buf_}.subspan(head_, tail_ - head_);
+
+            switch (state_) {
+            case State::HEAD: {
+                axle::Status<size_t, axle::HttpError> res = parser_.parse(data);
+                if (res.is_err()) {
+                    fail("400 Bad Request");
+
+                    return;
+                }
+                head_len_ = res.ok();
+                if (head_len_ == 0) {
+                    if (head_ == 0 && tail_ == buf_.size()) {
+                        fail("431 Request Header Fields Too Large");
+                    }
+
+                    return;
+                }
+                state_ = parser_.request().chunked ? State::CHUNKED : State::BODY;
+                break;
+            }
+
+            case State::BODY: {
+                const size_t len = head_len_ + parser_.request().content_length;
+                if (len > buf_.size()) {
+                    fail("413 Content Too Large");
+
+                    return;
+                }
+                if (data.size() < len) {
+                    return;
+                }
+                finish(data.subspan(head_len_, parser_.request().content_length), len);
+                break;
+            }
+
+            case State::CHUNKED: {
+                axle::Status<axle::ChunkedResult, axle::HttpError> res =
+                    decoder_.decode(data.subspan(head_len_ + chunked_len_));
+                if (res.is_err()) {
+                    fail("400 Bad Request");
+
+                    return;
+                }
+
+                const axle::ChunkedResult chunk = res.ok();
+                chunked_body_.append(chunk.data.begin(), chunk.data.end());
+                chunked_len_ += chunk.consumed;
+                if (decoder_.done()) {
+                    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+                    const auto* body = reinterpret_cast<const uint8_t*>(chunked_body_.data());
+                    finish(std::span<const uint8_t>{body, chunked_body_.size()},
+                           head_len_ + chunked_len_);
+                    chunked_body_.clear();
+                    chunked_len_ = 0;
+                    decoder_.reset();
+                } else if (chunk.consumed == 0) {
+                    if (head_ == 0 && tail_ == buf_.size()) {
+                        fail("413 Content Too Large");
+                    }
+
+                    return;
+                }
+                break;
+            }
+
+            case State::CLOSING: {
+                head_ = tail_;
+
+                return;
+            }
+            }
+        }
+    }
+
+    void finish(std::span<const uint8_t> body, size_t len) {
+        handle(parser_.request(), body);
+
+        head_ += len;
+        if (head_ == tail_) {
+            head_ = 0;
+            tail_ = 0;
+        }
+        parser_.reset();
+        if (state_ != State::CLOSING) {
+            state_ = State::HEAD;
+        }
+    }
+
+    void handle(const axle::HttpRequest& req, std::span<const uint8_t> body) {
+        ++stats_.requests;
+        if (!req.keep_alive) {
+            state_ = State::CLOSING;
+        }
+
+        const std::string_view path = req.target.substr(0, req.target.find('?'));
+        if (path == "/health") {
+            respond("200 OK", "text/plain", "ok\n");
+        } else if (path == "/api/stats" && req.method == "GET") {
+            std::string json = R"({"connections":)" + std::to_string(stats_.connections) +
+                               R"(,"requests":)" + std::to_string(stats_.requests) + "}";
+            respond("200 OK", "application/json", json);
+        } else if (path == "/api/echo" && req.method == "POST") {
+            std::string json = R"({"length":)" + std::to_string(body.size()) + "}";
+            respond("200 OK", "application/json", json);
+        } else {
+            respond("404 Not Found", "application/json", R"({"error":"not found"})");
+        }
+    }
+
+    // Answers a request that cannot be read past, and closes the connection once the answer is out.
+    void fail(std::string_view status) {
+        state_ = State::CLOSING;
+        respond(status, "application/json", R"({"error":"bad request"})");
+        head_ = tail_;
+    }
+
+    void respond(std::string_view status, std::string_view content_type, std::string_view body) {
+        std::array<char, 20> len{};
+        const std::to_chars_result res =
+            std::to_chars(len.data(), len.data() + len.size(), body.size());
+
+        out_.append("HTTP/1.1 ").append(status);
+        out_.append("\r\nContent-Type: ").append(content_type);
+        out_.append("\r\nContent-Length: ").append(len.data(), res.ptr);
+        if (state_ == State::CLOSING) {
+            out_.append("\r\nConnection: close");
+        }
+        out_.append("\r\n\r\n").append(body);
+    }
+};
+
+class HttpServer : public axle::TcpServer<Session> {
+  public:
+    explicit HttpServer(std::shared_ptr<axle::EventLoop> event_loop, int port)
+        : TcpServer(std::move(event_loop), port) {
+        set_write_coalescing();
+    }
+
+    std::shared_ptr<Session> handle_connection() override {
+        return std::make_shared<Session>(stats_);
+    }
+
+  private:
+    Stats stats_;
+};
+
+int main(int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+
+    constexpr int port = 8082;
+
+    try {
+        const std::shared_ptr<axle::EventLoop> event_loop = std::make_shared<axle::EventLoop>();
+        HttpServer server{event_loop, port};
+
+        server.start();
+        event_loop->run();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+    }
+}
@@ -0,0 +1,327 @@
+#include "cache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+// NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+
+namespace {
+
+constexpr size_t k_min_chunk_sz = 64;
+constexpr size_t k_chunk_align = 8;
+constexpr size_t k_growth_num = 5;
+constexpr size_t k_growth_den = 4;
+constexpr size_t k_min_slots = 1024;
+constexpr size_t k_max_load_num = 7;
+constexpr size_t k_max_load_den = 10;
+
+constexpr uint64_t k_hash_seed = 0x9e3779b97f4a7c15;
+constexpr uint64_t k_hash_mul = 0xff51afd7ed558ccd;
+constexpr size_t k_hash_shift = 33;
+
+uint64_t mix(uint64_t val) {
+    val ^= val >> k_hash_shift;
+    val *= k_hash_mul;
+    val ^= val >> k_hash_shift;
+
+    return val;
+}
+
+} // namespace
+
+namespace kv {
+
+uint64_t hash_key(std::string_view key) {
+    uint64_t hash = k_hash_seed ^ key.size();
+    while (key.size() >= sizeof(uint64_t)) {
+        uint64_t word = 0;
+        std::memcpy(&word, key.data(), sizeof(word));
+        hash = mix(hash ^ word);
+        key.remove_prefix(sizeof(word));
+    }
+
+    uint64_t tail = 0;
+    std::memcpy(&tail, key.data(), key.size());
+
+    return mix(hash ^ tail);
+}
+
+std::string_view Item::key() const {
+    return {reinterpret_cast<const char*>(this + 1), key_len};
+}
+
+std::span<const uint8_t> Item::value() const {
+    return {reinterpret_cast<const uint8_t*>(this + 1) + key_len, value_len};
+}
+
+Cache::Cache(size_t bytes_limit) : slots_(k_min_slots, Slot{0, nullptr}) {
+    stats_.bytes_limit = bytes_limit;
+
+    for (size_t sz = k_min_chunk_sz; sz < k_page_sz;) {
+        classes_.push_back(SlabClass{sz, {}, {}});
+        sz = (sz * k_growth_num / k_growth_den + k_chunk_align - 1) & ~(k_chunk_align - 1);
+    }
+    classes_.push_back(SlabClass{k_page_sz, {}, {}});
+}
+
+const Item* Cache::get(std::string_view key, uint32_t now) {
+    const size_t idx = find(key, hash_key(key));
+    if (idx == slots_.size()) {
+        ++stats_.misses;
+
+        return nullptr;
+    }
+
+    Item* item = slots_[idx].item;
+    if (item->expires != 0 && item->expires <= now) {
+        erase(idx);
+        release(item);
+        ++stats_.misses;
+
+        return nullptr;
+    }
+
+    item->referenced = 1;
+    ++stats_.hits;
+
+    return item;
+}
+
+bool Cache::set(std::string_view key,
+                uint32_t flags,
+                uint32_t expires,
+                std::span<const uint8_t> value) {
+    if (key.empty() || key.size() > k_max_key_len) {
+        return false;
+    }
+
+    const uint64_t hash = hash_key(key);
+    const size_t idx = find(key, hash);
+    if (idx != slots_.size()) {
+        Item* old = slots_[idx].item;
+        erase(idx);
+        release(old);
+    }
+
+    Item* item = alloc(sizeof(Item) + key.size() + value.size());
+    if (item == nullptr) {
+        return false;
+    }
+
+    const uint8_t cls = item->cls;
+    item = new (item) Item{hash,
+                           static_cast<uint32_t>(value.size()),
+                           flags,
+                           expires,
+                           static_cast<uint16_t>(key.size()),
+                           cls,
+                           0};
+    auto* data = reinterpret_cast<uint8_t*>(item + 1);
+    std::memcpy(data, key.data(), key.size());
+    std::memcpy(data + key.size(), value.data(), value.size());
+
+    insert(item);
+
+    return true;
+}
+
+bool Cache::del(std::string_view key) {
+    const size_t idx = find(key, hash_key(key));
+    if (idx == slots_.size()) {
+        return false;
+    }
+
+    Item* item = slots_[idx].item;
+    erase(idx);
+    release(item);
+
+    return true;
+}
+
+const CacheStats& Cache::stats() const {
+    return stats_;
+}
+
+Item* Cache::alloc(size_t len) {
+    const auto it = std::lower_bound(
+        classes_.begin(), classes_.end(), len, [](const SlabClass& cls, size_t sz) {
+            return cls.chunk_sz < sz;
+        });
+    if (it == classes_.end()) {
+        return nullptr;
+    }
+    SlabClass& cls = *it;
+
+    if (cls.free.empty() && stats_.bytes_allocated + k_page_sz <= stats_.bytes_limit) {
+        carve(cls, pages_.emplace_back(std::make_unique<uint8_t[]>(k_page_sz)).get());
+        stats_.bytes_allocated += k_page_sz;
+    } else if (cls.free.empty() && cls.pages.empty()) {
+        // Memory went to other size classes before this one saw any traffic.
+        reassign_page(cls);
+    }
+
+    Item* item = nullptr;
+    if (!cls.free.empty()) {
+        item = cls.free.back();
+        cls.free.pop_back();
+    } else {
+        item = evict(cls);
+        if (item == nullptr) {
+            return nullptr;
+        }
+    }
+
+    item->cls = static_cast<uint8_t>(it - classes_.begin());
+
+    return item;
+}
+
+void Cache::carve(SlabClass& cls, uint8_t* page) {
+    cls.pages.push_back(page);
+
+    // Hand out chunks front to back so the first items share cache lines and pages. Headers are
+    // cleared because a reassigned page still holds items laid out for another chunk size.
+    const size_t cnt = k_page_sz / cls.chunk_sz;
+    for (size_t i = cnt; i > 0; --i) {
+        cls.free.push_back(new (page + (i - 1) * cls.chunk_sz) Item{});
+    }
+}
+
+// Takes the last page of the class holding the most pages, dropping whatever it stores, and
+// carves it for `dst`.
+void Cache::reassign_page(SlabClass& dst) {
+    const auto victim_it = std::max_element(
+        classes_.begin(), classes_.end(), [](const SlabClass& lhs, const SlabClass& rhs) {
+            return lhs.pages.size() < rhs.pages.size();
+        });
+    if (victim_it->pages.empty()) {
+        return;
+    }
+    SlabClass& victim = *victim_it;
+
+    uint8_t* page = victim.pages.back();
+    victim.pages.pop_back();
+    victim.hand = 0;
+    std::erase_if(victim.free, [&](Item* item) {
+        const auto* chunk = reinterpret_cast<uint8_t*>(item);
+        return chunk >= page && chunk < page + k_page_sz;
+    });
+
+    for (size_t off = 0; off + victim.chunk_sz <= k_page_sz; off += victim.chunk_sz) {
+        auto* item = reinterpret_cast<Item*>(page + off);
+        const size_t idx = find(item->key(), item->hash);
+        if (idx != slots_.size() && slots_[idx].item == item) {
+            erase(idx);
+            --stats_.items;
+            ++stats_.evictions;
+        }
+    }
+
+    carve(dst, page);
+}
+
+Item* Cache::evict(SlabClass& cls) {
+    const size_t per_page = k_page_sz / cls.chunk_sz;
+    const size_t total = per_page * cls.pages.size();
+
+    // Two turns of the hand are enough to find an item whose reference bit is clear.
+    for (size_t step = 0; step < 2 * total; ++step) {
+        const size_t pos = cls.hand;
+        cls.hand = (cls.hand + 1) % total;
+
+        uint8_t* chunk = cls.pages[pos / per_page] + (pos % per_page) * cls.chunk_sz;
+        auto* item = reinterpret_cast<Item*>(chunk);
+        if (item->referenced != 0) {
+            item->referenced = 0;
+            continue;
+        }
+
+        const size_t idx = find(item->key(), item->hash);
+        if (idx != slots_.size()) {
+            erase(idx);
+            --stats_.items;
+            ++stats_.evictions;
+        }
+
+        return item;
+    }
+
+    return nullptr;
+}
+
+void Cache::release(Item* item) {
+    --stats_.items;
+    item->referenced = 0;
+    classes_[item->cls].free.push_back(item);
+}
+
+size_t Cache::find(std::string_view key, uint64_t hash) const {
+    const size_t mask = slots_.size() - 1;
+    for (size_t idx = hash & mask; slots_[idx].item != nullptr; idx = (idx + 1) & mask) {
+        if (slots_[idx].hash == hash && slots_[idx].item->key() == key) {
+            return idx;
+        }
+    }
+
+    return slots_.size();
+}
+
+void Cache::insert(Item* item) {
+    if ((stats_.items + 1) * k_max_load_den > slots_.size() * k_max_load_num) {
+        grow();
+    }
+
+    const size_t mask = slots_.size() - 1;
+    size_t idx = item->hash & mask;
+    while (slots_[idx].item != nullptr) {
+        idx = (idx + 1) & mask;
+    }
+    slots_[idx] = Slot{item->hash, item};
+    ++stats_.items;
+}
+
+// Backward-shift deletion keeps probe sequences intact without tombstones.
+void Cache::erase(size_t idx) {
+    const size_t mask = slots_.size() - 1;
+    size_t next = (idx + 1) & mask;
+    while (slots_[next].item != nullptr) {
+        const size_t home = slots_[next].hash & mask;
+        if (((next - home) & mask) >= ((next - idx) & mask)) {
+            slots_[idx] = slots_[next];
+            idx = next;
+        }
+        next = (next + 1) & mask;
+    }
+    slots_[idx] = Slot{0, nullptr};
+}
+
+void Cache::grow() {
+    std::vector<Slot> old(2 * slots_.size(), Slot{0, nullptr});
+    old.swap(slots_);
+
+    const size_t mask = slots_.size() - 1;
+    for (const Slot& slot : old) {
+        if (slot.item == nullptr) {
+            continue;
+        }
+        size_t idx = slot.hash & mask;
+        while (slots_[idx].item != nullptr) {
+            idx = (idx + 1) & mask;
+        }
+        slots_[idx] = slot;
+    }
+}
+
+} // namespace kv
+
+// NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
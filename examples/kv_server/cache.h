@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace kv {
+
+// Header of a cached item. The key and then the value follow it in the same slab chunk.
+struct Item {
+    uint64_t hash;
+    uint32_t value_len;
+    uint32_t flags;
+    uint32_t expires;
+    uint16_t key_len;
+    uint8_t cls;
+    uint8_t referenced;
+
+    std::string_view key() const;
+    std::span<const uint8_t> value() const;
+};
+
+struct CacheStats {
+    uint64_t items = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t bytes_limit = 0;
+    size_t bytes_allocated = 0;
+};
+
+// Single-threaded key-value store bounded by a memory limit. Items live in size-classed slab
+// chunks and are indexed by an open-addressed, linearly probed hash table. When a size class runs
+// out of chunks and no memory is left for a new slab page, a CLOCK sweep over that class evicts an
+// item that has not been read since the hand last passed it. A class that never received a page
+// takes one from the class holding the most.
+class Cache {
+  public:
+    static constexpr size_t k_max_key_len = 250;
+    static constexpr size_t k_page_sz = 1024 * 1024;
+
+    Cache() = delete;
+    Cache(const Cache&) = delete;
+    Cache& operator=(const Cache&) = delete;
+    Cache(Cache&&) = delete;
+    Cache& operator=(Cache&&) = delete;
+
+    explicit Cache(size_t bytes_limit);
+
+    ~Cache() = default;
+
+    // The returned item stays valid until the next call to `set` or `del`.
+    const Item* get(std::string_view key, uint32_t now);
+    bool set(std::string_view key,
+             uint32_t flags,
+             uint32_t expires,
+             std::span<const uint8_t> value);
+    bool del(std::string_view key);
+
+    const CacheStats& stats() const;
+
+  private:
+    struct Slot {
+        uint64_t hash;
+        Item* item;
+    };
+
+    struct SlabClass {
+        size_t chunk_sz;
+        std::vector<Item*> free;
+        std::vector<uint8_t*> pages;
+        size_t hand = 0;
+    };
+
+    std::vector<std::unique_ptr<uint8_t[]>> pages_;
+    std::vector<SlabClass> classes_;
+    std::vector<Slot> slots_;
+    CacheStats stats_;
+
+    Item* alloc(size_t len);
+    void carve(SlabClass& cls, uint8_t* page);
+    void reassign_page(SlabClass& dst);
+    Item* evict(SlabClass& cls);
+    void release(Item* item);
+
+    size_t find(std::string_view key, uint64_t hash) const;
+    void insert(Item* item);
+    void erase(size_t idx);
+    void grow();
+};
+
+uint64_t hash_key(std::string_view key);
+
+} // namespace kv
@@ -0,0 +1,94 @@
+#include <cstddef>
+#include <cstdint>
+
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "cache.h"
+#include "session.h"
+
+#include "axle/event.h"
+#include "axle/tcp.h"
+
+namespace {
+
+constexpr int k_default_port = 11211;
+constexpr size_t k_default_memory_mb = 64;
+constexpr size_t k_bytes_per_mb = 1024 * 1024;
+
+} // namespace
+
+class KvServer : public axle::TcpServer<kv::Session> {
+  public:
+    explicit KvServer(const std::shared_ptr<axle::EventLoop>& event_loop,
+                      int port,
+                      size_t bytes_limit)
+        : TcpServer(event_loop, port),
+          event_loop_{event_loop},
+          cache_{bytes_limit},
+          epoch_{std::chrono::steady_clock::now()} {}
+
+    std::shared_ptr<kv::Session> handle_connection() override {
+        return std::make_shared<kv::Session>(*event_loop_, cache_, epoch_);
+    }
+
+  private:
+    std::shared_ptr<axle::EventLoop> event_loop_;
+    kv::Cache cache_;
+    std::chrono::steady_clock::time_point epoch_;
+};
+
+// Runs one shard per thread. Each shard owns an event loop, a listener on `port + i` and its own
+// cache, so no state is shared between threads. Clients pick the shard for a key by hashing it
+// across the shard ports, the way memcached clients spread keys over servers.
+//
+// Usage: kv_server [--port=11211] [--shards=1] [--memory-mb=64]
+int main(int argc, char** argv) {
+    int port = k_default_port;
+    size_t shards = 1;
+    size_t memory_mb = k_default_memory_mb;
+
+    for (const char* raw : std::span<char*>{argv, static_cast<size_t>(argc)}.subspan(1)) {
+        const std::string_view arg{raw};
+        if (arg.starts_with("--port=")) {
+            (void)kv::parse_num(arg.substr(arg.find('=') + 1), port);
+        } else if (arg.starts_with("--shards=")) {
+            (void)kv::parse_num(arg.substr(arg.find('=') + 1), shards);
+        } else if (arg.starts_with("--memory-mb=")) {
+            (void)kv::parse_num(arg.substr(arg.find('=') + 1), memory_mb);
+        } else {
+            std::cerr << "unknown argument: " << arg << "\n";
+
+            return 1;
+        }
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(shards);
+    for (size_t i = 0; i < shards; ++i) {
+        threads.emplace_back([=] {
+            try {
+                const std::shared_ptr<axle::EventLoop> event_loop =
+                    std::make_shared<axle::EventLoop>();
+                KvServer server{event_loop,
+                                port + static_cast<int>(i),
+                                memory_mb * k_bytes_per_mb / shards};
+
+                server.start();
+                event_loop->run();
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << "\n";
+            }
+        });
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
@@ -0,0 +1,301 @@
+#include "session.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+
+#include "cache.h"
+
+#include "axle/event.h"
+
+namespace {
+
+constexpr size_t k_max_tokens = 24;
+// Expiration times above 30 days are absolute Unix timestamps, as in memcached.
+constexpr int64_t k_max_relative_exptime = 60 * 60 * 24 * 30;
+// Data blocks longer than this are refused as malformed, as in memcached, rather than skipped.
+constexpr size_t k_max_data_len = std::numeric_limits<int32_t>::max() - 2;
+
+// Seconds since the shard started, counting from 1 so that an expiry of 0 can mean "never". Read
+// once per batch of commands.
+uint32_t coarse_now(std::chrono::steady_clock::time_point epoch) {
+    return 1 + static_cast<uint32_t>(
+                   std::chrono::duration_cast<std::chrono::seconds>(
+                       std::chrono::steady_clock::now() - epoch)
+                       .count());
+}
+
+} // namespace
+
+namespace kv {
+
+Session::Session(axle::EventLoop& event_loop,
+                 Cache& cache,
+                 std::chrono::steady_clock::time_point epoch)
+    : event_loop_{event_loop},
+      cache_{cache},
+      epoch_{epoch},
+      buf_(k_buf_sz) {
+    out_.reserve(k_buf_sz);
+}
+
+std::span<uint8_t> Session::recv_buf(size_t max_len) {
+    if (tail_ == buf_.size() || head_ + want_ > buf_.size()) {
+        compact();
+    }
+
+    const size_t len = std::min<size_t>(buf_.size() - tail_, max_len);
+
+    return std::span<uint8_t>{buf_}.subspan(tail_, len);
+}
+
+void Session::post_recv(std::span<uint8_t> buf) {
+    tail_ += buf.size();
+    now_ = coarse_now(epoch_);
+    process();
+}
+
+std::span<const uint8_t> Session::send_buf(size_t max_len) {
+    const size_t len = std::min<size_t>(out_.size() - sent_, max_len);
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return std::span<const uint8_t>{reinterpret_cast<const uint8_t*>(out_.data()), out_.size()}
+        .subspan(sent_, len);
+}
+
+void Session::post_send(int64_t len) {
+    sent_ += len;
+    if (sent_ == out_.size()) {
+        out_.clear();
+        sent_ = 0;
+    }
+}
+
+void Session::end() {}
+
+void Session::compact() {
+    std::copy(buf_.begin() + head_, buf_.begin() + tail_, buf_.begin());
+    tail_ -= head_;
+    head_ = 0;
+    if (want_ > buf_.size()) {
+        buf_.resize(std::min(want_, k_max_buf_sz));
+    }
+}
+
+void Session::process() {
+    const size_t skipped = std::min(swallow_, tail_ - head_);
+    head_ += skipped;
+    swallow_ -= skipped;
+
+    for (size_t cmds = 0; swallow_ == 0; ++cmds) {
+        if (cmds == k_cmd_budget && head_ != tail_) {
+            defer_process();
+            break;
+        }
+
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        const std::string_view data{reinterpret_cast<const char*>(buf_.data()) + head_,
+                                    tail_ - head_};
+        const size_t eol = data.find('\n');
+        if (eol == std::string_view::npos) {
+            if (data.size() == buf_.size()) {
+                out_.append("CLIENT_ERROR line too long\r\n");
+                head_ = tail_;
+            } else {
+                want_ = data.size() + 1;
+            }
+            break;
+        }
+
+        std::string_view line = data.substr(0, eol);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+
+        const std::optional<size_t> consumed = dispatch(line, data.substr(eol + 1));
+        if (!consumed) {
+            want_ = eol + 1 + body_len_;
+            if (want_ > k_max_buf_sz) {
+                // The client sends the data block regardless. Like memcached, skip all of it,
+                // including what is still to come, rather than read it as commands.
+                out_.append("SERVER_ERROR object too large for cache\r\n");
+                swallow_ = want_ - data.size();
+                want_ = 0;
+                head_ = tail_;
+            }
+            break;
+        }
+        head_ += eol + 1 + *consumed;
+        want_ = 0;
+    }
+
+    if (head_ == tail_) {
+        head_ = 0;
+        tail_ = 0;
+        if (buf_.size() > k_buf_sz) {
+            buf_.resize(k_buf_sz);
+            buf_.shrink_to_fit();
+        }
+    }
+}
+
+void Session::defer_process() {
+    if (continuation_) {
+        return;
+    }
+    continuation_ = true;
+
+    event_loop_.defer([weak = weak_from_this()] {
+        if (const std::shared_ptr<Session> self = weak.lock()) {
+            self->continuation_ = false;
+            self->now_ = coarse_now(self->epoch_);
+            self->process();
+        }
+    });
+}
+
+// Executes one command and returns the number of bytes it consumed after the command line, or
+// nothing if its data block has not been received in full yet.
+std::optional<size_t> Session::dispatch(std::string_view line, std::string_view rest) {
+    std::array<std::string_view, k_max_tokens> tokens{};
+    size_t cnt = 0;
+    while (!line.empty() && cnt < tokens.size()) {
+        const size_t end = std::min(line.find(' '), line.size());
+        if (end != 0) {
+            tokens.at(cnt++) = line.substr(0, end);
+        }
+        line.remove_prefix(std::min(end + 1, line.size()));
+    }
+
+    const std::span<const std::string_view> args = std::span{tokens}.first(cnt);
+    if (args.empty()) {
+        out_.append("ERROR\r\n");
+    } else if (args[0] == "get" || args[0] == "gets") {
+        handle_get(args.subspan(1));
+    } else if (args[0] == "set") {
+        return handle_set(args.subspan(1), rest);
+    } else if (args[0] == "delete") {
+        handle_delete(args.subspan(1));
+    } else if (args[0] == "stats") {
+        handle_stats();
+    } else if (args[0] == "version") {
+        out_.append("VERSION axle-kv\r\n");
+    } else {
+        out_.append("ERROR\r\n");
+    }
+
+    return 0;
+}
+
+void Session::handle_get(std::span<const std::string_view> keys) {
+    for (const std::string_view key : keys) {
+        const Item* item = cache_.get(key, now_);
+        if (item == nullptr) {
+            continue;
+        }
+
+        out_.append("VALUE ").append(key).append(" ");
+        append_num(item->flags);
+        out_.append(" ");
+        append_num(item->value_len);
+        out_.append("\r\n");
+        out_.append(item->value().begin(), item->value().end());
+        out_.append("\r\n");
+    }
+    out_.append("END\r\n");
+}
+
+std::optional<size_t> Session::handle_set(std::span<const std::string_view> args,
+                                          std::string_view rest) {
+    uint32_t flags = 0;
+    int64_t exptime = 0;
+    size_t len = 0;
+    if (args.size() < 4 || !parse_num(args[1], flags) || !parse_num(args[2], exptime) ||
+        !parse_num(args[3], len) || len > k_max_data_len) {
+        out_.append("CLIENT_ERROR bad command line format\r\n");
+
+        return 0;
+    }
+    const bool noreply = args.size() > 4 && args[4] == "noreply";
+
+    body_len_ = len + 2;
+    if (rest.size() < body_len_) {
+        return std::nullopt;
+    }
+    if (rest.substr(len, 2) != "\r\n") {
+        out_.append("CLIENT_ERROR bad data chunk\r\n");
+
+        return body_len_;
+    }
+
+    uint32_t expires = 0;
+    if (exptime < 0) {
+        expires = now_;
+    } else if (exptime > k_max_relative_exptime) {
+        const int64_t unix_now =
+            std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now().time_since_epoch())
+                .count();
+        expires = now_ + static_cast<uint32_t>(std::max<int64_t>(exptime - unix_now, 1));
+    } else if (exptime > 0) {
+        expires = now_ + static_cast<uint32_t>(exptime);
+    }
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    const std::span<const uint8_t> value{reinterpret_cast<const uint8_t*>(rest.data()), len};
+    const bool stored = cache_.set(args[0], flags, expires, value);
+    if (!noreply) {
+        out_.append(stored ? "STORED\r\n" : "SERVER_ERROR out of memory storing object\r\n");
+    }
+
+    return body_len_;
+}
+
+void Session::handle_delete(std::span<const std::string_view> args) {
+    if (args.empty()) {
+        out_.append("ERROR\r\n");
+
+        return;
+    }
+
+    const bool deleted = cache_.del(args[0]);
+    if (args.size() < 2 || args[1] != "noreply") {
+        out_.append(deleted ? "DELETED\r\n" : "NOT_FOUND\r\n");
+    }
+}
+
+void Session::handle_stats() {
+    const CacheStats& stats = cache_.stats();
+    const std::pair<std::string_view, uint64_t> fields[] = {
+        {"curr_items", stats.items},
+        {"get_hits", stats.hits},
+        {"get_misses", stats.misses},
+        {"evictions", stats.evictions},
+        {"bytes", stats.bytes_allocated},
+        {"limit_maxbytes", stats.bytes_limit},
+    };
+    for (const auto& [name, val] : fields) {
+        out_.append("STAT ").append(name).append(" ");
+        append_num(val);
+        out_.append("\r\n");
+    }
+    out_.append("END\r\n");
+}
+
+void Session::append_num(uint64_t val) {
+    std::array<char, 20> num{};
+    const std::to_chars_result res = std::to_chars(num.data(), num.data() + num.size(), val);
+    out_.append(num.data(), res.ptr);
+}
+
+} // namespace kv
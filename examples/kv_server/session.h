@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <charconv>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "cache.h"
+
+#include "axle/event.h"
+
+namespace kv {
+
+template <typename T>
+bool parse_num(std::string_view str, T& val) {
+    const char* end = str.data() + str.size();
+    const std::from_chars_result res = std::from_chars(str.data(), end, val);
+
+    return res.ec == std::errc{} && res.ptr == end;
+}
+
+// Speaks the memcached text protocol (get/gets, set, delete, stats, version) against the cache of
+// the shard that accepted the connection. Replies to every command parsed from one read are
+// batched into a single buffer and flushed together. A deep pipeline is worked off
+// `k_cmd_budget` commands at a time, deferring the rest so other connections get a turn.
+class Session : public std::enable_shared_from_this<Session> {
+  public:
+    static constexpr size_t k_buf_sz = 16 * 1024;
+    // The largest command, data block included, that a session buffers.
+    static constexpr size_t k_max_buf_sz = Cache::k_page_sz + 2 * 1024;
+
+    Session() = delete;
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+    Session(Session&&) = delete;
+    Session& operator=(Session&&) = delete;
+
+    Session(axle::EventLoop& event_loop, Cache& cache, std::chrono::steady_clock::time_point epoch);
+
+    ~Session() = default;
+
+    std::span<uint8_t> recv_buf(size_t max_len);
+    void post_recv(std::span<uint8_t> buf);
+    std::span<const uint8_t> send_buf(size_t max_len);
+    void post_send(int64_t len);
+    void end();
+
+  private:
+    static constexpr size_t k_cmd_budget = 64;
+
+    axle::EventLoop& event_loop_;
+    Cache& cache_;
+    std::chrono::steady_clock::time_point epoch_;
+    uint32_t now_ = 0;
+
+    std::vector<uint8_t> buf_;
+    size_t head_ = 0;
+    size_t tail_ = 0;
+    // Bytes needed at `head_` to complete the pending command, and the size of its data block.
+    size_t want_ = 0;
+    size_t body_len_ = 0;
+    // What is left of the data block of a refused `set`, to be discarded as it arrives.
+    size_t swallow_ = 0;
+    std::string out_;
+    size_t sent_ = 0;
+    bool continuation_ = false;
+
+    void compact();
+    void process();
+    void defer_process();
+    std::optional<size_t> dispatch(std::string_view line, std::string_view rest);
+    void handle_get(std::span<const std::string_view> keys);
+    std::optional<size_t> handle_set(std::span<const std::string_view> args,
+                                     std::string_view rest);
+    void handle_delete(std::span<const std::string_view> args);
+    void handle_stats();
+    void append_num(uint64_t val);
+};
+
+} // namespace kv
@@ -0,0 +1,97 @@
+#include <csignal>
+#include <cstddef>
+
+#include <charconv>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "axle/event.h"
+#include "axle/loop_group.h"
+#include "axle/proxy.h"
+#include "axle/status.h"
+
+template <typename T>
+void parse_value(std::string_view text, T& val) {
+    (void)std::from_chars(text.data(), text.data() + text.size(), val);
+}
+
+// Forwards every connection on `--port=` to `--upstream=host:port`, one proxy per loop on the
+// same port. `--mode=copy` (the default) reads and writes the bytes through a buffer;
+// `--mode=splice` (Linux only) moves them through pipes without copying them into the process.
+//
+// Usage: tcp_proxy --upstream=127.0.0.1:8081 [--port=8089] [--loops=1] [--mode=copy]
+//                  [--pipe-kb=64]
+int main(int argc, char** argv) {
+    int port = 8089;
+    std::string upstream_address;
+    int upstream_port = 0;
+    size_t loops = 1;
+    size_t pipe_kb = 0;
+    axle::RelayMode mode = axle::RelayMode::COPY;
+    for (const char* raw : std::span<char*>{argv, static_cast<size_t>(argc)}.subspan(1)) {
+        const std::string_view arg{raw};
+        if (arg.starts_with("--port=")) {
+            parse_value(arg.substr(arg.find('=') + 1), port);
+        } else if (arg.starts_with("--upstream=")) {
+            const std::string_view target = arg.substr(arg.find('=') + 1);
+            upstream_address = target.substr(0, target.find(':'));
+            if (target.find(':') != std::string_view::npos) {
+                parse_value(target.substr(target.find(':') + 1), upstream_port);
+            }
+        } else if (arg.starts_with("--loops=")) {
+            parse_value(arg.substr(arg.find('=') + 1), loops);
+        } else if (arg.starts_with("--pipe-kb=")) {
+            parse_value(arg.substr(arg.find('=') + 1), pipe_kb);
+        } else if (arg == "--mode=copy") {
+            mode = axle::RelayMode::COPY;
+        } else if (arg == "--mode=splice") {
+            mode = axle::RelayMode::SPLICE;
+        } else {
+            std::cerr << "unknown argument: " << arg << "\n";
+
+            return 1;
+        }
+    }
+    if (upstream_address.empty() || upstream_port == 0) {
+        std::cerr << "missing --upstream=host:port\n";
+
+        return 1;
+    }
+    if (mode == axle::RelayMode::SPLICE && !axle::splice_supported()) {
+        std::cerr << "--mode=splice is not supported on this platform\n";
+
+        return 1;
+    }
+
+    // A receiver that has gone away fails the splice with `EPIPE` instead of killing the proxy.
+    (void)std::signal(SIGPIPE, SIG_IGN);
+
+    try {
+        std::vector<std::unique_ptr<axle::ProxyServer>> proxies(loops);
+        axle::LoopGroup group{std::vector<std::vector<int>>(loops)};
+
+        axle::Status<axle::None, int> res =
+            group.start([&](size_t idx, const std::shared_ptr<axle::EventLoop>& event_loop) {
+                proxies[idx] = std::make_unique<axle::ProxyServer>(
+                    event_loop, port, upstream_address, upstream_port, mode, pipe_kb * 1024);
+                if (loops > 1) {
+                    proxies[idx]->set_reuse_port();
+                }
+                proxies[idx]->start();
+            });
+        if (res.is_err()) {
+            std::cerr << "failed to start event loops: " << res.err() << "\n";
+
+            return 1;
+        }
+
+        group.join();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+    }
+}
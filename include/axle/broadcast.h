@@ -0,0 +1,69 @@
+#pragma once
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <deque>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace axle {
+
+// An immutable payload, written once and queued by reference on every connection it goes to. It
+// is freed when the last of them has sent it.
+using SharedBuffer = std::shared_ptr<const std::vector<uint8_t>>;
+
+SharedBuffer make_shared_buffer(std::span<const uint8_t> data);
+
+// What `TcpServer::broadcast` does with a connection whose queue is full.
+enum class SlowConsumerPolicy : uint8_t {
+    // Skip the payload for that connection only.
+    DROP,
+    // Close the connection.
+    DISCONNECT,
+};
+
+// A connection's outgoing data as a queue of shared buffers, sent straight from the buffers
+// without copying. Sessions that hold one can take part in `TcpServer::broadcast`, and can queue
+// their own replies on it as well.
+class SendQueue {
+  public:
+    SendQueue() = delete;
+    SendQueue(const SendQueue&) = delete;
+    SendQueue& operator=(const SendQueue&) = delete;
+    SendQueue(SendQueue&&) = delete;
+    SendQueue& operator=(SendQueue&&) = delete;
+
+    // Holds at most `max_bytes` unsent bytes, except that an empty queue takes any one buffer.
+    explicit SendQueue(size_t max_bytes);
+
+    ~SendQueue() = default;
+
+    // Queues `buf` by reference. Refused, leaving the queue as it was, if it would go over its
+    // limit.
+    bool push(SharedBuffer buf);
+
+    // Up to `max_len` bytes from the front of the queue as at most `bufs.size()` pieces; returns
+    // how many pieces were filled.
+    size_t gather(std::span<struct iovec> bufs, size_t max_len) const;
+    // The first piece of `gather`.
+    std::span<const uint8_t> front(size_t max_len) const;
+    // Drops `len` sent bytes from the front, releasing buffers sent in full.
+    void consume(size_t len);
+
+    // Unsent bytes.
+    size_t size() const;
+    bool empty() const;
+
+  private:
+    std::deque<SharedBuffer> bufs_;
+    // Bytes of the front buffer already sent.
+    size_t offset_ = 0;
+    size_t size_ = 0;
+    size_t max_bytes_;
+};
+
+} // namespace axle
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace axle {
+
+// Hands out fixed-size buffers and keeps up to `max_cached` returned ones for reuse, so a
+// connection can hold a buffer only while it has data in flight. Not thread-safe: use one pool per
+// event loop.
+class BufferPool {
+  public:
+    BufferPool() = delete;
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+    BufferPool(BufferPool&&) = delete;
+    BufferPool& operator=(BufferPool&&) = delete;
+
+    BufferPool(size_t buf_size, size_t max_cached);
+
+    ~BufferPool() = default;
+
+    std::unique_ptr<uint8_t[]> acquire(); // NOLINT(cppcoreguidelines-avoid-c-arrays)
+    void release(std::unique_ptr<uint8_t[]> buf); // NOLINT(cppcoreguidelines-avoid-c-arrays)
+
+    size_t buf_size() const;
+    // Buffers currently lent out.
+    size_t in_use() const;
+    // Buffers waiting in the pool for reuse.
+    size_t cached() const;
+
+  private:
+    size_t buf_size_;
+    size_t max_cached_;
+    size_t in_use_ = 0;
+    std::vector<std::unique_ptr<uint8_t[]>> free_; // NOLINT(cppcoreguidelines-avoid-c-arrays)
+};
+
+// A byte queue that borrows its storage from a `BufferPool` when data is written into it and gives
+// it back as soon as it has been read out again. An idle connection built on these costs a few
+// words instead of its buffer sizes.
+class LazyBuffer {
+  public:
+    LazyBuffer() = delete;
+    LazyBuffer(const LazyBuffer&) = delete;
+    LazyBuffer& operator=(const LazyBuffer&) = delete;
+    LazyBuffer(LazyBuffer&&) = delete;
+    LazyBuffer& operator=(LazyBuffer&&) = delete;
+
+    explicit LazyBuffer(BufferPool& pool);
+
+    ~LazyBuffer();
+
+    // Space for up to `max_len` more bytes, borrowing a buffer if none is held. Empty when full.
+    std::span<uint8_t> writable(size_t max_len);
+    // Appends `len` bytes written into `writable`. Returns the buffer if nothing is queued.
+    void commit(size_t len);
+
+    // Up to `max_len` queued bytes.
+    std::span<const uint8_t> readable(size_t max_len) const;
+    // Drops `len` bytes from the front. Returns the buffer once the queue is empty.
+    void consume(size_t len);
+
+    size_t size() const;
+    bool empty() const;
+    // Whether a pool buffer is currently held.
+    bool holding() const;
+
+    // Borrows from, and gives back to, `pool` from now on, as when the owner moves to another
+    // loop. A held buffer goes back to `pool` once emptied, so both must hand out buffers of the
+    // same size.
+    void set_pool(BufferPool& pool);
+
+  private:
+    BufferPool* pool_;
+    std::unique_ptr<uint8_t[]> buf_; // NOLINT(cppcoreguidelines-avoid-c-arrays)
+    uint32_t head_ = 0;
+    uint32_t tail_ = 0;
+
+    void give_back();
+};
+
+} // namespace axle
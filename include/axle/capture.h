@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <chrono>
+#include <optional>
+#include <span>
+#include <string>
+
+namespace axle {
+
+// A capture file holds the bytes that connections sent a server, with when they arrived, for
+// replaying against it later. After a 16-byte header ("AXLECAP" and a zero byte, then the format
+// version and four reserved bytes) it is a sequence of records, each a 16-byte header followed by
+// its data: the nanoseconds since the capture started, the stream the record belongs to, and the
+// kind of record in the top byte of a word whose low 24 bits give the data length. Every
+// connection is a stream of its own, numbered from zero in the order they opened. Integers are in
+// the host's byte order, and nothing is padded. Kinds start at one, so the zeroed tail of a file
+// whose writer never finished reads as its end.
+enum class CaptureKind : uint8_t {
+    // A connection opened. No data.
+    OPEN = 1,
+    // Bytes the connection sent.
+    DATA,
+    // The connection closed. No data.
+    CLOSE,
+};
+
+struct CaptureRecord {
+    CaptureKind kind;
+    uint32_t stream;
+    std::chrono::nanoseconds offset;
+    // Points into the reader's mapping of the file.
+    std::span<const uint8_t> data;
+};
+
+// Writes a capture file through a shared mapping of it, so that recording a read costs a copy
+// into memory rather than a system call. The file is sized to `capacity` up front; records that
+// no longer fit are dropped and counted, and the file is cut to what was written when the writer
+// is destroyed. One thread only, normally the loop of the server being captured.
+class CaptureWriter {
+  public:
+    CaptureWriter() = delete;
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+    CaptureWriter(CaptureWriter&&) = delete;
+    CaptureWriter& operator=(CaptureWriter&&) = delete;
+
+    // Creates or truncates `path`. Throws `std::runtime_error` if the file cannot be created or
+    // mapped.
+    CaptureWriter(const std::string& path, size_t capacity);
+
+    ~CaptureWriter();
+
+    // Starts a stream and returns its number.
+    uint32_t open();
+    // Records `bytes` on `stream`, split over as many records as their length needs.
+    void data(uint32_t stream, std::span<const uint8_t> bytes);
+    void close(uint32_t stream);
+
+    // Bytes of the file written so far, header included.
+    size_t size() const;
+    // Records dropped for lack of space.
+    uint64_t dropped() const;
+
+  private:
+    int fd_;
+    uint8_t* map_ = nullptr;
+    size_t capacity_;
+    size_t used_ = 0;
+    uint32_t next_stream_ = 0;
+    uint64_t dropped_ = 0;
+    std::chrono::steady_clock::time_point start_;
+
+    void append(CaptureKind kind, uint32_t stream, std::span<const uint8_t> bytes);
+};
+
+// Reads a capture file through a private mapping of it. The data of the records it returns stays
+// valid for as long as the reader.
+class CaptureReader {
+  public:
+    CaptureReader() = delete;
+    CaptureReader(const CaptureReader&) = delete;
+    CaptureReader& operator=(const CaptureReader&) = delete;
+    CaptureReader(CaptureReader&&) = delete;
+    CaptureReader& operator=(CaptureReader&&) = delete;
+
+    // Throws `std::runtime_error` if `path` cannot be opened or is not a capture file.
+    explicit CaptureReader(const std::string& path);
+
+    ~CaptureReader();
+
+    // The next record, or nothing at the end of the file or of what was written of it.
+    std::optional<CaptureRecord> next();
+    // Starts over from the first record.
+    void rewind();
+
+  private:
+    int fd_;
+    const uint8_t* map_ = nullptr;
+    size_t size_ = 0;
+    size_t pos_;
+};
+
+} // namespace axle
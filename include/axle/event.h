@@ -3,20 +3,121 @@
 #include <cstddef>
 #include <cstdint>
 
+#include <chrono>
+#include <deque>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 #include "axle/status.h"
+#include "axle/trace.h"
+
+struct kevent;
+struct timespec;
 
 namespace axle {
 
 using TimerEventCb = std::function<void(uint64_t, Status<None, int64_t>)>;
 using FdEventIOCb = std::function<void(uint64_t, Status<int64_t, uint32_t>)>;
 using FdEventEOFCb = std::function<void(uint64_t, Status<int64_t, uint32_t>)>;
+using PostedCb = std::function<void()>;
+
+// An fd callback as a plain function and the two words it is called with, for the hot paths that
+// serve many fds: the loop calls `fn` directly, where a `FdEventIOCb` goes through std::function's
+// invoker to reach the callable it wraps. `bind` makes one that calls a member function, which
+// the compiler can inline into `fn`.
+struct FdCallback {
+    using Fn = void (*)(void* ctx, uint64_t arg, uint64_t fd, Status<int64_t, uint32_t> status);
+
+    Fn fn = nullptr;
+    void* ctx = nullptr;
+    uint64_t arg = 0;
+
+    // Calls `(obj->*Method)(arg, fd, status)`.
+    template <auto Method, typename T>
+    static FdCallback bind(T* obj, uint64_t arg) {
+        return {[](void* ctx, uint64_t arg, uint64_t fd, Status<int64_t, uint32_t> status) {
+                    (static_cast<T*>(ctx)->*Method)(arg, fd, status);
+                },
+                obj,
+                arg};
+    }
+
+    explicit operator bool() const {
+        return fn != nullptr;
+    }
+
+    void operator()(uint64_t fd, Status<int64_t, uint32_t> status) const {
+        fn(ctx, arg, fd, status);
+    }
+};
+
+// Controls how `EventLoop::run` waits for events. With both spin limits at zero (the default) the
+// loop always blocks in the kernel. Otherwise it first polls with a zero timeout until an event
+// arrives or a limit is reached, trading CPU for wakeup latency.
+struct BusyPollConfig {
+    std::chrono::microseconds spin_duration{0};
+    size_t spin_iterations = 0;
+    // Halves the spin budget after every spin that found nothing and restores it once events
+    // arrive again, so an idle loop ends up blocking.
+    bool adaptive = true;
+    // Value for `SO_BUSY_POLL` on sockets accepted by servers driven by this loop; 0 leaves it off.
+    int socket_busy_poll_us = 0;
+};
+
+struct EventLoopStats {
+    // Time spent in zero-timeout polls that returned nothing, blocked in the kernel, and running
+    // callbacks.
+    std::chrono::nanoseconds spin_time{0};
+    std::chrono::nanoseconds wait_time{0};
+    std::chrono::nanoseconds work_time{0};
+    uint64_t spin_polls = 0;
+    uint64_t spin_hits = 0;
+    uint64_t blocking_waits = 0;
+    uint64_t events = 0;
+    uint64_t deferred = 0;
+    // Kernel timer events handled. Periodic timers that share a kernel timer count once per tick.
+    uint64_t timer_events = 0;
+    // Events dropped because their fd was closed and reused since the kernel queued them.
+    uint64_t stale_events = 0;
+    // Events asked of each poll, which follows the observed load.
+    size_t event_batch = 0;
+};
+
+// What an `EventLoop` waits on in place of a kernel queue, for testing the loop and what runs on it
+// against a simulation (see `SimBackend`). It speaks kqueue's language, so that the loop cannot
+// tell the two apart.
+class EventBackend {
+  public:
+    EventBackend() = default;
+    EventBackend(const EventBackend&) = delete;
+    EventBackend& operator=(const EventBackend&) = delete;
+    EventBackend(EventBackend&&) = delete;
+    EventBackend& operator=(EventBackend&&) = delete;
+
+    virtual ~EventBackend() = default;
+
+    // As `kevent(2)`: applies `nchanges` changes, then waits up to `timeout`, or indefinitely if
+    // null, for events and returns how many it stored. Sets `errno` and returns -1 on failure.
+    // Called from other threads to trigger user events.
+    virtual int kevent(const struct kevent* changes,
+                       int nchanges,
+                       struct kevent* events,
+                       int nevents,
+                       const struct timespec* timeout) = 0;
+
+    // The backend's clock, which timers are measured against.
+    virtual std::chrono::steady_clock::time_point now() const = 0;
+};
 
 class EventLoop {
   public:
     EventLoop();
+    // Waits on `backend` instead of the kernel. Only the fds the backend knows about can be
+    // watched.
+    explicit EventLoop(std::shared_ptr<EventBackend> backend);
     EventLoop(const EventLoop&) = delete;
     EventLoop& operator=(const EventLoop&) = delete;
     EventLoop(EventLoop&&) = delete;
@@ -24,38 +125,218 @@ class EventLoop {
 
     ~EventLoop();
 
+    // Bytes the loop keeps for an fd whose callbacks are all `FdCallback`s. A std::function
+    // callback adds a block of three more for the fd, 96 bytes with libstdc++ and libc++.
+    static constexpr size_t k_fd_entry_budget = 88;
+
     Status<None, int> register_fd_read(int fd, const FdEventIOCb& cb);
     Status<None, int> register_fd_write(int fd, const FdEventIOCb& cb);
     Status<None, int> register_fd_eof(int fd, const FdEventEOFCb& cb);
+    Status<None, int> register_fd_read(int fd, FdCallback cb);
+    Status<None, int> register_fd_write(int fd, FdCallback cb);
+    Status<None, int> register_fd_eof(int fd, FdCallback cb);
+    // Fires `cb` after `timeout` nanoseconds, and every `timeout` after that if `periodic`.
+    // Registering an id again replaces its timer. A non-zero `slack` lets the timer fire up to
+    // that much late so that it can share wakeups with others: a one-shot deadline is rounded up
+    // onto a grid as fine as the slack allows, and a periodic timer rides on the kernel timer of
+    // another with the same period when that one's ticks line up within the slack.
     Status<None, int> register_timer(uint64_t id,
                                      uint64_t timeout,
                                      bool periodic,
-                                     const TimerEventCb& cb);
+                                     const TimerEventCb& cb,
+                                     uint64_t slack = 0);
 
     Status<None, int> remove_fd_read(int fd);
     Status<None, int> remove_fd_write(int fd);
     Status<None, int> remove_fd_eof(int fd);
     Status<None, int> remove_timer(uint64_t id);
 
+    void set_busy_poll(const BusyPollConfig& config);
+    const BusyPollConfig& busy_poll() const;
+    const EventLoopStats& stats() const;
+
+    // Starts recording loop activity into a ring of `capacity` records, replacing any earlier
+    // trace; zero stops it. Loop thread only, or before `run`. Fails with `ENOTSUP` unless built
+    // with `AXLE_TRACING`. While off, tracing costs one branch per event.
+    Status<None, int> set_tracing(size_t capacity);
+    // Null unless tracing is on.
+    const TraceBuffer* trace() const;
+
+    // The time the current batch of events was picked up. Cheaper than reading the clock, and
+    // precise enough for rate limits and timeouts measured in milliseconds.
+    std::chrono::steady_clock::time_point now() const;
+    // A timer id no other caller of this function is given. These ids start at 2^31, clear of
+    // ids picked by hand.
+    uint64_t make_timer_id();
+
     void run();
 
     Status<None, int> shutdown() const;
+    // Runs `cb` on the loop's thread during its next iteration. Safe to call from any thread;
+    // callbacks posted from one thread run in the order they were posted.
+    Status<None, int> post(PostedCb cb);
+    // Runs `cb` after the current batch of events, in FIFO order with other deferred callbacks,
+    // and keeps the loop from blocking until it has run. Loop thread only. A callback that stops
+    // early to stay within its work budget defers the rest, so every other ready connection gets
+    // a turn before it continues.
+    void defer(PostedCb cb);
+
+    // Hooks run on every iteration of `run` until removed, in the order they were added, like
+    // libuv's handles of the same names: prepare hooks just before the loop polls, check hooks
+    // after the batch of events and deferred callbacks it picked up, and idle hooks before the
+    // prepare hooks. While any idle hook is registered the loop polls without blocking. A hook
+    // added from a hook first runs on the next iteration. Loop thread only.
+    uint64_t add_prepare_hook(PostedCb cb);
+    uint64_t add_check_hook(PostedCb cb);
+    uint64_t add_idle_hook(PostedCb cb);
+    // May be called from the hook itself.
+    Status<None, int> remove_hook(uint64_t id);
 
   private:
     static constexpr uint64_t k_shutdown_event_id = 19;
-    static constexpr size_t k_max_event_cnt = 64;
+    static constexpr uint64_t k_post_event_id = 20;
+    // Bounds for the events asked of each poll, which double when a poll returns as many and halve
+    // after a run of polls that return less than a quarter. The array holding them keeps its
+    // largest size, so that halving and doubling again allocate nothing.
+    static constexpr size_t k_min_event_cnt = 16;
+    static constexpr size_t k_initial_event_cnt = 64;
+    static constexpr size_t k_max_event_cnt = 1024;
+    static constexpr size_t k_shrink_after_polls = 64;
+    static constexpr unsigned k_max_backoff_shift = 8;
+    static constexpr uint64_t k_first_generated_timer_id = uint64_t{1} << 31;
 
     int kq_;
+    // Null when waiting on `kq_`.
+    std::shared_ptr<EventBackend> backend_;
     bool done_ = false;
+    BusyPollConfig busy_poll_;
+    // Right shift applied to the configured spin limits; at `k_max_backoff_shift` the loop blocks
+    // straight away.
+    unsigned backoff_shift_ = 0;
+    EventLoopStats stats_;
+    std::unique_ptr<TraceBuffer> trace_;
+    std::chrono::steady_clock::time_point now_ = std::chrono::steady_clock::now();
+    uint64_t next_timer_id_ = k_first_generated_timer_id;
+    size_t quiet_polls_ = 0;
     std::unordered_map<uint64_t, TimerEventCb> timers_;
-    std::unordered_map<uint64_t, FdEventIOCb> fd_read_;
-    std::unordered_map<uint64_t, FdEventIOCb> fd_write_;
-    std::unordered_map<uint64_t, FdEventEOFCb> fd_eof_;
 
-    void handle_shutdown(uint64_t id);
+    struct GroupedTimer {
+        uint64_t id;
+        // The tick of its group the timer first fires on.
+        uint64_t first_tick;
+        TimerEventCb cb;
+        bool removed = false;
+    };
+
+    // Periodic timers with the same period, driven by one kernel timer started at `start_ns`.
+    struct TimerGroup {
+        uint64_t period;
+        uint64_t start_ns;
+        uint64_t ticks = 0;
+        // A deque, so that a member can add others from its callback.
+        std::deque<GroupedTimer> members;
+        size_t live = 0;
+        bool firing = false;
+    };
+
+    // Keyed by the id of the group's kernel timer, one of `make_timer_id`'s.
+    std::unordered_map<uint64_t, TimerGroup> timer_groups_;
+    // Group of each grouped timer.
+    std::unordered_map<uint64_t, uint64_t> grouped_timers_;
+
+    struct Hook {
+        uint64_t id;
+        PostedCb cb;
+        // Set by `remove_hook`; the hook is dropped the next time its list runs, as it may be the
+        // caller.
+        bool removed = false;
+    };
+
+    // Deques, so that adding a hook leaves the running one in place.
+    std::deque<Hook> prepare_hooks_;
+    std::deque<Hook> check_hooks_;
+    std::deque<Hook> idle_hooks_;
+    uint64_t next_hook_id_ = 1;
+    size_t idle_cnt_ = 0;
+
+    struct FdFunctions {
+        FdEventIOCb read;
+        FdEventIOCb write;
+        FdEventEOFCb eof;
+    };
+
+    // Callbacks for one fd. The generation changes every time the fd goes from having no filters
+    // to having some, i.e. once per connection that uses it. Kernel events carry the generation
+    // they were registered with in their user data, so an event queued for a connection whose fd
+    // has been closed and reused within the same batch is recognised and dropped.
+    struct FdEntry {
+        uint32_t generation = 0;
+        FdCallback read;
+        FdCallback write;
+        FdCallback eof;
+        // The std::function callbacks among them, which `read`, `write` and `eof` call into. Made
+        // on first use, so that an fd served through `FdCallback`s costs only the entry.
+        std::unique_ptr<FdFunctions> functions;
+    };
+    static_assert(sizeof(FdEntry) <= k_fd_entry_budget);
+
+    // Indexed by fd. A deque keeps entries in place while it grows, so a callback can register
+    // new fds without invalidating the entry it is running from.
+    std::deque<FdEntry> fds_;
+    // Callbacks removed while a batch is being dispatched; one of them may be the caller.
+    std::vector<FdEventIOCb> removed_;
+
+    std::mutex posted_mu_;
+    std::vector<PostedCb> posted_;
+    std::vector<PostedCb> running_posted_;
+    std::vector<PostedCb> deferred_;
+    std::vector<PostedCb> running_deferred_;
+
+    int queue(const struct kevent* changes,
+              int nchanges,
+              struct kevent* events,
+              int nevents,
+              const struct timespec* timeout) const;
+    // Nanoseconds on the clock timers are measured against.
+    uint64_t clock_ns() const;
+    void register_user_events();
+    int poll(struct kevent* evs, int cnt);
+    int spin(struct kevent* evs, int cnt);
+
+    void handle_user(uint64_t id);
+    void run_posted();
+    void run_deferred();
+    uint64_t add_hook(std::deque<Hook>& hooks, PostedCb cb);
+    void run_hooks(std::deque<Hook>& hooks);
+    void resize_events(std::vector<struct kevent>& evs, size_t& batch, int ret);
+    TraceBuffer* tracer() const;
+    void dispatch(const struct kevent& ev);
+    void dispatch_traced(const struct kevent& ev);
     void handle_timer(uint64_t id, uint16_t flags, int64_t data);
-    void handle_fd_read(uint64_t fd, uint16_t flags, uint32_t fflags, int64_t data);
-    void handle_fd_write(uint64_t fd, uint16_t flags, uint32_t fflags, int64_t data);
+    Status<None, int> arm_timer(uint64_t id, uint64_t timeout, bool periodic);
+    Status<None, int> disarm_timer(uint64_t id);
+    Status<None, int> join_group(uint64_t id,
+                                 uint64_t period,
+                                 uint64_t slack,
+                                 const TimerEventCb& cb);
+    bool leave_group(uint64_t id);
+    void fire_group(uint64_t group_id, TimerGroup& group, int64_t expirations);
+    FdEntry* find_fd(uint64_t fd, void* udata);
+    FdEntry& fd_entry(int fd);
+    // Adds the kernel filter for a callback about to be registered, starting a new generation if
+    // the fd had none.
+    Status<None, int> watch_fd(int fd, int16_t filter);
+    void set_callback(FdEntry& entry,
+                      FdCallback FdEntry::*slot,
+                      FdEventIOCb FdFunctions::*function,
+                      FdCallback cb);
+    void set_function(FdEntry& entry,
+                      FdCallback FdEntry::*slot,
+                      FdEventIOCb FdFunctions::*function,
+                      const FdEventIOCb& cb);
+
+    void handle_fd_read(uint64_t fd, void* udata, uint16_t flags, uint32_t fflags, int64_t data);
+    void handle_fd_write(uint64_t fd, void* udata, uint16_t flags, uint32_t fflags, int64_t data);
 
     void do_shutdown();
 };
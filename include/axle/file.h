@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "axle/event.h"
+#include "axle/status.h"
+#include "axle/worker_pool.h"
+
+namespace axle {
+
+// Completions: the bytes read, the number of bytes written, or nothing for a sync; an errno value
+// on failure.
+using FileReadCb = std::function<void(Status<std::vector<uint8_t>, int>)>;
+using FileWriteCb = std::function<void(Status<size_t, int>)>;
+using FileSyncCb = std::function<void(Status<None, int>)>;
+
+// A file whose reads, writes and syncs run on a `WorkerPool`, so a slow disk holds up a worker
+// rather than the event loop. Completions run on the loop.
+//
+// Operations on one file run one at a time, in the order they were submitted, and complete in
+// that order: an `fsync` covers every write submitted before it. Different files proceed in
+// parallel. Buffers are owned by the operation, so nothing the caller holds is touched off the
+// loop's thread.
+//
+// Owned by a session and used only from its loop's thread. Destroying the file cancels whatever
+// it has outstanding, as `WorkQueue` does: operations that have not started are skipped and no
+// completion runs afterwards. The descriptor is closed once no operation is using it.
+class AsyncFile {
+  public:
+    AsyncFile() = delete;
+    AsyncFile(const AsyncFile&) = delete;
+    AsyncFile& operator=(const AsyncFile&) = delete;
+    AsyncFile(AsyncFile&&) = delete;
+    AsyncFile& operator=(AsyncFile&&) = delete;
+
+    // Takes ownership of `fd`.
+    AsyncFile(WorkerPool& pool, std::shared_ptr<EventLoop> loop, int fd);
+
+    ~AsyncFile();
+
+    // Reads up to `len` bytes at `offset`; fewer at the end of the file.
+    void read_at(uint64_t offset, size_t len, FileReadCb cb);
+    // Writes all of `data` at `offset`.
+    void write_at(uint64_t offset, std::vector<uint8_t> data, FileWriteCb cb);
+    // Flushes the file's data and metadata to the device, with `F_FULLFSYNC` on Apple platforms,
+    // where `fsync` leaves them in the drive's cache.
+    void fsync(FileSyncCb cb);
+
+    // Operations submitted whose completions have not run yet.
+    size_t pending() const;
+
+  private:
+    using Op = std::function<PostedCb(int fd)>;
+
+    struct State {
+        explicit State(int fd)
+            : fd{fd} {}
+
+        State(const State&) = delete;
+        State& operator=(const State&) = delete;
+        State(State&&) = delete;
+        State& operator=(State&&) = delete;
+
+        ~State();
+
+        const int fd;
+        std::atomic_bool cancelled = false;
+        std::mutex mu;
+        std::deque<Op> ops;
+        // Whether a worker is working through `ops`.
+        bool running = false;
+    };
+
+    WorkerPool& pool_;
+    std::shared_ptr<EventLoop> loop_;
+    std::shared_ptr<State> state_;
+    size_t pending_ = 0;
+
+    void submit(Op op);
+    static void drain(const std::shared_ptr<State>& state, const std::shared_ptr<EventLoop>& loop);
+};
+
+} // namespace axle
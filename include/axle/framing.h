@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "axle/status.h"
+
+namespace axle {
+
+enum class FrameMode : uint8_t {
+    FIXED,
+    VARINT,
+    DELIMITER,
+};
+
+enum class FrameError : uint8_t {
+    TOO_LARGE,
+    BAD_LENGTH,
+    BAD_CHECKSUM,
+};
+
+struct FramerConfig {
+    FrameMode mode = FrameMode::FIXED;
+    // Width of the big-endian length prefix in FIXED mode: 1, 2, 4 or 8 bytes.
+    size_t prefix_len = 4;
+    // Frame terminator in DELIMITER mode. It is not part of the delivered frame.
+    std::vector<uint8_t> delimiter{'\n'};
+    // Append a big-endian CRC32C of the payload after each frame. Length-prefixed modes only.
+    bool checksum = false;
+    size_t buf_sz = 16 * 1024;
+    size_t max_frame_sz = 1024 * 1024;
+};
+
+// Views into the receive buffer; only valid for the duration of the callback.
+using FrameBatchCb = std::function<void(std::span<const std::span<const uint8_t>>)>;
+
+// Splits a byte stream into frames without copying them out of the receive buffer. Plugs into a
+// session's `recv_buf`/`post_recv` pair: the socket reads straight into `recv_buf()` and each
+// `post_recv()` hands every frame completed by that read to the callback as one batch. Bytes are
+// only moved when a partial frame sits at the end of the buffer and needs room to complete.
+class Framer {
+  public:
+    static constexpr size_t k_max_header_sz = 10;
+    static constexpr size_t k_checksum_sz = 4;
+
+    Framer() = delete;
+    Framer(const Framer&) = delete;
+    Framer& operator=(const Framer&) = delete;
+    Framer(Framer&&) = delete;
+    Framer& operator=(Framer&&) = delete;
+
+    explicit Framer(FramerConfig config, FrameBatchCb cb);
+
+    ~Framer() = default;
+
+    std::span<uint8_t> recv_buf(size_t max_len);
+    Status<size_t, FrameError> post_recv(std::span<uint8_t> buf);
+
+    // Writes the length prefix for a payload of `payload_len` bytes and returns its size.
+    size_t encode_header(size_t payload_len, std::span<uint8_t, k_max_header_sz> out) const;
+    // Writes the checksum trailer for `payload`.
+    static void encode_trailer(std::span<const uint8_t> payload,
+                               std::span<uint8_t, k_checksum_sz> out);
+
+    size_t pending() const;
+
+  private:
+    struct Frame {
+        bool complete;
+        size_t hdr_len;
+        size_t payload_len;
+        size_t frame_len;
+    };
+
+    FramerConfig config_;
+    FrameBatchCb cb_;
+    std::vector<uint8_t> buf_;
+    std::vector<std::span<const uint8_t>> batch_;
+    size_t head_ = 0;
+    size_t tail_ = 0;
+    size_t scan_ = 0;
+    size_t want_ = 0;
+
+    Status<Frame, FrameError> next_frame();
+    Status<Frame, FrameError> next_prefixed_frame(std::span<const uint8_t> data) const;
+    Status<Frame, FrameError> next_delimited_frame(std::span<const uint8_t> data);
+
+    void make_room();
+};
+
+// CRC32C (Castagnoli). Uses the SSE4.2 or ARMv8 CRC instructions when the target supports them.
+uint32_t crc32c(std::span<const uint8_t> buf, uint32_t crc = 0);
+
+} // namespace axle
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "axle/event.h"
+#include "axle/socket.h"
+#include "axle/status.h"
+
+namespace axle {
+
+// Listening sockets taken over from the process being replaced, in the order it listed them.
+struct Takeover {
+    // The connection to the old process, which goes on accepting until `confirm_takeover`.
+    Socket channel;
+    std::vector<ServerSocket> listeners;
+};
+
+// Asks the process serving a `ListenerHandoff` at `path` for its listeners. Fails with `ENOENT` or
+// `ECONNREFUSED` when no process is serving there, as on a first start. Blocks until the listeners
+// arrive.
+Status<Takeover, int> take_listeners(const std::string& path);
+
+// Tells the old process that servers are now accepting on the listeners, so that it can stop and
+// drain, and closes the channel. Until then both processes accept, and if this process goes away
+// first the old one carries on alone.
+Status<None, int> confirm_takeover(Takeover& takeover);
+
+// Serves a process's listening sockets to its replacement over a Unix socket at `path`, for
+// restarts that refuse no connections. Each listener is a single socket the two processes share,
+// with a single backlog, so connections that arrive while one process hands over to the other
+// wait to be accepted by whichever is accepting rather than being refused, which a new process
+// binding a port of its own cannot promise. The replacement takes the listeners with
+// `take_listeners`, starts its servers on them and confirms; `on_handoff` then runs on the loop,
+// typically to `TcpServer::drain` each server, and the handoff stops serving. A replacement that
+// goes away, or does not confirm within `confirm_timeout`, leaves things as they were. Only
+// processes of the same user are handed the listeners, and only they can reach the socket. Loop
+// thread only.
+class ListenerHandoff {
+  public:
+    static constexpr std::chrono::seconds k_default_confirm_timeout{30};
+
+    ListenerHandoff() = delete;
+    ListenerHandoff(const ListenerHandoff&) = delete;
+    ListenerHandoff& operator=(const ListenerHandoff&) = delete;
+    ListenerHandoff(ListenerHandoff&&) = delete;
+    ListenerHandoff& operator=(ListenerHandoff&&) = delete;
+
+    // Replaces whatever is at `path`, which is normally the socket the process being replaced
+    // served from. `listeners` stay owned by the caller and must stay open until the handoff.
+    // Throws `std::runtime_error` if the socket cannot be set up.
+    ListenerHandoff(std::shared_ptr<EventLoop> event_loop,
+                    std::string path,
+                    std::vector<int> listeners,
+                    PostedCb on_handoff,
+                    std::chrono::nanoseconds confirm_timeout = k_default_confirm_timeout);
+
+    // Removes the socket at `path`, unless a replacement has taken over and serves its own there.
+    ~ListenerHandoff();
+
+    bool handed_off() const;
+
+  private:
+    std::shared_ptr<EventLoop> event_loop_;
+    std::string path_;
+    std::vector<int> listeners_;
+    PostedCb on_handoff_;
+    std::chrono::nanoseconds confirm_timeout_;
+    uint64_t confirm_timer_id_;
+    Socket socket_;
+    bool accepting_ = false;
+    // The replacement being handed the listeners, one at a time, which holds up the others until it
+    // confirms, goes away or runs out of time.
+    std::optional<Socket> peer_;
+    bool handed_off_ = false;
+
+    void watch_accept();
+    void accept_one();
+    void on_peer_readable();
+    void drop_peer();
+    void give_up_on_peer();
+};
+
+} // namespace axle
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include "axle/status.h"
+
+namespace axle {
+
+enum class HttpError : uint8_t {
+    BAD_REQUEST_LINE,
+    BAD_VERSION,
+    BAD_HEADER,
+    BAD_CONTENT_LENGTH,
+    // A transfer coding other than a final `chunked`, which leaves the body length unknown.
+    BAD_TRANSFER_ENCODING,
+    BAD_CHUNK,
+    TOO_MANY_HEADERS,
+    HEAD_TOO_LARGE,
+};
+
+struct HttpHeader {
+    std::string_view name;
+    std::string_view value;
+};
+
+// A parsed request head. Every view points into the buffer handed to the parser.
+struct HttpRequest {
+    std::string_view method;
+    std::string_view target;
+    uint8_t version_minor = 1;
+    std::span<const HttpHeader> headers;
+    size_t content_length = 0;
+    bool chunked = false;
+    bool keep_alive = true;
+
+    // Case-insensitive lookup of the first header called `name`.
+    std::optional<std::string_view> header(std::string_view name) const;
+};
+
+// Incremental, allocation-free HTTP/1.1 request head parser. Feed it the unconsumed front of the
+// receive buffer as more bytes arrive; it resumes scanning where the previous call stopped. Once
+// a head is complete `parse` returns its length and the body (if any) starts right after it.
+// Call `reset` before parsing the next pipelined request.
+class HttpRequestParser {
+  public:
+    static constexpr size_t k_max_headers = 64;
+    static constexpr size_t k_max_head_sz = 16 * 1024;
+
+    HttpRequestParser() = default;
+    HttpRequestParser(const HttpRequestParser&) = delete;
+    HttpRequestParser& operator=(const HttpRequestParser&) = delete;
+    HttpRequestParser(HttpRequestParser&&) = delete;
+    HttpRequestParser& operator=(HttpRequestParser&&) = delete;
+
+    ~HttpRequestParser() = default;
+
+    // Returns the size of the request head, or 0 if `buf` does not hold a complete head yet.
+    Status<size_t, HttpError> parse(std::span<const uint8_t> buf);
+
+    const HttpRequest& request() const;
+
+    void reset();
+
+  private:
+    std::array<HttpHeader, k_max_headers> headers_{};
+    HttpRequest request_{};
+    size_t scan_ = 0;
+
+    Status<None, HttpError> parse_request_line(std::string_view& head);
+    Status<None, HttpError> parse_headers(std::string_view head);
+};
+
+struct ChunkedResult {
+    size_t consumed;
+    std::span<const uint8_t> data;
+};
+
+// Incremental decoder for `Transfer-Encoding: chunked` bodies. Each call consumes chunk framing
+// from the front of `buf` and returns at most one run of body bytes as a view into `buf`. Call it
+// again with the remaining bytes until it consumes nothing or `done` is true.
+class ChunkedDecoder {
+  public:
+    Status<ChunkedResult, HttpError> decode(std::span<const uint8_t> buf);
+
+    bool done() const;
+
+    void reset();
+
+  private:
+    enum class State : uint8_t {
+        SIZE,
+        EXTENSION,
+        SIZE_LF,
+        DATA,
+        DATA_CR,
+        DATA_LF,
+        TRAILER,
+        TRAILER_LF,
+        DONE,
+    };
+
+    State state_ = State::SIZE;
+    uint64_t remaining_ = 0;
+    size_t size_digits_ = 0;
+    size_t trailer_len_ = 0;
+};
+
+} // namespace axle
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+
+#include <functional>
+#include <latch>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "axle/event.h"
+#include "axle/status.h"
+
+namespace axle {
+
+// Runs on a loop's own thread, after pinning and before the loop starts running. Servers, session
+// pools and buffers created here are first touched on the loop's CPU and NUMA node.
+using LoopInitCb = std::function<void(size_t idx, const std::shared_ptr<EventLoop>& loop)>;
+
+// A set of event loops, each running on its own thread that is restricted to a set of CPUs.
+//
+// On Linux a loop thread is pinned with `pthread_setaffinity_np` and then prefers memory from the
+// NUMA node of the CPU it runs on, so its allocations stay off the interconnect. On macOS, which
+// has no hard affinity, each loop gets its own affinity tag as a placement hint instead.
+class LoopGroup {
+  public:
+    LoopGroup() = delete;
+    LoopGroup(const LoopGroup&) = delete;
+    LoopGroup& operator=(const LoopGroup&) = delete;
+    LoopGroup(LoopGroup&&) = delete;
+    LoopGroup& operator=(LoopGroup&&) = delete;
+
+    // One loop per entry. An empty CPU set leaves that loop's thread unpinned.
+    explicit LoopGroup(std::vector<std::vector<int>> cpu_sets);
+
+    ~LoopGroup();
+
+    // Loop `i` pinned to CPU `i`, for `cnt` loops.
+    static std::vector<std::vector<int>> one_per_cpu(size_t cnt);
+
+    // Starts every loop and returns once each one has finished `init`. If a thread cannot be
+    // placed, or a loop or `init` throws, the loops already started are stopped and the error is
+    // returned: the code of a `std::system_error`, or `EINVAL` for any other exception.
+    Status<None, int> start(const LoopInitCb& init);
+    // Blocks until every loop has exited.
+    void join();
+    // Shuts every loop down and joins its thread.
+    void stop();
+
+    size_t size() const;
+    const std::shared_ptr<EventLoop>& loop(size_t idx) const;
+    // The first CPU in the loop's set, or -1 if the loop is unpinned. Suitable for
+    // `TcpServer::set_incoming_cpu`.
+    int cpu(size_t idx) const;
+    // The NUMA node the loop allocates from, or -1 if unknown.
+    int node(size_t idx) const;
+
+  private:
+    std::vector<std::vector<int>> cpu_sets_;
+    std::vector<std::shared_ptr<EventLoop>> loops_;
+    std::vector<int> nodes_;
+    std::vector<std::thread> threads_;
+
+    void run_loop(size_t idx, const LoopInitCb& init, std::latch& ready, int& err);
+};
+
+} // namespace axle
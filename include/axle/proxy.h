@@ -0,0 +1,214 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "axle/event.h"
+#include "axle/socket.h"
+#include "axle/status.h"
+
+namespace axle {
+
+// How a `Relay` moves bytes between its two sockets.
+enum class RelayMode : uint8_t {
+    // Through a buffer in the process, with a `recv` and a `send` per chunk.
+    COPY,
+    // Through a pipe with `splice` (Linux), so the payload never leaves the kernel.
+    SPLICE,
+};
+
+// Whether `RelayMode::SPLICE` can work here: false where `splice` does not exist, as on the BSDs
+// and macOS.
+bool splice_supported();
+
+// A pipe for splicing through, and how many bytes it holds.
+struct Pipe {
+    int read_fd = -1;
+    int write_fd = -1;
+    size_t capacity = 0;
+};
+
+// Hands out pipes to splice through and takes them back for reuse, so that relaying a connection
+// does not cost a `pipe` and two `close` calls per direction. Loop thread only.
+class PipePool {
+  public:
+    PipePool() = delete;
+    PipePool(const PipePool&) = delete;
+    PipePool& operator=(const PipePool&) = delete;
+    PipePool(PipePool&&) = delete;
+    PipePool& operator=(PipePool&&) = delete;
+
+    // Pipes are resized to `pipe_sz` bytes, which the kernel rounds up to a power of two pages and
+    // caps at fs.pipe-max-size for unprivileged processes; zero keeps the default of 64 KiB. At
+    // most `max_idle` returned pipes are kept.
+    PipePool(size_t pipe_sz, size_t max_idle);
+
+    ~PipePool();
+
+    // Fails with `ENOTSUP` where `splice` does not exist.
+    Status<Pipe, int> acquire();
+    // Takes back a pipe from `acquire`. One that may still hold data is closed, not reused.
+    void release(Pipe pipe, bool empty);
+
+    size_t idle() const;
+
+  private:
+    size_t pipe_sz_;
+    size_t max_idle_;
+    std::vector<Pipe> idle_;
+};
+
+struct RelayStats {
+    // Bytes relayed from downstream to upstream, and from upstream to downstream.
+    uint64_t upstream_bytes = 0;
+    uint64_t downstream_bytes = 0;
+};
+
+// Called once when the relay is over: with zero once both directions have been closed by their
+// senders and delivered in full, or with the errno of the first failure. The relay may be
+// destroyed from it.
+using RelayDoneCb = std::function<void(int err)>;
+
+// Relays bytes both ways between two connected sockets on one loop.
+//
+// Each direction reads from its sender only while its buffer, or pipe, is empty, and watches its
+// receiver for writability only while it is not. A receiver that falls behind therefore stops the
+// reads from its sender, whose data queues in the kernel and eventually pushes back on it; the
+// relay itself never holds more than a buffer per direction. An EOF from one side is passed on to
+// the other as a half-close once everything before it has been delivered, and the opposite
+// direction carries on until it sees its own EOF.
+class Relay {
+  public:
+    Relay() = delete;
+    Relay(const Relay&) = delete;
+    Relay& operator=(const Relay&) = delete;
+    Relay(Relay&&) = delete;
+    Relay& operator=(Relay&&) = delete;
+
+    // With `RelayMode::SPLICE`, takes a pipe per direction from `pipes` on `start` and returns
+    // them when destroyed; `pipes` must outlive the relay.
+    Relay(std::shared_ptr<EventLoop> event_loop,
+          Socket downstream,
+          Socket upstream,
+          RelayMode mode,
+          PipePool* pipes,
+          RelayDoneCb done);
+
+    ~Relay();
+
+    // Puts both sockets in non-blocking mode and starts relaying. On failure `done` is not called.
+    Status<None, int> start();
+
+    const RelayStats& stats() const;
+
+  private:
+    // One direction: bytes read from `src` and written to `dst`.
+    struct Flow {
+        Flow(Socket* src, Socket* dst, uint64_t* relayed)
+            : src{src},
+              dst{dst},
+              relayed{relayed} {}
+
+        Socket* src;
+        Socket* dst;
+        uint64_t* relayed;
+        Pipe pipe;
+        std::vector<uint8_t> buf;
+        // Bytes read from `src` and not yet written, starting at `head` in `buf` in copy mode.
+        size_t buffered = 0;
+        size_t head = 0;
+        // Whether the read and write filters are registered.
+        bool reading = false;
+        bool writing = false;
+        // Whether `src` has reported EOF, and whether that has been passed on to `dst`.
+        bool eof = false;
+        bool shut = false;
+    };
+
+    static constexpr size_t k_copy_buf_sz = 64 * 1024;
+
+    std::shared_ptr<EventLoop> event_loop_;
+    Socket downstream_;
+    Socket upstream_;
+    RelayMode mode_;
+    PipePool* pipes_;
+    RelayDoneCb done_;
+    RelayStats stats_;
+    Flow to_upstream_;
+    Flow to_downstream_;
+    bool finished_ = false;
+
+    void on_readable(Flow& flow);
+    void on_writable(Flow& flow);
+    Status<size_t, int> fill(Flow& flow);
+    Status<size_t, int> drain(Flow& flow);
+    Status<None, int> update_interest(Flow& flow);
+    void stop_watching(Flow& flow);
+    void finish(int err);
+};
+
+// Listens on a port and relays every connection it accepts to a fixed upstream address, a plain
+// L4 forwarder. The upstream connection is made without blocking the loop.
+class ProxyServer {
+  public:
+    ProxyServer() = delete;
+    ProxyServer(const ProxyServer&) = delete;
+    ProxyServer& operator=(const ProxyServer&) = delete;
+    ProxyServer(ProxyServer&&) = delete;
+    ProxyServer& operator=(ProxyServer&&) = delete;
+
+    // `pipe_sz` sizes the pipes of `RelayMode::SPLICE`, as for `PipePool`.
+    ProxyServer(std::shared_ptr<EventLoop> event_loop,
+                int port,
+                std::string upstream_address,
+                int upstream_port,
+                RelayMode mode,
+                size_t pipe_sz = 0);
+
+    ~ProxyServer();
+
+    // Must be called before `start`.
+    void set_reuse_port();
+
+    void start();
+
+    // Connections being relayed, or waiting for their upstream connection.
+    size_t active() const;
+    // Bytes relayed by connections that have closed.
+    const RelayStats& closed_stats() const;
+
+  private:
+    struct Connecting {
+        Socket downstream;
+        ClientSocket upstream;
+    };
+
+    static constexpr int k_listen_backlog = 128;
+    static constexpr int64_t k_accept_budget = 32;
+    static constexpr size_t k_max_idle_pipes = 256;
+
+    std::shared_ptr<EventLoop> event_loop_;
+    int port_;
+    std::string upstream_address_;
+    int upstream_port_;
+    RelayMode mode_;
+    bool reuse_port_ = false;
+    bool accepting_ = false;
+    ServerSocket socket_;
+    PipePool pipes_;
+    uint64_t next_id_ = 0;
+    std::unordered_map<uint64_t, std::unique_ptr<Connecting>> connecting_;
+    std::unordered_map<uint64_t, std::unique_ptr<Relay>> relays_;
+    RelayStats closed_stats_;
+
+    void accept_one();
+    void connected(uint64_t id);
+};
+
+} // namespace axle
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+#include <optional>
+
+namespace axle {
+
+// A sustained rate and the burst allowed on top of it, in tokens: bytes, messages or connections.
+struct Rate {
+    double per_second;
+    double burst;
+};
+
+// Token bucket refilled lazily: nothing happens over time, and `refill` adds whatever accrued since
+// its last call. The rate is passed in rather than stored, so a bucket is small and many buckets
+// can share one `Rate`. Comes out full from its first refill, whatever the time: a simulated
+// clock starts at zero.
+class TokenBucket {
+  public:
+    // Tokens available at `now_ns`.
+    double refill(const Rate& rate, uint64_t now_ns);
+    // May leave the bucket in debt, which later refills pay off first. This allows charging for
+    // work after it is done, e.g. for messages only counted once read.
+    void take(double cnt);
+    // How long until `cnt` tokens are available, as of the last refill.
+    uint64_t wait_ns(const Rate& rate, double cnt) const;
+
+  private:
+    double tokens_ = 0;
+    uint64_t last_ns_ = 0;
+    bool filled_ = false;
+};
+
+// Limits for a `TcpServer`. Messages are counted by sessions that provide `take_messages()`;
+// others are only limited by bytes.
+struct RateLimits {
+    std::optional<Rate> conn_bytes;
+    std::optional<Rate> conn_messages;
+    std::optional<Rate> server_bytes;
+    std::optional<Rate> server_messages;
+    std::optional<Rate> accepts;
+};
+
+} // namespace axle
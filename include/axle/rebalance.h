@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "axle/event.h"
+#include "axle/status.h"
+#include "axle/tcp.h"
+
+namespace axle {
+
+struct RebalanceConfig {
+    // How often each loop measures its busy time and considers shedding connections.
+    std::chrono::milliseconds interval{1000};
+    // A loop sheds connections only while its busy fraction is above that of its least busy peer
+    // by more than this.
+    double imbalance = 0.2;
+    // Connections a loop moves per interval at most.
+    size_t max_moves = 8;
+};
+
+// Moves connections off loops that are busier than their peers. Each of a group of servers, one
+// per loop and all sharing a port, joins the rebalancer from its own loop; from then on a timer on
+// that loop publishes the fraction of time the loop spent running callbacks and, when it is the
+// busier side of an imbalance, migrates some of its connections to the least busy loop.
+//
+// Connections are picked busiest first by their read events, but only while the load each is
+// estimated to carry fits within half the gap, so a single hot connection is never bounced
+// between loops. Each loop only ever moves its own connections, from its own thread.
+//
+// The rebalancer and every server must outlive the loops' run.
+template <typename ServerT>
+class Rebalancer {
+  public:
+    Rebalancer() = delete;
+    Rebalancer(const Rebalancer&) = delete;
+    Rebalancer& operator=(const Rebalancer&) = delete;
+    Rebalancer(Rebalancer&&) = delete;
+    Rebalancer& operator=(Rebalancer&&) = delete;
+
+    Rebalancer(size_t loops, const RebalanceConfig& config)
+        : config_{config},
+          slots_(loops) {}
+
+    ~Rebalancer() = default;
+
+    // Adds `server` as loop `idx` of the group. Call on the server's loop thread.
+    Status<None, int> join(size_t idx, ServerT& server) {
+        Slot& slot = slots_.at(idx);
+        const std::shared_ptr<EventLoop>& loop = server.event_loop();
+        slot.last_tick = loop->now();
+        slot.last_work = loop->stats().work_time;
+        slot.server.store(&server);
+
+        const uint64_t period =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(config_.interval).count();
+        return loop->register_timer(
+            loop->make_timer_id(),
+            period,
+            true,
+            [this, idx](uint64_t, Status<None, int64_t>) { tick(idx); },
+            period / k_slack_divisor);
+    }
+
+    // The busy fraction loop `idx` last published.
+    double busy(size_t idx) const {
+        return static_cast<double>(slots_.at(idx).busy_ppm.load()) / k_ppm;
+    }
+
+    // Connections loop `idx` has moved to its peers.
+    uint64_t moved(size_t idx) const {
+        return slots_.at(idx).moved.load();
+    }
+
+  private:
+    struct Slot {
+        std::atomic<ServerT*> server{nullptr};
+        std::atomic<uint64_t> busy_ppm{0};
+        std::atomic<uint64_t> moved{0};
+        // Owned by the slot's loop.
+        std::chrono::steady_clock::time_point last_tick;
+        std::chrono::nanoseconds last_work{0};
+    };
+
+    static constexpr double k_ppm = 1e6;
+    // The timer may run this fraction of its interval late to share wakeups.
+    static constexpr uint64_t k_slack_divisor = 10;
+
+    RebalanceConfig config_;
+    std::vector<Slot> slots_;
+
+    void tick(size_t idx) {
+        Slot& slot = slots_[idx];
+        ServerT& server = *slot.server.load();
+        const std::shared_ptr<EventLoop>& loop = server.event_loop();
+
+        const std::chrono::steady_clock::time_point now = loop->now();
+        const std::chrono::nanoseconds work = loop->stats().work_time;
+        const double elapsed = std::chrono::duration<double>(now - slot.last_tick).count();
+        const double busy =
+            elapsed > 0 ? std::chrono::duration<double>(work - slot.last_work).count() / elapsed
+                        : 0;
+        slot.last_tick = now;
+        slot.last_work = work;
+        slot.busy_ppm.store(static_cast<uint64_t>(std::clamp(busy, 0.0, 1.0) * k_ppm));
+
+        std::vector<ConnActivity> activity = server.take_activity();
+
+        ServerT* target = nullptr;
+        double target_busy = 0;
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            ServerT* peer = slots_[i].server.load();
+            if (i == idx || peer == nullptr) {
+                continue;
+            }
+            if (target == nullptr || this->busy(i) < target_busy) {
+                target = peer;
+                target_busy = this->busy(i);
+            }
+        }
+        if (target == nullptr || busy - target_busy <= config_.imbalance) {
+            return;
+        }
+
+        uint64_t total = 0;
+        for (const ConnActivity& conn : activity) {
+            total += conn.read_events;
+        }
+        if (total == 0) {
+            return;
+        }
+
+        std::sort(activity.begin(), activity.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.read_events > rhs.read_events;
+        });
+
+        // Moving load `x` leaves the loops at `busy - x` and `target_busy + x`, so anything
+        // under half the gap narrows it.
+        double budget = (busy - target_busy) / 2;
+        size_t moves = 0;
+        for (const ConnActivity& conn : activity) {
+            if (moves == config_.max_moves || conn.read_events == 0) {
+                break;
+            }
+
+            const double load = busy * static_cast<double>(conn.read_events) /
+                                static_cast<double>(total);
+            if (load >= budget || server.migrate(conn.handle, *target).is_err()) {
+                continue;
+            }
+            budget -= load;
+            ++moves;
+        }
+        slot.moved.fetch_add(moves);
+    }
+};
+
+} // namespace axle
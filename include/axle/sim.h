@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "axle/event.h"
+#include "axle/status.h"
+
+namespace axle {
+
+// How one direction of a simulated connection behaves.
+struct SimLinkConfig {
+    // Time between a write and its bytes becoming readable at the other end.
+    std::chrono::nanoseconds latency{0};
+    // Bytes written and not yet read, those in flight included, at which writes are cut short and
+    // then fail with `EAGAIN`, as on a full socket buffer.
+    size_t capacity = size_t{64} * 1024;
+    // The most one read or write moves, for partial reads and writes. Zero for no limit.
+    size_t max_read = 0;
+    size_t max_write = 0;
+};
+
+struct SimStats {
+    // Polls that asked for events.
+    uint64_t polls = 0;
+    // Polls that found nothing ready and moved the clock on to the next timer or arrival.
+    uint64_t skips = 0;
+    // Virtual time moved on by polls rather than by `advance`.
+    std::chrono::nanoseconds skipped{0};
+};
+
+// A kqueue in memory, for running an `EventLoop` deterministically and faster than real time. Its
+// clock only moves when the loop would otherwise wait, straight to the next timer deadline or
+// arrival of data, or when `advance` says that work took time; callbacks take none otherwise. A
+// loop waiting with nothing left to happen blocks until another thread triggers a user event, as
+// `post` and `shutdown` do, or writes to a simulated socket.
+//
+// Sockets are in-memory pairs with a latency, a buffer capacity and limits on how much a read or
+// a write moves, and reads or writes can be made to fail with `EAGAIN` on demand. Their fds are
+// only meaningful to the backend and, like the kernel's, the lowest free one is handed out first.
+// Readiness is level-triggered and reported in a fixed order, user events, then timers, then
+// writability and readability by fd, so that a run can be repeated exactly. Thread-safe.
+class SimBackend : public EventBackend {
+  public:
+    SimBackend(const SimBackend&) = delete;
+    SimBackend& operator=(const SimBackend&) = delete;
+    SimBackend(SimBackend&&) = delete;
+    SimBackend& operator=(SimBackend&&) = delete;
+
+    explicit SimBackend(
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::time_point{});
+
+    ~SimBackend() override = default;
+
+    int kevent(const struct kevent* changes,
+               int nchanges,
+               struct kevent* events,
+               int nevents,
+               const struct timespec* timeout) override;
+    std::chrono::steady_clock::time_point now() const override;
+
+    // Moves the clock on, as though the caller had been busy for `time`.
+    void advance(std::chrono::nanoseconds time);
+
+    // A connected pair of sockets, with the same behaviour both ways or, with two configs, the
+    // first for what the first socket sends.
+    std::array<int, 2> socket_pair(const SimLinkConfig& config = {});
+    std::array<int, 2> socket_pair(const SimLinkConfig& out, const SimLinkConfig& in);
+
+    // Zero at the end of input. Fails with `EAGAIN` when nothing has arrived yet.
+    Status<size_t, int> read(int fd, std::span<uint8_t> buf);
+    // Fails with `EAGAIN` when the link is at capacity and with `EPIPE` once either end is done.
+    Status<size_t, int> write(int fd, std::span<const uint8_t> buf);
+    // The peer reads the end of input once what was written before has arrived.
+    Status<None, int> shutdown_write(int fd);
+    // Shuts down writing and frees the fd, dropping its filters.
+    Status<None, int> close(int fd);
+
+    // Fails the next `reads` reads and `writes` writes on `fd` with `EAGAIN` whatever is ready,
+    // as after a spurious wakeup.
+    void fail_with_eagain(int fd, size_t reads, size_t writes);
+    // Bytes written to `fd` and not yet read by its peer, those in flight included.
+    size_t unread(int fd) const;
+
+    SimStats stats() const;
+
+  private:
+    struct Segment {
+        uint64_t arrives_ns;
+        std::vector<uint8_t> bytes;
+        size_t read = 0;
+    };
+
+    // One direction of a connection.
+    struct Link {
+        SimLinkConfig config;
+        std::deque<Segment> segments;
+        size_t unread = 0;
+        // When the writer's end of input reaches the reader.
+        std::optional<uint64_t> eof_ns;
+        bool reader_closed = false;
+    };
+
+    struct Endpoint {
+        size_t in;
+        size_t out;
+        size_t eagain_reads = 0;
+        size_t eagain_writes = 0;
+    };
+
+    struct Filter {
+        uint16_t flags;
+        uint32_t fflags;
+        void* udata;
+        // Timers.
+        uint64_t deadline_ns = 0;
+        uint64_t period_ns = 0;
+        // User events.
+        bool triggered = false;
+    };
+
+    mutable std::mutex mu_;
+    std::condition_variable wake_;
+    uint64_t now_ns_;
+    SimStats stats_;
+    std::vector<Link> links_;
+    std::map<int, Endpoint> endpoints_;
+    std::set<int> free_fds_;
+    int next_fd_;
+    // Keyed by filter and ident, which fixes the order events are reported in.
+    std::map<std::pair<int16_t, uintptr_t>, Filter> filters_;
+
+    int apply(const struct kevent& change);
+    int collect(struct kevent* events, int nevents);
+    std::optional<uint64_t> next_change_ns() const;
+    int allocate_fd();
+    Endpoint* endpoint(int fd);
+    size_t arrived(const Link& link) const;
+    bool eof_arrived(const Link& link) const;
+};
+
+} // namespace axle
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <sys/uio.h>
+
+#include <cstddef>
 #include <cstdint>
 
+#include <optional>
 #include <span>
 #include <string>
 
@@ -9,6 +13,42 @@
 
 namespace axle {
 
+// Socket options worth tuning per workload. Unset options are left alone; each set one costs a
+// `setsockopt` call. Options the platform lacks fail with `ENOPROTOOPT`.
+struct SocketOptions {
+    // TCP_NODELAY: send small writes at once instead of coalescing them while data is unacked.
+    std::optional<bool> no_delay;
+    // TCP_QUICKACK (Linux): acknowledge at once instead of waiting to piggyback on a reply. The
+    // kernel drops back to delayed acks on its own, and accepted sockets do not inherit it.
+    std::optional<bool> quick_ack;
+    // TCP_CORK (TCP_NOPUSH on BSD and macOS): hold back partial segments until uncorked.
+    std::optional<bool> cork;
+    // SO_RCVBUF and SO_SNDBUF in bytes. On Linux this turns off buffer autotuning and is capped by
+    // net.core.rmem_max and net.core.wmem_max.
+    std::optional<int> recv_buf;
+    std::optional<int> send_buf;
+    // TCP_NOTSENT_LOWAT: report writability only once unsent data falls below this many bytes,
+    // keeping queued data, and the latency of whatever is written next, small.
+    std::optional<int> not_sent_lowat;
+    // Listeners only. TCP_DEFER_ACCEPT (Linux): hold a connection back from `accept` until it has
+    // sent data, for up to this many seconds.
+    std::optional<int> defer_accept_s;
+    // Listeners only. TCP_FASTOPEN: accept data in the SYN, with at most this many pending
+    // fast-open requests.
+    std::optional<int> fast_open_queue;
+
+    // Request/response traffic made of small messages: no coalescing on either side, a short
+    // send queue, and no wakeups for connections that have not sent anything yet.
+    static SocketOptions low_latency();
+    // Streaming large payloads: big fixed socket buffers.
+    static SocketOptions bulk();
+
+    // The options a socket accepted from a listener does not inherit from it.
+    SocketOptions per_connection() const;
+    // The rest, which set on a listener carry over to the sockets it accepts at no extra cost.
+    SocketOptions inherited() const;
+};
+
 class Socket {
   public:
     Socket();
@@ -20,10 +60,27 @@ class Socket {
     virtual ~Socket();
 
     Status<None, int> set_non_blocking() const;
+    // Lets blocking reads and polls busy-wait on the device queue for up to `usec` microseconds
+    // (Linux `SO_BUSY_POLL`). Fails with `ENOPROTOOPT` where the option does not exist.
+    Status<None, int> set_busy_poll(int usec) const;
+    // Sets every option in `options`, carrying on past failures. Returns the first error.
+    Status<None, int> apply(const SocketOptions& options) const;
 
-    Status<None, int> send_all(std::span<const uint8_t> buf_view) const;
+    // With `more`, tells the kernel more data follows straight away (Linux `MSG_MORE`), so the
+    // tail of `buf_view` can share a segment with the next write. Ignored elsewhere.
+    Status<None, int> send_all(std::span<const uint8_t> buf_view, bool more = false) const;
+    // Sends what the socket takes of `bufs`, in order, with one call. Returns the bytes sent, zero
+    // if the socket is full.
+    Status<size_t, int> send_some(std::span<const struct iovec> bufs) const;
     Status<std::span<uint8_t>, int> recv_some(std::span<uint8_t> buf_view) const;
 
+    // Half-closes the connection: the peer reads EOF once it has everything sent before, and can
+    // still send.
+    Status<None, int> shutdown_write() const;
+    // The error left on the socket by an asynchronous operation such as `connect_async`, cleared
+    // by reading it.
+    Status<None, int> pending_error() const;
+
     Status<None, int> close();
 
     int get_fd() const;
@@ -37,11 +94,23 @@ class ClientSocket : public Socket {
     ClientSocket() = default;
 
     Status<None, int> connect(const std::string& address, int port) const;
+    // Starts connecting without waiting for the handshake; the socket must be non-blocking. The
+    // socket turns writable once the connection is made or has failed, which `pending_error` then
+    // tells apart.
+    Status<None, int> connect_async(const std::string& address, int port) const;
 };
 
 class ServerSocket : public Socket {
   public:
     ServerSocket();
+    // Takes over `fd`, a socket that is already listening.
+    explicit ServerSocket(int fd);
+
+    // Both must be called before `listen`. Listeners on the same port with `SO_REUSEPORT` share
+    // incoming connections; with `SO_INCOMING_CPU` set, Linux prefers the listener whose CPU
+    // handled the connection's packets. Fail with `ENOPROTOOPT` where the option does not exist.
+    Status<None, int> set_reuse_port() const;
+    Status<None, int> set_incoming_cpu(int cpu) const;
 
     Status<None, int> listen(int port, int backlog) const;
     Status<Socket, int> accept() const;
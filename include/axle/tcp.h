@@ -1,21 +1,154 @@
 #pragma once
 
+#include <sys/uio.h>
+
 #include <cerrno>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <deque>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <span>
 #include <utility>
+#include <vector>
 
 #include "log.h"
+#include "axle/broadcast.h"
+#include "axle/capture.h"
 #include "axle/event.h"
+#include "axle/rate_limit.h"
 #include "axle/socket.h"
 #include "axle/status.h"
 
 namespace axle {
 
+// Names one connection of a `TcpServer`. Slots are reused, so a handle outliving its connection
+// carries an old generation and simply stops resolving.
+struct ConnHandle {
+    uint32_t idx;
+    uint32_t generation;
+};
+
+// How busy a connection has been, as reported by `TcpServer::take_activity`.
+struct ConnActivity {
+    ConnHandle handle;
+    uint32_t read_events;
+};
+
+// What `TcpServer` asks of every session. The server calls these straight from its read and write
+// handlers, where the compiler sees the session's type and can inline them: `recv_buf` lends up to
+// `max_len` bytes to read into and `post_recv` is handed what was read, `send_buf` hands out up to
+// `max_len` bytes of output and `post_send` is told how many were sent, and `end` runs when the
+// connection closes.
+//
+// A session with no room for input says so by lending an empty span: the connection then stops
+// being watched for input, leaving the data to queue in the kernel and the TCP window to push back
+// on the client, until sending its output, or `TcpServer::resume_reading`, finds room again.
+// `post_recv` is only ever handed bytes. The end of input is not a read: once the client has
+// finished sending and all of it has been handed over, the connection stays open until the
+// session's output has gone out, and then closes (see `EndsInput`).
+template <typename SessionT>
+concept TcpSession = requires(SessionT& session,
+                              size_t max_len,
+                              std::span<uint8_t> received,
+                              int64_t sent) {
+    { session.recv_buf(max_len) } -> std::convertible_to<std::span<uint8_t>>;
+    session.post_recv(received);
+    { session.send_buf(max_len) } -> std::convertible_to<std::span<const uint8_t>>;
+    session.post_send(sent);
+    session.end();
+};
+
+// Servers that create their sessions with a non-virtual `handle_connection`, found through the
+// server type passed to `TcpServer` as its second argument.
+template <typename ServerT, typename SessionT>
+concept MakesSessions = requires(ServerT& server) {
+    { server.handle_connection() } -> std::same_as<std::shared_ptr<SessionT>>;
+};
+
+namespace detail {
+
+// Where `TcpServer` gets new sessions from: the derived server named by `ServerT`, called
+// directly...
+template <typename SessionT, typename ServerT>
+class SessionSource {
+  public:
+    virtual ~SessionSource() = default;
+
+  protected:
+    std::shared_ptr<SessionT> new_session() {
+        static_assert(MakesSessions<ServerT, SessionT>,
+                      "the server must have a public handle_connection() returning the session");
+
+        return static_cast<ServerT&>(*this).handle_connection();
+    }
+};
+
+// ...or, without one, a virtual `handle_connection`.
+template <typename SessionT>
+class SessionSource<SessionT, void> {
+  public:
+    virtual ~SessionSource() = default;
+
+    virtual std::shared_ptr<SessionT> handle_connection() = 0;
+
+  protected:
+    std::shared_ptr<SessionT> new_session() {
+        return handle_connection();
+    }
+};
+
+} // namespace detail
+
+// Sessions that count the messages they parse, for message rate limits. Returns the messages
+// completed since the last call.
+template <typename SessionT>
+concept CountsMessages = requires(SessionT& session) {
+    { session.take_messages() } -> std::convertible_to<size_t>;
+};
+
+// Sessions that keep their output in several pieces, e.g. one per queued response, and can hand
+// them all to a single gathering write. Fills at most `bufs.size()` entries with up to `max_len`
+// bytes in total and returns how many it filled; `post_send` is then told the bytes sent across
+// all of them.
+template <typename SessionT>
+concept GathersSends = requires(SessionT& session, std::span<struct iovec> bufs, size_t max_len) {
+    { session.send_bufs(bufs, max_len) } -> std::convertible_to<size_t>;
+};
+
+// Sessions that keep their output on a `SendQueue`, which `TcpServer::broadcast` queues onto.
+template <typename SessionT>
+concept Broadcasts = requires(SessionT& session) {
+    { session.send_queue() } -> std::same_as<SendQueue&>;
+};
+
+// Sessions that can end their connection, e.g. once a protocol's closing handshake is over or an
+// error has been answered. When `closing` returns true after a read or a write, the connection is
+// closed as soon as the session has no output left.
+template <typename SessionT>
+concept ClosesConnections = requires(SessionT& session) {
+    { session.closing() } -> std::convertible_to<bool>;
+};
+
+// Sessions that want to know when the client has finished sending, e.g. to answer a request that
+// runs to the end of input. `end_input` runs once all the input has been handed to `post_recv`;
+// output the session queues then still goes out before the connection closes.
 template <typename SessionT>
-class TcpServer {
+concept EndsInput = requires(SessionT& session) { session.end_input(); };
+
+// Serves connections on a port, each with a session of type `SessionT`. Derive from it and either
+// override `handle_connection`, or pass the derived type as `ServerT` and give it a non-virtual
+// `handle_connection`, which leaves no virtual call anywhere between the kernel and the session.
+template <TcpSession SessionT, typename ServerT = void>
+class TcpServer : public detail::SessionSource<SessionT, ServerT> {
   public:
     TcpServer() = delete;
     TcpServer(const TcpServer&) = delete;
@@ -29,14 +162,112 @@ class TcpServer {
           socket_{axle::ServerSocket()},
           running_{false} {}
 
-    virtual ~TcpServer() {
+    // Serves a socket that is already bound and listening, typically one handed over by the
+    // process being replaced (see `take_listeners`). `start` then only watches it for
+    // connections, and the listening options, port sharing and steering it was set up with
+    // stay as they are.
+    explicit TcpServer(std::shared_ptr<axle::EventLoop> event_loop, axle::ServerSocket&& listener)
+        : port_(0),
+          adopted_{true},
+          event_loop_{std::move(event_loop)},
+          socket_{std::move(listener)},
+          running_{false} {}
+
+    ~TcpServer() override {
+        if (accepting_) {
+            (void)event_loop_->remove_fd_read(socket_.get_fd());
+        }
+        if (resume_armed_) {
+            (void)event_loop_->remove_timer(resume_timer_id_);
+        }
+        if (drain_armed_) {
+            (void)event_loop_->remove_timer(drain_timer_id_);
+        }
+        if (flush_hook_ != 0) {
+            (void)event_loop_->remove_hook(flush_hook_);
+        }
         (void)socket_.close();
+
+        // Nothing is left to be told the server has drained.
+        draining_ = false;
+        close_all();
     }
 
-    virtual std::shared_ptr<SessionT> handle_connection() = 0;
+    // Lets several servers, typically one per event loop, listen on the same port. Must be called
+    // before `start`.
+    void set_reuse_port() {
+        reuse_port_ = true;
+    }
+
+    // Shares the port like `set_reuse_port` and asks the kernel to hand this server the
+    // connections whose packets arrive on `cpu`, normally the CPU its loop is pinned to. Must be
+    // called before `start`.
+    void set_incoming_cpu(int cpu) {
+        reuse_port_ = true;
+        incoming_cpu_ = cpu;
+    }
+
+    // Watches a connection for writability only while its session has output queued, as seen
+    // after each read and write, instead of for the connection's whole life. An idle connection
+    // then costs the loop nothing, where otherwise every connected socket is reported writable on
+    // every iteration. Only suits sessions that produce output while handling input. Must be
+    // called before `start`.
+    void set_write_on_demand() {
+        write_on_demand_ = true;
+    }
+
+    // Write on demand, and rather than waiting for writability after a read, sends whatever the
+    // read produced once the loop's current iteration is over: each connection that has output
+    // gets a single gathering write, however many responses its session queued during the
+    // iteration. Writability is only watched for when the socket does not take it all. Must be
+    // called before `start`.
+    void set_write_coalescing() {
+        write_on_demand_ = true;
+        coalesce_writes_ = true;
+    }
+
+    // Tunes the listener and the connections it accepts, e.g. with `SocketOptions::low_latency()`.
+    // Inherited options are set once on the listener; only the rest cost a call per connection.
+    // Must be called before `start`.
+    void set_socket_options(const SocketOptions& options) {
+        options_ = options;
+        per_conn_options_ = options.per_connection().quick_ack.has_value();
+    }
+
+    // Caps the rate of accepts, and of bytes and messages read per connection and across the
+    // server. A connection over its limit, or any connection while the server is over its limit,
+    // stops being watched for input until enough tokens have accrued, leaving the data to queue
+    // in the kernel and eventually push back on the client; the listener is paused the same way.
+    // Refills are worked out from the loop's cached time when a connection is read. Must be
+    // called before `start`.
+    void set_rate_limits(const RateLimits& limits) {
+        rate_limits_ = limits;
+        limited_ = limits.conn_bytes || limits.conn_messages || limits.server_bytes ||
+                   limits.server_messages;
+    }
+
+    // What `broadcast` does with a connection whose send queue is full. Drops the payload for that
+    // connection by default.
+    void set_slow_consumer_policy(SlowConsumerPolicy policy) {
+        slow_consumer_policy_ = policy;
+    }
+
+    // Records what each connection opened from now on sends, as it is read, into `capture`; null
+    // stops recording. Streams under way in an earlier writer are closed in it. A connection
+    // migrated in starts a stream of its own. The writer must outlive the server or be replaced
+    // first. Loop thread only.
+    void set_capture(CaptureWriter* capture) {
+        for (uint32_t& stream : capture_streams_) {
+            if (stream != k_not_captured) {
+                capture_->close(stream);
+                stream = k_not_captured;
+            }
+        }
+        capture_ = capture;
+    }
 
     void start() {
-        if (socket_.listen(port_, k_listen_backlog).is_err()) {
+        if (!adopted_ && !listen()) {
             return;
         }
 
@@ -44,119 +275,889 @@ class TcpServer {
             return;
         }
 
-        (void)event_loop_->register_fd_read(
+        if (limited_ || rate_limits_.accepts) {
+            resume_timer_id_ = event_loop_->make_timer_id();
+        }
+        watch_accept();
+
+        if (coalesce_writes_) {
+            flush_hook_ = event_loop_->add_check_hook([this] { flush(); });
+        }
+
+        running_.store(true);
+    }
+
+    void setup_handlers(axle::Socket&& peer_socket) {
+        const int busy_poll_us = event_loop_->busy_poll().socket_busy_poll_us;
+        if (busy_poll_us > 0 && peer_socket.set_busy_poll(busy_poll_us).is_err()) {
+            log("failed to enable busy polling on client socket\n");
+        }
+
+        if (per_conn_options_ && peer_socket.apply(options_.per_connection()).is_err()) {
+            log("failed to apply socket options to client socket\n");
+        }
+
+        attach(std::move(peer_socket), this->new_session());
+    }
+
+    // The session behind `handle`, or null once that connection has closed.
+    SessionT* session(ConnHandle handle) {
+        Connection* conn = find(handle);
+
+        return conn == nullptr ? nullptr : conn->session.get();
+    }
+
+    // Ends the session and closes the connection. Does nothing if it is already closed.
+    void close(ConnHandle handle) {
+        if (find(handle) != nullptr) {
+            release(handle.idx);
+        }
+    }
+
+    // Watches the connection for input again if its session, full when last read, now has room.
+    // Only needed for sessions that make room other than by sending, e.g. once work handed off
+    // elsewhere is done; sending output checks by itself. Loop thread only.
+    void resume_reading(ConnHandle handle) {
+        Connection* conn = find(handle);
+        if (conn != nullptr) {
+            refill(handle, *conn);
+        }
+    }
+
+    // Stops accepting and waits for the open connections to close, for a process handing its
+    // listener over to its replacement: connections queued on the listener stay there for the
+    // replacement to accept, so none are refused. Connections still open after `deadline` are
+    // closed, sessions and all. `on_drained` is posted to the loop once none are left. The
+    // listener stays open until the server goes away. Loop thread only.
+    void drain(std::chrono::milliseconds deadline, axle::PostedCb on_drained) {
+        draining_ = true;
+        on_drained_ = std::move(on_drained);
+        if (accepting_) {
+            if (event_loop_->remove_fd_read(socket_.get_fd()).is_err()) {
+                log("failed to stop accepting on server socket\n");
+            }
+            accepting_ = false;
+        }
+
+        if (connections() == 0) {
+            drained();
+
+            return;
+        }
+
+        const auto timeout = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline);
+        drain_timer_id_ = event_loop_->make_timer_id();
+        drain_armed_ = event_loop_
+                           ->register_timer(drain_timer_id_,
+                                            std::max<int64_t>(timeout.count(), 1),
+                                            false,
+                                            [this](uint64_t, axle::Status<axle::None, int64_t>) {
+                                                drain_armed_ = false;
+                                                close_all();
+                                            })
+                           .is_ok();
+    }
+
+    bool draining() const {
+        return draining_;
+    }
+
+    // The listening socket, for handing over to a replacement process.
+    int listener_fd() const {
+        return socket_.get_fd();
+    }
+
+    // Queues `payload` by reference on every open connection, so it is never copied however many
+    // connections there are, and returns how many took it. A connection whose queue is full is
+    // dealt with by the slow consumer policy. Loop thread only.
+    size_t broadcast(const SharedBuffer& payload)
+        requires Broadcasts<SessionT>
+    {
+        size_t queued = 0;
+        for (uint32_t idx = 0; idx < conns_.size(); ++idx) {
+            Connection& conn = conns_[idx];
+            if (conn.session == nullptr) {
+                continue;
+            }
+
+            if (!conn.session->send_queue().push(payload)) {
+                if (slow_consumer_policy_ == SlowConsumerPolicy::DISCONNECT) {
+                    release(idx);
+                }
+                continue;
+            }
+            ++queued;
+            want_write(ConnHandle{idx, conn.generation}, conn);
+        }
+
+        return queued;
+    }
+
+    // Moves the connection behind `handle`, session and all, to `target`, typically a server for
+    // the same port on another loop. The connection leaves this loop at once, without its session
+    // being ended, and is registered on the target's loop by a callback posted there; readiness is
+    // level-triggered, so input or an EOF that arrives in between is reported once it is. Output
+    // the session still has queued is sent from the target. `handle` stops resolving, and the
+    // target calls `handle_migrated` with the new handle. Loop thread only; the target must
+    // outlive its loop's run.
+    Status<None, int> migrate(ConnHandle handle, TcpServer& target) {
+        if (find(handle) == nullptr) {
+            return Status<None, int>::make_err(ENOTCONN);
+        }
+
+        // Posted callbacks must be copyable, and the socket is not.
+        auto moving = std::make_shared<Detached>(detach(handle.idx));
+        Status<None, int> res = target.event_loop_->post([&target, moving] {
+            const ConnHandle adopted =
+                target.attach(std::move(*moving->socket), std::move(moving->session));
+            target.handle_migrated(adopted, *target.conns_[adopted.idx].session);
+        });
+        if (res.is_err()) {
+            // Stays here after all.
+            attach(std::move(*moving->socket), std::move(moving->session));
+        } else if (draining_ && connections() == 0) {
+            drained();
+        }
+
+        return res;
+    }
+
+    // Called on the target's loop once a connection migrated with `migrate` is registered there,
+    // for sessions that hold on to their loop.
+    virtual void handle_migrated(ConnHandle handle, SessionT& session) {
+        (void)handle;
+        (void)session;
+    }
+
+    // Open connections.
+    size_t connections() const {
+        return conns_.size() - free_conns_.size();
+    }
+
+    // The read events each open connection has had since the last call, which starts the counts
+    // over. A rough measure of the load each puts on the loop, for picking which to migrate.
+    std::vector<ConnActivity> take_activity() {
+        std::vector<ConnActivity> activity;
+        activity.reserve(connections());
+        for (uint32_t idx = 0; idx < conns_.size(); ++idx) {
+            Connection& conn = conns_[idx];
+            if (conn.session != nullptr) {
+                activity.push_back({ConnHandle{idx, conn.generation}, read_events_[idx]});
+                read_events_[idx] = 0;
+            }
+        }
+
+        return activity;
+    }
+
+    const std::shared_ptr<axle::EventLoop>& event_loop() const {
+        return event_loop_;
+    }
+
+    bool running() {
+        return running_.load();
+    }
+
+    void stop() {
+        running_.store(false);
+    }
+
+  private:
+    struct Connection {
+        std::optional<axle::Socket> socket;
+        std::shared_ptr<SessionT> session;
+        // Bumped when the connection closes, invalidating its handles.
+        uint32_t generation = 0;
+        // Whether the read and write filters are registered. These flags and the ones below are
+        // single bits, to keep the slot within its budget.
+        bool reading : 1 = false;
+        bool writing : 1 = false;
+        // Whether the connection is queued for the end-of-iteration flush.
+        bool dirty : 1 = false;
+        // Whether reading stopped because the session had no room for input.
+        bool full : 1 = false;
+        // Whether the last read left input in the kernel, which comes before any end of input.
+        bool unread : 1 = false;
+        // Whether the client has finished sending and all it sent has been read.
+        bool input_ended : 1 = false;
+    };
+
+    // A connection taken off the loop, to be registered elsewhere.
+    struct Detached {
+        std::optional<axle::Socket> socket;
+        std::shared_ptr<SessionT> session;
+    };
+
+    struct ConnBuckets {
+        TokenBucket bytes;
+        TokenBucket messages;
+    };
+
+    // Per-connection bookkeeping, on top of the session and the loop's own per-fd entry: with that
+    // entry's `EventLoop::k_fd_entry_budget`, a connection costs 136 bytes besides its session and
+    // the kernel's socket.
+    static constexpr size_t k_conn_budget = 48;
+    static_assert(sizeof(Connection) <= k_conn_budget);
+
+    static constexpr int k_listen_backlog = 128;
+    // Work done per readiness event before yielding to the rest of the loop.
+    static constexpr int64_t k_accept_budget = 32;
+    static constexpr size_t k_read_budget = 4;
+    // Pieces of output handed to one gathering write.
+    static constexpr size_t k_max_send_bufs = 16;
+    // A connection paused for bytes resumes once this much can be read, or the whole burst if
+    // that is smaller, rather than trickling in a few bytes at a time.
+    static constexpr double k_resume_bytes = 4096;
+    static constexpr uint32_t k_not_captured = std::numeric_limits<uint32_t>::max();
+
+    int port_;
+    // Whether the listener was handed in already listening.
+    bool adopted_ = false;
+    bool reuse_port_ = false;
+    int incoming_cpu_ = -1;
+    bool write_on_demand_ = false;
+    bool coalesce_writes_ = false;
+    SlowConsumerPolicy slow_consumer_policy_ = SlowConsumerPolicy::DROP;
+    uint64_t flush_hook_ = 0;
+    // Connections with output produced during the current iteration.
+    std::vector<ConnHandle> dirty_;
+    SocketOptions options_;
+    bool per_conn_options_ = false;
+    std::shared_ptr<axle::EventLoop> event_loop_;
+    axle::ServerSocket socket_;
+    std::atomic_bool running_;
+    // A deque so that connections stay put while the table grows under a running callback.
+    std::deque<Connection> conns_;
+    std::vector<uint32_t> free_conns_;
+    // Indexed like `conns_`: read events since the last `take_activity`.
+    std::vector<uint32_t> read_events_;
+    CaptureWriter* capture_ = nullptr;
+    // Indexed like `conns_`: the capture stream of each connection being recorded.
+    std::vector<uint32_t> capture_streams_;
+
+    RateLimits rate_limits_;
+    // Whether any byte or message limit is set.
+    bool limited_ = false;
+    // Indexed like `conns_`; only filled in when `limited_`.
+    std::vector<ConnBuckets> buckets_;
+    TokenBucket server_bytes_;
+    TokenBucket server_messages_;
+    TokenBucket accepts_;
+    bool accepting_ = false;
+    std::vector<ConnHandle> paused_;
+    uint64_t resume_timer_id_ = 0;
+    bool resume_armed_ = false;
+    uint64_t resume_at_ns_ = 0;
+
+    bool draining_ = false;
+    axle::PostedCb on_drained_;
+    uint64_t drain_timer_id_ = 0;
+    bool drain_armed_ = false;
+
+    Connection* find(ConnHandle handle) {
+        if (handle.idx >= conns_.size()) {
+            return nullptr;
+        }
+
+        Connection& conn = conns_[handle.idx];
+
+        return conn.generation == handle.generation && conn.session != nullptr ? &conn : nullptr;
+    }
+
+    // A handle packed into, and back out of, the word an `FdCallback` carries.
+    static uint64_t to_arg(ConnHandle handle) {
+        return (static_cast<uint64_t>(handle.generation) << 32) | handle.idx;
+    }
+
+    static ConnHandle to_handle(uint64_t arg) {
+        return {static_cast<uint32_t>(arg), static_cast<uint32_t>(arg >> 32)};
+    }
+
+    uint64_t now_ns() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   event_loop_->now().time_since_epoch())
+            .count();
+    }
+
+    bool listen() {
+        if (reuse_port_ && socket_.set_reuse_port().is_err()) {
+            return false;
+        }
+
+        // Buffer sizes must be set before `listen` to take part in window scaling.
+        if (socket_.apply(options_.inherited()).is_err()) {
+            log("failed to apply some socket options to the listener\n");
+        }
+
+        if (incoming_cpu_ >= 0 && socket_.set_incoming_cpu(incoming_cpu_).is_err()) {
+            log("failed to steer connections to cpu {}\n", incoming_cpu_);
+        }
+
+        return socket_.listen(port_, k_listen_backlog).is_ok();
+    }
+
+    void watch_accept() {
+        const axle::Status<axle::None, int> res = event_loop_->register_fd_read(
             socket_.get_fd(), [this](uint64_t fd, axle::Status<int64_t, uint32_t> status) {
                 (void)fd;
                 if (status.is_err()) {
                     log("notification failure for server socket: {}\n", status.err());
                     return;
                 }
-                for (int64_t i = 0; i < status.ok(); ++i) {
+                // The listener is level-triggered: whatever is left of the backlog after this
+                // turn is reported again next iteration, behind the other ready sockets.
+                int64_t budget = std::min<int64_t>(status.ok(), k_accept_budget);
+                if (rate_limits_.accepts) {
+                    const double tokens = accepts_.refill(*rate_limits_.accepts, now_ns());
+                    budget = std::min(budget, static_cast<int64_t>(std::max(tokens, 0.0)));
+                    if (budget == 0) {
+                        pause_accept();
+
+                        return;
+                    }
+                }
+
+                for (int64_t i = 0; i < budget; ++i) {
                     axle::Status<axle::Socket, int> accept_status = socket_.accept();
                     if (accept_status.is_err()) {
-                        switch (accept_status.err()) {
-                        case EWOULDBLOCK:
-                            break;
-                        default:
-                            log("accept failure for server socket: {}\n", status.err());
+                        if (accept_status.err() == EWOULDBLOCK) {
                             break;
                         }
+                        log("accept failure for server socket: {}\n", accept_status.err());
                         continue;
                     }
 
+                    if (rate_limits_.accepts) {
+                        accepts_.take(1);
+                    }
                     setup_handlers(accept_status.ok());
                 }
             });
+        accepting_ = res.is_ok();
+    }
 
-        running_.store(true);
+    void watch_read(ConnHandle handle, int fd) {
+        const axle::Status<axle::None, int> res = event_loop_->register_fd_read(
+            fd, axle::FdCallback::bind<&TcpServer::on_readable>(this, to_arg(handle)));
+        conns_[handle.idx].reading = res.is_ok();
     }
 
-    void setup_handlers(axle::Socket&& peer_socket) {
-        const std::shared_ptr<axle::Socket> socket =
-            std::make_shared<axle::Socket>(std::move(peer_socket));
-        const std::shared_ptr<SessionT> session{handle_connection()};
+    void on_readable(uint64_t arg, uint64_t fd, axle::Status<int64_t, uint32_t> status) {
+        const ConnHandle handle = to_handle(arg);
+        Connection* conn = find(handle);
+        if (conn == nullptr) {
+            return;
+        }
 
-        (void)event_loop_->register_fd_read(
-            socket->get_fd(),
-            [socket, session](uint64_t fd, axle::Status<int64_t, uint32_t> status) {
-                (void)fd;
-                if (status.is_err()) {
-                    log("read failure from client socket: {}\n", status.err());
+        if (status.is_err()) {
+            log("read failure from client socket: {}\n", status.err());
 
-                    return;
-                }
+            return;
+        }
+        ++read_events_[handle.idx];
 
-                const std::span<uint8_t> buf = session->recv_buf(status.ok());
-                axle::Status<std::span<uint8_t>, int> res = socket->recv_some(buf);
-                if (res.is_err()) {
-                    log("failed to recv\n");
+        int64_t avail = status.ok();
+        if (limited_ && avail > 0) {
+            avail = std::min(avail, read_allowance(handle.idx));
+            if (avail == 0) {
+                pause_read(handle, static_cast<int>(fd));
 
-                    return;
+                return;
+            }
+        }
+
+        // Drain what the kernel reported, but in at most `k_read_budget` reads so a hot connection
+        // cannot hold the loop. Like the listener, the socket is reported again next iteration if
+        // data remains. Nothing is reported at the end of input, which the eof callback deals
+        // with.
+        SessionT& session = *conn->session;
+        int64_t received = 0;
+        for (size_t i = 0; i < k_read_budget && received < avail; ++i) {
+            const std::span<uint8_t> buf = session.recv_buf(avail - received);
+            if (buf.empty()) {
+                // Full on arrival means sending did not make room since the last read: stop
+                // asking until it does, rather than being woken for the same bytes every
+                // iteration. Filled by this read, it is left to the output that follows to make
+                // room.
+                if (i == 0) {
+                    stop_reading(*conn);
                 }
-                session->post_recv(res.ok());
-            });
+                break;
+            }
 
-        (void)event_loop_->register_fd_write(
-            socket->get_fd(),
-            [socket, session](uint64_t fd, axle::Status<int64_t, uint32_t> status) {
-                (void)fd;
-                if (status.is_err()) {
-                    log("write failure to client socket: {}\n", status.err());
+            axle::Status<std::span<uint8_t>, int> res = conn->socket->recv_some(buf);
+            if (res.is_err()) {
+                log("failed to recv\n");
+                release(handle.idx);
 
-                    return;
-                }
+                return;
+            }
+            if (res.ok().empty()) {
+                break;
+            }
+            if (capture_ != nullptr) [[unlikely]] {
+                capture(handle.idx, res.ok());
+            }
+            session.post_recv(res.ok());
 
-                const std::span<const uint8_t> buf = session->send_buf(status.ok());
-                const axle::Status<axle::None, int> res = socket->send_all(buf);
-                if (res.is_err()) {
-                    log("failed to send\n");
+            received += static_cast<int64_t>(res.ok().size());
+        }
+        conn->unread = received < status.ok();
 
-                    return;
-                }
-                session->post_send(buf.size());
-            });
+        if (limited_) {
+            charge(handle.idx, session, received);
+        }
+
+        if (!session.send_buf(1).empty()) {
+            want_write(handle, *conn);
+        } else {
+            (void)close_if_done(handle, *conn);
+        }
+    }
+
+    // Bytes the connection may read now: 0 while any of its buckets is empty.
+    int64_t read_allowance(uint32_t idx) {
+        const uint64_t now = now_ns();
+        ConnBuckets& buckets = buckets_[idx];
+        // Unbounded without a byte limit. Not `int64_t`'s maximum, which as a double rounds up to a
+        // value that does not convert back.
+        double allowance = std::numeric_limits<double>::infinity();
+
+        if (rate_limits_.conn_bytes) {
+            allowance = std::min(allowance, buckets.bytes.refill(*rate_limits_.conn_bytes, now));
+        }
+        if (rate_limits_.server_bytes) {
+            allowance = std::min(allowance, server_bytes_.refill(*rate_limits_.server_bytes, now));
+        }
+        if (rate_limits_.conn_messages &&
+            buckets.messages.refill(*rate_limits_.conn_messages, now) < 1) {
+            return 0;
+        }
+        if (rate_limits_.server_messages &&
+            server_messages_.refill(*rate_limits_.server_messages, now) < 1) {
+            return 0;
+        }
+
+        if (allowance < 1) {
+            return 0;
+        }
+
+        return std::isinf(allowance) ? std::numeric_limits<int64_t>::max()
+                                     : static_cast<int64_t>(allowance);
+    }
+
+    void charge(uint32_t idx, SessionT& session, int64_t bytes) {
+        ConnBuckets& buckets = buckets_[idx];
+        if (rate_limits_.conn_bytes) {
+            buckets.bytes.take(static_cast<double>(bytes));
+        }
+        if (rate_limits_.server_bytes) {
+            server_bytes_.take(static_cast<double>(bytes));
+        }
+
+        if constexpr (CountsMessages<SessionT>) {
+            const auto messages = static_cast<double>(session.take_messages());
+            if (rate_limits_.conn_messages) {
+                buckets.messages.take(messages);
+            }
+            if (rate_limits_.server_messages) {
+                server_messages_.take(messages);
+            }
+        } else {
+            (void)session;
+        }
+    }
+
+    void stop_reading(Connection& conn) {
+        if (event_loop_->remove_fd_read(conn.socket->get_fd()).is_err()) {
+            log("failed to stop reads on client socket\n");
+
+            return;
+        }
+        conn.reading = false;
+        conn.full = true;
+    }
+
+    // Watches a full connection for input again once its session has room.
+    void refill(ConnHandle handle, Connection& conn) {
+        if (!conn.full || conn.session->recv_buf(1).empty()) {
+            return;
+        }
+
+        conn.full = false;
+        if (!conn.reading) {
+            watch_read(handle, conn.socket->get_fd());
+        }
+    }
+
+    void pause_read(ConnHandle handle, int fd) {
+        Connection& conn = conns_[handle.idx];
+        if (event_loop_->remove_fd_read(fd).is_err()) {
+            log("failed to pause reads on client socket\n");
+
+            return;
+        }
+        conn.reading = false;
+        paused_.push_back(handle);
+
+        // Resume once every bucket that held the connection back has refilled.
+        const ConnBuckets& buckets = buckets_[handle.idx];
+        uint64_t wait = 0;
+        if (rate_limits_.conn_bytes) {
+            const Rate& rate = *rate_limits_.conn_bytes;
+            wait = std::max(wait,
+                            buckets.bytes.wait_ns(rate, std::min(k_resume_bytes, rate.burst)));
+        }
+        if (rate_limits_.server_bytes) {
+            const Rate& rate = *rate_limits_.server_bytes;
+            wait = std::max(wait,
+                            server_bytes_.wait_ns(rate, std::min(k_resume_bytes, rate.burst)));
+        }
+        if (rate_limits_.conn_messages) {
+            wait = std::max(wait, buckets.messages.wait_ns(*rate_limits_.conn_messages, 1));
+        }
+        if (rate_limits_.server_messages) {
+            wait = std::max(wait, server_messages_.wait_ns(*rate_limits_.server_messages, 1));
+        }
+        arm_resume(wait);
+    }
+
+    void pause_accept() {
+        if (event_loop_->remove_fd_read(socket_.get_fd()).is_err()) {
+            log("failed to pause accepts on server socket\n");
+
+            return;
+        }
+        accepting_ = false;
+        arm_resume(accepts_.wait_ns(*rate_limits_.accepts, 1));
+    }
+
+    // Paused connections share one timer, set for the earliest of their resume times. Any that
+    // resume too early pause again on their next read.
+    void arm_resume(uint64_t wait_ns) {
+        const uint64_t at = now_ns() + wait_ns;
+        if (resume_armed_ && at >= resume_at_ns_) {
+            return;
+        }
+
+        resume_at_ns_ = at;
+        resume_armed_ = event_loop_
+                            ->register_timer(resume_timer_id_,
+                                             std::max<uint64_t>(wait_ns, 1),
+                                             false,
+                                             [this](uint64_t, axle::Status<axle::None, int64_t>) {
+                                                 resume();
+                                             })
+                            .is_ok();
+    }
+
+    void resume() {
+        resume_armed_ = false;
+        if (!accepting_ && !draining_) {
+            watch_accept();
+        }
+
+        std::vector<ConnHandle> paused;
+        paused.swap(paused_);
+        for (const ConnHandle handle : paused) {
+            Connection* conn = find(handle);
+            if (conn != nullptr && !conn->reading && !conn->full) {
+                watch_read(handle, conn->socket->get_fd());
+            }
+        }
+    }
+
+    // Gets output the session has just produced on its way: at the end of the iteration when
+    // writes are coalesced, otherwise once the socket is writable.
+    void want_write(ConnHandle handle, Connection& conn) {
+        if (conn.writing) {
+            return;
+        }
+
+        if (!coalesce_writes_) {
+            watch_write(handle, conn.socket->get_fd());
+        } else if (!conn.dirty) {
+            conn.dirty = true;
+            dirty_.push_back(handle);
+        }
+    }
+
+    void watch_write(ConnHandle handle, int fd) {
+        const axle::Status<axle::None, int> res = event_loop_->register_fd_write(
+            fd, axle::FdCallback::bind<&TcpServer::on_writable>(this, to_arg(handle)));
+        conns_[handle.idx].writing = res.is_ok();
+    }
+
+    void on_writable(uint64_t arg, uint64_t fd, axle::Status<int64_t, uint32_t> status) {
+        const ConnHandle handle = to_handle(arg);
+        Connection* conn = find(handle);
+        if (conn == nullptr) {
+            return;
+        }
+
+        if (status.is_err()) {
+            log("write failure to client socket: {}\n", status.err());
+
+            return;
+        }
+
+        if (!send_pending(*conn, static_cast<size_t>(status.ok()))) {
+            release(handle.idx);
+
+            return;
+        }
+        if (close_if_done(handle, *conn)) {
+            return;
+        }
+        refill(handle, *conn);
+
+        if (write_on_demand_ && conn->session->send_buf(1).empty()) {
+            conn->writing = false;
+            (void)event_loop_->remove_fd_write(static_cast<int>(fd));
+        }
+    }
+
+    // Sends as much of the session's output as the socket takes, in one call. False on failure,
+    // after which the connection is no use.
+    bool send_pending(Connection& conn, size_t max_len) {
+        std::array<struct iovec, k_max_send_bufs> bufs{};
+        size_t cnt = 0;
+        if constexpr (GathersSends<SessionT>) {
+            cnt = conn.session->send_bufs(std::span<struct iovec>{bufs}, max_len);
+        } else {
+            const std::span<const uint8_t> buf = conn.session->send_buf(max_len);
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+            bufs[0] = {const_cast<uint8_t*>(buf.data()), buf.size()};
+            cnt = buf.empty() ? 0 : 1;
+        }
+        if (cnt == 0) {
+            return true;
+        }
+
+        axle::Status<size_t, int> res =
+            conn.socket->send_some(std::span<const struct iovec>{bufs}.first(cnt));
+        if (res.is_err()) {
+            log("failed to send\n");
+
+            return false;
+        }
+        conn.session->post_send(static_cast<int64_t>(res.ok()));
+
+        return true;
+    }
+
+    // Closes the connection if the client has finished sending or the session is done with it, and
+    // the session has sent all it had. True if it did.
+    bool close_if_done(ConnHandle handle, Connection& conn) {
+        SessionT& session = *conn.session;
+        bool done = conn.input_ended;
+        if constexpr (ClosesConnections<SessionT>) {
+            done = done || session.closing();
+        }
+        if (!done || !session.send_buf(1).empty()) {
+            return false;
+        }
+        release(handle.idx);
+
+        return true;
+    }
+
+    // Runs after every iteration of the loop when writes are coalesced.
+    void flush() {
+        for (const ConnHandle handle : dirty_) {
+            Connection* conn = find(handle);
+            if (conn == nullptr) {
+                continue;
+            }
+            conn->dirty = false;
+
+            if (conn->writing) {
+                continue;
+            }
+            if (!send_pending(*conn, std::numeric_limits<size_t>::max())) {
+                release(handle.idx);
+                continue;
+            }
+            if (close_if_done(handle, *conn)) {
+                continue;
+            }
+            refill(handle, *conn);
+            if (!conn->session->send_buf(1).empty()) {
+                watch_write(handle, conn->socket->get_fd());
+            }
+        }
+        dirty_.clear();
+    }
+
+    // Takes a slot for the connection and registers it. The callbacks are plain functions that
+    // hold only the server and the handle, and find the connection through the table: the loop
+    // calls straight into them, with no allocation per callback and no reference counting per
+    // event.
+    ConnHandle attach(axle::Socket&& peer_socket, std::shared_ptr<SessionT> session) {
+        uint32_t idx = 0;
+        if (free_conns_.empty()) {
+            idx = static_cast<uint32_t>(conns_.size());
+            conns_.emplace_back();
+        } else {
+            idx = free_conns_.back();
+            free_conns_.pop_back();
+        }
+
+        Connection& conn = conns_[idx];
+        conn.socket.emplace(std::move(peer_socket));
+        conn.session = std::move(session);
+        if (read_events_.size() <= idx) {
+            read_events_.resize(idx + 1);
+        }
+        read_events_[idx] = 0;
+        if (capture_ != nullptr) {
+            if (capture_streams_.size() <= idx) {
+                capture_streams_.resize(idx + 1, k_not_captured);
+            }
+            capture_streams_[idx] = capture_->open();
+        }
+        const int fd = conn.socket->get_fd();
+        const ConnHandle handle{idx, conn.generation};
+
+        if (limited_) {
+            if (buckets_.size() <= idx) {
+                buckets_.resize(idx + 1);
+            }
+            buckets_[idx] = ConnBuckets{};
+        }
+
+        watch_read(handle, fd);
+
+        if (!write_on_demand_) {
+            watch_write(handle, fd);
+        } else if (!conn.session->send_buf(1).empty()) {
+            // A migrated session may have output left over from its old loop.
+            want_write(handle, conn);
+        }
 
         (void)event_loop_->register_fd_eof(
-            socket->get_fd(),
-            [socket, session, this](uint64_t fd, axle::Status<int64_t, uint32_t> status) {
-                (void)fd;
-                if (status.is_err()) {
-                    log("close failure on socket: {}\n", status.err());
+            fd, axle::FdCallback::bind<&TcpServer::on_eof>(this, to_arg(handle)));
 
-                    return;
-                }
+        return handle;
+    }
 
-                session->end();
+    // The client has finished sending. What it sent before that still counts: input the last read
+    // left in the kernel, or that was not read at all because the session was full or a rate
+    // limit paused the connection, is reported again along with the end once it can be read.
+    void on_eof(uint64_t arg, uint64_t fd, axle::Status<int64_t, uint32_t> status) {
+        const ConnHandle handle = to_handle(arg);
+        Connection* conn = find(handle);
+        if (conn == nullptr) {
+            return;
+        }
 
-                if (event_loop_->remove_fd_write(socket->get_fd()).is_err()) {
-                    log("failed to remove fd write filter: {}\n", status.err());
-                }
+        if (status.is_err()) {
+            log("close failure on socket: {}\n", status.err());
 
-                if (event_loop_->remove_fd_read(socket->get_fd()).is_err()) {
-                    log("failed to remove fd read filter: {}\n", status.err());
-                }
+            return;
+        }
 
-                if (event_loop_->remove_fd_eof(socket->get_fd()).is_err()) {
-                    log("failed to remove fd eof filter: {}\n", status.err());
-                }
-            });
+        if (!conn->reading || conn->unread) {
+            return;
+        }
+        end_input(handle, static_cast<int>(fd), *conn);
     }
 
-    bool running() {
-        return running_.load();
+    // Stops reading, which would only report the end again, and closes the connection once the
+    // session has sent its output.
+    void end_input(ConnHandle handle, int fd, Connection& conn) {
+        if (conn.input_ended) {
+            return;
+        }
+        conn.input_ended = true;
+        if (conn.reading && event_loop_->remove_fd_read(fd).is_err()) {
+            log("failed to stop reads on client socket\n");
+        }
+        conn.reading = false;
+
+        if constexpr (EndsInput<SessionT>) {
+            conn.session->end_input();
+        }
+        if (conn.session->send_buf(1).empty()) {
+            release(handle.idx);
+        } else {
+            want_write(handle, conn);
+        }
     }
 
-    void stop() {
-        running_.store(false);
+    void capture(uint32_t idx, std::span<const uint8_t> bytes) {
+        if (idx < capture_streams_.size() && capture_streams_[idx] != k_not_captured) {
+            capture_->data(capture_streams_[idx], bytes);
+        }
     }
 
-  private:
-    static constexpr int k_listen_backlog = 128;
+    void release(uint32_t idx) {
+        conns_[idx].session->end();
+        (void)detach(idx);
+        if (draining_ && connections() == 0) {
+            drained();
+        }
+    }
 
-    int port_;
-    std::shared_ptr<axle::EventLoop> event_loop_;
-    axle::ServerSocket socket_;
-    std::atomic_bool running_;
+    void close_all() {
+        for (uint32_t idx = 0; idx < conns_.size(); ++idx) {
+            if (conns_[idx].session != nullptr) {
+                release(idx);
+            }
+        }
+    }
+
+    // Posted rather than called, so that it can destroy the server without pulling it out from
+    // under the callback that closed the last connection.
+    void drained() {
+        if (drain_armed_) {
+            (void)event_loop_->remove_timer(drain_timer_id_);
+            drain_armed_ = false;
+        }
+        if (on_drained_ && event_loop_->post(std::move(on_drained_)).is_err()) {
+            log("failed to post the end of draining\n");
+        }
+        on_drained_ = nullptr;
+    }
+
+    // Unregisters the connection and frees its slot, handing back its socket and session.
+    Detached detach(uint32_t idx) {
+        Connection& conn = conns_[idx];
+        const int fd = conn.socket->get_fd();
+
+        // The filters go before the socket is closed, so the loop knows the fd is free and tags
+        // its next user with a new generation.
+        if (conn.writing && event_loop_->remove_fd_write(fd).is_err()) {
+            log("failed to remove fd write filter\n");
+        }
+        conn.writing = false;
+
+        if (conn.reading && event_loop_->remove_fd_read(fd).is_err()) {
+            log("failed to remove fd read filter\n");
+        }
+        conn.reading = false;
+        conn.dirty = false;
+        conn.full = false;
+        conn.unread = false;
+        conn.input_ended = false;
+
+        if (event_loop_->remove_fd_eof(fd).is_err()) {
+            log("failed to remove fd eof filter\n");
+        }
+
+        if (idx < capture_streams_.size() && capture_streams_[idx] != k_not_captured) {
+            capture_->close(capture_streams_[idx]);
+            capture_streams_[idx] = k_not_captured;
+        }
+
+        Detached detached{std::move(conn.socket), std::move(conn.session)};
+        conn.socket.reset();
+        conn.session.reset();
+        ++conn.generation;
+        free_conns_.push_back(idx);
+
+        return detached;
+    }
 };
 
 } // namespace axle
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace axle {
+
+enum class TraceKind : uint8_t {
+    // Spans: waiting for events (argument: events returned), and dispatching one event or batch
+    // of work.
+    POLL,
+    READ,
+    WRITE,
+    TIMER,
+    USER,
+    DEFERRED,
+    HOOKS,
+    // Instants: registration changes, with the fd or timer id as argument.
+    REGISTER_READ,
+    REGISTER_WRITE,
+    REGISTER_TIMER,
+    REMOVE_READ,
+    REMOVE_WRITE,
+    REMOVE_TIMER,
+};
+
+struct TraceRecord {
+    uint64_t start_ns;
+    // The fd, timer id, user event id, or a count of events, callbacks or hooks, by kind.
+    uint64_t arg;
+    // Zero for instants. Wide enough for a poll that waits for hours.
+    uint64_t duration_ns;
+    TraceKind kind;
+};
+
+// A fixed-size ring of trace records that overwrites the oldest once full. Belongs to one event
+// loop and is only touched from its thread: read it from a callback posted to the loop, or once
+// the loop has stopped.
+class TraceBuffer {
+  public:
+    TraceBuffer() = delete;
+    TraceBuffer(const TraceBuffer&) = delete;
+    TraceBuffer& operator=(const TraceBuffer&) = delete;
+    TraceBuffer(TraceBuffer&&) = delete;
+    TraceBuffer& operator=(TraceBuffer&&) = delete;
+
+    // `capacity` is rounded up to a power of two.
+    explicit TraceBuffer(size_t capacity);
+
+    ~TraceBuffer() = default;
+
+    static uint64_t now_ns();
+
+    void record(TraceKind kind, uint64_t arg, uint64_t start_ns, uint64_t end_ns);
+    void instant(TraceKind kind, uint64_t arg);
+
+    // The records still held, oldest first.
+    std::vector<TraceRecord> records() const;
+    // Records overwritten since the buffer was created.
+    uint64_t dropped() const;
+
+  private:
+    std::vector<TraceRecord> ring_;
+    uint64_t next_ = 0;
+};
+
+// The records of one thread, as they should appear in a trace viewer.
+struct TraceThread {
+    uint32_t tid;
+    std::string name;
+    std::vector<TraceRecord> records;
+};
+
+const char* trace_kind_name(TraceKind kind);
+
+// Chrome trace event JSON, for chrome://tracing and the Perfetto UI.
+void write_chrome_trace(std::ostream& out, std::span<const TraceThread> threads);
+// Perfetto's protobuf trace format, with one track per thread.
+void write_perfetto_trace(std::ostream& out, std::span<const TraceThread> threads);
+
+} // namespace axle
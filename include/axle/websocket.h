@@ -0,0 +1,214 @@
+#pragma once
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "axle/broadcast.h"
+#include "axle/http.h"
+#include "axle/status.h"
+
+namespace axle {
+
+enum class WsOpcode : uint8_t {
+    CONTINUATION = 0x0,
+    TEXT = 0x1,
+    BINARY = 0x2,
+    CLOSE = 0x8,
+    PING = 0x9,
+    PONG = 0xa,
+};
+
+enum class WsError : uint8_t {
+    BAD_HANDSHAKE,
+    BAD_OPCODE,
+    RESERVED_BITS,
+    UNMASKED,
+    BAD_CONTROL,
+    BAD_CONTINUATION,
+    BAD_LENGTH,
+    TOO_LARGE,
+};
+
+// The key a client masks its frames with, in the order it appears on the wire.
+using WsMask = std::array<uint8_t, 4>;
+
+// The largest frame header: two bytes, a 64-bit length and a masking key.
+constexpr size_t k_ws_max_header_sz = 14;
+
+// The `Sec-WebSocket-Accept` value answering a client's `Sec-WebSocket-Key`.
+std::string ws_accept_key(std::string_view key);
+
+// Checks that `req` asks for a WebSocket upgrade the server can accept and, if so, appends the
+// `101 Switching Protocols` response to `response`.
+Status<None, WsError> ws_accept(const HttpRequest& req, std::string& response);
+
+// XORs `payload` with a frame's masking key, `payload` starting `offset` bytes into the frame's
+// payload so that a frame can be unmasked piecemeal as it arrives. Masking is its own inverse.
+// Uses AVX2 or SSE2 when the target supports them.
+void ws_unmask(std::span<uint8_t> payload, WsMask mask, size_t offset = 0);
+
+// Writes the header of a frame carrying `payload_len` bytes and returns its size. Servers send
+// their frames unmasked; clients pass the key they mask the payload with.
+size_t ws_encode_header(WsOpcode opcode,
+                        bool fin,
+                        size_t payload_len,
+                        const std::optional<WsMask>& mask,
+                        std::span<uint8_t, k_ws_max_header_sz> out);
+
+namespace detail {
+
+// What `ws_unmask` does without vector instructions, eight bytes at a time, for comparing the two.
+void ws_unmask_scalar(std::span<uint8_t> payload, WsMask mask, size_t offset);
+
+} // namespace detail
+
+struct WsFrame {
+    WsOpcode opcode = WsOpcode::CONTINUATION;
+    bool fin = false;
+    size_t header_len = 0;
+    size_t payload_len = 0;
+};
+
+// Incremental parser for the frames a client sends. Hand it the receive buffer from the first
+// byte of a frame on, as more bytes arrive; it reads the header once and unmasks the payload in
+// place as it comes in, so each byte is touched once while it is still in cache. Its state is
+// kept as offsets from the start of the frame, so the bytes may be moved between calls. Call
+// `reset` before parsing the next frame.
+class WsFrameParser {
+  public:
+    WsFrameParser() = delete;
+    WsFrameParser(const WsFrameParser&) = delete;
+    WsFrameParser& operator=(const WsFrameParser&) = delete;
+    WsFrameParser(WsFrameParser&&) = delete;
+    WsFrameParser& operator=(WsFrameParser&&) = delete;
+
+    explicit WsFrameParser(size_t max_payload_sz);
+
+    ~WsFrameParser() = default;
+
+    // Returns the length of the frame, or 0 if `buf` does not hold all of it yet.
+    Status<size_t, WsError> parse(std::span<uint8_t> buf);
+
+    // The frame's header, once `parse` has seen all of it.
+    const WsFrame& frame() const;
+
+    void reset();
+
+  private:
+    size_t max_payload_sz_;
+    WsFrame frame_{};
+    bool have_header_ = false;
+    WsMask mask_{};
+    size_t unmasked_ = 0;
+
+    Status<bool, WsError> parse_header(std::span<const uint8_t> buf);
+};
+
+struct WsConfig {
+    size_t buf_sz = 16 * 1024;
+    // Largest message, across all of its frames, and so the largest frame.
+    size_t max_message_sz = 1024 * 1024;
+    // Unsent bytes at which `send` starts refusing messages.
+    size_t max_queued = 4 * 1024 * 1024;
+};
+
+// A whole text or binary message. The payload is only valid for the duration of the callback.
+using WsMessageCb = std::function<void(WsOpcode opcode, std::span<const uint8_t> payload)>;
+
+// The server's side of a WebSocket connection, for a session to build on: hand it the session's
+// `recv_buf`/`post_recv`, `send_buf`/`send_bufs`/`post_send` and `closing`, and it does the
+// upgrade handshake, answers pings and the closing handshake, and delivers messages to the
+// callback. A message that arrives in one frame is delivered straight from the receive buffer;
+// only fragmented ones are assembled in a buffer of their own. Output is a queue of frames whose
+// headers are kept inline and whose payloads are shared buffers sent by reference, so sending a
+// payload to any number of connections copies nothing but the few header bytes, and a gathering
+// write takes headers and payloads together. Text payloads are not checked for valid UTF-8.
+class WsConnection {
+  public:
+    WsConnection() = delete;
+    WsConnection(const WsConnection&) = delete;
+    WsConnection& operator=(const WsConnection&) = delete;
+    WsConnection(WsConnection&&) = delete;
+    WsConnection& operator=(WsConnection&&) = delete;
+
+    explicit WsConnection(WsConfig config, WsMessageCb cb);
+
+    ~WsConnection() = default;
+
+    std::span<uint8_t> recv_buf(size_t max_len);
+    // Returns the messages delivered. A protocol error starts the closing handshake, with a close
+    // frame saying why, and is returned once the messages before it are delivered.
+    Status<size_t, WsError> post_recv(std::span<uint8_t> buf);
+
+    std::span<const uint8_t> send_buf(size_t max_len) const;
+    size_t send_bufs(std::span<struct iovec> bufs, size_t max_len) const;
+    void post_send(int64_t len);
+
+    // Queues `payload` as a message of one frame. Refused if the handshake is not done, the
+    // connection is closing, or the queue is over `max_queued`.
+    bool send(WsOpcode opcode, SharedBuffer payload);
+    // Starts the closing handshake with status `code`.
+    void close(uint16_t code);
+
+    // Whether the handshake is done and no close frame has gone either way.
+    bool open() const;
+    // Whether the connection is done with and has nothing left to send, after a failed handshake
+    // or a closing handshake.
+    bool closing() const;
+    // Unsent bytes.
+    size_t queued() const;
+
+  private:
+    enum class State : uint8_t {
+        HANDSHAKE,
+        OPEN,
+        // A close frame has been sent; input is read until the peer's arrives.
+        CLOSE_SENT,
+        CLOSED,
+    };
+
+    struct OutFrame {
+        std::array<uint8_t, k_ws_max_header_sz> header;
+        uint8_t header_len;
+        SharedBuffer payload;
+    };
+
+    WsConfig config_;
+    WsMessageCb cb_;
+    State state_ = State::HANDSHAKE;
+    std::vector<uint8_t> buf_;
+    size_t head_ = 0;
+    size_t tail_ = 0;
+    // Bytes the frame at `head_` needs in all, once its header is known.
+    size_t want_ = 0;
+    HttpRequestParser request_parser_;
+    WsFrameParser frame_parser_;
+    // A fragmented message being assembled.
+    std::optional<WsOpcode> message_opcode_;
+    std::vector<uint8_t> message_;
+
+    std::deque<OutFrame> out_;
+    // Bytes of the front frame already sent.
+    size_t sent_ = 0;
+    size_t queued_ = 0;
+
+    Status<bool, WsError> handshake();
+    Status<bool, WsError> handle_frame(std::span<uint8_t> payload);
+    void fail(WsError error);
+    void push(WsOpcode opcode, SharedBuffer payload);
+    void push_raw(std::string_view bytes);
+    void make_room();
+};
+
+} // namespace axle
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "axle/event.h"
+
+namespace axle {
+
+using WorkerTask = std::function<void()>;
+
+// A fixed set of threads for CPU-bound work that would otherwise stall an event loop.
+//
+// Every worker owns a deque. Tasks submitted from outside the pool are dealt round-robin across
+// the deques, and tasks submitted by a running task go to its own worker. A worker takes its own
+// tasks newest first, while they are still warm in its cache, and when it runs dry steals the
+// oldest task from another worker, so a burst landing on one deque spreads over the whole pool.
+class WorkerPool {
+  public:
+    WorkerPool() = delete;
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    WorkerPool(WorkerPool&&) = delete;
+    WorkerPool& operator=(WorkerPool&&) = delete;
+
+    explicit WorkerPool(size_t threads);
+
+    // Runs the tasks still queued, then joins the workers.
+    ~WorkerPool();
+
+    void submit(WorkerTask task);
+
+    size_t size() const;
+
+  private:
+    struct Worker {
+        std::mutex mu;
+        std::deque<WorkerTask> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_worker_ = 0;
+    // Tasks queued but not yet taken by a worker.
+    std::atomic<size_t> queued_ = 0;
+
+    std::mutex sleep_mu_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+
+    bool take(size_t idx, WorkerTask& task);
+    void run_worker(size_t idx);
+};
+
+// Offloads one connection's work to a `WorkerPool` and hands the results back on the connection's
+// event loop, in the order the work was submitted, however the workers happen to finish it.
+//
+// Owned by a session and used only from its loop's thread. Destroying the queue cancels whatever
+// it has outstanding: work that has not started is skipped and no completion runs afterwards, so
+// completions may safely capture the session.
+class WorkQueue {
+  public:
+    WorkQueue() = delete;
+    WorkQueue(const WorkQueue&) = delete;
+    WorkQueue& operator=(const WorkQueue&) = delete;
+    WorkQueue(WorkQueue&&) = delete;
+    WorkQueue& operator=(WorkQueue&&) = delete;
+
+    WorkQueue(WorkerPool& pool, std::shared_ptr<EventLoop> loop);
+
+    ~WorkQueue();
+
+    // Runs `work` on a worker; the callback it returns then runs on the loop.
+    void submit(std::function<PostedCb()> work);
+
+    // Runs `work` on a worker and passes its result to `done` on the loop.
+    template <typename Work, typename Done>
+    void submit(Work work, Done done) {
+        submit(std::function<PostedCb()>{
+            [work = std::move(work), done = std::move(done)]() mutable -> PostedCb {
+                return [done, result = work()]() mutable { done(std::move(result)); };
+            }});
+    }
+
+    // Runs `cb` on the loop once everything submitted before it has completed, or right away if
+    // nothing is outstanding. Keeps replies that need no offloading behind those that do.
+    void then(PostedCb cb);
+
+    // Drops everything outstanding. Work submitted afterwards is ignored.
+    void cancel();
+
+    size_t pending() const;
+
+  private:
+    struct State {
+        std::atomic_bool cancelled = false;
+        // The rest is only touched on the loop's thread.
+        uint64_t next_seq = 0;
+        uint64_t deliver_seq = 0;
+        std::map<uint64_t, PostedCb> ready;
+    };
+
+    WorkerPool& pool_;
+    std::shared_ptr<EventLoop> loop_;
+    std::shared_ptr<State> state_;
+
+    static void complete(const std::shared_ptr<State>& state, uint64_t seq, PostedCb cb);
+};
+
+} // namespace axle
@@ -0,0 +1,88 @@
+#include "axle/broadcast.h"
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace axle {
+
+SharedBuffer make_shared_buffer(std::span<const uint8_t> data) {
+    return std::make_shared<const std::vector<uint8_t>>(data.begin(), data.end());
+}
+
+SendQueue::SendQueue(size_t max_bytes)
+    : max_bytes_{max_bytes} {}
+
+bool SendQueue::push(SharedBuffer buf) {
+    if (buf == nullptr || buf->empty()) {
+        return true;
+    }
+    if (!bufs_.empty() && size_ + buf->size() > max_bytes_) {
+        return false;
+    }
+
+    size_ += buf->size();
+    bufs_.push_back(std::move(buf));
+
+    return true;
+}
+
+size_t SendQueue::gather(std::span<struct iovec> bufs, size_t max_len) const {
+    size_t cnt = 0;
+    size_t offset = offset_;
+    for (const SharedBuffer& buf : bufs_) {
+        if (cnt == bufs.size() || max_len == 0) {
+            break;
+        }
+
+        const size_t len = std::min(buf->size() - offset, max_len);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+        bufs[cnt++] = {const_cast<uint8_t*>(buf->data() + offset), len};
+        max_len -= len;
+        offset = 0;
+    }
+
+    return cnt;
+}
+
+std::span<const uint8_t> SendQueue::front(size_t max_len) const {
+    if (bufs_.empty()) {
+        return {};
+    }
+
+    return std::span<const uint8_t>{*bufs_.front()}.subspan(
+        offset_, std::min(bufs_.front()->size() - offset_, max_len));
+}
+
+void SendQueue::consume(size_t len) {
+    size_ -= len;
+    while (len > 0) {
+        const size_t left = bufs_.front()->size() - offset_;
+        if (len < left) {
+            offset_ += len;
+
+            return;
+        }
+
+        len -= left;
+        offset_ = 0;
+        bufs_.pop_front();
+    }
+}
+
+size_t SendQueue::size() const {
+    return size_;
+}
+
+bool SendQueue::empty() const {
+    return bufs_.empty();
+}
+
+} // namespace axle
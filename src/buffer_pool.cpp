@@ -0,0 +1,115 @@
+#include "axle/buffer_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <utility>
+
+namespace axle {
+
+BufferPool::BufferPool(size_t buf_size, size_t max_cached)
+    : buf_size_{buf_size},
+      max_cached_{max_cached} {}
+
+std::unique_ptr<uint8_t[]> BufferPool::acquire() { // NOLINT(cppcoreguidelines-avoid-c-arrays)
+    ++in_use_;
+    if (free_.empty()) {
+        return std::make_unique<uint8_t[]>(buf_size_); // NOLINT(cppcoreguidelines-avoid-c-arrays)
+    }
+
+    std::unique_ptr<uint8_t[]> buf = std::move(free_.back()); // NOLINT
+    free_.pop_back();
+
+    return buf;
+}
+
+void BufferPool::release(std::unique_ptr<uint8_t[]> buf) { // NOLINT(*-avoid-c-arrays)
+    --in_use_;
+    if (free_.size() < max_cached_) {
+        free_.push_back(std::move(buf));
+    }
+}
+
+size_t BufferPool::buf_size() const {
+    return buf_size_;
+}
+
+size_t BufferPool::in_use() const {
+    return in_use_;
+}
+
+size_t BufferPool::cached() const {
+    return free_.size();
+}
+
+LazyBuffer::LazyBuffer(BufferPool& pool)
+    : pool_{&pool} {}
+
+LazyBuffer::~LazyBuffer() {
+    if (buf_ != nullptr) {
+        pool_->release(std::move(buf_));
+    }
+}
+
+std::span<uint8_t> LazyBuffer::writable(size_t max_len) {
+    if (buf_ == nullptr) {
+        buf_ = pool_->acquire();
+    }
+
+    const size_t len = std::min(pool_->buf_size() - tail_, max_len);
+
+    return std::span<uint8_t>{buf_.get(), pool_->buf_size()}.subspan(tail_, len);
+}
+
+void LazyBuffer::commit(size_t len) {
+    tail_ += static_cast<uint32_t>(len);
+    if (empty()) {
+        give_back();
+    }
+}
+
+std::span<const uint8_t> LazyBuffer::readable(size_t max_len) const {
+    if (buf_ == nullptr) {
+        return std::span<const uint8_t>{};
+    }
+
+    const size_t len = std::min<size_t>(tail_ - head_, max_len);
+
+    return std::span<const uint8_t>{buf_.get(), pool_->buf_size()}.subspan(head_, len);
+}
+
+void LazyBuffer::consume(size_t len) {
+    head_ += static_cast<uint32_t>(len);
+    if (empty()) {
+        give_back();
+    }
+}
+
+size_t LazyBuffer::size() const {
+    return tail_ - head_;
+}
+
+bool LazyBuffer::empty() const {
+    return head_ == tail_;
+}
+
+bool LazyBuffer::holding() const {
+    return buf_ != nullptr;
+}
+
+void LazyBuffer::set_pool(BufferPool& pool) {
+    pool_ = &pool;
+}
+
+void LazyBuffer::give_back() {
+    head_ = 0;
+    tail_ = 0;
+    if (buf_ != nullptr) {
+        pool_->release(std::move(buf_));
+    }
+}
+
+} // namespace axle
@@ -0,0 +1,185 @@
+#include "axle/capture.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+constexpr std::array<char, 8> k_magic{'A', 'X', 'L', 'E', 'C', 'A', 'P', '\0'};
+constexpr uint32_t k_version = 1;
+constexpr size_t k_file_header_sz = 16;
+
+struct RecordHeader {
+    uint64_t offset_ns;
+    uint32_t stream;
+    // Kind in the top byte, data length below.
+    uint32_t kind_len;
+};
+
+static_assert(sizeof(RecordHeader) == 16);
+
+constexpr unsigned k_kind_shift = 24;
+constexpr uint32_t k_max_record_len = (uint32_t{1} << k_kind_shift) - 1;
+
+} // namespace
+
+namespace axle {
+
+CaptureWriter::CaptureWriter(const std::string& path, size_t capacity)
+    : fd_{::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)},
+      capacity_{std::max(capacity, k_file_header_sz)},
+      start_{std::chrono::steady_clock::now()} {
+    if (fd_ == -1) {
+        throw std::runtime_error("failed to create capture file");
+    }
+
+    if (ftruncate(fd_, static_cast<off_t>(capacity_)) == -1) {
+        (void)::close(fd_);
+        throw std::runtime_error("failed to size capture file");
+    }
+
+    void* map = mmap(nullptr, capacity_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (map == MAP_FAILED) {
+        (void)::close(fd_);
+        throw std::runtime_error("failed to map capture file");
+    }
+    map_ = static_cast<uint8_t*>(map);
+
+    std::memcpy(map_, k_magic.data(), k_magic.size());
+    std::memcpy(map_ + k_magic.size(), &k_version, sizeof(k_version));
+    used_ = k_file_header_sz;
+}
+
+CaptureWriter::~CaptureWriter() {
+    (void)munmap(map_, capacity_);
+    (void)ftruncate(fd_, static_cast<off_t>(used_));
+    (void)::close(fd_);
+}
+
+uint32_t CaptureWriter::open() {
+    const uint32_t stream = next_stream_++;
+    append(CaptureKind::OPEN, stream, {});
+
+    return stream;
+}
+
+void CaptureWriter::data(uint32_t stream, std::span<const uint8_t> bytes) {
+    while (!bytes.empty()) {
+        const size_t len = std::min<size_t>(bytes.size(), k_max_record_len);
+        append(CaptureKind::DATA, stream, bytes.first(len));
+        bytes = bytes.subspan(len);
+    }
+}
+
+void CaptureWriter::close(uint32_t stream) {
+    append(CaptureKind::CLOSE, stream, {});
+}
+
+size_t CaptureWriter::size() const {
+    return used_;
+}
+
+uint64_t CaptureWriter::dropped() const {
+    return dropped_;
+}
+
+void CaptureWriter::append(CaptureKind kind, uint32_t stream, std::span<const uint8_t> bytes) {
+    if (capacity_ - used_ < sizeof(RecordHeader) + bytes.size()) {
+        ++dropped_;
+
+        return;
+    }
+
+    const RecordHeader header{
+        static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::steady_clock::now() - start_)
+                                  .count()),
+        stream,
+        (static_cast<uint32_t>(kind) << k_kind_shift) | static_cast<uint32_t>(bytes.size())};
+    std::memcpy(map_ + used_, &header, sizeof(header));
+    used_ += sizeof(header);
+    if (!bytes.empty()) {
+        std::memcpy(map_ + used_, bytes.data(), bytes.size());
+        used_ += bytes.size();
+    }
+}
+
+CaptureReader::CaptureReader(const std::string& path)
+    : fd_{::open(path.c_str(), O_RDONLY | O_CLOEXEC)},
+      pos_{k_file_header_sz} {
+    if (fd_ == -1) {
+        throw std::runtime_error("failed to open capture file");
+    }
+
+    struct stat st{};
+    if (fstat(fd_, &st) == -1 || static_cast<size_t>(st.st_size) < k_file_header_sz) {
+        (void)::close(fd_);
+        throw std::runtime_error("not a capture file");
+    }
+    size_ = static_cast<size_t>(st.st_size);
+
+    void* map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (map == MAP_FAILED) {
+        (void)::close(fd_);
+        throw std::runtime_error("failed to map capture file");
+    }
+    map_ = static_cast<const uint8_t*>(map);
+
+    uint32_t version = 0;
+    std::memcpy(&version, map_ + k_magic.size(), sizeof(version));
+    if (std::memcmp(map_, k_magic.data(), k_magic.size()) != 0 || version != k_version) {
+        (void)munmap(map, size_);
+        (void)::close(fd_);
+        throw std::runtime_error("not a capture file");
+    }
+}
+
+CaptureReader::~CaptureReader() {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast) -- munmap takes a mutable pointer
+    (void)munmap(const_cast<uint8_t*>(map_), size_);
+    (void)::close(fd_);
+}
+
+std::optional<CaptureRecord> CaptureReader::next() {
+    if (size_ - pos_ < sizeof(RecordHeader)) {
+        return std::nullopt;
+    }
+
+    RecordHeader header{};
+    std::memcpy(&header, map_ + pos_, sizeof(header));
+    const auto kind = static_cast<uint8_t>(header.kind_len >> k_kind_shift);
+    const size_t len = header.kind_len & k_max_record_len;
+    if (kind < static_cast<uint8_t>(CaptureKind::OPEN) ||
+        kind > static_cast<uint8_t>(CaptureKind::CLOSE) ||
+        size_ - pos_ - sizeof(header) < len) {
+        return std::nullopt;
+    }
+
+    const CaptureRecord record{static_cast<CaptureKind>(kind),
+                               header.stream,
+                               std::chrono::nanoseconds{header.offset_ns},
+                               std::span<const uint8_t>{map_ + pos_ + sizeof(header), len}};
+    pos_ += sizeof(header) + len;
+
+    return record;
+}
+
+void CaptureReader::rewind() {
+    pos_ = k_file_header_sz;
+}
+
+} // namespace axle
@@ -7,11 +7,70 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
-
-#include <array>
+#include <ctime>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include "axle/status.h"
+#include "axle/trace.h"
+
+namespace {
+
+// Stands in for the spin duration when deciding whether to stop backing off a loop that only
+// bounds spinning by iterations.
+constexpr std::chrono::nanoseconds k_default_spin_window = std::chrono::microseconds{50};
+
+constexpr struct timespec k_zero_timeout{};
+
+#if defined(AXLE_TRACING)
+constexpr bool k_tracing = true;
+#else
+constexpr bool k_tracing = false;
+#endif
+
+constexpr size_t k_generation_shift = 32;
+
+// Packs an fd and its generation into kernel event user data.
+void* to_udata(int fd, uint32_t generation) {
+    const uint64_t token = (static_cast<uint64_t>(generation) << k_generation_shift) |
+                           static_cast<uint32_t>(fd);
+
+    return reinterpret_cast<void*>(token); // NOLINT(performance-no-int-to-ptr)
+}
+
+uint32_t generation_of(void* udata) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return static_cast<uint32_t>(reinterpret_cast<uint64_t>(udata) >> k_generation_shift);
+}
+
+// Stands in for a std::function callback in an fd's entry.
+void call_function(void* ctx, uint64_t arg, uint64_t fd, axle::Status<int64_t, uint32_t> status) {
+    (void)arg;
+    (*static_cast<axle::FdEventIOCb*>(ctx))(fd, status);
+}
+
+uint64_t to_ns(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+// Pushes a deadline `timeout` after `now` out onto a grid of the largest power of two within
+// `slack`, so that deadlines close together expire at the same instant.
+uint64_t round_deadline(uint64_t now, uint64_t timeout, uint64_t slack) {
+    const uint64_t grid = std::bit_floor(slack);
+    const uint64_t deadline = (now + timeout + grid - 1) & ~(grid - 1);
+
+    return deadline - now;
+}
+
+} // namespace
 
 namespace axle {
 
@@ -20,60 +79,108 @@ EventLoop::EventLoop() : kq_(kqueue()) {
         throw std::runtime_error("failed to initialize kqueue");
     }
 
+    register_user_events();
+}
+
+EventLoop::EventLoop(std::shared_ptr<EventBackend> backend)
+    : kq_(-1),
+      backend_{std::move(backend)},
+      now_{backend_->now()} {
+    register_user_events();
+}
+
+EventLoop::~EventLoop() {
+    if (kq_ != -1 && close(kq_) == -1) {
+        perror("failed to close kqueue file descriptor");
+    }
+}
+
+void EventLoop::register_user_events() {
     // Register shutdown handler
     struct kevent ev{};
     EV_SET(&ev, k_shutdown_event_id, EVFILT_USER, EV_ADD, 0, 0, nullptr);
-    const int ret = kevent(kq_, &ev, 1, nullptr, 0, nullptr);
+    int ret = queue(&ev, 1, nullptr, 0, nullptr);
     if (ret == -1) {
         throw std::runtime_error("failed to register shutdown handler");
     }
-}
 
-EventLoop::~EventLoop() {
-    const int ret = close(kq_);
+    // Register wakeup for posted callbacks. EV_CLEAR re-arms it each time it is delivered.
+    EV_SET(&ev, k_post_event_id, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+    ret = queue(&ev, 1, nullptr, 0, nullptr);
     if (ret == -1) {
-        perror("failed to close kqueue file descriptor");
+        throw std::runtime_error("failed to register post handler");
     }
 }
 
-Status<None, int> EventLoop::register_fd_read(int fd, const FdEventIOCb& cb) {
-    struct kevent ev{};
+// One branch on the way to the kernel, like tracing, so that the kernel path pays no virtual call.
+int EventLoop::queue(const struct kevent* changes,
+                     int nchanges,
+                     struct kevent* events,
+                     int nevents,
+                     const struct timespec* timeout) const {
+    if (backend_ != nullptr) [[unlikely]] {
+        return backend_->kevent(changes, nchanges, events, nevents, timeout);
+    }
 
-    EV_SET(&ev, fd, EVFILT_READ, EV_ADD, 0, 0, nullptr);
+    return ::kevent(kq_, changes, nchanges, events, nevents, timeout);
+}
 
-    const int ret = kevent(kq_, &ev, 1, nullptr, 0, nullptr);
-    if (ret == -1) {
-        perror("failed to register read filter for fd");
+uint64_t EventLoop::clock_ns() const {
+    return to_ns(backend_ != nullptr ? backend_->now() : std::chrono::steady_clock::now());
+}
 
-        return Status<None, int>::make_err(errno);
-    };
-    fd_read_[fd] = cb;
+Status<None, int> EventLoop::register_fd_read(int fd, const FdEventIOCb& cb) {
+    Status<None, int> res = watch_fd(fd, EVFILT_READ);
+    if (res.is_ok()) {
+        set_function(fd_entry(fd), &FdEntry::read, &FdFunctions::read, cb);
+    }
 
-    return Status<None, int>::make_ok();
+    return res;
 }
 
 Status<None, int> EventLoop::register_fd_write(int fd, const FdEventIOCb& cb) {
-    struct kevent ev{};
-
-    EV_SET(&ev, fd, EVFILT_WRITE, EV_ADD, 0, 0, nullptr);
+    Status<None, int> res = watch_fd(fd, EVFILT_WRITE);
+    if (res.is_ok()) {
+        set_function(fd_entry(fd), &FdEntry::write, &FdFunctions::write, cb);
+    }
 
-    const int ret = kevent(kq_, &ev, 1, nullptr, 0, nullptr);
-    if (ret == -1) {
-        perror("failed to register write filter for fd");
+    return res;
+}
 
-        return Status<None, int>::make_err(errno);
-    };
-    fd_write_[fd] = cb;
+Status<None, int> EventLoop::register_fd_eof(int fd, const FdEventEOFCb& cb) {
+    FdEntry* entry = fd < 0 ? nullptr : find_fd(fd, nullptr);
+    if (entry == nullptr || (!entry->read && !entry->write)) {
+        return Status<None, int>::make_err(0);
+    }
+    set_function(*entry, &FdEntry::eof, &FdFunctions::eof, cb);
 
     return Status<None, int>::make_ok();
 }
 
-Status<None, int> EventLoop::register_fd_eof(int fd, const FdEventEOFCb& cb) {
-    if (!fd_read_.contains(fd) && !fd_write_.contains(fd)) {
-        return Status<None, int>::make_err(0);
+Status<None, int> EventLoop::register_fd_read(int fd, FdCallback cb) {
+    Status<None, int> res = watch_fd(fd, EVFILT_READ);
+    if (res.is_ok()) {
+        set_callback(fd_entry(fd), &FdEntry::read, &FdFunctions::read, cb);
+    }
+
+    return res;
+}
+
+Status<None, int> EventLoop::register_fd_write(int fd, FdCallback cb) {
+    Status<None, int> res = watch_fd(fd, EVFILT_WRITE);
+    if (res.is_ok()) {
+        set_callback(fd_entry(fd), &FdEntry::write, &FdFunctions::write, cb);
     }
 
-    fd_eof_[fd] = cb;
+    return res;
+}
+
+Status<None, int> EventLoop::register_fd_eof(int fd, FdCallback cb) {
+    FdEntry* entry = fd < 0 ? nullptr : find_fd(fd, nullptr);
+    if (entry == nullptr || (!entry->read && !entry->write)) {
+        return Status<None, int>::make_err(0);
+    }
+    set_callback(*entry, &FdEntry::eof, &FdFunctions::eof, cb);
 
     return Status<None, int>::make_ok();
 }
@@ -81,33 +188,169 @@ Status<None, int> EventLoop::register_fd_eof(int fd, const FdEventEOFCb& cb) {
 Status<None, int> EventLoop::register_timer(uint64_t id,
                                             uint64_t timeout,
                                             bool periodic,
-                                            const TimerEventCb& cb) {
+                                            const TimerEventCb& cb,
+                                            uint64_t slack) {
+    // The timer may move between a kernel timer of its own and a group.
+    const bool grouped = periodic && slack > 0;
+    (void)leave_group(id);
+    if (grouped && timers_.contains(id)) {
+        (void)remove_timer(id);
+    }
+
+    if (grouped) {
+        const Status<None, int> res = join_group(id, timeout, slack, cb);
+        if (res.is_err()) {
+            return res;
+        }
+    } else {
+        if (slack > 0) {
+            timeout = round_deadline(clock_ns(), timeout, slack);
+        }
+        const Status<None, int> res = arm_timer(id, timeout, periodic);
+        if (res.is_err()) {
+            return res;
+        }
+        timers_[id] = cb;
+    }
+
+    if (TraceBuffer* trace = tracer(); trace != nullptr) [[unlikely]] {
+        trace->instant(TraceKind::REGISTER_TIMER, id);
+    }
+
+    return Status<None, int>::make_ok();
+}
+
+Status<None, int> EventLoop::arm_timer(uint64_t id, uint64_t timeout, bool periodic) {
     struct kevent ev{};
     const uint16_t oneshot = periodic ? 0 : EV_ONESHOT;
 
     EV_SET(&ev, id, EVFILT_TIMER, EV_ADD | oneshot, NOTE_NSECONDS, timeout, nullptr);
 
-    const int ret = kevent(kq_, &ev, 1, nullptr, 0, nullptr);
+    const int ret = queue(&ev, 1, nullptr, 0, nullptr);
     if (ret == -1) {
         perror("failed to register timer");
 
         return Status<None, int>::make_err(errno);
     };
-    timers_[id] = cb;
 
     return Status<None, int>::make_ok();
 }
 
+Status<None, int> EventLoop::disarm_timer(uint64_t id) {
+    struct kevent ev{};
+
+    EV_SET(&ev, id, EVFILT_TIMER, EV_DELETE, 0, 0, nullptr);
+
+    const int ret = queue(&ev, 1, nullptr, 0, nullptr);
+    if (ret == -1) {
+        perror("failed to remove timer filter");
+
+        return Status<None, int>::make_err(errno);
+    };
+
+    return Status<None, int>::make_ok();
+}
+
+Status<None, int> EventLoop::join_group(uint64_t id,
+                                        uint64_t period,
+                                        uint64_t slack,
+                                        const TimerEventCb& cb) {
+    const uint64_t due = clock_ns() + period;
+    for (auto& [group_id, group] : timer_groups_) {
+        if (group.period != period) {
+            continue;
+        }
+
+        // The group's first tick at or after the timer's own first deadline.
+        const uint64_t first_tick = (due - group.start_ns + period - 1) / period;
+        if (group.start_ns + (first_tick * period) - due > slack) {
+            continue;
+        }
+
+        group.members.push_back(GroupedTimer{id, first_tick, cb});
+        ++group.live;
+        grouped_timers_[id] = group_id;
+
+        return Status<None, int>::make_ok();
+    }
+
+    const uint64_t group_id = make_timer_id();
+    const Status<None, int> res = arm_timer(group_id, period, true);
+    if (res.is_err()) {
+        return res;
+    }
+
+    TimerGroup& group = timer_groups_[group_id];
+    group.period = period;
+    group.start_ns = due - period;
+    group.members.push_back(GroupedTimer{id, 1, cb});
+    group.live = 1;
+    grouped_timers_[id] = group_id;
+
+    return Status<None, int>::make_ok();
+}
+
+bool EventLoop::leave_group(uint64_t id) {
+    const auto it = grouped_timers_.find(id);
+    if (it == grouped_timers_.end()) {
+        return false;
+    }
+
+    const uint64_t group_id = it->second;
+    grouped_timers_.erase(it);
+    TimerGroup& group = timer_groups_.at(group_id);
+    for (GroupedTimer& timer : group.members) {
+        if (timer.id == id && !timer.removed) {
+            timer.removed = true;
+            --group.live;
+            break;
+        }
+    }
+
+    // A group that is firing is cleaned up once it is done.
+    if (group.live == 0 && !group.firing) {
+        (void)disarm_timer(group_id);
+        timer_groups_.erase(group_id);
+    }
+
+    return true;
+}
+
+void EventLoop::fire_group(uint64_t group_id, TimerGroup& group, int64_t expirations) {
+    group.ticks += std::max<int64_t>(expirations, 1);
+    group.firing = true;
+    // Members added from here on are past `cnt`; their first tick is still ahead.
+    const size_t cnt = group.members.size();
+    for (size_t i = 0; i < cnt; ++i) {
+        GroupedTimer& timer = group.members[i];
+        if (!timer.removed && group.ticks >= timer.first_tick) {
+            timer.cb(timer.id, Status<None, int64_t>::make_ok());
+        }
+    }
+    group.firing = false;
+
+    std::erase_if(group.members, [](const GroupedTimer& timer) { return timer.removed; });
+    if (group.live == 0) {
+        (void)disarm_timer(group_id);
+        timer_groups_.erase(group_id);
+    }
+}
+
 Status<None, int> EventLoop::remove_fd_read(int fd) {
-    if (fd_read_.erase(fd) != 1) {
+    FdEntry* entry = fd < 0 ? nullptr : find_fd(fd, nullptr);
+    if (entry == nullptr || !entry->read) {
         return Status<None, int>::make_err(0);
     }
+    set_callback(*entry, &FdEntry::read, &FdFunctions::read, FdCallback{});
 
+    if (TraceBuffer* trace = tracer(); trace != nullptr) [[unlikely]] {
+        trace->instant(TraceKind::REMOVE_READ, fd);
+    }
     struct kevent ev{};
 
     EV_SET(&ev, fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
 
-    const int ret = kevent(kq_, &ev, 1, nullptr, 0, nullptr);
+    const int ret = queue(&ev, 1, nullptr, 0, nullptr);
     if (ret == -1) {
         perror("failed to remove read filter for fd");
 
@@ -118,15 +361,20 @@ Status<None, int> EventLoop::remove_fd_read(int fd) {
 }
 
 Status<None, int> EventLoop::remove_fd_write(int fd) {
-    if (fd_write_.erase(fd) != 1) {
+    FdEntry* entry = fd < 0 ? nullptr : find_fd(fd, nullptr);
+    if (entry == nullptr || !entry->write) {
         return Status<None, int>::make_err(0);
     }
+    set_callback(*entry, &FdEntry::write, &FdFunctions::write, FdCallback{});
 
+    if (TraceBuffer* trace = tracer(); trace != nullptr) [[unlikely]] {
+        trace->instant(TraceKind::REMOVE_WRITE, fd);
+    }
     struct kevent ev{};
 
     EV_SET(&ev, fd, EVFILT_WRITE, EV_DELETE, 0, 0, nullptr);
 
-    const int ret = kevent(kq_, &ev, 1, nullptr, 0, nullptr);
+    const int ret = queue(&ev, 1, nullptr, 0, nullptr);
     if (ret == -1) {
         perror("failed to remove write filter for fd");
 
@@ -137,78 +385,255 @@ Status<None, int> EventLoop::remove_fd_write(int fd) {
 }
 
 Status<None, int> EventLoop::remove_fd_eof(int fd) {
-    if (fd_eof_.erase(fd) != 1) {
+    FdEntry* entry = fd < 0 ? nullptr : find_fd(fd, nullptr);
+    if (entry == nullptr || !entry->eof) {
         return Status<None, int>::make_err(0);
     }
+    set_callback(*entry, &FdEntry::eof, &FdFunctions::eof, FdCallback{});
 
     return Status<None, int>::make_ok();
 }
 
 Status<None, int> EventLoop::remove_timer(uint64_t id) {
-    if (timers_.erase(id) != 1) {
+    const bool grouped = leave_group(id);
+    if (!grouped && timers_.erase(id) != 1) {
         return Status<None, int>::make_err(0);
     }
 
-    struct kevent ev{};
+    if (TraceBuffer* trace = tracer(); trace != nullptr) [[unlikely]] {
+        trace->instant(TraceKind::REMOVE_TIMER, id);
+    }
 
-    EV_SET(&ev, id, EVFILT_TIMER, EV_DELETE, 0, 0, nullptr);
+    return grouped ? Status<None, int>::make_ok() : disarm_timer(id);
+}
 
-    const int ret = kevent(kq_, &ev, 1, nullptr, 0, nullptr);
-    if (ret == -1) {
-        perror("failed to remove timer filter");
+void EventLoop::set_busy_poll(const BusyPollConfig& config) {
+    busy_poll_ = config;
+    backoff_shift_ = 0;
+}
 
-        return Status<None, int>::make_err(errno);
-    };
+const BusyPollConfig& EventLoop::busy_poll() const {
+    return busy_poll_;
+}
+
+const EventLoopStats& EventLoop::stats() const {
+    return stats_;
+}
+
+Status<None, int> EventLoop::set_tracing(size_t capacity) {
+    if (!k_tracing) {
+        return Status<None, int>::make_err(ENOTSUP);
+    }
+
+    trace_ = capacity > 0 ? std::make_unique<TraceBuffer>(capacity) : nullptr;
 
     return Status<None, int>::make_ok();
 }
 
+const TraceBuffer* EventLoop::trace() const {
+    return trace_.get();
+}
+
+std::chrono::steady_clock::time_point EventLoop::now() const {
+    return now_;
+}
+
+uint64_t EventLoop::make_timer_id() {
+    return next_timer_id_++;
+}
+
+// Folds to a constant null pointer, and the tracing branches away, when built without tracing.
+TraceBuffer* EventLoop::tracer() const {
+    return k_tracing ? trace_.get() : nullptr;
+}
+
 void EventLoop::run() {
 
-    std::array<struct kevent, k_max_event_cnt> evs{};
+    std::vector<struct kevent> evs(k_initial_event_cnt);
+    size_t batch = evs.size();
 
     while (!done_) {
-        const int ret = kevent(kq_, nullptr, 0, evs.data(), evs.size(), nullptr);
+        run_hooks(idle_hooks_);
+        run_hooks(prepare_hooks_);
+
+        const uint64_t poll_start = tracer() != nullptr ? TraceBuffer::now_ns() : 0;
+        const int ret = poll(evs.data(), static_cast<int>(batch));
         if (ret == -1) {
             perror("failed to wait for events");
             continue;
         }
 
-        for (int i = 0; i < ret; ++i) {
-            const struct kevent& ev = evs.at(i);
-            switch (ev.filter) {
-            case EVFILT_USER: {
-                handle_shutdown(ev.ident);
-                break;
+        const std::chrono::steady_clock::time_point work_start = std::chrono::steady_clock::now();
+        now_ = backend_ != nullptr ? backend_->now() : work_start;
+        stats_.events += ret;
+        if (TraceBuffer* trace = tracer(); trace != nullptr) [[unlikely]] {
+            trace->record(TraceKind::POLL, ret, poll_start, TraceBuffer::now_ns());
+            for (int i = 0; i < ret; ++i) {
+                dispatch_traced(evs.at(i));
             }
-
-            case EVFILT_TIMER: {
-                handle_timer(ev.ident, ev.flags, ev.data);
-                break;
+        } else {
+            for (int i = 0; i < ret; ++i) {
+                dispatch(evs.at(i));
             }
+        }
 
-            case EVFILT_READ: {
-                handle_fd_read(ev.ident, ev.flags, ev.fflags, ev.data);
-                break;
+        if (tracer() != nullptr && !deferred_.empty()) [[unlikely]] {
+            const uint64_t start = TraceBuffer::now_ns();
+            const size_t cnt = deferred_.size();
+            run_deferred();
+            if (trace_ != nullptr) {
+                trace_->record(TraceKind::DEFERRED, cnt, start, TraceBuffer::now_ns());
             }
+        } else {
+            run_deferred();
+        }
+        run_hooks(check_hooks_);
+        removed_.clear();
+        stats_.work_time += std::chrono::steady_clock::now() - work_start;
 
-            case EVFILT_WRITE: {
-                handle_fd_write(ev.ident, ev.flags, ev.fflags, ev.data);
-                break;
-            }
+        resize_events(evs, batch, ret);
+    }
+}
 
-            default:
-                perror("unknown event type");
-            }
+void EventLoop::dispatch(const struct kevent& ev) {
+    switch (ev.filter) {
+    case EVFILT_USER: {
+        handle_user(ev.ident);
+        break;
+    }
+
+    case EVFILT_TIMER: {
+        handle_timer(ev.ident, ev.flags, ev.data);
+        break;
+    }
+
+    case EVFILT_READ: {
+        handle_fd_read(ev.ident, ev.udata, ev.flags, ev.fflags, ev.data);
+        break;
+    }
+
+    case EVFILT_WRITE: {
+        handle_fd_write(ev.ident, ev.udata, ev.flags, ev.fflags, ev.data);
+        break;
+    }
+
+    default:
+        perror("unknown event type");
+    }
+}
+
+void EventLoop::dispatch_traced(const struct kevent& ev) {
+    TraceKind kind = TraceKind::USER;
+    switch (ev.filter) {
+    case EVFILT_TIMER:
+        kind = TraceKind::TIMER;
+        break;
+    case EVFILT_READ:
+        kind = TraceKind::READ;
+        break;
+    case EVFILT_WRITE:
+        kind = TraceKind::WRITE;
+        break;
+    default:
+        break;
+    }
+
+    const uint64_t start = TraceBuffer::now_ns();
+    dispatch(ev);
+    // The callback may have turned tracing off.
+    if (trace_ != nullptr) {
+        trace_->record(kind, ev.ident, start, TraceBuffer::now_ns());
+    }
+}
+
+void EventLoop::resize_events(std::vector<struct kevent>& evs, size_t& batch, const int ret) {
+    const auto used = static_cast<size_t>(ret);
+    if (used == batch && batch < k_max_event_cnt) {
+        batch *= 2;
+        if (evs.size() < batch) {
+            evs.resize(batch);
+        }
+        quiet_polls_ = 0;
+    } else if (used < batch / 4 && batch > k_min_event_cnt) {
+        if (++quiet_polls_ == k_shrink_after_polls) {
+            batch /= 2;
+            quiet_polls_ = 0;
+        }
+    } else {
+        quiet_polls_ = 0;
+    }
+    stats_.event_batch = batch;
+}
+
+int EventLoop::poll(struct kevent* evs, const int cnt) {
+    // Deferred work or an idle hook is waiting, so only pick up what is ready already.
+    if (!deferred_.empty() || idle_cnt_ > 0) {
+        return queue(nullptr, 0, evs, cnt, &k_zero_timeout);
+    }
+
+    const bool spinning = busy_poll_.spin_duration.count() > 0 || busy_poll_.spin_iterations > 0;
+    if (spinning && backoff_shift_ < k_max_backoff_shift) {
+        const int ret = spin(evs, cnt);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const int ret = queue(nullptr, 0, evs, cnt, nullptr);
+    const std::chrono::nanoseconds waited = std::chrono::steady_clock::now() - start;
+    stats_.wait_time += waited;
+    ++stats_.blocking_waits;
+
+    // Events came in sooner than a full spin would have lasted, so spinning pays off again.
+    const std::chrono::nanoseconds window = busy_poll_.spin_duration.count() > 0
+                                                ? std::chrono::nanoseconds{busy_poll_.spin_duration}
+                                                : k_default_spin_window;
+    if (spinning && backoff_shift_ > 0 && waited < window) {
+        --backoff_shift_;
+    }
+
+    return ret;
+}
+
+// Polls with a zero timeout until events arrive or the (backed-off) spin budget runs out.
+int EventLoop::spin(struct kevent* evs, const int cnt) {
+    const std::chrono::nanoseconds budget = busy_poll_.spin_duration / (1U << backoff_shift_);
+    const size_t max_iterations = busy_poll_.spin_iterations >> backoff_shift_;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    int ret = 0;
+    for (size_t iteration = 0;; ++iteration) {
+        ret = queue(nullptr, 0, evs, cnt, &k_zero_timeout);
+        ++stats_.spin_polls;
+        if (ret != 0) {
+            break;
+        }
+
+        const std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+        if ((budget.count() > 0 && elapsed >= budget) ||
+            (max_iterations > 0 && iteration + 1 >= max_iterations) ||
+            (budget.count() == 0 && max_iterations == 0)) {
+            break;
         }
     }
+    stats_.spin_time += std::chrono::steady_clock::now() - start;
+
+    if (ret > 0) {
+        ++stats_.spin_hits;
+        backoff_shift_ = 0;
+    } else if (ret == 0 && busy_poll_.adaptive) {
+        ++backoff_shift_;
+    }
+
+    return ret;
 }
 
 Status<None, int> EventLoop::shutdown() const {
     struct kevent ev{};
     EV_SET(&ev, k_shutdown_event_id, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
 
-    const int ret = kevent(kq_, &ev, 1, nullptr, 0, nullptr);
+    const int ret = queue(&ev, 1, nullptr, 0, nullptr);
     if (ret == -1) {
         perror("failed to schedule shutdown event");
 
@@ -218,13 +643,135 @@ Status<None, int> EventLoop::shutdown() const {
     return Status<None, int>::make_ok();
 }
 
-void EventLoop::handle_shutdown(const uint64_t id) {
+Status<None, int> EventLoop::post(PostedCb cb) {
+    bool wake = false;
+    {
+        const std::lock_guard<std::mutex> lock{posted_mu_};
+        // Only the first callback of a batch needs to wake the loop; it drains the whole batch.
+        wake = posted_.empty();
+        posted_.push_back(std::move(cb));
+    }
+
+    if (!wake) {
+        return Status<None, int>::make_ok();
+    }
+
+    struct kevent ev{};
+    EV_SET(&ev, k_post_event_id, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+
+    const int ret = queue(&ev, 1, nullptr, 0, nullptr);
+    if (ret == -1) {
+        perror("failed to schedule post event");
+
+        return Status<None, int>::make_err(errno);
+    }
+
+    return Status<None, int>::make_ok();
+}
+
+void EventLoop::defer(PostedCb cb) {
+    deferred_.push_back(std::move(cb));
+}
+
+void EventLoop::handle_user(const uint64_t id) {
     if (id == k_shutdown_event_id) {
         done_ = true;
+    } else if (id == k_post_event_id) {
+        run_posted();
+    }
+}
+
+void EventLoop::run_posted() {
+    {
+        const std::lock_guard<std::mutex> lock{posted_mu_};
+        running_posted_.swap(posted_);
+    }
+
+    // Callbacks posted from here on wake the loop again and run in a later batch.
+    for (PostedCb& cb : running_posted_) {
+        cb();
+    }
+    running_posted_.clear();
+}
+
+void EventLoop::run_deferred() {
+    // Callbacks deferred from here on run in the next round, after the next batch of events.
+    running_deferred_.swap(deferred_);
+    stats_.deferred += running_deferred_.size();
+    for (PostedCb& cb : running_deferred_) {
+        cb();
+    }
+    running_deferred_.clear();
+}
+
+uint64_t EventLoop::add_prepare_hook(PostedCb cb) {
+    return add_hook(prepare_hooks_, std::move(cb));
+}
+
+uint64_t EventLoop::add_check_hook(PostedCb cb) {
+    return add_hook(check_hooks_, std::move(cb));
+}
+
+uint64_t EventLoop::add_idle_hook(PostedCb cb) {
+    ++idle_cnt_;
+
+    return add_hook(idle_hooks_, std::move(cb));
+}
+
+Status<None, int> EventLoop::remove_hook(const uint64_t id) {
+    for (std::deque<Hook>* hooks : {&prepare_hooks_, &check_hooks_, &idle_hooks_}) {
+        for (Hook& hook : *hooks) {
+            if (hook.id != id || hook.removed) {
+                continue;
+            }
+
+            hook.removed = true;
+            if (hooks == &idle_hooks_) {
+                --idle_cnt_;
+            }
+
+            return Status<None, int>::make_ok();
+        }
+    }
+
+    return Status<None, int>::make_err(0);
+}
+
+uint64_t EventLoop::add_hook(std::deque<Hook>& hooks, PostedCb cb) {
+    const uint64_t id = next_hook_id_++;
+    hooks.push_back(Hook{id, std::move(cb)});
+
+    return id;
+}
+
+void EventLoop::run_hooks(std::deque<Hook>& hooks) {
+    if (hooks.empty()) {
+        return;
+    }
+
+    const uint64_t start = tracer() != nullptr ? TraceBuffer::now_ns() : 0;
+    // Hooks added from here on are past `cnt` and wait for the next iteration.
+    const size_t cnt = hooks.size();
+    for (size_t i = 0; i < cnt; ++i) {
+        if (!hooks[i].removed) {
+            hooks[i].cb();
+        }
+    }
+    std::erase_if(hooks, [](const Hook& hook) { return hook.removed; });
+
+    if (start != 0 && trace_ != nullptr) [[unlikely]] {
+        trace_->record(TraceKind::HOOKS, cnt, start, TraceBuffer::now_ns());
     }
 }
 
 void EventLoop::handle_timer(const uint64_t id, const uint16_t flags, const int64_t data) {
+    ++stats_.timer_events;
+    if (const auto group = timer_groups_.find(id); group != timer_groups_.end()) {
+        fire_group(id, group->second, data);
+
+        return;
+    }
+
     if (!timers_.contains(id)) {
         return;
     }
@@ -238,42 +785,127 @@ void EventLoop::handle_timer(const uint64_t id, const uint16_t flags, const int6
     }
 }
 
+EventLoop::FdEntry* EventLoop::find_fd(const uint64_t fd, void* udata) {
+    if (fd >= fds_.size()) {
+        return nullptr;
+    }
+
+    FdEntry& entry = fds_[fd];
+    if (udata != nullptr && generation_of(udata) != entry.generation) {
+        ++stats_.stale_events;
+
+        return nullptr;
+    }
+
+    return &entry;
+}
+
+EventLoop::FdEntry& EventLoop::fd_entry(const int fd) {
+    const auto idx = static_cast<size_t>(fd);
+    if (idx >= fds_.size()) {
+        fds_.resize(idx + 1);
+    }
+
+    return fds_[idx];
+}
+
+Status<None, int> EventLoop::watch_fd(const int fd, const int16_t filter) {
+    if (fd < 0) {
+        return Status<None, int>::make_err(EBADF);
+    }
+
+    FdEntry& entry = fd_entry(fd);
+    const bool fresh = !entry.read && !entry.write;
+    const uint32_t generation = fresh ? entry.generation + 1 : entry.generation;
+    struct kevent ev{};
+
+    EV_SET(&ev, fd, filter, EV_ADD, 0, 0, to_udata(fd, generation));
+
+    const int ret = queue(&ev, 1, nullptr, 0, nullptr);
+    if (ret == -1) {
+        perror(filter == EVFILT_READ ? "failed to register read filter for fd"
+                                     : "failed to register write filter for fd");
+
+        return Status<None, int>::make_err(errno);
+    };
+    entry.generation = generation;
+
+    if (TraceBuffer* trace = tracer(); trace != nullptr) [[unlikely]] {
+        trace->instant(filter == EVFILT_READ ? TraceKind::REGISTER_READ : TraceKind::REGISTER_WRITE,
+                       fd);
+    }
+    return Status<None, int>::make_ok();
+}
+
+void EventLoop::set_callback(FdEntry& entry,
+                             FdCallback FdEntry::*slot,
+                             FdEventIOCb FdFunctions::*function,
+                             const FdCallback cb) {
+    // The callback being replaced may be the caller: a std::function behind it lives on until the
+    // end of the batch.
+    if (entry.functions != nullptr && (*entry.functions).*function) {
+        removed_.push_back(std::move((*entry.functions).*function));
+        (*entry.functions).*function = nullptr;
+    }
+    entry.*slot = cb;
+}
+
+void EventLoop::set_function(FdEntry& entry,
+                             FdCallback FdEntry::*slot,
+                             FdEventIOCb FdFunctions::*function,
+                             const FdEventIOCb& cb) {
+    if (entry.functions == nullptr) {
+        entry.functions = std::make_unique<FdFunctions>();
+    }
+    FdEventIOCb& stored = (*entry.functions).*function;
+    set_callback(entry, slot, function, {&call_function, &stored, 0});
+    stored = cb;
+}
+
 void EventLoop::handle_fd_read(const uint64_t fd,
+                               void* udata,
                                const uint16_t flags,
                                const uint32_t fflags,
                                const int64_t data) {
-    if (fd_read_.contains(fd)) {
-        const FdEventIOCb& cb = fd_read_[fd];
+    FdEntry* entry = find_fd(fd, udata);
+    if (entry == nullptr) {
+        return;
+    }
+
+    const uint32_t generation = entry->generation;
+    if (entry->read) {
         if ((flags & EV_ERROR) != 0) {
-            cb(fd, Status<int64_t, uint32_t>::make_err(fflags));
+            entry->read(fd, Status<int64_t, uint32_t>::make_err(fflags));
         } else {
-            cb(fd, Status<int64_t, uint32_t>::make_ok(data));
+            entry->read(fd, Status<int64_t, uint32_t>::make_ok(data));
         }
     }
 
-    if ((flags & EV_EOF) != 0 && fd_eof_.contains(fd)) {
-        const FdEventEOFCb& cb = fd_eof_[fd];
-        cb(fd, Status<int64_t, uint32_t>::make_ok(data));
+    // The read callback may have closed the fd and handed it to a new connection.
+    if ((flags & EV_EOF) != 0 && entry->eof && entry->generation == generation) {
+        entry->eof(fd, Status<int64_t, uint32_t>::make_ok(data));
     }
 }
 
 void EventLoop::handle_fd_write(const uint64_t fd,
+                                void* udata,
                                 const uint16_t flags,
                                 const uint32_t fflags,
                                 const int64_t data) {
-    if (!fd_write_.contains(fd)) {
+    FdEntry* entry = find_fd(fd, udata);
+    if (entry == nullptr || !entry->write) {
         return;
     }
-    const FdEventIOCb& cb = fd_write_[fd];
+
+    const uint32_t generation = entry->generation;
     if ((flags & EV_ERROR) != 0) {
-        cb(fd, Status<int64_t, uint32_t>::make_err(fflags));
+        entry->write(fd, Status<int64_t, uint32_t>::make_err(fflags));
     } else {
-        cb(fd, Status<int64_t, uint32_t>::make_ok(data));
+        entry->write(fd, Status<int64_t, uint32_t>::make_ok(data));
     }
 
-    if ((flags & EV_EOF) != 0 && fd_eof_.contains(fd)) {
-        const FdEventEOFCb& cb = fd_eof_[fd];
-        cb(fd, Status<int64_t, uint32_t>::make_ok(data));
+    if ((flags & EV_EOF) != 0 && entry->eof && entry->generation == generation) {
+        entry->eof(fd, Status<int64_t, uint32_t>::make_ok(data));
     }
 }
 
@@ -0,0 +1,176 @@
+#include "axle/file.h"
+
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <fcntl.h>
+#endif
+#include <sys/types.h> // IWYU pragma: keep -- for ssize_t, off_t
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "axle/event.h"
+#include "axle/status.h"
+#include "axle/worker_pool.h"
+
+namespace {
+
+// `fsync` on Apple platforms only hands the data to the drive, which may keep it in its cache;
+// `F_FULLFSYNC` asks the drive to write it out too. File systems that do not support it get the
+// plain `fsync`.
+int sync_to_device(int fd) {
+#if defined(__APPLE__)
+    if (::fcntl(fd, F_FULLFSYNC) == 0) {
+        return 0;
+    }
+#endif
+    return ::fsync(fd);
+}
+
+} // namespace
+
+namespace axle {
+
+AsyncFile::State::~State() {
+    if (::close(fd) == -1) {
+        perror("failed to close file");
+    }
+}
+
+AsyncFile::AsyncFile(WorkerPool& pool, std::shared_ptr<EventLoop> loop, int fd)
+    : pool_{pool},
+      loop_{std::move(loop)},
+      state_{std::make_shared<State>(fd)} {}
+
+AsyncFile::~AsyncFile() {
+    state_->cancelled.store(true, std::memory_order_relaxed);
+}
+
+void AsyncFile::read_at(uint64_t offset, size_t len, FileReadCb cb) {
+    submit([this, offset, len, cb = std::move(cb)](int fd) mutable -> PostedCb {
+        std::vector<uint8_t> buf(len);
+        size_t done = 0;
+        while (done < len) {
+            const ssize_t ret = pread(fd,
+                                      buf.data() + done,
+                                      len - done,
+                                      static_cast<off_t>(offset + done));
+            if (ret == -1 && errno == EINTR) {
+                continue;
+            }
+            if (ret == -1) {
+                return [this, cb = std::move(cb), err = errno] {
+                    --pending_;
+                    cb(Status<std::vector<uint8_t>, int>::make_err(err));
+                };
+            }
+            if (ret == 0) {
+                break;
+            }
+            done += static_cast<size_t>(ret);
+        }
+        buf.resize(done);
+
+        return [this, cb = std::move(cb), buf = std::move(buf)]() mutable {
+            --pending_;
+            cb(Status<std::vector<uint8_t>, int>::make_ok(std::move(buf)));
+        };
+    });
+}
+
+void AsyncFile::write_at(uint64_t offset, std::vector<uint8_t> data, FileWriteCb cb) {
+    submit([this, offset, data = std::move(data), cb = std::move(cb)](int fd) mutable -> PostedCb {
+        size_t done = 0;
+        while (done < data.size()) {
+            const ssize_t ret = pwrite(fd,
+                                       data.data() + done,
+                                       data.size() - done,
+                                       static_cast<off_t>(offset + done));
+            if (ret == -1 && errno == EINTR) {
+                continue;
+            }
+            if (ret == -1) {
+                return [this, cb = std::move(cb), err = errno] {
+                    --pending_;
+                    cb(Status<size_t, int>::make_err(err));
+                };
+            }
+            done += static_cast<size_t>(ret);
+        }
+
+        return [this, cb = std::move(cb), done] {
+            --pending_;
+            cb(Status<size_t, int>::make_ok(done));
+        };
+    });
+}
+
+void AsyncFile::fsync(FileSyncCb cb) {
+    submit([this, cb = std::move(cb)](int fd) mutable -> PostedCb {
+        const int err = sync_to_device(fd) == -1 ? errno : 0;
+
+        return [this, cb = std::move(cb), err] {
+            --pending_;
+            cb(err == 0 ? Status<None, int>::make_ok() : Status<None, int>::make_err(err));
+        };
+    });
+}
+
+size_t AsyncFile::pending() const {
+    return pending_;
+}
+
+void AsyncFile::submit(Op op) {
+    ++pending_;
+
+    bool start = false;
+    {
+        const std::lock_guard<std::mutex> lock{state_->mu};
+        state_->ops.push_back(std::move(op));
+        start = !state_->running;
+        state_->running = true;
+    }
+
+    if (start) {
+        pool_.submit([state = state_, loop = loop_] { drain(state, loop); });
+    }
+}
+
+// Runs on a worker until the file has no operations left. Completions are posted from here one
+// at a time, so they reach the loop in submission order.
+void AsyncFile::drain(const std::shared_ptr<State>& state, const std::shared_ptr<EventLoop>& loop) {
+    for (;;) {
+        Op op;
+        {
+            const std::lock_guard<std::mutex> lock{state->mu};
+            if (state->ops.empty()) {
+                state->running = false;
+
+                return;
+            }
+            op = std::move(state->ops.front());
+            state->ops.pop_front();
+        }
+
+        if (state->cancelled.load(std::memory_order_relaxed)) {
+            continue;
+        }
+
+        PostedCb done = op(state->fd);
+        (void)loop->post([state, done = std::move(done)] {
+            // The completion captures the file, which may be gone by now.
+            if (!state->cancelled.load(std::memory_order_relaxed)) {
+                done();
+            }
+        });
+    }
+}
+
+} // namespace axle
@@ -0,0 +1,352 @@
+#include "axle/framing.h"
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+#include "axle/status.h"
+
+namespace {
+
+constexpr size_t k_max_varint_len = 10;
+constexpr uint8_t k_varint_more = 0x80;
+constexpr uint8_t k_varint_mask = 0x7f;
+constexpr size_t k_varint_shift = 7;
+constexpr size_t k_byte_bits = 8;
+constexpr uint64_t k_byte_mask = 0xff;
+
+#if defined(__SSE4_2__) || defined(__ARM_FEATURE_CRC32)
+uint32_t crc32c_hw(std::span<const uint8_t> buf, uint32_t crc) {
+    while (buf.size() >= sizeof(uint64_t)) {
+        uint64_t word = 0;
+        std::memcpy(&word, buf.data(), sizeof(word));
+#if defined(__SSE4_2__)
+        crc = static_cast<uint32_t>(_mm_crc32_u64(crc, word));
+#else
+        crc = __crc32cd(crc, word);
+#endif
+        buf = buf.subspan(sizeof(word));
+    }
+
+    for (const uint8_t byte : buf) {
+#if defined(__SSE4_2__)
+        crc = _mm_crc32_u8(crc, byte);
+#else
+        crc = __crc32cb(crc, byte);
+#endif
+    }
+
+    return crc;
+}
+#else
+constexpr uint32_t k_crc32c_poly = 0x82f63b78;
+
+constexpr std::array<uint32_t, 256> make_crc32c_table() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < table.size(); ++i) {
+        uint32_t crc = i;
+        for (size_t bit = 0; bit < k_byte_bits; ++bit) {
+            crc = (crc & 1) != 0 ? (crc >> 1) ^ k_crc32c_poly : crc >> 1;
+        }
+        table.at(i) = crc;
+    }
+
+    return table;
+}
+
+constexpr std::array<uint32_t, 256> k_crc32c_table = make_crc32c_table();
+
+uint32_t crc32c_scalar(std::span<const uint8_t> buf, uint32_t crc) {
+    for (const uint8_t byte : buf) {
+        crc = k_crc32c_table.at((crc ^ byte) & k_byte_mask) ^ (crc >> k_byte_bits);
+    }
+
+    return crc;
+}
+#endif
+
+uint64_t read_be(std::span<const uint8_t> buf) {
+    uint64_t val = 0;
+    for (const uint8_t byte : buf) {
+        val = (val << k_byte_bits) | byte;
+    }
+
+    return val;
+}
+
+void write_be(uint64_t val, std::span<uint8_t> out) {
+    for (auto it = out.rbegin(); it != out.rend(); ++it) {
+        *it = static_cast<uint8_t>(val & k_byte_mask);
+        val >>= k_byte_bits;
+    }
+}
+
+} // namespace
+
+namespace axle {
+
+uint32_t crc32c(std::span<const uint8_t> buf, uint32_t crc) {
+    crc = ~crc;
+#if defined(__SSE4_2__) || defined(__ARM_FEATURE_CRC32)
+    crc = crc32c_hw(buf, crc);
+#else
+    crc = crc32c_scalar(buf, crc);
+#endif
+
+    return ~crc;
+}
+
+Framer::Framer(FramerConfig config, FrameBatchCb cb)
+    : config_{std::move(config)},
+      cb_{std::move(cb)},
+      buf_(config_.buf_sz) {
+    switch (config_.mode) {
+    case FrameMode::FIXED: {
+        const size_t len = config_.prefix_len;
+        if (len != 1 && len != 2 && len != 4 && len != sizeof(uint64_t)) {
+            throw std::runtime_error("unsupported frame length prefix width");
+        }
+        break;
+    }
+    case FrameMode::VARINT:
+        break;
+    case FrameMode::DELIMITER: {
+        if (config_.delimiter.empty()) {
+            throw std::runtime_error("frame delimiter must not be empty");
+        }
+        if (config_.checksum) {
+            throw std::runtime_error("frame checksums require a length prefix");
+        }
+        break;
+    }
+    }
+
+    if (config_.buf_sz == 0) {
+        throw std::runtime_error("frame buffer must not be empty");
+    }
+}
+
+std::span<uint8_t> Framer::recv_buf(size_t max_len) {
+    make_room();
+
+    const size_t len = std::min(buf_.size() - tail_, max_len);
+
+    return std::span<uint8_t>{buf_}.subspan(tail_, len);
+}
+
+Status<size_t, FrameError> Framer::post_recv(std::span<uint8_t> buf) {
+    tail_ += buf.size();
+    batch_.clear();
+
+    Status<size_t, FrameError> res = Status<size_t, FrameError>::make_ok(0);
+    for (;;) {
+        Status<Frame, FrameError> frame_res = next_frame();
+        if (frame_res.is_err()) {
+            res = Status<size_t, FrameError>::make_err(frame_res.err());
+            break;
+        }
+
+        const Frame frame = frame_res.ok();
+        if (!frame.complete) {
+            want_ = std::max(frame.frame_len, pending() + 1);
+            break;
+        }
+        want_ = 0;
+
+        const std::span<const uint8_t> payload =
+            std::span<const uint8_t>{buf_}.subspan(head_ + frame.hdr_len, frame.payload_len);
+        if (config_.checksum) {
+            const std::span<const uint8_t> trailer =
+                std::span<const uint8_t>{buf_}.subspan(head_ + frame.hdr_len + frame.payload_len,
+                                                       k_checksum_sz);
+            if (read_be(trailer) != crc32c(payload)) {
+                res = Status<size_t, FrameError>::make_err(FrameError::BAD_CHECKSUM);
+                break;
+            }
+        }
+
+        batch_.push_back(payload);
+        head_ += frame.frame_len;
+        scan_ = head_;
+    }
+
+    if (!batch_.empty()) {
+        cb_(batch_);
+    }
+
+    if (head_ == tail_) {
+        head_ = 0;
+        tail_ = 0;
+        scan_ = 0;
+        if (buf_.size() > config_.buf_sz) {
+            buf_.resize(config_.buf_sz);
+            buf_.shrink_to_fit();
+        }
+    }
+
+    if (res.is_err()) {
+        return res;
+    }
+
+    return Status<size_t, FrameError>::make_ok(batch_.size());
+}
+
+size_t Framer::encode_header(size_t payload_len, std::span<uint8_t, k_max_header_sz> out) const {
+    switch (config_.mode) {
+    case FrameMode::FIXED: {
+        write_be(payload_len, std::span<uint8_t>{out}.first(config_.prefix_len));
+
+        return config_.prefix_len;
+    }
+    case FrameMode::VARINT: {
+        size_t len = 0;
+        do {
+            uint8_t byte = payload_len & k_varint_mask;
+            payload_len >>= k_varint_shift;
+            if (payload_len != 0) {
+                byte |= k_varint_more;
+            }
+            out[len++] = byte;
+        } while (payload_len != 0);
+
+        return len;
+    }
+    case FrameMode::DELIMITER:
+        break;
+    }
+
+    return 0;
+}
+
+void Framer::encode_trailer(std::span<const uint8_t> payload,
+                            std::span<uint8_t, k_checksum_sz> out) {
+    write_be(crc32c(payload), out);
+}
+
+size_t Framer::pending() const {
+    return tail_ - head_;
+}
+
+// An incomplete frame carries the total number of bytes it needs, or 0 if that is not known yet.
+Status<Framer::Frame, FrameError> Framer::next_frame() {
+    const std::span<const uint8_t> data = std::span<const uint8_t>{buf_}.subspan(head_, pending());
+    if (config_.mode == FrameMode::DELIMITER) {
+        return next_delimited_frame(data);
+    }
+
+    return next_prefixed_frame(data);
+}
+
+Status<Framer::Frame, FrameError>
+Framer::next_prefixed_frame(std::span<const uint8_t> data) const {
+    size_t hdr_len = 0;
+    uint64_t payload_len = 0;
+
+    if (config_.mode == FrameMode::FIXED) {
+        if (data.size() < config_.prefix_len) {
+            return Status<Frame, FrameError>::make_ok(Frame{false, 0, 0, config_.prefix_len});
+        }
+        hdr_len = config_.prefix_len;
+        payload_len = read_be(data.first(hdr_len));
+    } else {
+        for (;;) {
+            if (hdr_len == k_max_varint_len) {
+                return Status<Frame, FrameError>::make_err(FrameError::BAD_LENGTH);
+            }
+            if (hdr_len == data.size()) {
+                return Status<Frame, FrameError>::make_ok(Frame{false, 0, 0, 0});
+            }
+
+            const uint8_t byte = data[hdr_len];
+            payload_len |= static_cast<uint64_t>(byte & k_varint_mask) << (k_varint_shift * hdr_len);
+            ++hdr_len;
+            if ((byte & k_varint_more) == 0) {
+                break;
+            }
+        }
+    }
+
+    if (payload_len > config_.max_frame_sz) {
+        return Status<Frame, FrameError>::make_err(FrameError::TOO_LARGE);
+    }
+
+    const size_t frame_len = hdr_len + payload_len + (config_.checksum ? k_checksum_sz : 0);
+    if (data.size() < frame_len) {
+        return Status<Frame, FrameError>::make_ok(Frame{false, 0, 0, frame_len});
+    }
+
+    return Status<Frame, FrameError>::make_ok(Frame{true, hdr_len, payload_len, frame_len});
+}
+
+Status<Framer::Frame, FrameError> Framer::next_delimited_frame(std::span<const uint8_t> data) {
+    const std::span<const uint8_t> delim{config_.delimiter};
+    size_t pos = scan_ - head_;
+
+    while (pos < data.size()) {
+        const void* hit = std::memchr(&data[pos], delim[0], data.size() - pos);
+        if (hit == nullptr) {
+            pos = data.size();
+            break;
+        }
+
+        pos = static_cast<const uint8_t*>(hit) - data.data();
+        if (data.size() - pos < delim.size()) {
+            break;
+        }
+
+        if (std::equal(delim.begin(), delim.end(), data.begin() + pos)) {
+            if (pos > config_.max_frame_sz) {
+                return Status<Frame, FrameError>::make_err(FrameError::TOO_LARGE);
+            }
+
+            return Status<Frame, FrameError>::make_ok(Frame{true, 0, pos, pos + delim.size()});
+        }
+        ++pos;
+    }
+
+    if (data.size() > config_.max_frame_sz + delim.size()) {
+        return Status<Frame, FrameError>::make_err(FrameError::TOO_LARGE);
+    }
+
+    // Resume the next scan where a delimiter could still begin.
+    scan_ = head_ + std::min(pos, data.size() - std::min(data.size(), delim.size() - 1));
+
+    return Status<Frame, FrameError>::make_ok(Frame{false, 0, 0, 0});
+}
+
+void Framer::make_room() {
+    const size_t len = pending();
+    const size_t need = std::max(want_, len + 1);
+    if (head_ + need <= buf_.size()) {
+        return;
+    }
+
+    // The partial frame straddles the end of the buffer: move it to the front and, if it still
+    // does not fit, grow the buffer up to the largest frame we accept.
+    const size_t delim_len = config_.mode == FrameMode::DELIMITER ? config_.delimiter.size() : 0;
+    const size_t cap = k_max_header_sz + config_.max_frame_sz + k_checksum_sz + delim_len;
+    if (need > buf_.size()) {
+        buf_.resize(std::min(std::max(need, 2 * buf_.size()), std::max(cap, buf_.size())));
+    }
+
+    if (head_ != 0) {
+        std::copy(buf_.begin() + head_, buf_.begin() + tail_, buf_.begin());
+        scan_ -= head_;
+        head_ = 0;
+        tail_ = len;
+    }
+}
+
+} // namespace axle
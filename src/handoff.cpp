@@ -0,0 +1,370 @@
+#include "axle/handoff.h"
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h> // IWYU pragma: keep -- for ssize_t
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "log.h"
+#include "axle/event.h"
+#include "axle/socket.h"
+#include "axle/status.h"
+
+namespace {
+
+// Listeners passed in one message; a process has one per loop and port.
+constexpr size_t k_max_listeners = 64;
+constexpr int k_listen_backlog = 4;
+// Sent by the replacement once its servers accept.
+constexpr char k_ready = 'R';
+
+#if defined(MSG_CMSG_CLOEXEC)
+constexpr int k_recv_flags = MSG_CMSG_CLOEXEC;
+#else
+constexpr int k_recv_flags = 0;
+#endif
+
+using ControlBuf = std::array<char, CMSG_SPACE(sizeof(int) * k_max_listeners)>;
+
+bool make_address(const std::string& path, struct sockaddr_un& addr) {
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(&addr.sun_path[0], path.c_str(), path.size() + 1);
+
+    return true;
+}
+
+int unix_socket() {
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        perror("failed to create unix socket");
+    }
+
+    return fd;
+}
+
+// Whether the process at the other end of `fd` runs as the same user as this one.
+bool same_user(int fd) {
+    uid_t uid = 0;
+#if defined(__linux__)
+    struct ucred cred{};
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1) {
+        perror("failed to get handoff peer credentials");
+
+        return false;
+    }
+    uid = cred.uid;
+#else
+    gid_t gid = 0;
+    if (getpeereid(fd, &uid, &gid) == -1) {
+        perror("failed to get handoff peer credentials");
+
+        return false;
+    }
+#endif
+
+    return uid == geteuid();
+}
+
+// NOLINTBEGIN(cppcoreguidelines-pro-*) -- the CMSG macros cast and do pointer arithmetic
+
+// Sends the number of listeners, with the descriptors themselves attached.
+axle::Status<axle::None, int> send_listeners(int fd, const std::vector<int>& listeners) {
+    auto cnt = static_cast<uint32_t>(listeners.size());
+    struct iovec iov{&cnt, sizeof(cnt)};
+    ControlBuf control{};
+
+    struct msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (!listeners.empty()) {
+        const size_t len = sizeof(int) * listeners.size();
+        msg.msg_control = control.data();
+        msg.msg_controllen = CMSG_SPACE(len);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(len);
+        std::memcpy(CMSG_DATA(cmsg), listeners.data(), len);
+    }
+
+    if (sendmsg(fd, &msg, 0) == -1) {
+        perror("failed to send listeners");
+
+        return axle::Status<axle::None, int>::make_err(errno);
+    }
+
+    return axle::Status<axle::None, int>::make_ok();
+}
+
+axle::Status<std::vector<axle::ServerSocket>, int> recv_listeners(int fd) {
+    using Result = axle::Status<std::vector<axle::ServerSocket>, int>;
+
+    uint32_t cnt = 0;
+    struct iovec iov{&cnt, sizeof(cnt)};
+    ControlBuf control{};
+
+    struct msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+
+    ssize_t len = 0;
+    do {
+        len = recvmsg(fd, &msg, k_recv_flags);
+    } while (len == -1 && errno == EINTR);
+    if (len == -1) {
+        perror("failed to receive listeners");
+
+        return Result::make_err(errno);
+    }
+
+    // Whatever arrived is owned from here on, even if the message turns out to be short.
+    std::vector<axle::ServerSocket> listeners;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        const size_t fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < fds; ++i) {
+            int listener = -1;
+            std::memcpy(&listener, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            listeners.emplace_back(listener);
+        }
+    }
+
+    if (static_cast<size_t>(len) != sizeof(cnt) || (msg.msg_flags & MSG_CTRUNC) != 0 ||
+        listeners.size() != cnt) {
+        return Result::make_err(EPROTO);
+    }
+
+    return Result::make_ok(std::move(listeners));
+}
+
+// NOLINTEND(cppcoreguidelines-pro-*)
+
+} // namespace
+
+namespace axle {
+
+Status<Takeover, int> take_listeners(const std::string& path) {
+    struct sockaddr_un addr{};
+    if (!make_address(path, addr)) {
+        return Status<Takeover, int>::make_err(ENAMETOOLONG);
+    }
+
+    const int fd = unix_socket();
+    if (fd == -1) {
+        return Status<Takeover, int>::make_err(errno);
+    }
+    Socket channel{fd};
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == -1) {
+        // The usual case on a first start, so not worth a message.
+        return Status<Takeover, int>::make_err(errno);
+    }
+
+    Status<std::vector<ServerSocket>, int> listeners = recv_listeners(fd);
+    if (listeners.is_err()) {
+        return Status<Takeover, int>::make_err(listeners.err());
+    }
+
+    return Status<Takeover, int>::make_ok(Takeover{std::move(channel), listeners.ok()});
+}
+
+Status<None, int> confirm_takeover(Takeover& takeover) {
+    const std::array<uint8_t, 1> ready{k_ready};
+    Status<None, int> res = takeover.channel.send_all(ready);
+    (void)takeover.channel.close();
+
+    return res;
+}
+
+ListenerHandoff::ListenerHandoff(std::shared_ptr<EventLoop> event_loop,
+                                 std::string path,
+                                 std::vector<int> listeners,
+                                 PostedCb on_handoff,
+                                 std::chrono::nanoseconds confirm_timeout)
+    : event_loop_{std::move(event_loop)},
+      path_{std::move(path)},
+      listeners_{std::move(listeners)},
+      on_handoff_{std::move(on_handoff)},
+      confirm_timeout_{confirm_timeout},
+      confirm_timer_id_{event_loop_->make_timer_id()},
+      socket_{unix_socket()} {
+    if (socket_.get_fd() == -1) {
+        throw std::runtime_error("failed to create handoff socket");
+    }
+    if (listeners_.size() > k_max_listeners) {
+        throw std::runtime_error("too many listeners to hand off");
+    }
+
+    struct sockaddr_un addr{};
+    if (!make_address(path_, addr)) {
+        throw std::runtime_error("handoff socket path is too long");
+    }
+
+    // The old process's socket, if any, has served its purpose by the time a new one is made.
+    (void)unlink(path_.c_str());
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    if (bind(socket_.get_fd(), reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == -1) {
+        perror("failed to bind handoff socket");
+        throw std::runtime_error("failed to bind handoff socket");
+    }
+    // Whatever the umask, before anyone can connect.
+    if (chmod(path_.c_str(), S_IRUSR | S_IWUSR) == -1) {
+        perror("failed to restrict handoff socket");
+        (void)unlink(path_.c_str());
+        throw std::runtime_error("failed to restrict handoff socket");
+    }
+
+    if (::listen(socket_.get_fd(), k_listen_backlog) == -1 || socket_.set_non_blocking().is_err()) {
+        (void)unlink(path_.c_str());
+        throw std::runtime_error("failed to listen on handoff socket");
+    }
+
+    watch_accept();
+}
+
+ListenerHandoff::~ListenerHandoff() {
+    if (accepting_) {
+        (void)event_loop_->remove_fd_read(socket_.get_fd());
+    }
+    if (peer_) {
+        (void)event_loop_->remove_fd_read(peer_->get_fd());
+    }
+    (void)event_loop_->remove_timer(confirm_timer_id_);
+    if (!handed_off_) {
+        (void)unlink(path_.c_str());
+    }
+}
+
+bool ListenerHandoff::handed_off() const {
+    return handed_off_;
+}
+
+void ListenerHandoff::watch_accept() {
+    const Status<None, int> res = event_loop_->register_fd_read(
+        socket_.get_fd(), [this](uint64_t, Status<int64_t, uint32_t> status) {
+            if (status.is_err()) {
+                log("notification failure for handoff socket: {}\n", status.err());
+
+                return;
+            }
+            accept_one();
+        });
+    accepting_ = res.is_ok();
+}
+
+void ListenerHandoff::accept_one() {
+    const int fd = ::accept(socket_.get_fd(), nullptr, nullptr);
+    if (fd == -1) {
+        if (errno != EWOULDBLOCK && errno != EAGAIN) {
+            perror("failed to accept on handoff socket");
+        }
+
+        return;
+    }
+
+    Socket peer{fd};
+    if (!same_user(fd)) {
+        log("refused a handoff to a process of another user\n");
+
+        return;
+    }
+    // A small message on a fresh connection, which the socket buffer always has room for.
+    if (send_listeners(fd, listeners_).is_err() || peer.set_non_blocking().is_err()) {
+        return;
+    }
+
+    // Other replacements wait in the backlog until this one confirms or goes away.
+    if (event_loop_->remove_fd_read(socket_.get_fd()).is_err()) {
+        log("failed to pause accepts on handoff socket\n");
+    }
+    accepting_ = false;
+
+    peer_.emplace(std::move(peer));
+    const Status<None, int> res = event_loop_->register_fd_read(
+        fd, [this](uint64_t, Status<int64_t, uint32_t>) { on_peer_readable(); });
+    if (res.is_err()) {
+        peer_.reset();
+        watch_accept();
+
+        return;
+    }
+
+    const Status<None, int> timer = event_loop_->register_timer(
+        confirm_timer_id_,
+        static_cast<uint64_t>(confirm_timeout_.count()),
+        false /* periodic */,
+        [this](uint64_t, Status<None, int64_t>) {
+            log("handoff peer did not confirm in time\n");
+            give_up_on_peer();
+        });
+    if (timer.is_err()) {
+        // Without a deadline, a replacement that hangs would hold up every later one.
+        give_up_on_peer();
+    }
+}
+
+void ListenerHandoff::on_peer_readable() {
+    std::array<uint8_t, 1> byte{};
+    const ssize_t len = read(peer_->get_fd(), byte.data(), byte.size());
+    if (len == -1 && (errno == EWOULDBLOCK || errno == EAGAIN || errno == EINTR)) {
+        return;
+    }
+
+    if (len != 1 || byte[0] != k_ready) {
+        // The replacement went away or is confused; keep serving for the next one.
+        (void)event_loop_->remove_timer(confirm_timer_id_);
+        give_up_on_peer();
+
+        return;
+    }
+
+    handed_off_ = true;
+    (void)event_loop_->remove_timer(confirm_timer_id_);
+    drop_peer();
+    (void)socket_.close();
+    if (event_loop_->post(std::move(on_handoff_)).is_err()) {
+        log("failed to post the end of the handoff\n");
+    }
+}
+
+void ListenerHandoff::drop_peer() {
+    if (event_loop_->remove_fd_read(peer_->get_fd()).is_err()) {
+        log("failed to remove handoff peer read filter\n");
+    }
+    peer_.reset();
+}
+
+// Leaves the confirmation timer to the caller, which may be running in it.
+void ListenerHandoff::give_up_on_peer() {
+    drop_peer();
+    watch_accept();
+}
+
+} // namespace axle
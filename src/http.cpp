@@ -0,0 +1,503 @@
+#include "axle/http.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include "axle/status.h"
+
+namespace {
+
+constexpr size_t k_hex_shift = 4;
+constexpr size_t k_max_chunk_size_digits = 15;
+constexpr size_t k_decimal_base = 10;
+constexpr uint8_t k_del = 0x7f;
+constexpr uint8_t k_last_ctl = 0x1f;
+
+constexpr std::array<bool, 256> make_token_table() {
+    std::array<bool, 256> table{};
+    for (size_t c = '0'; c <= '9'; ++c) {
+        table.at(c) = true;
+    }
+    for (size_t c = 'a'; c <= 'z'; ++c) {
+        table.at(c) = true;
+        table.at(c - 'a' + 'A') = true;
+    }
+    for (const char c : std::string_view{"!#$%&'*+-.^_`|~"}) {
+        table.at(static_cast<uint8_t>(c)) = true;
+    }
+
+    return table;
+}
+
+constexpr std::array<bool, 256> k_token_table = make_token_table();
+
+bool is_token(std::string_view str) {
+    return !str.empty() && std::all_of(str.begin(), str.end(), [](char c) {
+        return k_token_table.at(static_cast<uint8_t>(c));
+    });
+}
+
+bool is_ctl(uint8_t c) {
+    return (c <= k_last_ctl && c != '\t') || c == k_del;
+}
+
+// Index of the first '\n' at or after `pos`, or `buf.size()` if there is none.
+size_t find_lf(std::span<const uint8_t> buf, size_t pos) {
+#if defined(__AVX2__)
+    const __m256i lf = _mm256_set1_epi8('\n');
+    while (pos + sizeof(__m256i) <= buf.size()) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&buf[pos]));
+        const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, lf)));
+        if (mask != 0) {
+            return pos + std::countr_zero(mask);
+        }
+        pos += sizeof(__m256i);
+    }
+#elif defined(__SSE4_2__)
+    const __m128i lf = _mm_set1_epi8('\n');
+    while (pos + sizeof(__m128i) <= buf.size()) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&buf[pos]));
+        const int idx = _mm_cmpestri(lf, 1, chunk, sizeof(__m128i), _SIDD_CMP_EQUAL_ANY);
+        if (idx != sizeof(__m128i)) {
+            return pos + idx;
+        }
+        pos += sizeof(__m128i);
+    }
+#endif
+    if (pos >= buf.size()) {
+        return buf.size();
+    }
+
+    const void* hit = std::memchr(&buf[pos], '\n', buf.size() - pos);
+
+    return hit == nullptr ? buf.size() : static_cast<const uint8_t*>(hit) - buf.data();
+}
+
+// Index of the first control character other than HTAB at or after `pos`, or `buf.size()`. In a
+// well-formed header this is the CR that ends the field value.
+size_t find_ctl(std::span<const uint8_t> buf, size_t pos) {
+#if defined(__AVX2__)
+    const __m256i last_ctl = _mm256_set1_epi8(k_last_ctl);
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i del = _mm256_set1_epi8(k_del);
+    while (pos + sizeof(__m256i) <= buf.size()) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&buf[pos]));
+        const __m256i ctl = _mm256_cmpeq_epi8(_mm256_max_epu8(chunk, last_ctl), last_ctl);
+        const __m256i not_tab = _mm256_andnot_si256(_mm256_cmpeq_epi8(chunk, tab), ctl);
+        const __m256i bad = _mm256_or_si256(not_tab, _mm256_cmpeq_epi8(chunk, del));
+        const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(bad));
+        if (mask != 0) {
+            return pos + std::countr_zero(mask);
+        }
+        pos += sizeof(__m256i);
+    }
+#elif defined(__SSE4_2__)
+    // Byte ranges [0x00, 0x08], [0x0a, 0x1f] and [0x7f, 0x7f].
+    const __m128i ranges =
+        _mm_setr_epi8(0x00, 0x08, 0x0a, 0x1f, 0x7f, 0x7f, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    while (pos + sizeof(__m128i) <= buf.size()) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&buf[pos]));
+        const int idx =
+            _mm_cmpestri(ranges, 6, chunk, sizeof(__m128i), _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES);
+        if (idx != sizeof(__m128i)) {
+            return pos + idx;
+        }
+        pos += sizeof(__m128i);
+    }
+#endif
+    while (pos < buf.size() && !is_ctl(buf[pos])) {
+        ++pos;
+    }
+
+    return pos;
+}
+
+bool iequals(std::string_view lhs, std::string_view rhs) {
+    constexpr char k_case_bit = 0x20;
+
+    const auto fold = [](char c) {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c | k_case_bit) : c;
+    };
+
+    return lhs.size() == rhs.size() &&
+           std::equal(lhs.begin(), lhs.end(), rhs.begin(), [&](char a, char b) {
+               return fold(a) == fold(b);
+           });
+}
+
+bool ends_with_token(std::string_view value, std::string_view token) {
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+        value.remove_suffix(1);
+    }
+    if (value.size() < token.size() || !iequals(value.substr(value.size() - token.size()), token)) {
+        return false;
+    }
+    value.remove_suffix(token.size());
+
+    return value.empty() || value.back() == ',' || value.back() == ' ' || value.back() == '\t';
+}
+
+std::optional<size_t> parse_decimal(std::string_view str) {
+    if (str.empty()) {
+        return std::nullopt;
+    }
+
+    size_t val = 0;
+    for (const char c : str) {
+        if (c < '0' || c > '9') {
+            return std::nullopt;
+        }
+        const auto digit = static_cast<size_t>(c - '0');
+        if (val > (SIZE_MAX - digit) / k_decimal_base) {
+            return std::nullopt;
+        }
+        val = val * k_decimal_base + digit;
+    }
+
+    return val;
+}
+
+std::optional<uint8_t> hex_value(uint8_t c) {
+    constexpr uint8_t k_ten = 10;
+
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + k_ten;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + k_ten;
+    }
+
+    return std::nullopt;
+}
+
+} // namespace
+
+namespace axle {
+
+std::optional<std::string_view> HttpRequest::header(std::string_view name) const {
+    for (const HttpHeader& hdr : headers) {
+        if (iequals(hdr.name, name)) {
+            return hdr.value;
+        }
+    }
+
+    return std::nullopt;
+}
+
+Status<size_t, HttpError> HttpRequestParser::parse(std::span<const uint8_t> buf) {
+    // Find the blank line that ends the head, resuming from where the last call left off.
+    size_t pos = scan_;
+    size_t head_len = 0;
+    while (head_len == 0) {
+        pos = find_lf(buf, pos);
+        if (pos + 1 < buf.size() && buf[pos + 1] == '\n') {
+            head_len = pos + 2;
+        } else if (pos + 2 < buf.size() && buf[pos + 1] == '\r' && buf[pos + 2] == '\n') {
+            head_len = pos + 3;
+        } else if (pos + 2 >= buf.size()) {
+            scan_ = std::min(pos, buf.size());
+            if (buf.size() > k_max_head_sz) {
+                return Status<size_t, HttpError>::make_err(HttpError::HEAD_TOO_LARGE);
+            }
+
+            return Status<size_t, HttpError>::make_ok(0);
+        } else {
+            ++pos;
+        }
+    }
+
+    if (head_len > k_max_head_sz) {
+        return Status<size_t, HttpError>::make_err(HttpError::HEAD_TOO_LARGE);
+    }
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    std::string_view head{reinterpret_cast<const char*>(buf.data()), head_len};
+    Status<None, HttpError> res = parse_request_line(head);
+    if (res.is_err()) {
+        return Status<size_t, HttpError>::make_err(res.err());
+    }
+
+    res = parse_headers(head);
+    if (res.is_err()) {
+        return Status<size_t, HttpError>::make_err(res.err());
+    }
+
+    return Status<size_t, HttpError>::make_ok(head_len);
+}
+
+const HttpRequest& HttpRequestParser::request() const {
+    return request_;
+}
+
+void HttpRequestParser::reset() {
+    request_ = HttpRequest{};
+    scan_ = 0;
+}
+
+Status<None, HttpError> HttpRequestParser::parse_request_line(std::string_view& head) {
+    constexpr std::string_view k_version_prefix = "HTTP/1.";
+
+    const size_t eol = head.find('\n');
+    std::string_view line = head.substr(0, eol);
+    head.remove_prefix(eol + 1);
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+
+    const size_t method_end = line.find(' ');
+    if (method_end == std::string_view::npos || !is_token(line.substr(0, method_end))) {
+        return Status<None, HttpError>::make_err(HttpError::BAD_REQUEST_LINE);
+    }
+    request_.method = line.substr(0, method_end);
+    line.remove_prefix(method_end + 1);
+
+    const size_t target_end = line.find(' ');
+    if (target_end == 0 || target_end == std::string_view::npos) {
+        return Status<None, HttpError>::make_err(HttpError::BAD_REQUEST_LINE);
+    }
+    request_.target = line.substr(0, target_end);
+    line.remove_prefix(target_end + 1);
+    if (std::any_of(request_.target.begin(), request_.target.end(), [](char c) {
+            return is_ctl(static_cast<uint8_t>(c)) || c == '\t';
+        })) {
+        return Status<None, HttpError>::make_err(HttpError::BAD_REQUEST_LINE);
+    }
+
+    if (line.size() != k_version_prefix.size() + 1 || !line.starts_with(k_version_prefix) ||
+        (line.back() != '0' && line.back() != '1')) {
+        return Status<None, HttpError>::make_err(HttpError::BAD_VERSION);
+    }
+    request_.version_minor = line.back() - '0';
+    request_.keep_alive = request_.version_minor == 1;
+
+    return Status<None, HttpError>::make_ok();
+}
+
+Status<None, HttpError> HttpRequestParser::parse_headers(std::string_view head) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    const std::span<const uint8_t> bytes{reinterpret_cast<const uint8_t*>(head.data()),
+                                         head.size()};
+    size_t cnt = 0;
+    size_t pos = 0;
+    std::optional<size_t> content_length;
+    bool transfer_encoding = false;
+
+    while (head[pos] != '\r' && head[pos] != '\n') {
+        const size_t colon = head.find(':', pos);
+        const std::string_view name = head.substr(pos, colon - pos);
+        if (colon == std::string_view::npos || !is_token(name)) {
+            return Status<None, HttpError>::make_err(HttpError::BAD_HEADER);
+        }
+
+        pos = colon + 1;
+        while (head[pos] == ' ' || head[pos] == '\t') {
+            ++pos;
+        }
+
+        const size_t value_end = find_ctl(bytes, pos);
+        size_t next = value_end + 1;
+        if (head[value_end] == '\r') {
+            ++next;
+            if (head[value_end + 1] != '\n') {
+                return Status<None, HttpError>::make_err(HttpError::BAD_HEADER);
+            }
+        } else if (head[value_end] != '\n') {
+            return Status<None, HttpError>::make_err(HttpError::BAD_HEADER);
+        }
+
+        std::string_view value = head.substr(pos, value_end - pos);
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+            value.remove_suffix(1);
+        }
+        pos = next;
+
+        if (cnt == k_max_headers) {
+            return Status<None, HttpError>::make_err(HttpError::TOO_MANY_HEADERS);
+        }
+        headers_.at(cnt++) = HttpHeader{name, value};
+
+        if (iequals(name, "content-length")) {
+            const std::optional<size_t> len = parse_decimal(value);
+            if (!len || (content_length && *content_length != *len)) {
+                return Status<None, HttpError>::make_err(HttpError::BAD_CONTENT_LENGTH);
+            }
+            content_length = len;
+        } else if (iequals(name, "transfer-encoding")) {
+            // Repeated headers make one list of codings, of which `chunked` must be the last and
+            // must come only once. Anything after it would leave the body's end unknown.
+            if (request_.chunked) {
+                return Status<None, HttpError>::make_err(HttpError::BAD_TRANSFER_ENCODING);
+            }
+            transfer_encoding = true;
+            request_.chunked = ends_with_token(value, "chunked");
+        } else if (iequals(name, "connection")) {
+            if (iequals(value, "close")) {
+                request_.keep_alive = false;
+            } else if (iequals(value, "keep-alive")) {
+                request_.keep_alive = true;
+            }
+        }
+    }
+
+    // Falling back to Content-Length here is what lets a request be smuggled past a proxy that
+    // reads the body differently.
+    if (transfer_encoding && !request_.chunked) {
+        return Status<None, HttpError>::make_err(HttpError::BAD_TRANSFER_ENCODING);
+    }
+
+    request_.headers = std::span<const HttpHeader>{headers_}.first(cnt);
+    request_.content_length = request_.chunked ? 0 : content_length.value_or(0);
+
+    return Status<None, HttpError>::make_ok();
+}
+
+Status<ChunkedResult, HttpError> ChunkedDecoder::decode(std::span<const uint8_t> buf) {
+    size_t pos = 0;
+    while (pos < buf.size() && state_ != State::DONE) {
+        const uint8_t c = buf[pos];
+        switch (state_) {
+        case State::SIZE: {
+            const std::optional<uint8_t> digit = hex_value(c);
+            if (digit) {
+                if (++size_digits_ > k_max_chunk_size_digits) {
+                    return Status<ChunkedResult, HttpError>::make_err(HttpError::BAD_CHUNK);
+                }
+                remaining_ = (remaining_ << k_hex_shift) | *digit;
+                ++pos;
+                break;
+            }
+            if (size_digits_ == 0) {
+                return Status<ChunkedResult, HttpError>::make_err(HttpError::BAD_CHUNK);
+            }
+            if (c == ';' || c == ' ' || c == '\t') {
+                state_ = State::EXTENSION;
+            } else if (c == '\r') {
+                state_ = State::SIZE_LF;
+            } else if (c == '\n') {
+                state_ = remaining_ == 0 ? State::TRAILER : State::DATA;
+                size_digits_ = 0;
+            } else {
+                return Status<ChunkedResult, HttpError>::make_err(HttpError::BAD_CHUNK);
+            }
+            ++pos;
+            break;
+        }
+
+        case State::EXTENSION: {
+            if (c == '\r') {
+                state_ = State::SIZE_LF;
+            } else if (c == '\n') {
+                state_ = remaining_ == 0 ? State::TRAILER : State::DATA;
+                size_digits_ = 0;
+            }
+            ++pos;
+            break;
+        }
+
+        case State::SIZE_LF: {
+            if (c != '\n') {
+                return Status<ChunkedResult, HttpError>::make_err(HttpError::BAD_CHUNK);
+            }
+            state_ = remaining_ == 0 ? State::TRAILER : State::DATA;
+            size_digits_ = 0;
+            ++pos;
+            break;
+        }
+
+        case State::DATA: {
+            const size_t len = std::min<uint64_t>(remaining_, buf.size() - pos);
+            const std::span<const uint8_t> data = buf.subspan(pos, len);
+            remaining_ -= len;
+            if (remaining_ == 0) {
+                state_ = State::DATA_CR;
+            }
+
+            return Status<ChunkedResult, HttpError>::make_ok(ChunkedResult{pos + len, data});
+        }
+
+        case State::DATA_CR: {
+            if (c == '\r') {
+                state_ = State::DATA_LF;
+            } else if (c == '\n') {
+                state_ = State::SIZE;
+            } else {
+                return Status<ChunkedResult, HttpError>::make_err(HttpError::BAD_CHUNK);
+            }
+            ++pos;
+            break;
+        }
+
+        case State::DATA_LF: {
+            if (c != '\n') {
+                return Status<ChunkedResult, HttpError>::make_err(HttpError::BAD_CHUNK);
+            }
+            state_ = State::SIZE;
+            ++pos;
+            break;
+        }
+
+        // Trailer fields are skipped; an empty line ends the body.
+        case State::TRAILER: {
+            if (c == '\r') {
+                state_ = State::TRAILER_LF;
+            } else if (c == '\n') {
+                state_ = trailer_len_ == 0 ? State::DONE : State::TRAILER;
+                trailer_len_ = 0;
+            } else {
+                ++trailer_len_;
+            }
+            ++pos;
+            break;
+        }
+
+        case State::TRAILER_LF: {
+            if (c != '\n') {
+                return Status<ChunkedResult, HttpError>::make_err(HttpError::BAD_CHUNK);
+            }
+            state_ = trailer_len_ == 0 ? State::DONE : State::TRAILER;
+            trailer_len_ = 0;
+            ++pos;
+            break;
+        }
+
+        case State::DONE:
+            break;
+        }
+    }
+
+    return Status<ChunkedResult, HttpError>::make_ok(ChunkedResult{pos, {}});
+}
+
+bool ChunkedDecoder::done() const {
+    return state_ == State::DONE;
+}
+
+void ChunkedDecoder::reset() {
+    state_ = State::SIZE;
+    remaining_ = 0;
+    size_digits_ = 0;
+    trailer_len_ = 0;
+}
+
+} // namespace axle
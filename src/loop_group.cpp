@@ -0,0 +1,206 @@
+#include "axle/loop_group.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#endif
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+
+#include <exception>
+#include <functional>
+#include <latch>
+#include <memory>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "log.h"
+#include "axle/event.h"
+#include "axle/status.h"
+
+namespace {
+
+constexpr size_t k_max_nodes = 8 * sizeof(unsigned long);
+
+// Returns 0 or an errno value, like the pthread functions.
+int pin_thread(const std::vector<int>& cpus, size_t idx) {
+    if (cpus.empty()) {
+        return 0;
+    }
+
+#if defined(__linux__)
+    (void)idx;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : cpus) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            return EINVAL;
+        }
+        CPU_SET(cpu, &set);
+    }
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(__APPLE__)
+    // Threads with different tags are kept apart where the scheduler supports it. Apple silicon
+    // ignores the policy, which is fine for a hint.
+    thread_affinity_policy_data_t policy{static_cast<integer_t>(idx + 1)};
+    (void)thread_policy_set(pthread_mach_thread_np(pthread_self()),
+                            THREAD_AFFINITY_POLICY,
+                            reinterpret_cast<thread_policy_t>(&policy), // NOLINT
+                            THREAD_AFFINITY_POLICY_COUNT);
+
+    return 0;
+#else
+    (void)idx;
+
+    return ENOTSUP;
+#endif
+}
+
+// Makes the calling thread prefer memory from the NUMA node it is running on and returns that
+// node, or -1 if it cannot be determined.
+int prefer_local_node() {
+#if defined(__linux__)
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == -1 || node >= k_max_nodes) {
+        return -1;
+    }
+
+    // Preferred rather than bound, so allocations fall back to other nodes instead of failing.
+    const unsigned long mask = 1UL << node;
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, k_max_nodes + 1) == -1) {
+        perror("failed to set memory policy for loop thread");
+    }
+
+    return static_cast<int>(node);
+#else
+    (void)k_max_nodes;
+
+    return -1;
+#endif
+}
+
+} // namespace
+
+namespace axle {
+
+LoopGroup::LoopGroup(std::vector<std::vector<int>> cpu_sets)
+    : cpu_sets_{std::move(cpu_sets)},
+      loops_(cpu_sets_.size()),
+      nodes_(cpu_sets_.size(), -1) {}
+
+LoopGroup::~LoopGroup() {
+    stop();
+}
+
+std::vector<std::vector<int>> LoopGroup::one_per_cpu(size_t cnt) {
+    std::vector<std::vector<int>> cpu_sets;
+    cpu_sets.reserve(cnt);
+    for (size_t i = 0; i < cnt; ++i) {
+        cpu_sets.push_back({static_cast<int>(i)});
+    }
+
+    return cpu_sets;
+}
+
+Status<None, int> LoopGroup::start(const LoopInitCb& init) {
+    std::latch ready{static_cast<std::ptrdiff_t>(cpu_sets_.size())};
+    std::vector<int> errs(cpu_sets_.size(), 0);
+
+    threads_.reserve(cpu_sets_.size());
+    for (size_t i = 0; i < cpu_sets_.size(); ++i) {
+        threads_.emplace_back(
+            [this, i, &init, &ready, &errs] { run_loop(i, init, ready, errs[i]); });
+    }
+    ready.wait();
+
+    for (const int err : errs) {
+        if (err != 0) {
+            stop();
+
+            return Status<None, int>::make_err(err);
+        }
+    }
+
+    return Status<None, int>::make_ok();
+}
+
+void LoopGroup::join() {
+    for (std::thread& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void LoopGroup::stop() {
+    for (const std::shared_ptr<EventLoop>& loop : loops_) {
+        if (loop != nullptr) {
+            (void)loop->shutdown();
+        }
+    }
+
+    join();
+    threads_.clear();
+}
+
+size_t LoopGroup::size() const {
+    return loops_.size();
+}
+
+const std::shared_ptr<EventLoop>& LoopGroup::loop(size_t idx) const {
+    return loops_.at(idx);
+}
+
+int LoopGroup::cpu(size_t idx) const {
+    const std::vector<int>& cpus = cpu_sets_.at(idx);
+
+    return cpus.empty() ? -1 : cpus.front();
+}
+
+int LoopGroup::node(size_t idx) const {
+    return nodes_.at(idx);
+}
+
+void LoopGroup::run_loop(size_t idx, const LoopInitCb& init, std::latch& ready, int& err) {
+    err = pin_thread(cpu_sets_[idx], idx);
+    if (err == 0 && !cpu_sets_[idx].empty()) {
+        nodes_[idx] = prefer_local_node();
+    }
+
+    if (err == 0) {
+        try {
+            loops_[idx] = std::make_shared<EventLoop>();
+            init(idx, loops_[idx]);
+        } catch (const std::system_error& e) {
+            log("failed to start event loop {}: {}\n", idx, e.what());
+            const bool posix = e.code().category() == std::generic_category() ||
+                               e.code().category() == std::system_category();
+            err = posix && e.code().value() != 0 ? e.code().value() : EINVAL;
+        } catch (const std::exception& e) {
+            // `errno` is stale by now, if it was ever set for this.
+            log("failed to start event loop {}: {}\n", idx, e.what());
+            err = EINVAL;
+        }
+    }
+
+    const std::shared_ptr<EventLoop> loop = err == 0 ? loops_[idx] : nullptr;
+    ready.count_down();
+
+    if (loop != nullptr) {
+        loop->run();
+    }
+}
+
+} // namespace axle
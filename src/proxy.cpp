@@ -0,0 +1,511 @@
+#include "axle/proxy.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h> // IWYU pragma: keep -- for ssize_t
+#include <sys/uio.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "log.h"
+#include "axle/event.h"
+#include "axle/socket.h"
+#include "axle/status.h"
+
+namespace {
+
+#if defined(SPLICE_F_NONBLOCK)
+// The pipe end is non-blocking, and pages are moved rather than copied where the kernel can.
+constexpr unsigned k_splice_flags = SPLICE_F_NONBLOCK | SPLICE_F_MOVE;
+#endif
+
+constexpr size_t k_default_pipe_sz = 64 * 1024;
+
+void close_pipe(const axle::Pipe& pipe) {
+    (void)close(pipe.read_fd);
+    (void)close(pipe.write_fd);
+}
+
+// Moves up to `len` bytes from `in` to `out`, one of which must be a pipe. Returns zero for
+// EAGAIN; `eof` is set when `in` has nothing more to give.
+axle::Status<size_t, int> splice_some(int in, int out, size_t len, bool& eof) {
+#if defined(SPLICE_F_NONBLOCK)
+    const ssize_t ret = splice(in, nullptr, out, nullptr, len, k_splice_flags);
+    if (ret == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return axle::Status<size_t, int>::make_ok(0);
+        }
+
+        return axle::Status<size_t, int>::make_err(errno);
+    }
+
+    eof = ret == 0;
+
+    return axle::Status<size_t, int>::make_ok(static_cast<size_t>(ret));
+#else
+    (void)in;
+    (void)out;
+    (void)len;
+    (void)eof;
+
+    return axle::Status<size_t, int>::make_err(ENOTSUP);
+#endif
+}
+
+} // namespace
+
+namespace axle {
+
+bool splice_supported() {
+#if defined(SPLICE_F_NONBLOCK)
+    return true;
+#else
+    return false;
+#endif
+}
+
+PipePool::PipePool(size_t pipe_sz, size_t max_idle)
+    : pipe_sz_{pipe_sz},
+      max_idle_{max_idle} {}
+
+PipePool::~PipePool() {
+    for (const Pipe& pipe : idle_) {
+        close_pipe(pipe);
+    }
+}
+
+Status<Pipe, int> PipePool::acquire() {
+    if (!idle_.empty()) {
+        const Pipe pipe = idle_.back();
+        idle_.pop_back();
+
+        return Status<Pipe, int>::make_ok(pipe);
+    }
+
+#if defined(SPLICE_F_NONBLOCK)
+    std::array<int, 2> fds{};
+    if (pipe2(fds.data(), O_NONBLOCK | O_CLOEXEC) == -1) {
+        perror("failed to create pipe");
+
+        return Status<Pipe, int>::make_err(errno);
+    }
+
+    Pipe pipe{fds[0], fds[1], k_default_pipe_sz};
+    if (pipe_sz_ > 0) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+        const int capacity = fcntl(pipe.write_fd, F_SETPIPE_SZ, static_cast<int>(pipe_sz_));
+        if (capacity == -1) {
+            perror("failed to resize pipe");
+        } else {
+            pipe.capacity = static_cast<size_t>(capacity);
+        }
+    }
+
+    return Status<Pipe, int>::make_ok(pipe);
+#else
+    return Status<Pipe, int>::make_err(ENOTSUP);
+#endif
+}
+
+void PipePool::release(Pipe pipe, bool empty) {
+    if (!empty || idle_.size() >= max_idle_) {
+        close_pipe(pipe);
+
+        return;
+    }
+
+    idle_.push_back(pipe);
+}
+
+size_t PipePool::idle() const {
+    return idle_.size();
+}
+
+Relay::Relay(std::shared_ptr<EventLoop> event_loop,
+             Socket downstream,
+             Socket upstream,
+             RelayMode mode,
+             PipePool* pipes,
+             RelayDoneCb done)
+    : event_loop_{std::move(event_loop)},
+      downstream_{std::move(downstream)},
+      upstream_{std::move(upstream)},
+      mode_{mode},
+      pipes_{pipes},
+      done_{std::move(done)},
+      to_upstream_{&downstream_, &upstream_, &stats_.upstream_bytes},
+      to_downstream_{&upstream_, &downstream_, &stats_.downstream_bytes} {}
+
+Relay::~Relay() {
+    for (Flow* flow : {&to_upstream_, &to_downstream_}) {
+        stop_watching(*flow);
+        if (flow->pipe.read_fd != -1) {
+            pipes_->release(flow->pipe, flow->buffered == 0);
+        }
+    }
+}
+
+Status<None, int> Relay::start() {
+    if (Status<None, int> res = downstream_.set_non_blocking(); res.is_err()) {
+        return res;
+    }
+    if (Status<None, int> res = upstream_.set_non_blocking(); res.is_err()) {
+        return res;
+    }
+
+    for (Flow* flow : {&to_upstream_, &to_downstream_}) {
+        if (mode_ == RelayMode::COPY) {
+            flow->buf.resize(k_copy_buf_sz);
+        } else {
+            Status<Pipe, int> pipe = pipes_->acquire();
+            if (pipe.is_err()) {
+                return Status<None, int>::make_err(pipe.err());
+            }
+            flow->pipe = pipe.ok();
+        }
+
+        if (Status<None, int> res = update_interest(*flow); res.is_err()) {
+            return res;
+        }
+    }
+
+    return Status<None, int>::make_ok();
+}
+
+const RelayStats& Relay::stats() const {
+    return stats_;
+}
+
+void Relay::on_readable(Flow& flow) {
+    if (flow.buffered == 0 && !flow.eof) {
+        Status<size_t, int> res = fill(flow);
+        if (res.is_err()) {
+            finish(res.err());
+
+            return;
+        }
+    }
+
+    on_writable(flow);
+}
+
+void Relay::on_writable(Flow& flow) {
+    while (flow.buffered > 0) {
+        Status<size_t, int> res = drain(flow);
+        if (res.is_err()) {
+            finish(res.err());
+
+            return;
+        }
+        if (res.ok() == 0) {
+            break;
+        }
+    }
+
+    if (flow.eof && flow.buffered == 0 && !flow.shut) {
+        if (Status<None, int> res = flow.dst->shutdown_write(); res.is_err()) {
+            finish(res.err());
+
+            return;
+        }
+        flow.shut = true;
+
+        if (to_upstream_.shut && to_downstream_.shut) {
+            finish(0);
+
+            return;
+        }
+    }
+
+    if (Status<None, int> res = update_interest(flow); res.is_err()) {
+        finish(res.err());
+    }
+}
+
+// Reads what the sender has, up to a buffer or pipe's worth, into the empty buffer or pipe.
+Status<size_t, int> Relay::fill(Flow& flow) {
+    size_t len = 0;
+    if (mode_ == RelayMode::COPY) {
+        Status<std::span<uint8_t>, int> res = flow.src->recv_some(flow.buf);
+        if (res.is_err()) {
+            if (res.err() == EAGAIN || res.err() == EWOULDBLOCK) {
+                return Status<size_t, int>::make_ok(0);
+            }
+
+            return Status<size_t, int>::make_err(res.err());
+        }
+        len = res.ok().size();
+        flow.eof = len == 0;
+        flow.head = 0;
+    } else {
+        Status<size_t, int> res =
+            splice_some(flow.src->get_fd(), flow.pipe.write_fd, flow.pipe.capacity, flow.eof);
+        if (res.is_err()) {
+            return res;
+        }
+        len = res.ok();
+    }
+
+    flow.buffered = len;
+
+    return Status<size_t, int>::make_ok(len);
+}
+
+// Writes what the receiver takes of the buffer or pipe. Returns zero once it takes no more.
+Status<size_t, int> Relay::drain(Flow& flow) {
+    size_t len = 0;
+    if (mode_ == RelayMode::COPY) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const struct iovec buf{flow.buf.data() + flow.head, flow.buffered};
+        Status<size_t, int> res = flow.dst->send_some({&buf, 1});
+        if (res.is_err()) {
+            return res;
+        }
+        len = res.ok();
+        flow.head += len;
+    } else {
+        bool eof = false;
+        Status<size_t, int> res =
+            splice_some(flow.pipe.read_fd, flow.dst->get_fd(), flow.buffered, eof);
+        if (res.is_err()) {
+            return res;
+        }
+        len = res.ok();
+    }
+
+    flow.buffered -= len;
+    *flow.relayed += len;
+
+    return Status<size_t, int>::make_ok(len);
+}
+
+// Reads while the buffer is empty and the sender has not finished, and waits for writability
+// while it is not.
+Status<None, int> Relay::update_interest(Flow& flow) {
+    const bool want_read = !flow.eof && flow.buffered == 0;
+    const bool want_write = flow.buffered > 0;
+
+    if (want_read != flow.reading) {
+        const int fd = flow.src->get_fd();
+        Status<None, int> res =
+            want_read ? event_loop_->register_fd_read(
+                            fd,
+                            [this, &flow](uint64_t, Status<int64_t, uint32_t> status) {
+                                if (status.is_err()) {
+                                    finish(static_cast<int>(status.err()));
+
+                                    return;
+                                }
+                                on_readable(flow);
+                            })
+                      : event_loop_->remove_fd_read(fd);
+        if (res.is_err()) {
+            return res;
+        }
+        flow.reading = want_read;
+    }
+
+    if (want_write != flow.writing) {
+        const int fd = flow.dst->get_fd();
+        Status<None, int> res =
+            want_write ? event_loop_->register_fd_write(
+                             fd,
+                             [this, &flow](uint64_t, Status<int64_t, uint32_t> status) {
+                                 if (status.is_err()) {
+                                     finish(static_cast<int>(status.err()));
+
+                                     return;
+                                 }
+                                 on_writable(flow);
+                             })
+                       : event_loop_->remove_fd_write(fd);
+        if (res.is_err()) {
+            return res;
+        }
+        flow.writing = want_write;
+    }
+
+    return Status<None, int>::make_ok();
+}
+
+void Relay::stop_watching(Flow& flow) {
+    if (flow.reading) {
+        (void)event_loop_->remove_fd_read(flow.src->get_fd());
+        flow.reading = false;
+    }
+    if (flow.writing) {
+        (void)event_loop_->remove_fd_write(flow.dst->get_fd());
+        flow.writing = false;
+    }
+}
+
+void Relay::finish(int err) {
+    if (finished_) {
+        return;
+    }
+    finished_ = true;
+
+    stop_watching(to_upstream_);
+    stop_watching(to_downstream_);
+
+    // The callback may destroy the relay, so it runs from the stack, last.
+    const RelayDoneCb done = std::move(done_);
+    if (done) {
+        done(err);
+    }
+}
+
+ProxyServer::ProxyServer(std::shared_ptr<EventLoop> event_loop,
+                         int port,
+                         std::string upstream_address,
+                         int upstream_port,
+                         RelayMode mode,
+                         size_t pipe_sz)
+    : event_loop_{std::move(event_loop)},
+      port_{port},
+      upstream_address_{std::move(upstream_address)},
+      upstream_port_{upstream_port},
+      mode_{mode},
+      pipes_{pipe_sz, k_max_idle_pipes} {}
+
+ProxyServer::~ProxyServer() {
+    if (accepting_) {
+        (void)event_loop_->remove_fd_read(socket_.get_fd());
+    }
+    for (const auto& [id, conn] : connecting_) {
+        (void)event_loop_->remove_fd_write(conn->upstream.get_fd());
+    }
+    // Relays go before the pipes they hold.
+    relays_.clear();
+}
+
+void ProxyServer::set_reuse_port() {
+    reuse_port_ = true;
+}
+
+void ProxyServer::start() {
+    if (reuse_port_ && socket_.set_reuse_port().is_err()) {
+        return;
+    }
+
+    if (socket_.listen(port_, k_listen_backlog).is_err()) {
+        return;
+    }
+
+    if (socket_.set_non_blocking().is_err()) {
+        return;
+    }
+
+    Status<None, int> res = event_loop_->register_fd_read(
+        socket_.get_fd(), [this](uint64_t, Status<int64_t, uint32_t> status) {
+            if (status.is_err()) {
+                log("notification failure for proxy socket: {}\n", status.err());
+
+                return;
+            }
+
+            // Level-triggered, like `TcpServer`'s listener: the rest of the backlog is reported
+            // again next iteration.
+            const int64_t budget = std::min<int64_t>(status.ok(), k_accept_budget);
+            for (int64_t i = 0; i < budget; ++i) {
+                accept_one();
+            }
+        });
+    accepting_ = res.is_ok();
+}
+
+size_t ProxyServer::active() const {
+    return connecting_.size() + relays_.size();
+}
+
+const RelayStats& ProxyServer::closed_stats() const {
+    return closed_stats_;
+}
+
+void ProxyServer::accept_one() {
+    Status<Socket, int> accepted = socket_.accept();
+    if (accepted.is_err()) {
+        if (accepted.err() != EWOULDBLOCK) {
+            log("accept failure for proxy socket: {}\n", accepted.err());
+        }
+
+        return;
+    }
+
+    auto conn = std::make_unique<Connecting>(Connecting{accepted.ok(), ClientSocket{}});
+    if (conn->upstream.set_non_blocking().is_err() ||
+        conn->upstream.connect_async(upstream_address_, upstream_port_).is_err()) {
+        return;
+    }
+
+    // Writable once the handshake is over, one way or the other.
+    const uint64_t id = next_id_++;
+    Status<None, int> res = event_loop_->register_fd_write(
+        conn->upstream.get_fd(),
+        [this, id](uint64_t, Status<int64_t, uint32_t>) { connected(id); });
+    if (res.is_err()) {
+        return;
+    }
+
+    connecting_.emplace(id, std::move(conn));
+}
+
+void ProxyServer::connected(uint64_t id) {
+    auto it = connecting_.find(id);
+    if (it == connecting_.end()) {
+        return;
+    }
+
+    const std::unique_ptr<Connecting> conn = std::move(it->second);
+    connecting_.erase(it);
+    (void)event_loop_->remove_fd_write(conn->upstream.get_fd());
+
+    if (Status<None, int> res = conn->upstream.pending_error(); res.is_err()) {
+        log("failed to connect to upstream: {}\n", res.err());
+
+        return;
+    }
+
+    // Segments are forwarded as they arrive; holding back a partial one for the peer's ack would
+    // stall on its delayed ack.
+    SocketOptions options;
+    options.no_delay = true;
+    (void)conn->downstream.apply(options);
+    (void)conn->upstream.apply(options);
+
+    auto relay = std::make_unique<Relay>(event_loop_,
+                                         std::move(conn->downstream),
+                                         std::move(conn->upstream),
+                                         mode_,
+                                         &pipes_,
+                                         [this, id](int err) {
+                                             if (err != 0) {
+                                                 log("relay failure: {}\n", err);
+                                             }
+
+                                             auto it = relays_.find(id);
+                                             const RelayStats& stats = it->second->stats();
+                                             closed_stats_.upstream_bytes += stats.upstream_bytes;
+                                             closed_stats_.downstream_bytes +=
+                                                 stats.downstream_bytes;
+                                             relays_.erase(it);
+                                         });
+    if (relay->start().is_err()) {
+        return;
+    }
+
+    relays_.emplace(id, std::move(relay));
+}
+
+} // namespace axle
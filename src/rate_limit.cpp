@@ -0,0 +1,43 @@
+#include "axle/rate_limit.h"
+
+#include <cstdint>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr double k_ns_per_s = 1e9;
+
+} // namespace
+
+namespace axle {
+
+double TokenBucket::refill(const Rate& rate, uint64_t now_ns) {
+    if (!filled_) {
+        tokens_ = rate.burst;
+        last_ns_ = now_ns;
+        filled_ = true;
+    } else if (now_ns > last_ns_) {
+        const double accrued =
+            static_cast<double>(now_ns - last_ns_) * rate.per_second / k_ns_per_s;
+        tokens_ = std::min(rate.burst, tokens_ + accrued);
+        last_ns_ = now_ns;
+    }
+
+    return tokens_;
+}
+
+void TokenBucket::take(double cnt) {
+    tokens_ -= cnt;
+}
+
+uint64_t TokenBucket::wait_ns(const Rate& rate, double cnt) const {
+    if (tokens_ >= cnt) {
+        return 0;
+    }
+
+    return static_cast<uint64_t>(std::ceil((cnt - tokens_) * k_ns_per_s / rate.per_second));
+}
+
+} // namespace axle
@@ -0,0 +1,448 @@
+#include "axle/sim.h"
+
+#include <sys/event.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "axle/status.h"
+
+namespace {
+
+// The first fd handed out, past the standard streams.
+constexpr int k_first_fd = 3;
+
+constexpr uint64_t k_ns_per_us = 1000;
+constexpr uint64_t k_ns_per_ms = 1000 * k_ns_per_us;
+constexpr uint64_t k_ns_per_s = 1000 * k_ns_per_ms;
+
+uint64_t to_ns(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+// A timer's period in nanoseconds, from the units its flags give it. Milliseconds by default.
+uint64_t timer_ns(uint32_t fflags, int64_t data) {
+    const auto val = static_cast<uint64_t>(std::max<int64_t>(data, 0));
+    if ((fflags & NOTE_NSECONDS) != 0) {
+        return val;
+    }
+    if ((fflags & NOTE_USECONDS) != 0) {
+        return val * k_ns_per_us;
+    }
+    if ((fflags & NOTE_SECONDS) != 0) {
+        return val * k_ns_per_s;
+    }
+
+    return val * k_ns_per_ms;
+}
+
+size_t limit(size_t len, size_t max) {
+    return max == 0 ? len : std::min(len, max);
+}
+
+} // namespace
+
+namespace axle {
+
+SimBackend::SimBackend(std::chrono::steady_clock::time_point start)
+    : now_ns_{to_ns(start)},
+      next_fd_{k_first_fd} {}
+
+int SimBackend::kevent(const struct kevent* changes,
+                       int nchanges,
+                       struct kevent* events,
+                       int nevents,
+                       const struct timespec* timeout) {
+    std::unique_lock<std::mutex> lock{mu_};
+    for (const struct kevent& change : std::span{changes, static_cast<size_t>(nchanges)}) {
+        const int err = apply(change);
+        if (err != 0) {
+            errno = err;
+
+            return -1;
+        }
+    }
+
+    if (nevents == 0) {
+        return 0;
+    }
+    ++stats_.polls;
+
+    std::optional<uint64_t> until;
+    if (timeout != nullptr) {
+        until = now_ns_ + (static_cast<uint64_t>(timeout->tv_sec) * k_ns_per_s) +
+                static_cast<uint64_t>(timeout->tv_nsec);
+    }
+
+    while (true) {
+        const int cnt = collect(events, nevents);
+        if (cnt > 0 || (until.has_value() && *until <= now_ns_)) {
+            return cnt;
+        }
+
+        // Nothing is ready, so time passes until something will be.
+        std::optional<uint64_t> next = next_change_ns();
+        if (until.has_value() && (!next.has_value() || *next > *until)) {
+            next = until;
+        }
+        if (next.has_value()) {
+            ++stats_.skips;
+            stats_.skipped += std::chrono::nanoseconds{*next - now_ns_};
+            now_ns_ = *next;
+            continue;
+        }
+
+        // Only another thread can change anything now.
+        wake_.wait(lock);
+    }
+}
+
+std::chrono::steady_clock::time_point SimBackend::now() const {
+    const std::lock_guard<std::mutex> lock{mu_};
+
+    return std::chrono::steady_clock::time_point{std::chrono::nanoseconds{now_ns_}};
+}
+
+void SimBackend::advance(std::chrono::nanoseconds time) {
+    const std::lock_guard<std::mutex> lock{mu_};
+    now_ns_ += static_cast<uint64_t>(std::max<int64_t>(time.count(), 0));
+}
+
+std::array<int, 2> SimBackend::socket_pair(const SimLinkConfig& config) {
+    return socket_pair(config, config);
+}
+
+std::array<int, 2> SimBackend::socket_pair(const SimLinkConfig& out, const SimLinkConfig& in) {
+    const std::lock_guard<std::mutex> lock{mu_};
+    const size_t first = links_.size();
+    links_.resize(first + 2);
+    links_[first].config = out;
+    links_[first + 1].config = in;
+
+    const std::array<int, 2> fds{allocate_fd(), allocate_fd()};
+    endpoints_[fds[0]] = Endpoint{first + 1, first};
+    endpoints_[fds[1]] = Endpoint{first, first + 1};
+
+    return fds;
+}
+
+Status<size_t, int> SimBackend::read(int fd, std::span<uint8_t> buf) {
+    const std::lock_guard<std::mutex> lock{mu_};
+    Endpoint* end = endpoint(fd);
+    if (end == nullptr) {
+        return Status<size_t, int>::make_err(EBADF);
+    }
+    if (end->eagain_reads > 0) {
+        --end->eagain_reads;
+
+        return Status<size_t, int>::make_err(EAGAIN);
+    }
+
+    Link& link = links_[end->in];
+    buf = buf.first(limit(buf.size(), link.config.max_read));
+    size_t len = 0;
+    while (len < buf.size() && !link.segments.empty() &&
+           link.segments.front().arrives_ns <= now_ns_) {
+        Segment& segment = link.segments.front();
+        const size_t cnt = std::min(buf.size() - len, segment.bytes.size() - segment.read);
+        std::copy_n(segment.bytes.begin() + static_cast<ptrdiff_t>(segment.read),
+                    cnt,
+                    buf.begin() + static_cast<ptrdiff_t>(len));
+        segment.read += cnt;
+        len += cnt;
+        if (segment.read == segment.bytes.size()) {
+            link.segments.pop_front();
+        }
+    }
+    link.unread -= len;
+
+    if (len == 0 && !buf.empty() && !eof_arrived(link)) {
+        return Status<size_t, int>::make_err(EAGAIN);
+    }
+
+    return Status<size_t, int>::make_ok(len);
+}
+
+Status<size_t, int> SimBackend::write(int fd, std::span<const uint8_t> buf) {
+    const std::lock_guard<std::mutex> lock{mu_};
+    Endpoint* end = endpoint(fd);
+    if (end == nullptr) {
+        return Status<size_t, int>::make_err(EBADF);
+    }
+
+    Link& link = links_[end->out];
+    if (link.eof_ns.has_value() || link.reader_closed) {
+        return Status<size_t, int>::make_err(EPIPE);
+    }
+    if (end->eagain_writes > 0) {
+        --end->eagain_writes;
+
+        return Status<size_t, int>::make_err(EAGAIN);
+    }
+
+    const size_t room = link.config.capacity - std::min(link.unread, link.config.capacity);
+    const size_t len = limit(std::min(buf.size(), room), link.config.max_write);
+    if (len == 0 && !buf.empty()) {
+        return Status<size_t, int>::make_err(EAGAIN);
+    }
+
+    // Bytes written at the same instant arrive together.
+    const std::span<const uint8_t> sent = buf.first(len);
+    const uint64_t arrives = now_ns_ + static_cast<uint64_t>(link.config.latency.count());
+    if (!link.segments.empty() && link.segments.back().arrives_ns == arrives) {
+        std::vector<uint8_t>& bytes = link.segments.back().bytes;
+        bytes.insert(bytes.end(), sent.begin(), sent.end());
+    } else if (len > 0) {
+        link.segments.push_back(Segment{arrives, {sent.begin(), sent.end()}});
+    }
+    link.unread += len;
+    wake_.notify_all();
+
+    return Status<size_t, int>::make_ok(len);
+}
+
+Status<None, int> SimBackend::shutdown_write(int fd) {
+    const std::lock_guard<std::mutex> lock{mu_};
+    Endpoint* end = endpoint(fd);
+    if (end == nullptr) {
+        return Status<None, int>::make_err(EBADF);
+    }
+
+    Link& link = links_[end->out];
+    if (!link.eof_ns.has_value()) {
+        link.eof_ns = now_ns_ + static_cast<uint64_t>(link.config.latency.count());
+    }
+    wake_.notify_all();
+
+    return Status<None, int>::make_ok();
+}
+
+Status<None, int> SimBackend::close(int fd) {
+    const std::lock_guard<std::mutex> lock{mu_};
+    Endpoint* end = endpoint(fd);
+    if (end == nullptr) {
+        return Status<None, int>::make_err(EBADF);
+    }
+
+    Link& out = links_[end->out];
+    if (!out.eof_ns.has_value()) {
+        out.eof_ns = now_ns_ + static_cast<uint64_t>(out.config.latency.count());
+    }
+    Link& in = links_[end->in];
+    in.reader_closed = true;
+    in.segments.clear();
+    in.unread = 0;
+
+    // As with the kernel, closing an fd drops its filters.
+    const auto ident = static_cast<uintptr_t>(fd);
+    filters_.erase({EVFILT_READ, ident});
+    filters_.erase({EVFILT_WRITE, ident});
+    endpoints_.erase(fd);
+    free_fds_.insert(fd);
+    wake_.notify_all();
+
+    return Status<None, int>::make_ok();
+}
+
+void SimBackend::fail_with_eagain(int fd, size_t reads, size_t writes) {
+    const std::lock_guard<std::mutex> lock{mu_};
+    if (Endpoint* end = endpoint(fd); end != nullptr) {
+        end->eagain_reads = reads;
+        end->eagain_writes = writes;
+    }
+}
+
+size_t SimBackend::unread(int fd) const {
+    const std::lock_guard<std::mutex> lock{mu_};
+    const auto it = endpoints_.find(fd);
+
+    return it == endpoints_.end() ? 0 : links_[it->second.out].unread;
+}
+
+SimStats SimBackend::stats() const {
+    const std::lock_guard<std::mutex> lock{mu_};
+
+    return stats_;
+}
+
+int SimBackend::apply(const struct kevent& change) {
+    const std::pair<int16_t, uintptr_t> key{change.filter, change.ident};
+    if ((change.flags & EV_DELETE) != 0) {
+        return filters_.erase(key) == 1 ? 0 : ENOENT;
+    }
+
+    if ((change.flags & EV_ADD) == 0) {
+        // Triggering a user event is the only other change the loop makes.
+        const auto it = filters_.find(key);
+        if (it == filters_.end()) {
+            return ENOENT;
+        }
+        if (change.filter == EVFILT_USER && (change.fflags & NOTE_TRIGGER) != 0) {
+            it->second.triggered = true;
+            wake_.notify_all();
+        }
+
+        return 0;
+    }
+
+    Filter filter{change.flags, change.fflags, change.udata};
+    switch (change.filter) {
+    case EVFILT_READ:
+    case EVFILT_WRITE:
+        if (endpoint(static_cast<int>(change.ident)) == nullptr) {
+            return EBADF;
+        }
+        break;
+    case EVFILT_TIMER: {
+        const uint64_t period = std::max<uint64_t>(timer_ns(change.fflags, change.data), 1);
+        filter.deadline_ns = now_ns_ + period;
+        filter.period_ns = (change.flags & EV_ONESHOT) != 0 ? 0 : period;
+        break;
+    }
+    case EVFILT_USER:
+        filter.triggered = (change.fflags & NOTE_TRIGGER) != 0;
+        break;
+    default:
+        return EINVAL;
+    }
+    filters_[key] = filter;
+
+    return 0;
+}
+
+int SimBackend::collect(struct kevent* events, int nevents) {
+    const std::span<struct kevent> out{events, static_cast<size_t>(nevents)};
+    size_t cnt = 0;
+    for (auto it = filters_.begin(); it != filters_.end() && cnt < out.size();) {
+        const auto [filter_type, ident] = it->first;
+        Filter& filter = it->second;
+        uint16_t flags = 0;
+        int64_t data = 0;
+        bool ready = false;
+        bool drop = false;
+
+        switch (filter_type) {
+        case EVFILT_USER:
+            ready = filter.triggered;
+            if ((filter.flags & EV_CLEAR) != 0) {
+                filter.triggered = false;
+            }
+            break;
+        case EVFILT_TIMER:
+            ready = filter.deadline_ns <= now_ns_;
+            if (!ready) {
+                break;
+            }
+            if (filter.period_ns == 0) {
+                data = 1;
+                drop = true;
+            } else {
+                const uint64_t late = now_ns_ - filter.deadline_ns;
+                const uint64_t expirations = 1 + (late / filter.period_ns);
+                filter.deadline_ns += expirations * filter.period_ns;
+                data = static_cast<int64_t>(expirations);
+            }
+            break;
+        case EVFILT_READ: {
+            const Link& link = links_[endpoints_.at(static_cast<int>(ident)).in];
+            data = static_cast<int64_t>(arrived(link));
+            const bool eof = eof_arrived(link);
+            ready = data > 0 || eof;
+            flags = eof ? EV_EOF : 0;
+            break;
+        }
+        case EVFILT_WRITE: {
+            const Link& link = links_[endpoints_.at(static_cast<int>(ident)).out];
+            const bool eof = link.reader_closed;
+            data = static_cast<int64_t>(link.config.capacity -
+                                        std::min(link.unread, link.config.capacity));
+            ready = data > 0 || eof;
+            flags = eof ? EV_EOF : 0;
+            break;
+        }
+        default:
+            break;
+        }
+
+        if (ready) {
+            EV_SET(&out[cnt], ident, filter_type, filter.flags | flags, filter.fflags, data,
+                   filter.udata);
+            ++cnt;
+        }
+        it = drop ? filters_.erase(it) : std::next(it);
+    }
+
+    return static_cast<int>(cnt);
+}
+
+std::optional<uint64_t> SimBackend::next_change_ns() const {
+    std::optional<uint64_t> next;
+    const auto consider = [&](uint64_t at) {
+        if (at > now_ns_ && (!next.has_value() || at < *next)) {
+            next = at;
+        }
+    };
+
+    for (const auto& [key, filter] : filters_) {
+        if (key.first == EVFILT_TIMER) {
+            consider(filter.deadline_ns);
+        } else if (key.first == EVFILT_READ) {
+            const Link& link = links_[endpoints_.at(static_cast<int>(key.second)).in];
+            if (!link.segments.empty()) {
+                consider(link.segments.front().arrives_ns);
+            }
+            if (link.eof_ns.has_value()) {
+                consider(*link.eof_ns);
+            }
+        }
+    }
+
+    return next;
+}
+
+int SimBackend::allocate_fd() {
+    if (free_fds_.empty()) {
+        return next_fd_++;
+    }
+
+    const int fd = *free_fds_.begin();
+    free_fds_.erase(free_fds_.begin());
+
+    return fd;
+}
+
+SimBackend::Endpoint* SimBackend::endpoint(int fd) {
+    const auto it = endpoints_.find(fd);
+
+    return it == endpoints_.end() ? nullptr : &it->second;
+}
+
+size_t SimBackend::arrived(const Link& link) const {
+    size_t len = 0;
+    for (const Segment& segment : link.segments) {
+        if (segment.arrives_ns > now_ns_) {
+            break;
+        }
+        len += segment.bytes.size() - segment.read;
+    }
+
+    return len;
+}
+
+bool SimBackend::eof_arrived(const Link& link) const {
+    return link.eof_ns.has_value() && *link.eof_ns <= now_ns_;
+}
+
+} // namespace axle
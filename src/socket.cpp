@@ -4,13 +4,18 @@
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <sys/types.h> // IWYU pragma: keep -- for ssize_t
+#include <sys/uio.h>
 
 #include <cerrno>
+#include <cstddef>
 #include <cstdint>
 #include <cstdio>
 
+#include <array>
+#include <optional>
 #include <span>
 #include <stdexcept>
 #include <string>
@@ -34,10 +39,125 @@ struct sockaddr* endpoint_to_sockaddr(const std::string& address,
     return reinterpret_cast<struct sockaddr*>(&addr_in);
 }
 
+#if defined(MSG_MORE)
+constexpr int k_msg_more = MSG_MORE;
+#else
+constexpr int k_msg_more = 0;
+#endif
+
+// A peer that has gone away fails the write with `EPIPE` instead of raising SIGPIPE.
+#if defined(MSG_NOSIGNAL)
+constexpr int k_msg_nosignal = MSG_NOSIGNAL;
+#else
+constexpr int k_msg_nosignal = 0;
+#endif
+
+#if defined(TCP_CORK)
+constexpr int k_tcp_cork = TCP_CORK;
+#elif defined(TCP_NOPUSH)
+constexpr int k_tcp_cork = TCP_NOPUSH;
+#else
+constexpr int k_tcp_cork = -1;
+#endif
+
+#if defined(TCP_QUICKACK)
+constexpr int k_tcp_quickack = TCP_QUICKACK;
+#else
+constexpr int k_tcp_quickack = -1;
+#endif
+
+#if defined(TCP_NOTSENT_LOWAT)
+constexpr int k_tcp_notsent_lowat = TCP_NOTSENT_LOWAT;
+#else
+constexpr int k_tcp_notsent_lowat = -1;
+#endif
+
+#if defined(TCP_DEFER_ACCEPT)
+constexpr int k_tcp_defer_accept = TCP_DEFER_ACCEPT;
+#else
+constexpr int k_tcp_defer_accept = -1;
+#endif
+
+#if defined(TCP_FASTOPEN)
+constexpr int k_tcp_fastopen = TCP_FASTOPEN;
+#else
+constexpr int k_tcp_fastopen = -1;
+#endif
+
+constexpr int k_low_latency_lowat = 16 * 1024;
+constexpr int k_defer_accept_s = 1;
+constexpr int k_fast_open_queue = 256;
+constexpr int k_bulk_buf_sz = 4 * 1024 * 1024;
+
+std::optional<int> as_int(std::optional<bool> flag) {
+    if (!flag.has_value()) {
+        return std::nullopt;
+    }
+
+    return *flag ? 1 : 0;
+}
+
+// Sets an int-valued option. `name` is -1 where the platform lacks the option.
+int set_int_option(int fd, int level, int name, int val, const char* what) {
+    if (name == -1) {
+        return ENOPROTOOPT;
+    }
+
+    if (setsockopt(fd, level, name, &val, sizeof(val)) == -1) {
+        perror(what);
+
+        return errno;
+    }
+
+    return 0;
+}
+
 } // namespace
 
 namespace axle {
 
+SocketOptions SocketOptions::low_latency() {
+    SocketOptions options;
+    options.no_delay = true;
+    // Only what the platform supports, so the profile applies cleanly everywhere.
+    if (k_tcp_notsent_lowat != -1) {
+        options.not_sent_lowat = k_low_latency_lowat;
+    }
+    if (k_tcp_quickack != -1) {
+        options.quick_ack = true;
+    }
+    if (k_tcp_defer_accept != -1) {
+        options.defer_accept_s = k_defer_accept_s;
+    }
+    if (k_tcp_fastopen != -1) {
+        options.fast_open_queue = k_fast_open_queue;
+    }
+
+    return options;
+}
+
+SocketOptions SocketOptions::bulk() {
+    SocketOptions options;
+    options.recv_buf = k_bulk_buf_sz;
+    options.send_buf = k_bulk_buf_sz;
+
+    return options;
+}
+
+SocketOptions SocketOptions::per_connection() const {
+    SocketOptions options;
+    options.quick_ack = quick_ack;
+
+    return options;
+}
+
+SocketOptions SocketOptions::inherited() const {
+    SocketOptions options = *this;
+    options.quick_ack.reset();
+
+    return options;
+}
+
 Socket::Socket() : fd_(socket(AF_INET, SOCK_STREAM, 0)) {
     if (fd_ == -1) {
         throw std::runtime_error("failed to create client socket");
@@ -72,10 +192,71 @@ Status<None, int> Socket::set_non_blocking() const {
     return Status<None, int>::make_ok();
 }
 
-Status<None, int> Socket::send_all(std::span<const uint8_t> buf) const {
+Status<None, int> Socket::set_busy_poll(int usec) const {
+#ifdef SO_BUSY_POLL
+    if (setsockopt(fd_, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec)) == -1) {
+        perror("failed to enable busy polling on socket");
+
+        return Status<None, int>::make_err(errno);
+    }
+
+    return Status<None, int>::make_ok();
+#else
+    (void)usec;
+
+    return Status<None, int>::make_err(ENOPROTOOPT);
+#endif
+}
+
+Status<None, int> Socket::apply(const SocketOptions& options) const {
+    struct Option {
+        std::optional<int> val;
+        int level;
+        int name;
+        const char* what;
+    };
+
+    const std::array<Option, 8> all{{
+        {as_int(options.no_delay), IPPROTO_TCP, TCP_NODELAY, "failed to set TCP_NODELAY"},
+        {as_int(options.quick_ack), IPPROTO_TCP, k_tcp_quickack, "failed to set TCP_QUICKACK"},
+        {as_int(options.cork), IPPROTO_TCP, k_tcp_cork, "failed to set TCP_CORK"},
+        {options.recv_buf, SOL_SOCKET, SO_RCVBUF, "failed to set SO_RCVBUF"},
+        {options.send_buf, SOL_SOCKET, SO_SNDBUF, "failed to set SO_SNDBUF"},
+        {options.not_sent_lowat,
+         IPPROTO_TCP,
+         k_tcp_notsent_lowat,
+         "failed to set TCP_NOTSENT_LOWAT"},
+        {options.defer_accept_s,
+         IPPROTO_TCP,
+         k_tcp_defer_accept,
+         "failed to set TCP_DEFER_ACCEPT"},
+        {options.fast_open_queue, IPPROTO_TCP, k_tcp_fastopen, "failed to set TCP_FASTOPEN"},
+    }};
+
+    int first_err = 0;
+    for (const Option& option : all) {
+        if (!option.val.has_value()) {
+            continue;
+        }
+
+        const int err = set_int_option(fd_, option.level, option.name, *option.val, option.what);
+        if (first_err == 0) {
+            first_err = err;
+        }
+    }
+
+    if (first_err != 0) {
+        return Status<None, int>::make_err(first_err);
+    }
+
+    return Status<None, int>::make_ok();
+}
+
+Status<None, int> Socket::send_all(std::span<const uint8_t> buf, bool more) const {
+    const int flags = more ? k_msg_more : 0;
     while (!buf.empty()) {
         // NOLINTNEXTLINE(misc-include-cleaner) -- for ssize_t
-        const ssize_t len = write(fd_, buf.data(), buf.size());
+        const ssize_t len = send(fd_, buf.data(), buf.size(), flags);
         if (len == -1) {
             perror("failed to write to socket");
 
@@ -87,6 +268,24 @@ Status<None, int> Socket::send_all(std::span<const uint8_t> buf) const {
     return Status<None, int>::make_ok();
 }
 
+Status<size_t, int> Socket::send_some(std::span<const struct iovec> bufs) const {
+    struct msghdr msg{};
+    msg.msg_iov = const_cast<struct iovec*>(bufs.data()); // NOLINT(*-const-cast)
+    msg.msg_iovlen = bufs.size();
+
+    const ssize_t len = sendmsg(fd_, &msg, k_msg_nosignal);
+    if (len == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return Status<size_t, int>::make_ok(0);
+        }
+        perror("failed to write to socket");
+
+        return Status<size_t, int>::make_err(errno);
+    }
+
+    return Status<size_t, int>::make_ok(static_cast<size_t>(len));
+}
+
 Status<std::span<uint8_t>, int> Socket::recv_some(std::span<uint8_t> buf_view) const {
     const ssize_t len = read(fd_, buf_view.data(), buf_view.size());
     if (len == -1) {
@@ -98,6 +297,32 @@ Status<std::span<uint8_t>, int> Socket::recv_some(std::span<uint8_t> buf_view) c
     return Status<std::span<uint8_t>, int>::make_ok(buf_view.first(len));
 }
 
+Status<None, int> Socket::shutdown_write() const {
+    if (::shutdown(fd_, SHUT_WR) == -1) {
+        perror("failed to shut down socket for writing");
+
+        return Status<None, int>::make_err(errno);
+    }
+
+    return Status<None, int>::make_ok();
+}
+
+Status<None, int> Socket::pending_error() const {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &err, &len) == -1) {
+        perror("failed to get socket error");
+
+        return Status<None, int>::make_err(errno);
+    }
+
+    if (err != 0) {
+        return Status<None, int>::make_err(err);
+    }
+
+    return Status<None, int>::make_ok();
+}
+
 Status<None, int> Socket::close() {
     const int fd = fd_;
     if (fd != -1 && ::close(fd) == -1) {
@@ -128,6 +353,19 @@ Status<None, int> ClientSocket::connect(const std::string& address, int port) co
     return Status<None, int>::make_ok();
 }
 
+Status<None, int> ClientSocket::connect_async(const std::string& address, int port) const {
+    struct sockaddr_in addr_in{};
+    struct sockaddr* addr = endpoint_to_sockaddr(address, port, addr_in);
+
+    if (::connect(get_fd(), addr, sizeof(*addr)) == -1 && errno != EINPROGRESS) {
+        perror("failed to connect to server");
+
+        return Status<None, int>::make_err(errno);
+    }
+
+    return Status<None, int>::make_ok();
+}
+
 ServerSocket::ServerSocket() {
     int enable = 1;
     if (setsockopt(get_fd(), SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) == -1) {
@@ -135,6 +373,35 @@ ServerSocket::ServerSocket() {
     }
 }
 
+ServerSocket::ServerSocket(int fd) : Socket(fd) {}
+
+Status<None, int> ServerSocket::set_reuse_port() const {
+    int enable = 1;
+    if (setsockopt(get_fd(), SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == -1) {
+        perror("failed to enable port reuse on socket");
+
+        return Status<None, int>::make_err(errno);
+    }
+
+    return Status<None, int>::make_ok();
+}
+
+Status<None, int> ServerSocket::set_incoming_cpu(int cpu) const {
+#ifdef SO_INCOMING_CPU
+    if (setsockopt(get_fd(), SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) == -1) {
+        perror("failed to set incoming cpu on socket");
+
+        return Status<None, int>::make_err(errno);
+    }
+
+    return Status<None, int>::make_ok();
+#else
+    (void)cpu;
+
+    return Status<None, int>::make_err(ENOPROTOOPT);
+#endif
+}
+
 Status<None, int> ServerSocket::listen(int port, int backlog) const {
     struct sockaddr_in addr_in{};
     struct sockaddr* addr = endpoint_to_sockaddr("0.0.0.0", port, addr_in);
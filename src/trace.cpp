@@ -0,0 +1,291 @@
+#include "axle/trace.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <ios>
+#include <iomanip>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr double k_ns_per_us = 1e3;
+constexpr uint32_t k_trace_pid = 1;
+// Arbitrary, but fixed so that packets from one export form a single sequence.
+constexpr uint32_t k_sequence_id = 1;
+constexpr uint64_t k_track_uuid_base = 0xa41e000000000000;
+
+// Field numbers and enum values from Perfetto's protos/perfetto/trace.
+namespace pb {
+
+constexpr uint32_t k_trace_packet = 1;
+
+constexpr uint32_t k_packet_timestamp = 8;
+constexpr uint32_t k_packet_sequence_id = 10;
+constexpr uint32_t k_packet_sequence_flags = 13;
+constexpr uint32_t k_packet_track_event = 11;
+constexpr uint32_t k_packet_track_descriptor = 60;
+
+constexpr uint32_t k_track_uuid = 1;
+constexpr uint32_t k_track_name = 2;
+constexpr uint32_t k_track_thread = 4;
+
+constexpr uint32_t k_thread_pid = 1;
+constexpr uint32_t k_thread_tid = 2;
+constexpr uint32_t k_thread_name = 5;
+
+constexpr uint32_t k_event_annotations = 4;
+constexpr uint32_t k_event_type = 9;
+constexpr uint32_t k_event_track_uuid = 11;
+constexpr uint32_t k_event_name = 23;
+
+constexpr uint32_t k_annotation_uint = 3;
+constexpr uint32_t k_annotation_name = 10;
+
+constexpr uint64_t k_slice_begin = 1;
+constexpr uint64_t k_slice_end = 2;
+constexpr uint64_t k_instant = 3;
+constexpr uint64_t k_incremental_state_cleared = 1;
+
+constexpr uint32_t k_varint = 0;
+constexpr uint32_t k_len = 2;
+constexpr unsigned k_wire_type_bits = 3;
+constexpr unsigned k_varint_bits = 7;
+constexpr uint64_t k_varint_more = 0x80;
+
+void put_varint(std::string& out, uint64_t val) {
+    while (val >= k_varint_more) {
+        out.push_back(static_cast<char>(val | k_varint_more));
+        val >>= k_varint_bits;
+    }
+    out.push_back(static_cast<char>(val));
+}
+
+void put_uint(std::string& out, uint32_t field, uint64_t val) {
+    put_varint(out, (field << k_wire_type_bits) | k_varint);
+    put_varint(out, val);
+}
+
+void put_bytes(std::string& out, uint32_t field, std::string_view bytes) {
+    put_varint(out, (field << k_wire_type_bits) | k_len);
+    put_varint(out, bytes.size());
+    out.append(bytes);
+}
+
+} // namespace pb
+
+// Writes `str` as the inside of a JSON string.
+void put_json_string(std::ostream& out, std::string_view str) {
+    constexpr std::string_view hex = "0123456789abcdef";
+    for (const char c : str) {
+        const auto byte = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (byte < 0x20) {
+            out << "\\u00" << hex[byte >> 4] << hex[byte & 0xf];
+        } else {
+            out << c;
+        }
+    }
+}
+
+bool is_span(axle::TraceKind kind) {
+    return kind <= axle::TraceKind::HOOKS;
+}
+
+const char* arg_name(axle::TraceKind kind) {
+    switch (kind) {
+    case axle::TraceKind::POLL:
+        return "events";
+    case axle::TraceKind::TIMER:
+    case axle::TraceKind::REGISTER_TIMER:
+    case axle::TraceKind::REMOVE_TIMER:
+    case axle::TraceKind::USER:
+        return "id";
+    case axle::TraceKind::DEFERRED:
+        return "callbacks";
+    case axle::TraceKind::HOOKS:
+        return "hooks";
+    default:
+        return "fd";
+    }
+}
+
+std::string perfetto_event(uint64_t track, uint64_t type, const axle::TraceRecord* rec) {
+    std::string event;
+    pb::put_uint(event, pb::k_event_type, type);
+    pb::put_uint(event, pb::k_event_track_uuid, track);
+    if (rec != nullptr) {
+        pb::put_bytes(event, pb::k_event_name, axle::trace_kind_name(rec->kind));
+
+        std::string annotation;
+        pb::put_bytes(annotation, pb::k_annotation_name, arg_name(rec->kind));
+        pb::put_uint(annotation, pb::k_annotation_uint, rec->arg);
+        pb::put_bytes(event, pb::k_event_annotations, annotation);
+    }
+
+    return event;
+}
+
+void put_packet(std::ostream& out, uint64_t timestamp, uint32_t field, const std::string& body) {
+    std::string packet;
+    if (field == pb::k_packet_track_event) {
+        pb::put_uint(packet, pb::k_packet_timestamp, timestamp);
+    } else {
+        pb::put_uint(packet, pb::k_packet_sequence_flags, pb::k_incremental_state_cleared);
+    }
+    pb::put_uint(packet, pb::k_packet_sequence_id, k_sequence_id);
+    pb::put_bytes(packet, field, body);
+
+    std::string framed;
+    pb::put_bytes(framed, pb::k_trace_packet, packet);
+    out.write(framed.data(), static_cast<std::streamsize>(framed.size()));
+}
+
+} // namespace
+
+namespace axle {
+
+TraceBuffer::TraceBuffer(size_t capacity)
+    : ring_(std::bit_ceil(std::max<size_t>(capacity, 1))) {}
+
+uint64_t TraceBuffer::now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void TraceBuffer::record(TraceKind kind, uint64_t arg, uint64_t start_ns, uint64_t end_ns) {
+    ring_[next_++ & (ring_.size() - 1)] = TraceRecord{start_ns, arg, end_ns - start_ns, kind};
+}
+
+void TraceBuffer::instant(TraceKind kind, uint64_t arg) {
+    const uint64_t now = now_ns();
+    record(kind, arg, now, now);
+}
+
+std::vector<TraceRecord> TraceBuffer::records() const {
+    std::vector<TraceRecord> out;
+    const uint64_t first = next_ - std::min<uint64_t>(next_, ring_.size());
+    out.reserve(next_ - first);
+    for (uint64_t i = first; i < next_; ++i) {
+        out.push_back(ring_[i & (ring_.size() - 1)]);
+    }
+
+    return out;
+}
+
+uint64_t TraceBuffer::dropped() const {
+    return next_ - std::min<uint64_t>(next_, ring_.size());
+}
+
+const char* trace_kind_name(TraceKind kind) {
+    switch (kind) {
+    case TraceKind::POLL:
+        return "poll";
+    case TraceKind::READ:
+        return "read";
+    case TraceKind::WRITE:
+        return "write";
+    case TraceKind::TIMER:
+        return "timer";
+    case TraceKind::USER:
+        return "user";
+    case TraceKind::DEFERRED:
+        return "deferred";
+    case TraceKind::HOOKS:
+        return "hooks";
+    case TraceKind::REGISTER_READ:
+        return "register_read";
+    case TraceKind::REGISTER_WRITE:
+        return "register_write";
+    case TraceKind::REGISTER_TIMER:
+        return "register_timer";
+    case TraceKind::REMOVE_READ:
+        return "remove_read";
+    case TraceKind::REMOVE_WRITE:
+        return "remove_write";
+    case TraceKind::REMOVE_TIMER:
+        return "remove_timer";
+    }
+
+    return "unknown";
+}
+
+void write_chrome_trace(std::ostream& out, std::span<const TraceThread> threads) {
+    const std::ios_base::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    // Timestamps are in microseconds; keep the nanoseconds.
+    out << std::fixed << std::setprecision(3);
+
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (const TraceThread& thread : threads) {
+        out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":"
+            << k_trace_pid << ",\"tid\":" << thread.tid << ",\"args\":{\"name\":\"";
+        put_json_string(out, thread.name);
+        out << "\"}}";
+        first = false;
+
+        for (const TraceRecord& rec : thread.records) {
+            out << ",\n{\"name\":\"" << trace_kind_name(rec.kind) << "\",\"pid\":" << k_trace_pid
+                << ",\"tid\":" << thread.tid
+                << ",\"ts\":" << static_cast<double>(rec.start_ns) / k_ns_per_us;
+            if (is_span(rec.kind)) {
+                out << ",\"ph\":\"X\",\"dur\":"
+                    << static_cast<double>(rec.duration_ns) / k_ns_per_us;
+            } else {
+                out << ",\"ph\":\"i\",\"s\":\"t\"";
+            }
+            out << ",\"args\":{\"" << arg_name(rec.kind) << "\":" << rec.arg << "}}";
+        }
+    }
+    out << "\n]}\n";
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void write_perfetto_trace(std::ostream& out, std::span<const TraceThread> threads) {
+    for (const TraceThread& thread : threads) {
+        const uint64_t track = k_track_uuid_base + thread.tid;
+
+        std::string desc;
+        std::string thread_desc;
+        pb::put_uint(thread_desc, pb::k_thread_pid, k_trace_pid);
+        pb::put_uint(thread_desc, pb::k_thread_tid, thread.tid);
+        pb::put_bytes(thread_desc, pb::k_thread_name, thread.name);
+        pb::put_uint(desc, pb::k_track_uuid, track);
+        pb::put_bytes(desc, pb::k_track_name, thread.name);
+        pb::put_bytes(desc, pb::k_track_thread, thread_desc);
+        put_packet(out, 0, pb::k_packet_track_descriptor, desc);
+
+        for (const TraceRecord& rec : thread.records) {
+            if (!is_span(rec.kind)) {
+                put_packet(out,
+                           rec.start_ns,
+                           pb::k_packet_track_event,
+                           perfetto_event(track, pb::k_instant, &rec));
+                continue;
+            }
+
+            put_packet(out,
+                       rec.start_ns,
+                       pb::k_packet_track_event,
+                       perfetto_event(track, pb::k_slice_begin, &rec));
+            put_packet(out,
+                       rec.start_ns + rec.duration_ns,
+                       pb::k_packet_track_event,
+                       perfetto_event(track, pb::k_slice_end, nullptr));
+        }
+    }
+}
+
+} // namespace axle
@@ -0,0 +1,783 @@
+#include "axle/websocket.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "axle/broadcast.h"
+#include "axle/http.h"
+#include "axle/status.h"
+
+namespace {
+
+constexpr uint8_t k_fin_bit = 0x80;
+constexpr uint8_t k_reserved_bits = 0x70;
+constexpr uint8_t k_opcode_bits = 0x0f;
+constexpr uint8_t k_control_bit = 0x08;
+constexpr uint8_t k_mask_bit = 0x80;
+constexpr uint8_t k_len_bits = 0x7f;
+constexpr uint8_t k_len16 = 126;
+constexpr uint8_t k_len64 = 127;
+constexpr size_t k_max_len7 = 125;
+constexpr size_t k_max_len16 = 0xffff;
+constexpr size_t k_max_control_payload = 125;
+constexpr size_t k_byte_bits = 8;
+constexpr uint64_t k_byte_mask = 0xff;
+
+constexpr uint16_t k_close_protocol_error = 1002;
+constexpr uint16_t k_close_too_large = 1009;
+
+// Appended to the client's key before hashing, per RFC 6455.
+constexpr std::string_view k_accept_guid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+// A client's key is 16 random bytes in base64.
+constexpr size_t k_key_len = 24;
+
+constexpr std::string_view k_bad_request =
+    "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+uint64_t read_be(std::span<const uint8_t> buf) {
+    uint64_t val = 0;
+    for (const uint8_t byte : buf) {
+        val = (val << k_byte_bits) | byte;
+    }
+
+    return val;
+}
+
+void write_be(uint64_t val, std::span<uint8_t> out) {
+    for (size_t i = out.size(); i > 0; --i) {
+        out[i - 1] = static_cast<uint8_t>(val & k_byte_mask);
+        val >>= k_byte_bits;
+    }
+}
+
+// NOLINTBEGIN(readability-magic-numbers) -- the word sizes and rotations of SHA-1 and base64
+constexpr size_t k_sha1_block_sz = 64;
+constexpr size_t k_sha1_len_offset = 56;
+constexpr size_t k_sha1_rounds = 80;
+constexpr size_t k_sha1_round_group = 20;
+constexpr uint8_t k_sha1_pad = 0x80;
+constexpr std::array<uint32_t, 5> k_sha1_init{
+    0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+constexpr std::array<uint32_t, 4> k_sha1_round_consts{
+    0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6};
+
+using Sha1Digest = std::array<uint8_t, 20>;
+
+void sha1_block(std::array<uint32_t, 5>& state, std::span<const uint8_t, k_sha1_block_sz> block) {
+    std::array<uint32_t, k_sha1_rounds> words{};
+    for (size_t i = 0; i < 16; ++i) {
+        words.at(i) = static_cast<uint32_t>(read_be(block.subspan(i * 4, 4)));
+    }
+    for (size_t i = 16; i < words.size(); ++i) {
+        words.at(i) = std::rotl(
+            words.at(i - 3) ^ words.at(i - 8) ^ words.at(i - 14) ^ words.at(i - 16), 1);
+    }
+
+    auto [a, b, c, d, e] = state;
+    for (size_t i = 0; i < words.size(); ++i) {
+        uint32_t f = 0;
+        switch (i / k_sha1_round_group) {
+        case 0:
+            f = (b & c) | (~b & d);
+            break;
+        case 2:
+            f = (b & c) | (b & d) | (c & d);
+            break;
+        default:
+            f = b ^ c ^ d;
+            break;
+        }
+
+        const uint32_t temp = std::rotl(a, 5) + f + e +
+                              k_sha1_round_consts.at(i / k_sha1_round_group) + words.at(i);
+        e = d;
+        d = c;
+        c = std::rotl(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+// Only ever hashes a handshake key, so it is written for clarity rather than speed.
+Sha1Digest sha1(std::string_view data) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    std::span<const uint8_t> bytes{reinterpret_cast<const uint8_t*>(data.data()), data.size()};
+    std::array<uint32_t, 5> state = k_sha1_init;
+
+    while (bytes.size() >= k_sha1_block_sz) {
+        sha1_block(state, bytes.first<k_sha1_block_sz>());
+        bytes = bytes.subspan(k_sha1_block_sz);
+    }
+
+    std::array<uint8_t, k_sha1_block_sz> block{};
+    std::copy(bytes.begin(), bytes.end(), block.begin());
+    block.at(bytes.size()) = k_sha1_pad;
+    if (bytes.size() >= k_sha1_len_offset) {
+        sha1_block(state, block);
+        block.fill(0);
+    }
+    write_be(data.size() * k_byte_bits, std::span<uint8_t>{block}.subspan(k_sha1_len_offset));
+    sha1_block(state, block);
+
+    Sha1Digest digest{};
+    for (size_t i = 0; i < state.size(); ++i) {
+        write_be(state.at(i), std::span<uint8_t>{digest}.subspan(i * 4, 4));
+    }
+
+    return digest;
+}
+
+std::string base64(std::span<const uint8_t> data) {
+    constexpr std::string_view k_alphabet =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    constexpr uint32_t k_sextet = 0x3f;
+
+    std::string out;
+    out.reserve((data.size() + 2) / 3 * 4);
+    for (size_t i = 0; i < data.size(); i += 3) {
+        const size_t len = std::min<size_t>(3, data.size() - i);
+        uint32_t group = 0;
+        for (size_t j = 0; j < 3; ++j) {
+            group = (group << k_byte_bits) | (j < len ? data[i + j] : 0);
+        }
+        for (size_t j = 0; j < 4; ++j) {
+            out += j <= len ? k_alphabet[(group >> (18 - (6 * j))) & k_sextet] : '=';
+        }
+    }
+
+    return out;
+}
+// NOLINTEND(readability-magic-numbers)
+
+bool iequals(std::string_view lhs, std::string_view rhs) {
+    constexpr char k_case_bit = 0x20;
+
+    const auto fold = [](char c) {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c | k_case_bit) : c;
+    };
+
+    return lhs.size() == rhs.size() &&
+           std::equal(lhs.begin(), lhs.end(), rhs.begin(), [&](char a, char b) {
+               return fold(a) == fold(b);
+           });
+}
+
+// Whether the comma-separated `value` lists `token`, in any case.
+bool has_token(std::string_view value, std::string_view token) {
+    while (!value.empty()) {
+        const size_t comma = value.find(',');
+        std::string_view item = value.substr(0, comma);
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) {
+            item.remove_prefix(1);
+        }
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) {
+            item.remove_suffix(1);
+        }
+        if (iequals(item, token)) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        value.remove_prefix(comma + 1);
+    }
+
+    return false;
+}
+
+bool is_known_opcode(uint8_t opcode) {
+    switch (static_cast<axle::WsOpcode>(opcode)) {
+    case axle::WsOpcode::CONTINUATION:
+    case axle::WsOpcode::TEXT:
+    case axle::WsOpcode::BINARY:
+    case axle::WsOpcode::CLOSE:
+    case axle::WsOpcode::PING:
+    case axle::WsOpcode::PONG:
+        return true;
+    }
+
+    return false;
+}
+
+// The mask lined up with `offset`, twice over, for XORing eight bytes at a time.
+std::array<uint8_t, 8> mask_pattern(axle::WsMask mask, size_t offset) {
+    std::array<uint8_t, 8> pattern{};
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        pattern.at(i) = mask.at((offset + i) % mask.size());
+    }
+
+    return pattern;
+}
+
+// The unmasking steps below each take whole words from `pos` on and return where they stopped.
+// Every word is a multiple of the mask's length, so the pattern stays lined up for what follows.
+
+// Vectors, where the target has them.
+size_t unmask_vectors(std::span<uint8_t> payload, const std::array<uint8_t, 8>& pattern) {
+    size_t pos = 0;
+#if defined(__AVX2__) || defined(__SSE2__)
+    uint32_t word = 0;
+    std::memcpy(&word, pattern.data(), sizeof(word));
+#endif
+#if defined(__AVX2__)
+    const __m256i mask256 = _mm256_set1_epi32(static_cast<int>(word));
+    while (pos + (2 * sizeof(__m256i)) <= payload.size()) {
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+        auto* lo = reinterpret_cast<__m256i*>(&payload[pos]);
+        auto* hi = reinterpret_cast<__m256i*>(&payload[pos + sizeof(__m256i)]);
+        // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+        _mm256_storeu_si256(lo, _mm256_xor_si256(_mm256_loadu_si256(lo), mask256));
+        _mm256_storeu_si256(hi, _mm256_xor_si256(_mm256_loadu_si256(hi), mask256));
+        pos += 2 * sizeof(__m256i);
+    }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+    const __m128i mask128 = _mm_set1_epi32(static_cast<int>(word));
+    while (pos + sizeof(__m128i) <= payload.size()) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        auto* chunk = reinterpret_cast<__m128i*>(&payload[pos]);
+        _mm_storeu_si128(chunk, _mm_xor_si128(_mm_loadu_si128(chunk), mask128));
+        pos += sizeof(__m128i);
+    }
+#else
+    (void)payload;
+    (void)pattern;
+#endif
+
+    return pos;
+}
+
+size_t unmask_u64(std::span<uint8_t> payload, const std::array<uint8_t, 8>& pattern, size_t pos) {
+    uint64_t word64 = 0;
+    std::memcpy(&word64, pattern.data(), sizeof(word64));
+    while (pos + sizeof(word64) <= payload.size()) {
+        uint64_t chunk = 0;
+        std::memcpy(&chunk, &payload[pos], sizeof(chunk));
+        chunk ^= word64;
+        std::memcpy(&payload[pos], &chunk, sizeof(chunk));
+        pos += sizeof(word64);
+    }
+
+    return pos;
+}
+
+void unmask_bytes(std::span<uint8_t> payload, const std::array<uint8_t, 8>& pattern, size_t pos) {
+    for (; pos < payload.size(); ++pos) {
+        payload[pos] ^= pattern.at(pos % std::tuple_size_v<axle::WsMask>);
+    }
+}
+
+} // namespace
+
+namespace axle {
+
+std::string ws_accept_key(std::string_view key) {
+    std::string input{key};
+    input += k_accept_guid;
+
+    return base64(sha1(input));
+}
+
+Status<None, WsError> ws_accept(const HttpRequest& req, std::string& response) {
+    const std::optional<std::string_view> upgrade = req.header("Upgrade");
+    const std::optional<std::string_view> connection = req.header("Connection");
+    const std::optional<std::string_view> version = req.header("Sec-WebSocket-Version");
+    const std::optional<std::string_view> key = req.header("Sec-WebSocket-Key");
+    if (req.method != "GET" || req.version_minor < 1 || !upgrade ||
+        !has_token(*upgrade, "websocket") || !connection || !has_token(*connection, "upgrade") ||
+        version != "13" || !key || key->size() != k_key_len) {
+        return Status<None, WsError>::make_err(WsError::BAD_HANDSHAKE);
+    }
+
+    response.append("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n");
+    response.append("Connection: Upgrade\r\nSec-WebSocket-Accept: ");
+    response.append(ws_accept_key(*key)).append("\r\n\r\n");
+
+    return Status<None, WsError>::make_ok();
+}
+
+void ws_unmask(std::span<uint8_t> payload, WsMask mask, size_t offset) {
+    const std::array<uint8_t, 8> pattern = mask_pattern(mask, offset);
+    unmask_bytes(payload, pattern, unmask_u64(payload, pattern, unmask_vectors(payload, pattern)));
+}
+
+namespace detail {
+
+void ws_unmask_scalar(std::span<uint8_t> payload, WsMask mask, size_t offset) {
+    const std::array<uint8_t, 8> pattern = mask_pattern(mask, offset);
+    unmask_bytes(payload, pattern, unmask_u64(payload, pattern, 0));
+}
+
+} // namespace detail
+
+size_t ws_encode_header(WsOpcode opcode,
+                        bool fin,
+                        size_t payload_len,
+                        const std::optional<WsMask>& mask,
+                        std::span<uint8_t, k_ws_max_header_sz> out) {
+    out[0] = static_cast<uint8_t>((fin ? k_fin_bit : 0) | static_cast<uint8_t>(opcode));
+    const uint8_t mask_bit = mask ? k_mask_bit : 0;
+
+    size_t len = 2;
+    if (payload_len <= k_max_len7) {
+        out[1] = static_cast<uint8_t>(mask_bit | payload_len);
+    } else if (payload_len <= k_max_len16) {
+        out[1] = mask_bit | k_len16;
+        write_be(payload_len, std::span<uint8_t>{out}.subspan(2, 2));
+        len += 2;
+    } else {
+        out[1] = mask_bit | k_len64;
+        write_be(payload_len, std::span<uint8_t>{out}.subspan(2, sizeof(uint64_t)));
+        len += sizeof(uint64_t);
+    }
+
+    if (mask) {
+        std::copy(mask->begin(), mask->end(), out.begin() + static_cast<ptrdiff_t>(len));
+        len += mask->size();
+    }
+
+    return len;
+}
+
+WsFrameParser::WsFrameParser(size_t max_payload_sz)
+    : max_payload_sz_{max_payload_sz} {}
+
+Status<size_t, WsError> WsFrameParser::parse(std::span<uint8_t> buf) {
+    if (!have_header_) {
+        Status<bool, WsError> res = parse_header(buf);
+        if (res.is_err()) {
+            return Status<size_t, WsError>::make_err(res.err());
+        }
+        if (!res.ok()) {
+            return Status<size_t, WsError>::make_ok(0);
+        }
+        have_header_ = true;
+    }
+
+    const size_t avail = std::min(buf.size() - frame_.header_len, frame_.payload_len);
+    if (avail > unmasked_) {
+        ws_unmask(buf.subspan(frame_.header_len + unmasked_, avail - unmasked_), mask_, unmasked_);
+        unmasked_ = avail;
+    }
+
+    return Status<size_t, WsError>::make_ok(
+        avail == frame_.payload_len ? frame_.header_len + frame_.payload_len : 0);
+}
+
+const WsFrame& WsFrameParser::frame() const {
+    return frame_;
+}
+
+void WsFrameParser::reset() {
+    frame_ = WsFrame{};
+    have_header_ = false;
+    unmasked_ = 0;
+}
+
+Status<bool, WsError> WsFrameParser::parse_header(std::span<const uint8_t> buf) {
+    if (buf.size() < 2) {
+        return Status<bool, WsError>::make_ok(false);
+    }
+
+    if ((buf[0] & k_reserved_bits) != 0) {
+        return Status<bool, WsError>::make_err(WsError::RESERVED_BITS);
+    }
+    const uint8_t opcode = buf[0] & k_opcode_bits;
+    if (!is_known_opcode(opcode)) {
+        return Status<bool, WsError>::make_err(WsError::BAD_OPCODE);
+    }
+    if ((buf[1] & k_mask_bit) == 0) {
+        return Status<bool, WsError>::make_err(WsError::UNMASKED);
+    }
+    const bool fin = (buf[0] & k_fin_bit) != 0;
+
+    size_t len_sz = 0;
+    uint64_t payload_len = buf[1] & k_len_bits;
+    if (payload_len == k_len16) {
+        len_sz = 2;
+    } else if (payload_len == k_len64) {
+        len_sz = sizeof(uint64_t);
+    }
+    const size_t header_len = 2 + len_sz + std::tuple_size_v<WsMask>;
+    if (buf.size() < header_len) {
+        return Status<bool, WsError>::make_ok(false);
+    }
+    if (len_sz != 0) {
+        payload_len = read_be(buf.subspan(2, len_sz));
+        if ((payload_len >> (sizeof(uint64_t) * k_byte_bits - 1)) != 0) {
+            return Status<bool, WsError>::make_err(WsError::BAD_LENGTH);
+        }
+    }
+
+    if ((opcode & k_control_bit) != 0 && (!fin || payload_len > k_max_control_payload)) {
+        return Status<bool, WsError>::make_err(WsError::BAD_CONTROL);
+    }
+    if (payload_len > max_payload_sz_) {
+        return Status<bool, WsError>::make_err(WsError::TOO_LARGE);
+    }
+
+    std::copy_n(buf.begin() + static_cast<ptrdiff_t>(2 + len_sz), mask_.size(), mask_.begin());
+    frame_ = WsFrame{static_cast<WsOpcode>(opcode), fin, header_len, payload_len};
+
+    return Status<bool, WsError>::make_ok(true);
+}
+
+WsConnection::WsConnection(WsConfig config, WsMessageCb cb)
+    : config_{config},
+      cb_{std::move(cb)},
+      buf_(config_.buf_sz),
+      frame_parser_{config_.max_message_sz} {
+    if (config_.buf_sz == 0) {
+        throw std::runtime_error("websocket buffer must not be empty");
+    }
+}
+
+std::span<uint8_t> WsConnection::recv_buf(size_t max_len) {
+    make_room();
+
+    const size_t len = std::min(buf_.size() - tail_, max_len);
+
+    return std::span<uint8_t>{buf_}.subspan(tail_, len);
+}
+
+Status<size_t, WsError> WsConnection::post_recv(std::span<uint8_t> buf) {
+    tail_ += buf.size();
+
+    size_t delivered = 0;
+    std::optional<WsError> error;
+    while (state_ != State::CLOSED && head_ < tail_) {
+        if (state_ == State::HANDSHAKE) {
+            Status<bool, WsError> res = handshake();
+            if (res.is_err()) {
+                error = res.err();
+                break;
+            }
+            if (!res.ok()) {
+                break;
+            }
+            continue;
+        }
+
+        const std::span<uint8_t> data = std::span<uint8_t>{buf_}.subspan(head_, tail_ - head_);
+        Status<size_t, WsError> res = frame_parser_.parse(data);
+        if (res.is_err()) {
+            error = res.err();
+            break;
+        }
+        const WsFrame& frame = frame_parser_.frame();
+        if (res.ok() == 0) {
+            want_ = frame.header_len + frame.payload_len;
+            break;
+        }
+        want_ = 0;
+
+        Status<bool, WsError> handled =
+            handle_frame(data.subspan(frame.header_len, frame.payload_len));
+        head_ += res.ok();
+        frame_parser_.reset();
+        if (handled.is_err()) {
+            error = handled.err();
+            break;
+        }
+        delivered += handled.ok() ? 1 : 0;
+    }
+
+    if (error) {
+        fail(*error);
+    }
+    if (head_ == tail_ || state_ == State::CLOSED) {
+        // Whatever follows the end of the connection is dropped.
+        head_ = 0;
+        tail_ = 0;
+        want_ = 0;
+        if (buf_.size() > config_.buf_sz) {
+            buf_.resize(config_.buf_sz);
+            buf_.shrink_to_fit();
+        }
+    }
+
+    if (error) {
+        return Status<size_t, WsError>::make_err(*error);
+    }
+
+    return Status<size_t, WsError>::make_ok(delivered);
+}
+
+std::span<const uint8_t> WsConnection::send_buf(size_t max_len) const {
+    if (out_.empty()) {
+        return {};
+    }
+
+    const OutFrame& frame = out_.front();
+    if (sent_ < frame.header_len) {
+        return std::span<const uint8_t>{frame.header}.subspan(
+            sent_, std::min<size_t>(frame.header_len - sent_, max_len));
+    }
+
+    const size_t offset = sent_ - frame.header_len;
+
+    return std::span<const uint8_t>{*frame.payload}.subspan(
+        offset, std::min(frame.payload->size() - offset, max_len));
+}
+
+size_t WsConnection::send_bufs(std::span<struct iovec> bufs, size_t max_len) const {
+    size_t cnt = 0;
+    size_t offset = sent_;
+    for (const OutFrame& frame : out_) {
+        if (cnt == bufs.size() || max_len == 0) {
+            break;
+        }
+
+        if (offset < frame.header_len) {
+            const size_t len = std::min<size_t>(frame.header_len - offset, max_len);
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+            bufs[cnt++] = {const_cast<uint8_t*>(frame.header.data() + offset), len};
+            max_len -= len;
+            offset = frame.header_len;
+        }
+
+        const size_t payload_sz = frame.payload == nullptr ? 0 : frame.payload->size();
+        const size_t payload_offset = offset - frame.header_len;
+        if (payload_offset < payload_sz && cnt < bufs.size() && max_len != 0) {
+            const size_t len = std::min(payload_sz - payload_offset, max_len);
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+            bufs[cnt++] = {const_cast<uint8_t*>(frame.payload->data() + payload_offset), len};
+            max_len -= len;
+        }
+        offset = 0;
+    }
+
+    return cnt;
+}
+
+void WsConnection::post_send(int64_t len) {
+    auto left = static_cast<size_t>(len);
+    queued_ -= left;
+    while (left > 0) {
+        const OutFrame& frame = out_.front();
+        const size_t frame_sz =
+            frame.header_len + (frame.payload == nullptr ? 0 : frame.payload->size());
+        if (left < frame_sz - sent_) {
+            sent_ += left;
+
+            return;
+        }
+
+        left -= frame_sz - sent_;
+        sent_ = 0;
+        out_.pop_front();
+    }
+}
+
+bool WsConnection::send(WsOpcode opcode, SharedBuffer payload) {
+    const size_t len = payload == nullptr ? 0 : payload->size();
+    const bool control = (static_cast<uint8_t>(opcode) & k_control_bit) != 0;
+    if (state_ != State::OPEN || opcode == WsOpcode::CONTINUATION || opcode == WsOpcode::CLOSE ||
+        (control && len > k_max_control_payload) ||
+        (queued_ != 0 && queued_ + len > config_.max_queued)) {
+        return false;
+    }
+
+    push(opcode, std::move(payload));
+
+    return true;
+}
+
+void WsConnection::close(uint16_t code) {
+    if (state_ == State::HANDSHAKE) {
+        state_ = State::CLOSED;
+    }
+    if (state_ != State::OPEN) {
+        return;
+    }
+
+    std::array<uint8_t, 2> payload{};
+    write_be(code, payload);
+    push(WsOpcode::CLOSE, make_shared_buffer(payload));
+    state_ = State::CLOSE_SENT;
+}
+
+bool WsConnection::open() const {
+    return state_ == State::OPEN;
+}
+
+bool WsConnection::closing() const {
+    return state_ == State::CLOSED && out_.empty();
+}
+
+size_t WsConnection::queued() const {
+    return queued_;
+}
+
+Status<bool, WsError> WsConnection::handshake() {
+    Status<size_t, HttpError> res = request_parser_.parse(
+        std::span<const uint8_t>{buf_}.subspan(head_, tail_ - head_));
+    if (res.is_err()) {
+        return Status<bool, WsError>::make_err(WsError::BAD_HANDSHAKE);
+    }
+    if (res.ok() == 0) {
+        return Status<bool, WsError>::make_ok(false);
+    }
+
+    const HttpRequest& req = request_parser_.request();
+    std::string response;
+    if (req.content_length != 0 || req.chunked || ws_accept(req, response).is_err()) {
+        return Status<bool, WsError>::make_err(WsError::BAD_HANDSHAKE);
+    }
+
+    push_raw(response);
+    head_ += res.ok();
+    state_ = State::OPEN;
+
+    return Status<bool, WsError>::make_ok(true);
+}
+
+// Returns whether a message went to the callback.
+Status<bool, WsError> WsConnection::handle_frame(std::span<uint8_t> payload) {
+    const WsFrame& frame = frame_parser_.frame();
+    switch (frame.opcode) {
+    case WsOpcode::PING:
+        if (state_ == State::OPEN) {
+            push(WsOpcode::PONG, make_shared_buffer(payload));
+        }
+
+        return Status<bool, WsError>::make_ok(false);
+
+    case WsOpcode::PONG:
+        return Status<bool, WsError>::make_ok(false);
+
+    case WsOpcode::CLOSE:
+        if (payload.size() == 1) {
+            return Status<bool, WsError>::make_err(WsError::BAD_CONTROL);
+        }
+        // Echo the peer's status code, which completes the closing handshake.
+        if (state_ == State::OPEN) {
+            const size_t code_len = std::min<size_t>(payload.size(), 2);
+            push(WsOpcode::CLOSE, make_shared_buffer(payload.first(code_len)));
+        }
+        state_ = State::CLOSED;
+
+        return Status<bool, WsError>::make_ok(false);
+
+    case WsOpcode::TEXT:
+    case WsOpcode::BINARY:
+        if (message_opcode_) {
+            return Status<bool, WsError>::make_err(WsError::BAD_CONTINUATION);
+        }
+        if (!frame.fin) {
+            message_opcode_ = frame.opcode;
+            message_.assign(payload.begin(), payload.end());
+
+            return Status<bool, WsError>::make_ok(false);
+        }
+        break;
+
+    case WsOpcode::CONTINUATION: {
+        if (!message_opcode_) {
+            return Status<bool, WsError>::make_err(WsError::BAD_CONTINUATION);
+        }
+        if (message_.size() + payload.size() > config_.max_message_sz) {
+            return Status<bool, WsError>::make_err(WsError::TOO_LARGE);
+        }
+        message_.insert(message_.end(), payload.begin(), payload.end());
+        if (!frame.fin) {
+            return Status<bool, WsError>::make_ok(false);
+        }
+
+        const WsOpcode opcode = *message_opcode_;
+        message_opcode_.reset();
+        // Once a close frame has gone out, what the peer still sends is dropped.
+        if (state_ == State::OPEN) {
+            cb_(opcode, message_);
+        }
+        message_.clear();
+
+        return Status<bool, WsError>::make_ok(state_ == State::OPEN);
+    }
+    }
+
+    if (state_ == State::OPEN) {
+        cb_(frame.opcode, payload);
+    }
+
+    return Status<bool, WsError>::make_ok(state_ == State::OPEN);
+}
+
+void WsConnection::fail(WsError error) {
+    if (state_ == State::HANDSHAKE) {
+        push_raw(k_bad_request);
+    } else if (state_ == State::OPEN) {
+        std::array<uint8_t, 2> payload{};
+        write_be(error == WsError::TOO_LARGE ? k_close_too_large : k_close_protocol_error,
+                 payload);
+        push(WsOpcode::CLOSE, make_shared_buffer(payload));
+    }
+    state_ = State::CLOSED;
+}
+
+void WsConnection::push(WsOpcode opcode, SharedBuffer payload) {
+    OutFrame frame{};
+    const size_t len = payload == nullptr ? 0 : payload->size();
+    frame.header_len = static_cast<uint8_t>(
+        ws_encode_header(opcode, true, len, std::nullopt, frame.header));
+    frame.payload = std::move(payload);
+    queued_ += frame.header_len + len;
+    out_.push_back(std::move(frame));
+}
+
+void WsConnection::push_raw(std::string_view bytes) {
+    OutFrame frame{};
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    frame.payload =
+        make_shared_buffer({reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size()});
+    queued_ += bytes.size();
+    out_.push_back(std::move(frame));
+}
+
+// Like `Framer`: a partial frame straddling the end of the buffer is moved to the front, and the
+// buffer grows up to the largest frame accepted if it still does not fit.
+void WsConnection::make_room() {
+    const size_t len = tail_ - head_;
+    const size_t need = std::max(want_, len + 1);
+    if (head_ + need <= buf_.size()) {
+        return;
+    }
+
+    const size_t cap = k_ws_max_header_sz + config_.max_message_sz;
+    if (need > buf_.size()) {
+        buf_.resize(std::min(std::max(need, 2 * buf_.size()), std::max(cap, buf_.size())));
+    }
+
+    if (head_ != 0) {
+        std::copy(buf_.begin() + head_, buf_.begin() + tail_, buf_.begin());
+        head_ = 0;
+        tail_ = len;
+    }
+}
+
+} // namespace axle
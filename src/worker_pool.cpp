@@ -0,0 +1,192 @@
+#include "axle/worker_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "axle/event.h"
+
+namespace {
+
+// Lets tasks that submit more work push onto their own worker's deque.
+thread_local const axle::WorkerPool* t_pool = nullptr;
+thread_local size_t t_worker = 0;
+
+} // namespace
+
+namespace axle {
+
+WorkerPool::WorkerPool(size_t threads) {
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+
+    threads_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        threads_.emplace_back([this, i] { run_worker(i); });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        const std::lock_guard<std::mutex> lock{sleep_mu_};
+        stop_ = true;
+    }
+    wake_.notify_all();
+
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+void WorkerPool::submit(WorkerTask task) {
+    const size_t idx = t_pool == this ? t_worker
+                                      : next_worker_.fetch_add(1, std::memory_order_relaxed) %
+                                            workers_.size();
+    {
+        Worker& worker = *workers_[idx];
+        const std::lock_guard<std::mutex> lock{worker.mu};
+        worker.tasks.push_back(std::move(task));
+    }
+    queued_.fetch_add(1);
+
+    // Taking the lock orders this wakeup after a sleeping worker's check of `queued_`.
+    {
+        const std::lock_guard<std::mutex> lock{sleep_mu_};
+    }
+    wake_.notify_one();
+}
+
+size_t WorkerPool::size() const {
+    return workers_.size();
+}
+
+bool WorkerPool::take(size_t idx, WorkerTask& task) {
+    {
+        Worker& own = *workers_[idx];
+        const std::lock_guard<std::mutex> lock{own.mu};
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < workers_.size(); ++i) {
+        Worker& victim = *workers_[(idx + i) % workers_.size()];
+        const std::lock_guard<std::mutex> lock{victim.mu};
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkerPool::run_worker(size_t idx) {
+    t_pool = this;
+    t_worker = idx;
+
+    WorkerTask task;
+    for (;;) {
+        if (take(idx, task)) {
+            queued_.fetch_sub(1);
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock{sleep_mu_};
+        wake_.wait(lock, [this] { return stop_ || queued_.load() > 0; });
+        if (stop_ && queued_.load() == 0) {
+            return;
+        }
+    }
+}
+
+WorkQueue::WorkQueue(WorkerPool& pool, std::shared_ptr<EventLoop> loop)
+    : pool_{pool},
+      loop_{std::move(loop)},
+      state_{std::make_shared<State>()} {}
+
+WorkQueue::~WorkQueue() {
+    cancel();
+}
+
+void WorkQueue::submit(std::function<PostedCb()> work) {
+    const uint64_t seq = state_->next_seq++;
+
+    pool_.submit([state = state_, loop = loop_, seq, work = std::move(work)] {
+        if (state->cancelled.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        PostedCb done = work();
+        (void)loop->post([state, seq, done = std::move(done)]() mutable {
+            complete(state, seq, std::move(done));
+        });
+    });
+}
+
+void WorkQueue::then(PostedCb cb) {
+    if (state_->cancelled.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    if (pending() == 0) {
+        cb();
+
+        return;
+    }
+
+    const uint64_t seq = state_->next_seq++;
+    state_->ready.emplace(seq, std::move(cb));
+}
+
+void WorkQueue::cancel() {
+    state_->cancelled.store(true, std::memory_order_relaxed);
+    state_->ready.clear();
+    state_->deliver_seq = state_->next_seq;
+}
+
+size_t WorkQueue::pending() const {
+    return state_->next_seq - state_->deliver_seq;
+}
+
+void WorkQueue::complete(const std::shared_ptr<State>& state, uint64_t seq, PostedCb cb) {
+    if (state->cancelled.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    state->ready.emplace(seq, std::move(cb));
+    while (!state->ready.empty() && state->ready.begin()->first == state->deliver_seq) {
+        const PostedCb next = std::move(state->ready.begin()->second);
+        state->ready.erase(state->ready.begin());
+        ++state->deliver_seq;
+
+        if (next) {
+            next();
+        }
+        // The completion may have closed the connection and destroyed the queue.
+        if (state->cancelled.load(std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+} // namespace axle
@@ -0,0 +1,242 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "axle/broadcast.h"
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <memory>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "axle/event.h"
+#include "axle/socket.h"
+#include "axle/status.h"
+#include "axle/tcp.h"
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+namespace {
+
+class FeedSession {
+  public:
+    explicit FeedSession(size_t max_queued)
+        : queue_{max_queued} {}
+
+    SendQueue& send_queue() {
+        return queue_;
+    }
+
+    std::span<uint8_t> recv_buf(size_t max_len) {
+        return std::span<uint8_t>{discard_}.first(std::min(discard_.size(), max_len));
+    }
+
+    void post_recv(std::span<uint8_t>) {}
+
+    std::span<const uint8_t> send_buf(size_t max_len) {
+        return queue_.front(max_len);
+    }
+
+    size_t send_bufs(std::span<struct iovec> bufs, size_t max_len) {
+        return queue_.gather(bufs, max_len);
+    }
+
+    void post_send(int64_t len) {
+        queue_.consume(len);
+    }
+
+    void end() {}
+
+  private:
+    SendQueue queue_;
+    std::array<uint8_t, 64> discard_{};
+};
+
+// Broadcasts once `subscribers` connections are open.
+class FeedServer : public TcpServer<FeedSession> {
+  public:
+    FeedServer(const std::shared_ptr<EventLoop>& event_loop,
+               int port,
+               size_t subscribers,
+               size_t max_queued,
+               std::function<void()> on_ready)
+        : TcpServer(event_loop, port),
+          event_loop_{event_loop},
+          subscribers_{subscribers},
+          max_queued_{max_queued},
+          on_ready_{std::move(on_ready)} {
+        set_write_coalescing();
+    }
+
+    std::shared_ptr<FeedSession> handle_connection() override {
+        if (++accepted_ == subscribers_) {
+            event_loop_->defer(on_ready_);
+        }
+
+        return std::make_shared<FeedSession>(max_queued_);
+    }
+
+  private:
+    std::shared_ptr<EventLoop> event_loop_;
+    size_t subscribers_;
+    size_t max_queued_;
+    std::function<void()> on_ready_;
+    size_t accepted_ = 0;
+};
+
+std::vector<uint8_t> pattern(size_t len, uint8_t seed) {
+    std::vector<uint8_t> data(len);
+    for (size_t i = 0; i < len; ++i) {
+        data[i] = static_cast<uint8_t>(seed + i);
+    }
+
+    return data;
+}
+
+} // namespace
+
+TEST(BroadcastTest, SendQueue) {
+    SendQueue queue{100};
+    const SharedBuffer first = make_shared_buffer(pattern(60, 0));
+    const SharedBuffer second = make_shared_buffer(pattern(30, 100));
+
+    ASSERT_TRUE(queue.push(first));
+    ASSERT_TRUE(queue.push(second));
+    ASSERT_FALSE(queue.push(first));
+    ASSERT_EQ(90, queue.size());
+    // The refused push did not keep a reference.
+    ASSERT_EQ(2, first.use_count());
+
+    std::array<struct iovec, 4> bufs{};
+    ASSERT_EQ(2, queue.gather(bufs, 70));
+    ASSERT_EQ(first->data(), bufs[0].iov_base);
+    ASSERT_EQ(60, bufs[0].iov_len);
+    ASSERT_EQ(second->data(), bufs[1].iov_base);
+    ASSERT_EQ(10, bufs[1].iov_len);
+
+    // Sending past the end of the first buffer lets go of it.
+    queue.consume(70);
+    ASSERT_EQ(1, first.use_count());
+    ASSERT_EQ(20, queue.size());
+    ASSERT_EQ(second->data() + 10, queue.front(100).data());
+    ASSERT_EQ(20, queue.front(100).size());
+
+    queue.consume(20);
+    ASSERT_TRUE(queue.empty());
+    ASSERT_EQ(1, second.use_count());
+
+    // An empty queue takes a buffer of any size.
+    ASSERT_TRUE(queue.push(make_shared_buffer(pattern(200, 0))));
+}
+
+TEST(BroadcastTest, Fanout) {
+    constexpr int port = 8092;
+    constexpr size_t subscribers = 3;
+    constexpr size_t payload_sz = 256 * 1024;
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    const std::vector<uint8_t> data = pattern(payload_sz, 7);
+    SharedBuffer payload = make_shared_buffer(data);
+    size_t queued = 0;
+
+    std::unique_ptr<FeedServer> server;
+    server = std::make_unique<FeedServer>(loop, port, subscribers, payload_sz, [&] {
+        queued = server->broadcast(payload);
+        // Held by the test and by every queue it has not been sent from in full.
+        EXPECT_LE(payload.use_count(), subscribers + 1);
+    });
+    server->start();
+
+    std::thread client_thread{[&] {
+        std::vector<std::unique_ptr<ClientSocket>> clients;
+        for (size_t i = 0; i < subscribers; ++i) {
+            clients.push_back(std::make_unique<ClientSocket>());
+            ASSERT_TRUE(clients.back()->connect("127.0.0.1", port).is_ok());
+        }
+
+        for (const std::unique_ptr<ClientSocket>& client : clients) {
+            std::vector<uint8_t> in(payload_sz);
+            size_t received = 0;
+            while (received < payload_sz) {
+                Status<std::span<uint8_t>, int> res =
+                    client->recv_some(std::span<uint8_t>{in}.subspan(received));
+                ASSERT_TRUE(res.is_ok());
+                ASSERT_FALSE(res.ok().empty());
+                received += res.ok().size();
+            }
+            ASSERT_EQ(data, in);
+        }
+
+        ASSERT_TRUE(loop->post([&] {
+                            // Sent in full everywhere, so only the test holds it.
+                            EXPECT_EQ(1, payload.use_count());
+                            ASSERT_TRUE(loop->shutdown().is_ok());
+                        })
+                        .is_ok());
+    }};
+
+    loop->run();
+    client_thread.join();
+
+    ASSERT_EQ(subscribers, queued);
+}
+
+TEST(BroadcastTest, SlowConsumer) {
+    constexpr int port = 8093;
+    constexpr size_t payload_sz = 64 * 1024;
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    const SharedBuffer payload = make_shared_buffer(pattern(payload_sz, 0));
+    std::vector<size_t> drop_counts;
+    std::vector<size_t> disconnect_counts;
+
+    // Three payloads in one go overflow a queue with room for one and a half, before the
+    // connection has had a chance to send anything.
+    std::unique_ptr<FeedServer> server;
+    server = std::make_unique<FeedServer>(loop, port, 1, payload_sz * 3 / 2, [&] {
+        for (int i = 0; i < 3; ++i) {
+            drop_counts.push_back(server->broadcast(payload));
+        }
+        server->set_slow_consumer_policy(SlowConsumerPolicy::DISCONNECT);
+        for (int i = 0; i < 2; ++i) {
+            disconnect_counts.push_back(server->broadcast(payload));
+        }
+    });
+    server->start();
+
+    std::thread client_thread{[&] {
+        const ClientSocket client;
+        ASSERT_TRUE(client.connect("127.0.0.1", port).is_ok());
+
+        // Closed before its queue is flushed, so at most the first payload gets out.
+        std::vector<uint8_t> in(4 * payload_sz);
+        size_t received = 0;
+        for (;;) {
+            Status<std::span<uint8_t>, int> res =
+                client.recv_some(std::span<uint8_t>{in}.subspan(received));
+            if (res.is_err() || res.ok().empty()) {
+                break;
+            }
+            received += res.ok().size();
+        }
+        EXPECT_LE(received, payload_sz);
+
+        ASSERT_TRUE(loop->shutdown().is_ok());
+    }};
+
+    loop->run();
+    client_thread.join();
+
+    ASSERT_EQ((std::vector<size_t>{1, 0, 0}), drop_counts);
+    ASSERT_EQ((std::vector<size_t>{0, 0}), disconnect_counts);
+}
+
+} // namespace axle
+// NOLINTEND(readability-function-cognitive-complexity)
@@ -0,0 +1,70 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "axle/buffer_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <utility>
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+TEST(BufferPoolTest, ReusesBuffers) {
+    BufferPool pool{64, 1};
+
+    std::unique_ptr<uint8_t[]> first = pool.acquire(); // NOLINT(cppcoreguidelines-avoid-c-arrays)
+    std::unique_ptr<uint8_t[]> second = pool.acquire(); // NOLINT(cppcoreguidelines-avoid-c-arrays)
+    const uint8_t* const first_ptr = first.get();
+    ASSERT_EQ(2, pool.in_use());
+    ASSERT_EQ(0, pool.cached());
+
+    pool.release(std::move(first));
+    // Over the cache limit, so this one is freed.
+    pool.release(std::move(second));
+    ASSERT_EQ(0, pool.in_use());
+    ASSERT_EQ(1, pool.cached());
+
+    ASSERT_EQ(first_ptr, pool.acquire().get());
+}
+
+TEST(BufferPoolTest, LazyBufferHoldsOnlyWhilePending) {
+    BufferPool pool{8, 4};
+    LazyBuffer buf{pool};
+    ASSERT_FALSE(buf.holding());
+    ASSERT_TRUE(buf.readable(8).empty());
+
+    std::span<uint8_t> space = buf.writable(5);
+    ASSERT_EQ(5, space.size());
+    std::fill(space.begin(), space.end(), 'a');
+    buf.commit(5);
+    ASSERT_TRUE(buf.holding());
+    ASSERT_EQ(1, pool.in_use());
+
+    // Only what is left of the buffer is offered.
+    ASSERT_EQ(3, buf.writable(100).size());
+    buf.commit(0);
+
+    ASSERT_EQ(2, buf.readable(2).size());
+    buf.consume(2);
+    ASSERT_EQ(3, buf.size());
+    ASSERT_TRUE(buf.holding());
+
+    buf.consume(3);
+    ASSERT_TRUE(buf.empty());
+    ASSERT_FALSE(buf.holding());
+    ASSERT_EQ(0, pool.in_use());
+
+    // A read that turns up nothing does not keep the buffer.
+    (void)buf.writable(8);
+    buf.commit(0);
+    ASSERT_FALSE(buf.holding());
+    ASSERT_EQ(8, buf.writable(8).size());
+}
+
+} // namespace axle
+// NOLINTEND(readability-function-cognitive-complexity)
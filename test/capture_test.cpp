@@ -0,0 +1,234 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "axle/capture.h"
+
+#include <stdlib.h> // NOLINT(modernize-deprecated-headers) -- for mkstemp
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "axle/event.h"
+#include "axle/socket.h"
+#include "axle/status.h"
+#include "axle/tcp.h"
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+namespace {
+
+// A path for a capture file, removed when the test is over.
+class TempPath {
+  public:
+    TempPath() {
+        const int fd = mkstemp(path_.data());
+        EXPECT_NE(-1, fd);
+        EXPECT_EQ(0, close(fd));
+    }
+
+    TempPath(const TempPath&) = delete;
+    TempPath& operator=(const TempPath&) = delete;
+    TempPath(TempPath&&) = delete;
+    TempPath& operator=(TempPath&&) = delete;
+
+    ~TempPath() {
+        (void)unlink(path_.c_str());
+    }
+
+    const std::string& path() const {
+        return path_;
+    }
+
+  private:
+    std::string path_ = "/tmp/axle-capture-test-XXXXXX";
+};
+
+std::span<const uint8_t> as_bytes(const std::string& str) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return {reinterpret_cast<const uint8_t*>(str.data()), str.size()};
+}
+
+std::string as_string(std::span<const uint8_t> bytes) {
+    return {bytes.begin(), bytes.end()};
+}
+
+// Discards what it reads.
+class SinkSession {
+  public:
+    std::span<uint8_t> recv_buf(size_t max_len) {
+        return std::span<uint8_t>{buf_}.first(std::min(buf_.size(), max_len));
+    }
+
+    void post_recv(std::span<uint8_t> buf) {
+        (void)buf;
+    }
+
+    std::span<const uint8_t> send_buf(size_t max_len) {
+        (void)max_len;
+
+        return {};
+    }
+
+    void post_send(int64_t len) {
+        (void)len;
+    }
+
+    void end() {}
+
+  private:
+    std::array<uint8_t, 1024> buf_{};
+};
+
+class SinkServer : public TcpServer<SinkSession, SinkServer> {
+  public:
+    SinkServer(const std::shared_ptr<EventLoop>& event_loop, int port)
+        : TcpServer(event_loop, port) {
+        set_write_on_demand();
+    }
+
+    std::shared_ptr<SinkSession> handle_connection() {
+        return std::make_shared<SinkSession>();
+    }
+};
+
+} // namespace
+
+TEST(CaptureTest, RoundTrip) {
+    const TempPath path;
+    {
+        CaptureWriter writer{path.path(), 4096};
+        const uint32_t first = writer.open();
+        const uint32_t second = writer.open();
+        EXPECT_EQ(0, first);
+        EXPECT_EQ(1, second);
+        writer.data(second, as_bytes("hello"));
+        writer.data(first, as_bytes("world"));
+        writer.close(first);
+        writer.close(second);
+        EXPECT_EQ(16 + (6 * 16) + 10, writer.size());
+        EXPECT_EQ(0, writer.dropped());
+    }
+
+    CaptureReader reader{path.path()};
+    std::vector<CaptureRecord> records;
+    while (std::optional<CaptureRecord> record = reader.next()) {
+        records.push_back(*record);
+    }
+    ASSERT_EQ(6, records.size());
+
+    EXPECT_EQ(CaptureKind::OPEN, records[0].kind);
+    EXPECT_EQ(0, records[0].stream);
+    EXPECT_EQ(CaptureKind::OPEN, records[1].kind);
+    EXPECT_EQ(1, records[1].stream);
+    EXPECT_EQ(CaptureKind::DATA, records[2].kind);
+    EXPECT_EQ(1, records[2].stream);
+    EXPECT_EQ("hello", as_string(records[2].data));
+    EXPECT_EQ(CaptureKind::DATA, records[3].kind);
+    EXPECT_EQ(0, records[3].stream);
+    EXPECT_EQ("world", as_string(records[3].data));
+    EXPECT_EQ(CaptureKind::CLOSE, records[4].kind);
+    EXPECT_EQ(CaptureKind::CLOSE, records[5].kind);
+    EXPECT_TRUE(records[5].data.empty());
+
+    for (size_t i = 1; i < records.size(); ++i) {
+        EXPECT_LE(records[i - 1].offset, records[i].offset);
+    }
+
+    reader.rewind();
+    std::optional<CaptureRecord> first = reader.next();
+    ASSERT_TRUE(first.has_value());
+    EXPECT_EQ(CaptureKind::OPEN, first->kind);
+}
+
+TEST(CaptureTest, DropsWhenFull) {
+    const TempPath path;
+    {
+        // Room for the header and two records of five bytes.
+        CaptureWriter writer{path.path(), 16 + (2 * 21)};
+        const uint32_t stream = writer.open();
+        writer.data(stream, as_bytes("abcde"));
+        writer.data(stream, as_bytes("fghij"));
+        writer.close(stream);
+        EXPECT_EQ(2, writer.dropped());
+    }
+
+    CaptureReader reader{path.path()};
+    std::optional<CaptureRecord> record = reader.next();
+    ASSERT_TRUE(record.has_value());
+    EXPECT_EQ(CaptureKind::OPEN, record->kind);
+    record = reader.next();
+    ASSERT_TRUE(record.has_value());
+    EXPECT_EQ("abcde", as_string(record->data));
+    EXPECT_FALSE(reader.next().has_value());
+}
+
+TEST(CaptureTest, RejectsOtherFiles) {
+    const TempPath path;
+    EXPECT_THROW(CaptureReader{path.path()}, std::runtime_error);
+    EXPECT_THROW(CaptureReader{"/nonexistent/capture"}, std::runtime_error);
+}
+
+// What clients send a server is recorded per connection, from open to close.
+TEST(CaptureTest, CapturesServer) {
+    constexpr int port = 8106;
+    const TempPath path;
+    auto writer = std::make_unique<CaptureWriter>(path.path(), 1 << 20);
+
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    SinkServer server{loop, port};
+    server.set_capture(writer.get());
+    server.start();
+
+    std::thread client_thread{[&] {
+        {
+            const ClientSocket client;
+            ASSERT_TRUE(client.connect("127.0.0.1", port).is_ok());
+            ASSERT_TRUE(client.send_all(as_bytes("one")).is_ok());
+            std::this_thread::sleep_for(std::chrono::milliseconds{20});
+            ASSERT_TRUE(client.send_all(as_bytes("two")).is_ok());
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{20});
+
+        ASSERT_TRUE(loop->shutdown().is_ok());
+    }};
+
+    loop->run();
+    client_thread.join();
+    EXPECT_EQ(0, server.connections());
+    writer.reset();
+
+    CaptureReader reader{path.path()};
+    std::optional<CaptureRecord> record = reader.next();
+    ASSERT_TRUE(record.has_value());
+    EXPECT_EQ(CaptureKind::OPEN, record->kind);
+
+    std::string sent;
+    std::vector<std::chrono::nanoseconds> offsets;
+    while ((record = reader.next()) && record->kind == CaptureKind::DATA) {
+        sent += as_string(record->data);
+        offsets.push_back(record->offset);
+    }
+    EXPECT_EQ("onetwo", sent);
+    ASSERT_GE(offsets.size(), 2);
+    EXPECT_GE(offsets.back() - offsets.front(), std::chrono::milliseconds{20});
+
+    ASSERT_TRUE(record.has_value());
+    EXPECT_EQ(CaptureKind::CLOSE, record->kind);
+    EXPECT_FALSE(reader.next().has_value());
+}
+
+} // namespace axle
+// NOLINTEND(readability-function-cognitive-complexity)
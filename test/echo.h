@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "axle/event.h"
+#include "axle/socket.h"
+#include "axle/status.h"
+#include "axle/tcp.h"
+
+// The echo server the TcpServer feature tests run against.
+
+namespace axle {
+
+struct EchoConfig {
+    size_t buf_sz = 1024;
+    // CPU spent on every read, to make a loop busy.
+    std::chrono::microseconds work{0};
+    // Coalesced writes, or else writes on demand.
+    bool coalesce = true;
+};
+
+// Echoes what it reads through a buffer of `buf_sz` bytes, spending `work` of CPU on every read.
+class EchoSession {
+  public:
+    explicit EchoSession(const EchoConfig& config)
+        : work_{config.work},
+          buf_(config.buf_sz) {}
+
+    std::span<uint8_t> recv_buf(size_t max_len) {
+        return std::span<uint8_t>{buf_}.subspan(tail_, std::min(buf_.size() - tail_, max_len));
+    }
+
+    void post_recv(std::span<uint8_t> buf) {
+        tail_ += buf.size();
+        readers_.push_back(std::this_thread::get_id());
+
+        const std::chrono::steady_clock::time_point until =
+            std::chrono::steady_clock::now() + work_;
+        while (std::chrono::steady_clock::now() < until) {
+        }
+    }
+
+    std::span<const uint8_t> send_buf(size_t max_len) {
+        return std::span<const uint8_t>{buf_}.subspan(head_, std::min(tail_ - head_, max_len));
+    }
+
+    void post_send(int64_t len) {
+        head_ += len;
+        if (head_ == tail_) {
+            head_ = 0;
+            tail_ = 0;
+        }
+    }
+
+    void end() {}
+
+    // Threads that read for the session, in order.
+    const std::vector<std::thread::id>& readers() const {
+        return readers_;
+    }
+
+  private:
+    std::chrono::microseconds work_;
+    std::vector<uint8_t> buf_;
+    size_t head_ = 0;
+    size_t tail_ = 0;
+    std::vector<std::thread::id> readers_;
+};
+
+class EchoServer : public TcpServer<EchoSession> {
+  public:
+    EchoServer(const std::shared_ptr<EventLoop>& event_loop,
+               int port,
+               const EchoConfig& config = {})
+        : TcpServer(event_loop, port),
+          config_{config} {
+        set_writes();
+    }
+
+    EchoServer(const std::shared_ptr<EventLoop>& event_loop,
+               ServerSocket&& listener,
+               const EchoConfig& config = {})
+        : TcpServer(event_loop, std::move(listener)),
+          config_{config} {
+        set_writes();
+    }
+
+    std::shared_ptr<EchoSession> handle_connection() override {
+        return std::make_shared<EchoSession>(config_);
+    }
+
+    void handle_migrated(ConnHandle handle, EchoSession& session) override {
+        (void)handle;
+        migrated_.push_back(&session);
+    }
+
+    // Sessions migrated in, in order.
+    const std::vector<EchoSession*>& migrated() const {
+        return migrated_;
+    }
+
+  private:
+    EchoConfig config_;
+    std::vector<EchoSession*> migrated_;
+
+    void set_writes() {
+        if (config_.coalesce) {
+            set_write_coalescing();
+        } else {
+            set_write_on_demand();
+        }
+    }
+};
+
+// Sends `msg` and returns what comes back, up to its length; short if the connection fails.
+inline std::string echo(const ClientSocket& client, const std::string& msg) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    const std::span<const uint8_t> out{reinterpret_cast<const uint8_t*>(msg.data()), msg.size()};
+    if (client.send_all(out).is_err()) {
+        return {};
+    }
+
+    std::string reply;
+    std::array<uint8_t, 1024> buf{};
+    while (reply.size() < msg.size()) {
+        Status<std::span<uint8_t>, int> res = client.recv_some(buf);
+        if (res.is_err() || res.ok().empty()) {
+            break;
+        }
+        reply.append(res.ok().begin(), res.ok().end());
+    }
+
+    return reply;
+}
+
+} // namespace axle
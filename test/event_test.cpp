@@ -2,6 +2,9 @@
 
 #include "axle/event.h"
 
+#include <unistd.h>
+#include <sys/socket.h>
+
 #include <cerrno>
 #include <cstdint>
 #include <cstdio>
@@ -9,10 +12,13 @@
 #include <algorithm>
 #include <array>
 #include <atomic>
+#include <chrono>
+#include <functional>
 #include <span>
 #include <string>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include "axle/socket.h"
 #include "axle/status.h"
@@ -110,6 +116,318 @@ TEST(EventLoopTest, TimerUpdate) {
     ASSERT_EQ(counter_max, counter);
 }
 
+TEST(EventLoopTest, TimerSlackSharesTicks) {
+    constexpr uint64_t period = 5e6;
+    constexpr size_t timer_cnt = 8;
+    constexpr int fires = 5;
+    EventLoop ev_loop;
+    std::array<int, timer_cnt> fired{};
+    int callbacks = 0;
+
+    // With as much slack as the period, every timer rides on the first one's kernel timer. The
+    // first timer drops out of the group after two ticks.
+    for (size_t i = 0; i < timer_cnt; ++i) {
+        const TimerEventCb cb = [&, i](uint64_t id, Status<None, int64_t> status) {
+            EXPECT_EQ(i + 1, id);
+            EXPECT_TRUE(status.is_ok());
+            ++callbacks;
+            ++fired.at(i);
+
+            if (i == 0 && fired.at(i) == 2) {
+                EXPECT_TRUE(ev_loop.remove_timer(id).is_ok());
+            }
+            if (i == timer_cnt - 1 && fired.at(i) == fires) {
+                EXPECT_TRUE(ev_loop.shutdown().is_ok());
+            }
+        };
+        ASSERT_TRUE(ev_loop.register_timer(i + 1, period, true /* periodic */, cb, period).is_ok());
+    }
+
+    ev_loop.run();
+
+    ASSERT_EQ(2, fired.at(0));
+    ASSERT_EQ(fires, fired.at(timer_cnt - 1));
+    ASSERT_LE(ev_loop.stats().timer_events, fires + 1);
+    ASSERT_GT(callbacks, 3 * static_cast<int>(ev_loop.stats().timer_events));
+    ASSERT_TRUE(ev_loop.remove_timer(1).is_err());
+}
+
+TEST(EventLoopTest, TimerSlackOneshot) {
+    EventLoop ev_loop;
+    constexpr uint64_t delay = 3e6;
+    constexpr uint64_t slack = 1e6;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration elapsed{};
+
+    // Slack only ever makes a timer late.
+    const TimerEventCb cb = [&](uint64_t, Status<None, int64_t>) {
+        elapsed = std::chrono::steady_clock::now() - start;
+        EXPECT_TRUE(ev_loop.shutdown().is_ok());
+    };
+    ASSERT_TRUE(ev_loop.register_timer(1, delay, false /* periodic */, cb, slack).is_ok());
+
+    ev_loop.run();
+
+    ASSERT_GE(elapsed, std::chrono::nanoseconds{delay});
+}
+
+TEST(EventLoopTest, BusyPoll) {
+    EventLoop ev_loop;
+    const uint64_t delay = 1e6;
+    int counter = 0;
+    int counter_max = 4;
+
+    // A spin far longer than the timer period catches every expiration without blocking.
+    ev_loop.set_busy_poll(BusyPollConfig{.spin_duration = std::chrono::milliseconds{100},
+                                         .adaptive = false});
+
+    const TimerEventCb cb = [&](uint64_t, Status<None, int64_t> status) {
+        EXPECT_TRUE(status.is_ok());
+
+        if (++counter == counter_max) {
+            const Status<None, int> res = ev_loop.shutdown();
+            EXPECT_TRUE(res.is_ok());
+        }
+    };
+
+    ASSERT_TRUE(ev_loop.register_timer(1, delay, true /* periodic */, cb).is_ok());
+
+    ev_loop.run();
+
+    const EventLoopStats& stats = ev_loop.stats();
+    ASSERT_EQ(counter_max, counter);
+    ASSERT_EQ(0, stats.blocking_waits);
+    ASSERT_EQ(counter_max + 1, stats.spin_hits);
+    ASSERT_LT(stats.spin_hits, stats.spin_polls);
+    ASSERT_GT(stats.spin_time.count(), 0);
+}
+
+TEST(EventLoopTest, BusyPollBackoff) {
+    EventLoop ev_loop;
+    const uint64_t delay = 2e7;
+    int counter = 0;
+    int counter_max = 3;
+
+    // Spins that never find anything shrink until the loop blocks right away.
+    ev_loop.set_busy_poll(BusyPollConfig{.spin_duration = std::chrono::microseconds{10}});
+
+    const TimerEventCb cb = [&](uint64_t, Status<None, int64_t> status) {
+        EXPECT_TRUE(status.is_ok());
+
+        if (++counter == counter_max) {
+            const Status<None, int> res = ev_loop.shutdown();
+            EXPECT_TRUE(res.is_ok());
+        }
+    };
+
+    ASSERT_TRUE(ev_loop.register_timer(1, delay, true /* periodic */, cb).is_ok());
+
+    ev_loop.run();
+
+    const EventLoopStats& stats = ev_loop.stats();
+    ASSERT_EQ(counter_max, counter);
+    ASSERT_EQ(counter_max, stats.blocking_waits);
+    ASSERT_GT(stats.wait_time, stats.spin_time);
+}
+
+TEST(EventLoopTest, DeferRoundRobin) {
+    EventLoop ev_loop;
+    std::string order;
+    int rounds_a = 0;
+    int rounds_b = 0;
+
+    // Two continuations re-defer themselves; each gets one turn per iteration. With no events
+    // pending, the loop must not block between rounds.
+    std::function<void()> cont_a = [&] {
+        order += 'a';
+        if (++rounds_a < 3) {
+            ev_loop.defer(cont_a);
+        }
+    };
+    std::function<void()> cont_b = [&] {
+        order += 'b';
+        if (++rounds_b < 3) {
+            ev_loop.defer(cont_b);
+        } else {
+            ASSERT_TRUE(ev_loop.shutdown().is_ok());
+        }
+    };
+    ev_loop.defer(cont_a);
+    ev_loop.defer(cont_b);
+
+    ev_loop.run();
+
+    ASSERT_EQ("ababab", order);
+    ASSERT_EQ(6, ev_loop.stats().deferred);
+    // Only the wait that picks up the shutdown, after the last continuation ran.
+    ASSERT_EQ(1, ev_loop.stats().blocking_waits);
+}
+
+TEST(EventLoopTest, Hooks) {
+    EventLoop ev_loop;
+    std::string order;
+    int idle_runs = 0;
+    uint64_t idle_id = 0;
+
+    // The idle hook keeps the loop from blocking until it removes itself, along with the check
+    // hook, on its third run.
+    (void)ev_loop.add_prepare_hook([&] { order += 'p'; });
+    const uint64_t check_id = ev_loop.add_check_hook([&] { order += 'c'; });
+    idle_id = ev_loop.add_idle_hook([&] {
+        order += 'i';
+        if (++idle_runs == 3) {
+            ASSERT_TRUE(ev_loop.remove_hook(idle_id).is_ok());
+            ASSERT_TRUE(ev_loop.remove_hook(check_id).is_ok());
+            ASSERT_TRUE(ev_loop.shutdown().is_ok());
+        }
+    });
+
+    ev_loop.run();
+
+    ASSERT_EQ("ipcipcip", order);
+    // Only the wait that picks up the shutdown, once the idle hook is gone.
+    ASSERT_EQ(1, ev_loop.stats().blocking_waits);
+    ASSERT_TRUE(ev_loop.remove_hook(idle_id).is_err());
+}
+
+TEST(EventLoopTest, EventBatchGrows) {
+    constexpr size_t pair_cnt = 300;
+    EventLoop ev_loop;
+    std::vector<std::array<int, 2>> pairs(pair_cnt);
+    size_t reads = 0;
+
+    // Never drains the socket, so every socket stays ready on every iteration.
+    const FdEventIOCb read_cb = [&](uint64_t, Status<int64_t, uint32_t>) {
+        if (++reads == 10 * pair_cnt) {
+            ASSERT_TRUE(ev_loop.shutdown().is_ok());
+        }
+    };
+
+    for (std::array<int, 2>& pair : pairs) {
+        ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair.data()));
+        ASSERT_EQ(1, write(pair[1], "x", 1));
+        ASSERT_TRUE(ev_loop.register_fd_read(pair[0], read_cb).is_ok());
+    }
+
+    ev_loop.run();
+
+    ASSERT_GE(ev_loop.stats().event_batch, pair_cnt);
+    for (const std::array<int, 2>& pair : pairs) {
+        ASSERT_TRUE(ev_loop.remove_fd_read(pair[0]).is_ok());
+        close(pair[0]);
+        close(pair[1]);
+    }
+}
+
+TEST(EventLoopTest, StaleEventDropped) {
+    EventLoop ev_loop;
+    std::array<std::array<int, 2>, 2> pairs{};
+    std::array<int, 2> reused{-1, -1};
+    size_t reads = 0;
+    bool reused_read = false;
+
+    // Both sockets are ready in the same batch. Whichever is dispatched first closes the other and
+    // hands its fd to a new socket before the other's event comes up.
+    const FdEventIOCb read_cb = [&](uint64_t fd, Status<int64_t, uint32_t>) {
+        ++reads;
+        std::array<int, 2>& victim = static_cast<int>(fd) == pairs[0][0] ? pairs[1] : pairs[0];
+        ASSERT_TRUE(ev_loop.remove_fd_read(victim[0]).is_ok());
+        close(victim[0]);
+        close(victim[1]);
+
+        ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, reused.data()));
+        ASSERT_EQ(victim[0], reused[0]);
+        ASSERT_TRUE(ev_loop
+                        .register_fd_read(reused[0],
+                                          [&](uint64_t, Status<int64_t, uint32_t>) {
+                                              reused_read = true;
+                                          })
+                        .is_ok());
+        victim = {-1, -1};
+
+        ASSERT_TRUE(ev_loop.remove_fd_read(static_cast<int>(fd)).is_ok());
+        ASSERT_TRUE(ev_loop.shutdown().is_ok());
+    };
+
+    for (std::array<int, 2>& pair : pairs) {
+        ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair.data()));
+        ASSERT_EQ(1, write(pair[1], "x", 1));
+        ASSERT_TRUE(ev_loop.register_fd_read(pair[0], read_cb).is_ok());
+    }
+
+    ev_loop.run();
+
+    ASSERT_EQ(1, reads);
+    ASSERT_FALSE(reused_read);
+    ASSERT_EQ(1, ev_loop.stats().stale_events);
+
+    ASSERT_TRUE(ev_loop.remove_fd_read(reused[0]).is_ok());
+    for (const std::array<int, 2>& pair : {pairs[0], pairs[1], reused}) {
+        if (pair[0] >= 0) {
+            close(pair[0]);
+            close(pair[1]);
+        }
+    }
+}
+
+namespace {
+
+// Reads through an `FdCallback`, which hands the fd over to a std::function from inside its own
+// callback, which hands it back in turn.
+struct Reader {
+    EventLoop* loop;
+    uint64_t arg = 0;
+    size_t reads = 0;
+    size_t function_reads = 0;
+
+    void on_read(uint64_t arg, uint64_t fd, Status<int64_t, uint32_t> status) {
+        this->arg = arg;
+        ++reads;
+        ASSERT_TRUE(status.is_ok());
+        if (arg == 2) {
+            ASSERT_TRUE(loop->remove_fd_read(static_cast<int>(fd)).is_ok());
+            ASSERT_TRUE(loop->shutdown().is_ok());
+
+            return;
+        }
+        ASSERT_TRUE(loop->register_fd_read(static_cast<int>(fd),
+                                           [this](uint64_t fd, Status<int64_t, uint32_t>) {
+                                               on_function_read(static_cast<int>(fd));
+                                           })
+                        .is_ok());
+    }
+
+    void on_function_read(int fd) {
+        ++function_reads;
+        // Replaces the function that is running.
+        const FdCallback cb = FdCallback::bind<&Reader::on_read>(this, 2);
+        ASSERT_TRUE(loop->register_fd_read(fd, cb).is_ok());
+    }
+};
+
+} // namespace
+
+TEST(EventLoopTest, FdCallback) {
+    EventLoop ev_loop;
+    std::array<int, 2> pair{};
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair.data()));
+    ASSERT_EQ(1, write(pair[1], "x", 1));
+
+    Reader reader{&ev_loop};
+    ASSERT_TRUE(
+        ev_loop.register_fd_read(pair[0], FdCallback::bind<&Reader::on_read>(&reader, 1)).is_ok());
+
+    ev_loop.run();
+
+    // The byte is never read, so the fd stays ready and each callback runs once in turn.
+    EXPECT_EQ(2, reader.reads);
+    EXPECT_EQ(2, reader.arg);
+    EXPECT_EQ(1, reader.function_reads);
+
+    close(pair[0]);
+    close(pair[1]);
+}
+
 TEST(EventLoopTest, BadFd) {
     EventLoop ev_loop{};
     const int bogus_fd = 5;
@@ -0,0 +1,123 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "axle/file.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "axle/event.h"
+#include "axle/status.h"
+#include "axle/worker_pool.h"
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+namespace {
+
+// Creates an empty file, unlinked so that it goes away with its descriptor.
+int temp_file() {
+    std::string path = "/tmp/axle-file-test-XXXXXX";
+    const int fd = mkstemp(path.data());
+    EXPECT_NE(-1, fd);
+    EXPECT_EQ(0, unlink(path.c_str()));
+
+    return fd;
+}
+
+std::vector<uint8_t> bytes(const std::string& str) {
+    return {str.begin(), str.end()};
+}
+
+} // namespace
+
+TEST(FileTest, WriteSyncRead) {
+    WorkerPool pool{2};
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    const std::thread::id loop_thread = std::this_thread::get_id();
+    std::vector<int> order;
+
+    AsyncFile file{pool, loop, temp_file()};
+    file.write_at(0, bytes("hello "), [&](Status<size_t, int> res) {
+        EXPECT_EQ(loop_thread, std::this_thread::get_id());
+        ASSERT_TRUE(res.is_ok());
+        EXPECT_EQ(6, res.ok());
+        order.push_back(0);
+    });
+    file.write_at(6, bytes("world"), [&](Status<size_t, int> res) {
+        ASSERT_TRUE(res.is_ok());
+        order.push_back(1);
+    });
+    file.fsync([&](Status<None, int> res) {
+        ASSERT_TRUE(res.is_ok());
+        order.push_back(2);
+    });
+    // Runs after the writes, and reads short at the end of the file.
+    file.read_at(0, 64, [&](Status<std::vector<uint8_t>, int> res) {
+        ASSERT_TRUE(res.is_ok());
+        EXPECT_EQ(bytes("hello world"), res.ok());
+        order.push_back(3);
+        ASSERT_TRUE(loop->shutdown().is_ok());
+    });
+    ASSERT_EQ(4, file.pending());
+
+    loop->run();
+
+    ASSERT_EQ((std::vector<int>{0, 1, 2, 3}), order);
+    ASSERT_EQ(0, file.pending());
+}
+
+TEST(FileTest, ReportsErrors) {
+    WorkerPool pool{1};
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    std::string path = "/tmp/axle-file-test-XXXXXX";
+    const int fd = mkstemp(path.data());
+    ASSERT_NE(-1, fd);
+    ASSERT_EQ(0, close(fd));
+    const int write_only = open(path.c_str(), O_WRONLY);
+    ASSERT_EQ(0, unlink(path.c_str()));
+
+    AsyncFile file{pool, loop, write_only};
+    file.read_at(0, 16, [&](Status<std::vector<uint8_t>, int> res) {
+        ASSERT_TRUE(res.is_err());
+        EXPECT_EQ(EBADF, res.err());
+        ASSERT_TRUE(loop->shutdown().is_ok());
+    });
+
+    loop->run();
+}
+
+TEST(FileTest, CancelOnDestroy) {
+    WorkerPool pool{1};
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    int delivered = 0;
+
+    auto file = std::make_unique<AsyncFile>(pool, loop, temp_file());
+    for (int i = 0; i < 4; ++i) {
+        file->write_at(0, std::vector<uint8_t>(1024 * 1024), [&](Status<size_t, int>) {
+            ++delivered;
+        });
+    }
+
+    // The session goes away with its writes in flight.
+    file.reset();
+    file = std::make_unique<AsyncFile>(pool, loop, temp_file());
+    file->fsync([&](Status<None, int>) { ASSERT_TRUE(loop->shutdown().is_ok()); });
+
+    loop->run();
+
+    ASSERT_EQ(0, delivered);
+}
+
+} // namespace axle
+// NOLINTEND(readability-function-cognitive-complexity)
@@ -0,0 +1,196 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "axle/framing.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "axle/status.h"
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+namespace {
+
+std::span<const uint8_t> as_bytes(const std::string& str) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return {reinterpret_cast<const uint8_t*>(str.data()), str.size()};
+}
+
+std::string as_string(std::span<const uint8_t> buf) {
+    return {buf.begin(), buf.end()};
+}
+
+class FramerHarness {
+  public:
+    explicit FramerHarness(FramerConfig config)
+        : framer_{std::move(config), [this](std::span<const std::span<const uint8_t>> batch) {
+                      ++batches_;
+                      for (const std::span<const uint8_t> frame : batch) {
+                          frames_.push_back(as_string(frame));
+                      }
+                  }} {}
+
+    // Feeds `input` through the framer in reads of at most `chunk` bytes.
+    Status<size_t, FrameError> feed(std::span<const uint8_t> input, size_t chunk) {
+        size_t total = 0;
+        while (!input.empty()) {
+            const std::span<uint8_t> buf = framer_.recv_buf(chunk);
+            EXPECT_FALSE(buf.empty());
+            const size_t len = std::min(buf.size(), input.size());
+            std::copy_n(input.begin(), len, buf.begin());
+            input = input.subspan(len);
+
+            Status<size_t, FrameError> res = framer_.post_recv(buf.first(len));
+            if (res.is_err()) {
+                return res;
+            }
+            total += res.ok();
+        }
+
+        return Status<size_t, FrameError>::make_ok(total);
+    }
+
+    Framer& framer() {
+        return framer_;
+    }
+
+    const std::vector<std::string>& frames() const {
+        return frames_;
+    }
+
+    size_t batches() const {
+        return batches_;
+    }
+
+  private:
+    Framer framer_;
+    std::vector<std::string> frames_;
+    size_t batches_ = 0;
+};
+
+std::string encode(Framer& framer, const std::string& payload, bool checksum) {
+    std::array<uint8_t, Framer::k_max_header_sz> hdr{};
+    const size_t hdr_len = framer.encode_header(payload.size(), hdr);
+
+    std::string out{hdr.begin(), hdr.begin() + hdr_len};
+    out += payload;
+    if (checksum) {
+        std::array<uint8_t, Framer::k_checksum_sz> trailer{};
+        Framer::encode_trailer(as_bytes(payload), trailer);
+        out.append(trailer.begin(), trailer.end());
+    }
+
+    return out;
+}
+
+} // namespace
+
+TEST(FramingTest, Crc32c) {
+    ASSERT_EQ(0xe3069283, crc32c(as_bytes("123456789")));
+    ASSERT_EQ(0, crc32c({}));
+
+    const std::string str = "the quick brown fox jumps over the lazy dog";
+    const uint32_t partial = crc32c(as_bytes(str.substr(0, 11)));
+    ASSERT_EQ(crc32c(as_bytes(str)), crc32c(as_bytes(str.substr(11)), partial));
+}
+
+TEST(FramingTest, FixedPrefixBatch) {
+    FramerHarness harness{FramerConfig{.mode = FrameMode::FIXED, .prefix_len = 2}};
+    const std::string stream =
+        encode(harness.framer(), "alpha", false) + encode(harness.framer(), "", false) +
+        encode(harness.framer(), "gamma", false);
+
+    Status<size_t, FrameError> res = harness.feed(as_bytes(stream), stream.size());
+    ASSERT_TRUE(res.is_ok());
+    ASSERT_EQ(3, res.ok());
+    ASSERT_EQ(1, harness.batches());
+    ASSERT_EQ((std::vector<std::string>{"alpha", "", "gamma"}), harness.frames());
+    ASSERT_EQ(0, harness.framer().pending());
+}
+
+TEST(FramingTest, VarintPrefixByteAtATime) {
+    FramerHarness harness{FramerConfig{.mode = FrameMode::VARINT}};
+    const std::string big(300, 'x');
+    const std::string stream =
+        encode(harness.framer(), "hello", false) + encode(harness.framer(), big, false);
+
+    Status<size_t, FrameError> res = harness.feed(as_bytes(stream), 1);
+    ASSERT_TRUE(res.is_ok());
+    ASSERT_EQ(2, res.ok());
+    ASSERT_EQ((std::vector<std::string>{"hello", big}), harness.frames());
+}
+
+TEST(FramingTest, VarintOverlong) {
+    FramerHarness harness{FramerConfig{.mode = FrameMode::VARINT}};
+    const std::string stream(11, '\xff');
+
+    Status<size_t, FrameError> res = harness.feed(as_bytes(stream), stream.size());
+    ASSERT_TRUE(res.is_err());
+    ASSERT_EQ(FrameError::BAD_LENGTH, res.err());
+}
+
+TEST(FramingTest, DelimiterStraddlesReads) {
+    FramerHarness harness{FramerConfig{
+        .mode = FrameMode::DELIMITER,
+        .delimiter = {'\r', '\n'},
+        .buf_sz = 8,
+    }};
+    const std::string stream = "GET a\r\n\r\nSET bb cc\r\nEND\r\n";
+
+    Status<size_t, FrameError> res = harness.feed(as_bytes(stream), 3);
+    ASSERT_TRUE(res.is_ok());
+    ASSERT_EQ(4, res.ok());
+    ASSERT_EQ((std::vector<std::string>{"GET a", "", "SET bb cc", "END"}), harness.frames());
+}
+
+TEST(FramingTest, FrameLargerThanBuffer) {
+    FramerHarness harness{FramerConfig{.mode = FrameMode::FIXED, .buf_sz = 16}};
+    const std::string big(1000, 'y');
+    const std::string stream =
+        encode(harness.framer(), big, false) + encode(harness.framer(), "tail", false);
+
+    Status<size_t, FrameError> res = harness.feed(as_bytes(stream), 64);
+    ASSERT_TRUE(res.is_ok());
+    ASSERT_EQ((std::vector<std::string>{big, "tail"}), harness.frames());
+}
+
+TEST(FramingTest, TooLarge) {
+    FramerHarness fixed{FramerConfig{.mode = FrameMode::FIXED, .max_frame_sz = 8}};
+    const std::string stream = encode(fixed.framer(), "123456789", false);
+    Status<size_t, FrameError> res = fixed.feed(as_bytes(stream), stream.size());
+    ASSERT_TRUE(res.is_err());
+    ASSERT_EQ(FrameError::TOO_LARGE, res.err());
+
+    FramerHarness delimited{FramerConfig{.mode = FrameMode::DELIMITER, .max_frame_sz = 8}};
+    res = delimited.feed(as_bytes("0123456789"), 4);
+    ASSERT_TRUE(res.is_err());
+    ASSERT_EQ(FrameError::TOO_LARGE, res.err());
+}
+
+TEST(FramingTest, Checksum) {
+    FramerHarness harness{FramerConfig{.mode = FrameMode::VARINT, .checksum = true}};
+    std::string stream =
+        encode(harness.framer(), "first", true) + encode(harness.framer(), "second", true);
+
+    Status<size_t, FrameError> res = harness.feed(as_bytes(stream), 5);
+    ASSERT_TRUE(res.is_ok());
+    ASSERT_EQ((std::vector<std::string>{"first", "second"}), harness.frames());
+
+    stream = encode(harness.framer(), "third", true);
+    stream[2] ^= 1;
+    res = harness.feed(as_bytes(stream), stream.size());
+    ASSERT_TRUE(res.is_err());
+    ASSERT_EQ(FrameError::BAD_CHECKSUM, res.err());
+}
+
+} // namespace axle
+// NOLINTEND(readability-function-cognitive-complexity)
@@ -0,0 +1,215 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "axle/handoff.h"
+
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "echo.h"
+
+#include "axle/event.h"
+#include "axle/socket.h"
+#include "axle/status.h"
+#include "axle/tcp.h"
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+namespace {
+
+bool echoes(const ClientSocket& client, const std::string& msg) {
+    return echo(client, msg) == msg;
+}
+
+std::string handoff_path(const char* name) {
+    return std::string{"/tmp/axle-handoff-"} + name + ".sock";
+}
+
+} // namespace
+
+TEST(HandoffTest, NothingToTakeOver) {
+    Status<Takeover, int> res = take_listeners(handoff_path("none"));
+    ASSERT_TRUE(res.is_err());
+    EXPECT_EQ(res.err(), ENOENT);
+}
+
+TEST(HandoffTest, HandsOverListener) {
+    constexpr int port = 8109;
+    const std::string path = handoff_path("restart");
+
+    const std::shared_ptr<EventLoop> old_loop = std::make_shared<EventLoop>();
+    EchoServer old_server{old_loop, port};
+    old_server.start();
+
+    std::atomic_bool handed_off = false;
+    std::atomic_bool drained = false;
+    ListenerHandoff handoff{old_loop, path, {old_server.listener_fd()}, [&] {
+                                handed_off.store(true);
+                                old_server.drain(std::chrono::seconds{5}, [&] {
+                                    drained.store(true);
+                                    (void)old_loop->shutdown();
+                                });
+                            }};
+    std::thread old_thread{[&] { old_loop->run(); }};
+
+    // A connection open across the restart, served by the old process until it closes.
+    ClientSocket held;
+    ASSERT_TRUE(held.connect("127.0.0.1", port).is_ok());
+    EXPECT_TRUE(echoes(held, "before"));
+
+    // New connections throughout, none of which may be refused.
+    std::atomic_bool restarting = true;
+    std::atomic<size_t> served = 0;
+    std::atomic<size_t> failed = 0;
+    std::thread client_thread{[&] {
+        while (restarting.load()) {
+            const ClientSocket client;
+            if (client.connect("127.0.0.1", port).is_ok() && echoes(client, "ping")) {
+                served.fetch_add(1);
+            } else {
+                failed.fetch_add(1);
+            }
+        }
+    }};
+
+    Status<Takeover, int> res = take_listeners(path);
+    ASSERT_TRUE(res.is_ok());
+    Takeover takeover = res.ok();
+    ASSERT_EQ(takeover.listeners.size(), 1);
+
+    const std::shared_ptr<EventLoop> new_loop = std::make_shared<EventLoop>();
+    EchoServer new_server{new_loop, std::move(takeover.listeners[0])};
+    new_server.start();
+    std::thread new_thread{[&] { new_loop->run(); }};
+
+    ASSERT_TRUE(confirm_takeover(takeover).is_ok());
+    while (!handed_off.load()) {
+        std::this_thread::yield();
+    }
+
+    // Draining still serves what is open.
+    EXPECT_TRUE(echoes(held, "during"));
+    EXPECT_FALSE(drained.load());
+
+    // Every connection from here on is the new server's.
+    const size_t before = served.load();
+    while (served.load() < before + 10) {
+        std::this_thread::yield();
+    }
+
+    (void)held.close();
+    old_thread.join();
+    EXPECT_TRUE(drained.load());
+    EXPECT_EQ(old_server.connections(), 0);
+
+    restarting.store(false);
+    client_thread.join();
+    EXPECT_EQ(failed.load(), 0);
+    EXPECT_GT(served.load(), before);
+
+    ASSERT_TRUE(new_loop->shutdown().is_ok());
+    new_thread.join();
+}
+
+TEST(HandoffTest, DrainClosesAtDeadline) {
+    constexpr int port = 8110;
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    EchoServer server{loop, port};
+    server.start();
+
+    bool drained = false;
+    std::thread loop_thread{[&] { loop->run(); }};
+
+    const ClientSocket idle;
+    ASSERT_TRUE(idle.connect("127.0.0.1", port).is_ok());
+    EXPECT_TRUE(echoes(idle, "hello"));
+
+    ASSERT_TRUE(loop->post([&] {
+                        server.drain(std::chrono::milliseconds{50}, [&] {
+                            drained = true;
+                            (void)loop->shutdown();
+                        });
+                    })
+                    .is_ok());
+
+    // The idle connection is closed at the deadline.
+    std::array<uint8_t, 16> buf{};
+    Status<std::span<uint8_t>, int> res = idle.recv_some(buf);
+    ASSERT_TRUE(res.is_ok());
+    EXPECT_TRUE(res.ok().empty());
+
+    loop_thread.join();
+    EXPECT_TRUE(drained);
+    EXPECT_EQ(server.connections(), 0);
+
+    // Nothing accepts any more, and the listener stays open, so a connection waits unanswered.
+    const ClientSocket late;
+    EXPECT_TRUE(late.connect("127.0.0.1", port).is_ok());
+}
+
+// A replacement that takes the listeners and then hangs holds up the next one only until its time
+// to confirm runs out. The socket is only open to the user that made it.
+TEST(HandoffTest, StalledReplacementTimesOut) {
+    constexpr int port = 8122;
+    constexpr std::chrono::milliseconds confirm_timeout{100};
+    const std::string path = handoff_path("stalled");
+
+    const std::shared_ptr<EventLoop> old_loop = std::make_shared<EventLoop>();
+    EchoServer old_server{old_loop, port};
+    old_server.start();
+    std::atomic_bool handed_off = false;
+    ListenerHandoff handoff{old_loop,
+                            path,
+                            {old_server.listener_fd()},
+                            [&] {
+                                handed_off.store(true);
+                                (void)old_loop->shutdown();
+                            },
+                            confirm_timeout};
+    std::thread old_thread{[&] { old_loop->run(); }};
+
+    struct stat info{};
+    ASSERT_EQ(0, stat(path.c_str(), &info));
+    EXPECT_EQ(S_IRUSR | S_IWUSR, info.st_mode & (S_IRWXU | S_IRWXG | S_IRWXO));
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Status<Takeover, int> stalled = take_listeners(path);
+    ASSERT_TRUE(stalled.is_ok());
+
+    // Waits in the backlog until the first gives up.
+    Status<Takeover, int> res = take_listeners(path);
+    ASSERT_TRUE(res.is_ok());
+    EXPECT_GE(std::chrono::steady_clock::now() - start, confirm_timeout);
+    EXPECT_FALSE(handed_off.load());
+
+    // Too late for the first to confirm.
+    Takeover late = stalled.ok();
+    std::array<uint8_t, 1> buf{};
+    Status<std::span<uint8_t>, int> closed = late.channel.recv_some(buf);
+    ASSERT_TRUE(closed.is_ok());
+    EXPECT_TRUE(closed.ok().empty());
+
+    Takeover takeover = res.ok();
+    ASSERT_EQ(takeover.listeners.size(), 1);
+    ASSERT_TRUE(confirm_takeover(takeover).is_ok());
+    old_thread.join();
+    EXPECT_TRUE(handed_off.load());
+}
+
+} // namespace axle
+
+// NOLINTEND(readability-function-cognitive-complexity)
@@ -0,0 +1,186 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "hotpath.h"
+
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "axle/event.h"
+#include "axle/socket.h"
+#include "axle/status.h"
+#include "axle/tcp.h"
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+namespace {
+
+constexpr size_t k_round_trips = 200;
+// Round trips left out of the checks while the loop's and the server's buffers reach the sizes
+// they keep.
+constexpr size_t k_warm_up = 8;
+
+// Echoes what it reads, noting the loop thread's counts as each message arrives. The space for
+// them is reserved up front so that noting them allocates nothing.
+class CountingSession {
+  public:
+    CountingSession() {
+        counts_.reserve(k_round_trips);
+    }
+
+    std::span<uint8_t> recv_buf(size_t max_len) {
+        return std::span<uint8_t>{buf_}.subspan(tail_, std::min(buf_.size() - tail_, max_len));
+    }
+
+    void post_recv(std::span<uint8_t> buf) {
+        if (!buf.empty() && counts_.size() < counts_.capacity()) {
+            counts_.push_back(bench::thread_counts());
+        }
+        tail_ += buf.size();
+    }
+
+    std::span<const uint8_t> send_buf(size_t max_len) {
+        return std::span<const uint8_t>{buf_}.subspan(head_, std::min(tail_ - head_, max_len));
+    }
+
+    void post_send(int64_t len) {
+        head_ += len;
+        if (head_ == tail_) {
+            head_ = 0;
+            tail_ = 0;
+        }
+    }
+
+    void end() {}
+
+    const std::vector<bench::HotPathCounts>& counts() const {
+        return counts_;
+    }
+
+  private:
+    std::array<uint8_t, 1024> buf_{};
+    size_t head_ = 0;
+    size_t tail_ = 0;
+    std::vector<bench::HotPathCounts> counts_;
+};
+
+class CountingServer : public TcpServer<CountingSession, CountingServer> {
+  public:
+    CountingServer(const std::shared_ptr<EventLoop>& event_loop, int port, bool coalesce)
+        : TcpServer(event_loop, port) {
+        if (coalesce) {
+            set_write_coalescing();
+        } else {
+            set_write_on_demand();
+        }
+    }
+
+    std::shared_ptr<CountingSession> handle_connection() {
+        session_ = std::make_shared<CountingSession>();
+
+        return session_;
+    }
+
+    const CountingSession& session() const {
+        return *session_;
+    }
+
+  private:
+    std::shared_ptr<CountingSession> session_;
+};
+
+// Runs `k_round_trips` ping-pongs of a small message over one connection and returns what the
+// loop did between the arrivals of consecutive messages after the warm-up, each interval a full
+// round trip.
+std::vector<bench::HotPathCounts> round_trips(int port, bool coalesce) {
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    CountingServer server{loop, port, coalesce};
+    server.start();
+
+    std::thread client_thread{[&] {
+        const ClientSocket client;
+        ASSERT_TRUE(client.connect("127.0.0.1", port).is_ok());
+
+        const std::array<uint8_t, 16> msg{};
+        std::array<uint8_t, 16> reply{};
+        for (size_t i = 0; i < k_round_trips; ++i) {
+            ASSERT_TRUE(client.send_all(msg).is_ok());
+            size_t got = 0;
+            while (got < reply.size()) {
+                Status<std::span<uint8_t>, int> res =
+                    client.recv_some(std::span<uint8_t>{reply}.subspan(got));
+                ASSERT_TRUE(res.is_ok());
+                ASSERT_FALSE(res.ok().empty());
+                got += res.ok().size();
+            }
+        }
+
+        ASSERT_TRUE(loop->shutdown().is_ok());
+    }};
+
+    loop->run();
+    client_thread.join();
+
+    const std::vector<bench::HotPathCounts>& counts = server.session().counts();
+    std::vector<bench::HotPathCounts> intervals;
+    for (size_t i = k_warm_up + 1; i < counts.size(); ++i) {
+        intervals.push_back(counts[i] - counts[i - 1]);
+    }
+
+    return intervals;
+}
+
+} // namespace
+
+TEST(HotPathTest, CountsThread) {
+    const bench::HotPathCounts before = bench::thread_counts();
+    const std::unique_ptr<int> ptr = std::make_unique<int>(1);
+    std::array<int, 2> fds{};
+    ASSERT_EQ(0, pipe(fds.data()));
+    ASSERT_EQ(0, close(fds[0]));
+    ASSERT_EQ(0, close(fds[1]));
+    const bench::HotPathCounts used = bench::thread_counts() - before;
+
+    EXPECT_EQ(1, used.allocations);
+    EXPECT_EQ(sizeof(int), used.allocated_bytes);
+    // `pipe` is not counted.
+    EXPECT_EQ(2, used.syscalls);
+}
+
+// An echo round trip on an established connection with coalesced writes: a wait for the
+// message, a read and a write, and no allocation.
+TEST(HotPathTest, CoalescedEchoRoundTrip) {
+    const std::vector<bench::HotPathCounts> intervals = round_trips(8104, true);
+    ASSERT_EQ(k_round_trips - k_warm_up - 1, intervals.size());
+
+    for (const bench::HotPathCounts& interval : intervals) {
+        EXPECT_EQ(0, interval.allocations);
+        EXPECT_LE(interval.syscalls, 3);
+    }
+}
+
+// Writing on demand adds the registration of the write filter and a wait for writability, but
+// still no allocation.
+TEST(HotPathTest, OnDemandEchoRoundTrip) {
+    const std::vector<bench::HotPathCounts> intervals = round_trips(8105, false);
+    ASSERT_EQ(k_round_trips - k_warm_up - 1, intervals.size());
+
+    for (const bench::HotPathCounts& interval : intervals) {
+        EXPECT_EQ(0, interval.allocations);
+        EXPECT_LE(interval.syscalls, 6);
+    }
+}
+
+} // namespace axle
+// NOLINTEND(readability-function-cognitive-complexity)
@@ -0,0 +1,233 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "axle/http.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "axle/status.h"
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+namespace {
+
+std::span<const uint8_t> as_bytes(std::string_view str) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return {reinterpret_cast<const uint8_t*>(str.data()), str.size()};
+}
+
+std::string as_string(std::span<const uint8_t> buf) {
+    return {buf.begin(), buf.end()};
+}
+
+} // namespace
+
+TEST(HttpTest, SimpleRequest) {
+    const std::string_view raw =
+        "GET /health?verbose=1 HTTP/1.1\r\n"
+        "Host: localhost:8082\r\n"
+        "Accept:  */*  \r\n"
+        "\r\n";
+
+    HttpRequestParser parser;
+    Status<size_t, HttpError> res = parser.parse(as_bytes(raw));
+    ASSERT_TRUE(res.is_ok());
+    ASSERT_EQ(raw.size(), res.ok());
+
+    const HttpRequest& req = parser.request();
+    ASSERT_EQ("GET", req.method);
+    ASSERT_EQ("/health?verbose=1", req.target);
+    ASSERT_EQ(1, req.version_minor);
+    ASSERT_TRUE(req.keep_alive);
+    ASSERT_EQ(2, req.headers.size());
+    ASSERT_EQ("*/*", req.header("ACCEPT"));
+    ASSERT_EQ("localhost:8082", req.header("host"));
+    ASSERT_EQ(std::nullopt, req.header("content-type"));
+
+    // Header views point into the caller's buffer.
+    ASSERT_EQ(raw.data() + raw.find("localhost"), req.header("host")->data());
+}
+
+TEST(HttpTest, Incremental) {
+    const std::string raw =
+        "POST /api/echo HTTP/1.0\r\n"
+        "Content-Length: 5\r\n"
+        "Connection: keep-alive\r\n"
+        "X-Long-Header-Name-To-Cross-Vector-Boundaries: "
+        "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz\r\n"
+        "\r\n"
+        "hello";
+    const size_t head_len = raw.find("hello");
+
+    HttpRequestParser parser;
+    for (size_t len = 0; len < head_len; ++len) {
+        Status<size_t, HttpError> res = parser.parse(as_bytes(raw).first(len));
+        ASSERT_TRUE(res.is_ok());
+        ASSERT_EQ(0, res.ok());
+    }
+
+    Status<size_t, HttpError> res = parser.parse(as_bytes(raw));
+    ASSERT_TRUE(res.is_ok());
+    ASSERT_EQ(head_len, res.ok());
+    ASSERT_EQ("POST", parser.request().method);
+    ASSERT_EQ(0, parser.request().version_minor);
+    ASSERT_TRUE(parser.request().keep_alive);
+    ASSERT_EQ(5, parser.request().content_length);
+}
+
+TEST(HttpTest, Pipelined) {
+    const std::string raw = "GET /a HTTP/1.1\r\n\r\n"
+                            "GET /b HTTP/1.1\r\nConnection: close\r\n\r\n"
+                            "GET /c HTTP/1.1\r\n";
+
+    HttpRequestParser parser;
+    std::span<const uint8_t> buf = as_bytes(raw);
+
+    Status<size_t, HttpError> res = parser.parse(buf);
+    ASSERT_TRUE(res.is_ok());
+    ASSERT_EQ("/a", parser.request().target);
+    buf = buf.subspan(res.ok());
+    parser.reset();
+
+    res = parser.parse(buf);
+    ASSERT_TRUE(res.is_ok());
+    ASSERT_EQ("/b", parser.request().target);
+    ASSERT_FALSE(parser.request().keep_alive);
+    buf = buf.subspan(res.ok());
+    parser.reset();
+
+    res = parser.parse(buf);
+    ASSERT_TRUE(res.is_ok());
+    ASSERT_EQ(0, res.ok());
+}
+
+TEST(HttpTest, Malformed) {
+    const std::string_view cases[] = {
+        "GET\r\n\r\n",
+        "GET /path\r\n\r\n",
+        "G(T / HTTP/1.1\r\n\r\n",
+    };
+    for (const std::string_view raw : cases) {
+        HttpRequestParser parser;
+        Status<size_t, HttpError> res = parser.parse(as_bytes(raw));
+        ASSERT_TRUE(res.is_err());
+        ASSERT_EQ(HttpError::BAD_REQUEST_LINE, res.err());
+    }
+
+    HttpRequestParser parser;
+    Status<size_t, HttpError> res = parser.parse(as_bytes("GET / HTTP/2.0\r\n\r\n"));
+    ASSERT_TRUE(res.is_err());
+    ASSERT_EQ(HttpError::BAD_VERSION, res.err());
+
+    parser.reset();
+    res = parser.parse(as_bytes("GET / HTTP/1.1\r\nBad Name: x\r\n\r\n"));
+    ASSERT_TRUE(res.is_err());
+    ASSERT_EQ(HttpError::BAD_HEADER, res.err());
+
+    parser.reset();
+    res = parser.parse(as_bytes("GET / HTTP/1.1\r\nName: a\x01z\r\n\r\n"));
+    ASSERT_TRUE(res.is_err());
+    ASSERT_EQ(HttpError::BAD_HEADER, res.err());
+
+    parser.reset();
+    res = parser.parse(
+        as_bytes("GET / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n"));
+    ASSERT_TRUE(res.is_err());
+    ASSERT_EQ(HttpError::BAD_CONTENT_LENGTH, res.err());
+
+    parser.reset();
+    const std::string huge = "GET / HTTP/1.1\r\nX: " +
+                             std::string(HttpRequestParser::k_max_head_sz, 'x') + "\r\n\r\n";
+    res = parser.parse(as_bytes(huge));
+    ASSERT_TRUE(res.is_err());
+    ASSERT_EQ(HttpError::HEAD_TOO_LARGE, res.err());
+}
+
+TEST(HttpTest, TooManyHeaders) {
+    std::string raw = "GET / HTTP/1.1\r\n";
+    for (size_t i = 0; i <= HttpRequestParser::k_max_headers; ++i) {
+        raw += "X-" + std::to_string(i) + ": v\r\n";
+    }
+    raw += "\r\n";
+
+    HttpRequestParser parser;
+    Status<size_t, HttpError> res = parser.parse(as_bytes(raw));
+    ASSERT_TRUE(res.is_err());
+    ASSERT_EQ(HttpError::TOO_MANY_HEADERS, res.err());
+}
+
+TEST(HttpTest, Chunked) {
+    const std::string_view head =
+        "POST /api/echo HTTP/1.1\r\nTransfer-Encoding: gzip, chunked\r\n\r\n";
+    const std::string body = "5\r\nhello\r\n7;ext=1\r\n, world\r\n0\r\nX-Trailer: 1\r\n\r\n";
+
+    HttpRequestParser parser;
+    Status<size_t, HttpError> res = parser.parse(as_bytes(head));
+    ASSERT_TRUE(res.is_ok());
+    ASSERT_TRUE(parser.request().chunked);
+
+    // Feed the body one byte at a time to exercise every state transition.
+    ChunkedDecoder decoder;
+    std::string decoded;
+    for (size_t i = 0; i < body.size(); ++i) {
+        std::span<const uint8_t> buf = as_bytes(body).subspan(i, 1);
+        while (!buf.empty()) {
+            Status<ChunkedResult, HttpError> chunk_res = decoder.decode(buf);
+            ASSERT_TRUE(chunk_res.is_ok());
+            const ChunkedResult chunk = chunk_res.ok();
+            decoded += as_string(chunk.data);
+            buf = buf.subspan(chunk.consumed);
+        }
+    }
+    ASSERT_TRUE(decoder.done());
+    ASSERT_EQ("hello, world", decoded);
+
+    decoder.reset();
+    Status<ChunkedResult, HttpError> chunk_res = decoder.decode(as_bytes("zz\r\n"));
+    ASSERT_TRUE(chunk_res.is_err());
+    ASSERT_EQ(HttpError::BAD_CHUNK, chunk_res.err());
+}
+
+// Every Transfer-Encoding header adds to one list of codings, which must end in a single
+// `chunked`; otherwise the request fails instead of falling back to Content-Length.
+TEST(HttpTest, TransferEncoding) {
+    const std::string_view bad[] = {
+        "Transfer-Encoding: chunked\r\nTransfer-Encoding: identity\r\n",
+        "Transfer-Encoding: chunked\r\nTransfer-Encoding: identity\r\nContent-Length: 4\r\n",
+        "Transfer-Encoding: chunked, gzip\r\n",
+        "Content-Length: 4\r\nTransfer-Encoding: chunked, gzip\r\n",
+        "Transfer-Encoding: gzip\r\n",
+        "Transfer-Encoding: gzip\r\nContent-Length: 4\r\n",
+        "Transfer-Encoding: chunked\r\nTransfer-Encoding: chunked\r\n",
+    };
+    for (const std::string_view headers : bad) {
+        const std::string raw = "POST / HTTP/1.1\r\n" + std::string(headers) + "\r\n";
+        HttpRequestParser parser;
+        Status<size_t, HttpError> res = parser.parse(as_bytes(raw));
+        ASSERT_TRUE(res.is_err()) << headers;
+        ASSERT_EQ(HttpError::BAD_TRANSFER_ENCODING, res.err()) << headers;
+    }
+
+    const std::string_view good[] = {
+        "Transfer-Encoding: gzip\r\nTransfer-Encoding: chunked\r\n",
+        "Transfer-Encoding: gzip\r\nTransfer-Encoding: chunked\r\nContent-Length: 4\r\n",
+    };
+    for (const std::string_view headers : good) {
+        const std::string raw = "POST / HTTP/1.1\r\n" + std::string(headers) + "\r\n";
+        HttpRequestParser parser;
+        Status<size_t, HttpError> res = parser.parse(as_bytes(raw));
+        ASSERT_TRUE(res.is_ok()) << headers;
+        EXPECT_TRUE(parser.request().chunked) << headers;
+        EXPECT_EQ(0, parser.request().content_length) << headers;
+    }
+}
+
+} // namespace axle
+// NOLINTEND(readability-function-cognitive-complexity)
@@ -0,0 +1,192 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "kv_server/cache.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+namespace {
+
+// Items of a 6-byte key and this much value fill the smallest chunks, 64 bytes, exactly.
+constexpr size_t k_small_value_sz = 64 - sizeof(kv::Item) - 6;
+constexpr size_t k_small_per_page = kv::Cache::k_page_sz / 64;
+
+std::string key_of(size_t idx) {
+    std::string key = std::to_string(idx);
+
+    return "k" + std::string(5 - key.size(), '0') + key;
+}
+
+std::vector<uint8_t> value_of(size_t sz, uint8_t fill) {
+    return std::vector<uint8_t>(sz, fill);
+}
+
+bool set(kv::Cache& cache, std::string_view key, const std::vector<uint8_t>& value) {
+    return cache.set(key, 0, 0, value);
+}
+
+// The value stored under `key`, or "miss".
+std::string lookup(kv::Cache& cache, std::string_view key) {
+    const kv::Item* item = cache.get(key, 0);
+    if (item == nullptr) {
+        return "miss";
+    }
+    const std::span<const uint8_t> value = item->value();
+
+    return {value.begin(), value.end()};
+}
+
+// `cnt` keys that all start their probe in the same slot of a table of `slots` slots.
+std::vector<std::string> colliding_keys(size_t cnt, size_t slots, size_t home) {
+    std::vector<std::string> keys;
+    for (size_t idx = 0; keys.size() < cnt; ++idx) {
+        const std::string key = "c" + std::to_string(idx);
+        if ((kv::hash_key(key) & (slots - 1)) == home) {
+            keys.push_back(key);
+        }
+    }
+
+    return keys;
+}
+
+} // namespace
+
+TEST(KvCacheTest, Overwrite) {
+    kv::Cache cache{2 * kv::Cache::k_page_sz};
+
+    ASSERT_TRUE(set(cache, "key", value_of(4, 'a')));
+    ASSERT_TRUE(set(cache, "key", value_of(2, 'b')));
+    EXPECT_EQ("bb", lookup(cache, "key"));
+    EXPECT_EQ(1, cache.stats().items);
+
+    // Into another size class, which frees the old chunk.
+    ASSERT_TRUE(set(cache, "key", value_of(500, 'c')));
+    EXPECT_EQ(std::string(500, 'c'), lookup(cache, "key"));
+    EXPECT_EQ(1, cache.stats().items);
+
+    // Overwriting reuses the chunk it frees: a full page takes any number of them.
+    kv::Cache full{kv::Cache::k_page_sz};
+    for (size_t i = 0; i < k_small_per_page; ++i) {
+        ASSERT_TRUE(set(full, key_of(i), value_of(k_small_value_sz, 'x')));
+    }
+    for (size_t i = 0; i < 4 * k_small_per_page; ++i) {
+        ASSERT_TRUE(set(full, key_of(i % 16), value_of(k_small_value_sz, 'y')));
+    }
+    EXPECT_EQ(k_small_per_page, full.stats().items);
+    EXPECT_EQ(0, full.stats().evictions);
+    EXPECT_EQ(std::string(k_small_value_sz, 'y'), lookup(full, key_of(15)));
+    EXPECT_EQ(std::string(k_small_value_sz, 'x'), lookup(full, key_of(16)));
+}
+
+TEST(KvCacheTest, EvictsWhenClassIsFull) {
+    constexpr size_t extra = 100;
+    kv::Cache cache{kv::Cache::k_page_sz};
+    for (size_t i = 0; i < k_small_per_page; ++i) {
+        ASSERT_TRUE(set(cache, key_of(i), value_of(k_small_value_sz, 'x')));
+    }
+    EXPECT_EQ(0, cache.stats().evictions);
+
+    // A read keeps the first item through the first turn of the hand.
+    EXPECT_NE("miss", lookup(cache, key_of(0)));
+    for (size_t i = k_small_per_page; i < k_small_per_page + extra; ++i) {
+        ASSERT_TRUE(set(cache, key_of(i), value_of(k_small_value_sz, 'x')));
+    }
+
+    EXPECT_EQ(extra, cache.stats().evictions);
+    EXPECT_EQ(k_small_per_page, cache.stats().items);
+    EXPECT_EQ(kv::Cache::k_page_sz, cache.stats().bytes_allocated);
+    EXPECT_NE("miss", lookup(cache, key_of(0)));
+    for (size_t i = 1; i <= extra; ++i) {
+        EXPECT_EQ("miss", lookup(cache, key_of(i)));
+    }
+    for (size_t i = extra + 1; i < k_small_per_page + extra; ++i) {
+        EXPECT_NE("miss", lookup(cache, key_of(i)));
+    }
+}
+
+// A size class that appears once the memory is spent takes the last page of the class holding the
+// most, and everything stored on it is gone.
+TEST(KvCacheTest, StealsPageForNewClass) {
+    kv::Cache cache{2 * kv::Cache::k_page_sz};
+    for (size_t i = 0; i < 2 * k_small_per_page; ++i) {
+        ASSERT_TRUE(set(cache, key_of(i), value_of(k_small_value_sz, 'x')));
+    }
+    EXPECT_EQ(2 * k_small_per_page, cache.stats().items);
+
+    ASSERT_TRUE(set(cache, "large", value_of(1000, 'l')));
+    EXPECT_EQ(std::string(1000, 'l'), lookup(cache, "large"));
+    EXPECT_EQ(k_small_per_page, cache.stats().evictions);
+    EXPECT_EQ(k_small_per_page + 1, cache.stats().items);
+    EXPECT_EQ(2 * kv::Cache::k_page_sz, cache.stats().bytes_allocated);
+
+    // Chunks are handed out front to back, so the second page held the later keys.
+    size_t hits = 0;
+    for (size_t i = 0; i < 2 * k_small_per_page; ++i) {
+        const bool hit = lookup(cache, key_of(i)) != "miss";
+        EXPECT_EQ(i < k_small_per_page, hit) << key_of(i);
+        hits += hit ? 1 : 0;
+    }
+    EXPECT_EQ(k_small_per_page, hits);
+
+    // The smaller class carries on in the page it has left, evicting as it goes.
+    ASSERT_TRUE(set(cache, "small", value_of(k_small_value_sz - 1, 's')));
+    EXPECT_EQ(k_small_per_page + 1, cache.stats().items);
+    EXPECT_EQ(k_small_per_page + 1, cache.stats().evictions);
+    EXPECT_NE("miss", lookup(cache, "small"));
+    EXPECT_EQ(std::string(1000, 'l'), lookup(cache, "large"));
+
+    // Deleting what is left brings the count back to zero.
+    ASSERT_TRUE(cache.del("small"));
+    ASSERT_TRUE(cache.del("large"));
+    for (size_t i = 0; i < k_small_per_page; ++i) {
+        (void)cache.del(key_of(i));
+    }
+    EXPECT_EQ(0, cache.stats().items);
+}
+
+// Deleting from the middle of a probe chain keeps the keys after it reachable, including around
+// the end of the table.
+TEST(KvCacheTest, DeletesInProbeChains) {
+    constexpr size_t slots = 1024;
+    for (const size_t home : {size_t{17}, slots - 2}) {
+        kv::Cache cache{kv::Cache::k_page_sz};
+        const std::vector<std::string> keys = colliding_keys(5, slots, home);
+        for (const std::string& key : keys) {
+            ASSERT_TRUE(set(cache, key, value_of(1, 'v')));
+        }
+        // A key whose own slot the chain has taken, pushed past its end.
+        const std::vector<std::string> next = colliding_keys(1, slots, (home + 2) & (slots - 1));
+        ASSERT_TRUE(set(cache, next[0], value_of(1, 'n')));
+
+        ASSERT_TRUE(cache.del(keys[1]));
+        ASSERT_TRUE(cache.del(keys[3]));
+        EXPECT_FALSE(cache.del(keys[3]));
+        EXPECT_EQ("miss", lookup(cache, keys[1]));
+        EXPECT_EQ("miss", lookup(cache, keys[3]));
+        for (const size_t idx : {0, 2, 4}) {
+            EXPECT_EQ("v", lookup(cache, keys[idx])) << home << " " << idx;
+        }
+        EXPECT_EQ("n", lookup(cache, next[0])) << home;
+
+        ASSERT_TRUE(cache.del(keys[0]));
+        EXPECT_EQ("v", lookup(cache, keys[4])) << home;
+        EXPECT_EQ("n", lookup(cache, next[0])) << home;
+
+        // Deleted keys can come back into the chain.
+        ASSERT_TRUE(set(cache, keys[1], value_of(1, 'w')));
+        EXPECT_EQ("w", lookup(cache, keys[1]));
+        EXPECT_EQ(4, cache.stats().items);
+    }
+}
+
+} // namespace axle
+// NOLINTEND(readability-function-cognitive-complexity)
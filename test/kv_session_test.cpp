@@ -0,0 +1,86 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "kv_server/session.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "kv_server/cache.h"
+
+#include "axle/event.h"
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+namespace {
+
+// Hands `input` to the session the way a connection would, in reads of at most `read_sz` bytes.
+void feed(kv::Session& session, std::string_view input, size_t read_sz) {
+    while (!input.empty()) {
+        const std::span<uint8_t> buf = session.recv_buf(std::min(read_sz, input.size()));
+        ASSERT_FALSE(buf.empty());
+        std::copy_n(input.begin(), buf.size(), buf.begin());
+        input.remove_prefix(buf.size());
+        session.post_recv(buf);
+    }
+}
+
+// Everything the session has to send.
+std::string take_output(kv::Session& session) {
+    std::string out;
+    for (;;) {
+        const std::span<const uint8_t> buf = session.send_buf(64 * 1024);
+        if (buf.empty()) {
+            return out;
+        }
+        out.append(buf.begin(), buf.end());
+        session.post_send(static_cast<int64_t>(buf.size()));
+    }
+}
+
+} // namespace
+
+// The data block of a value too large to store is skipped as it arrives, however it is split
+// into reads, and none of it is taken for commands.
+TEST(KvSessionTest, SkipsOversizedValue) {
+    EventLoop loop;
+    kv::Cache cache{4 * kv::Cache::k_page_sz};
+    const std::shared_ptr<kv::Session> session =
+        std::make_shared<kv::Session>(loop, cache, std::chrono::steady_clock::now());
+
+    feed(*session, "set key 0 0 1\r\nv\r\n", 1024);
+    ASSERT_EQ("STORED\r\n", take_output(*session));
+
+    // Commands buried in the value, both in the first read and well past it.
+    const std::string injected = "delete key\r\nset key 0 0 1\r\nx\r\n";
+    std::string value = injected + std::string(kv::Session::k_max_buf_sz, 'a');
+    value += injected;
+    const std::string oversized =
+        "set big 0 0 " + std::to_string(value.size()) + "\r\n" + value + "\r\n";
+
+    for (const size_t read_sz : {size_t{1000}, size_t{64} * 1024}) {
+        feed(*session, oversized + "get key\r\n", read_sz);
+        EXPECT_EQ("SERVER_ERROR object too large for cache\r\n"
+                  "VALUE key 0 1\r\nv\r\nEND\r\n",
+                  take_output(*session))
+            << read_sz;
+    }
+    EXPECT_EQ(1, cache.stats().items);
+
+    // Skipping stops at the end of the data block when none of it came with the command line.
+    feed(*session, "set big 0 0 " + std::to_string(kv::Session::k_max_buf_sz) + "\r\n", 1024);
+    EXPECT_EQ("SERVER_ERROR object too large for cache\r\n", take_output(*session));
+    feed(*session, std::string(kv::Session::k_max_buf_sz + 2, 'b') + "version\r\n", 4096);
+    EXPECT_EQ("VERSION axle-kv\r\n", take_output(*session));
+}
+
+} // namespace axle
+// NOLINTEND(readability-function-cognitive-complexity)
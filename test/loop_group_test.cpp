@@ -0,0 +1,95 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "axle/loop_group.h"
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "axle/event.h"
+#include "axle/status.h"
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+TEST(LoopGroupTest, StartStop) {
+    LoopGroup group{{{0}, {}}};
+    std::vector<int> init_cpus(group.size(), -1);
+    std::vector<std::thread::id> init_threads(group.size());
+    std::atomic_int fired = 0;
+
+    const LoopInitCb init = [&](size_t idx, const std::shared_ptr<EventLoop>& loop) {
+#if defined(__linux__)
+        init_cpus[idx] = sched_getcpu();
+#endif
+        init_threads[idx] = std::this_thread::get_id();
+        const TimerEventCb cb = [&](uint64_t, Status<None, int64_t>) { ++fired; };
+        ASSERT_TRUE(loop->register_timer(1, 1e6, false /* periodic */, cb).is_ok());
+    };
+
+    const Status<None, int> res = group.start(init);
+    ASSERT_TRUE(res.is_ok());
+
+    ASSERT_EQ(2, group.size());
+    ASSERT_EQ(0, group.cpu(0));
+    ASSERT_EQ(-1, group.cpu(1));
+    ASSERT_EQ(-1, group.node(1));
+    ASSERT_NE(nullptr, group.loop(0));
+    ASSERT_NE(group.loop(0), group.loop(1));
+    ASSERT_NE(init_threads[0], init_threads[1]);
+    ASSERT_NE(std::this_thread::get_id(), init_threads[0]);
+#if defined(__linux__)
+    ASSERT_EQ(0, init_cpus[0]);
+#endif
+
+    while (fired.load() != 2) {
+        std::this_thread::yield();
+    }
+
+    group.stop();
+}
+
+TEST(LoopGroupTest, BadCpu) {
+    LoopGroup group{{{0}, {1 << 20}}};
+
+    const Status<None, int> res = group.start([](size_t, const std::shared_ptr<EventLoop>&) {});
+#if defined(__APPLE__)
+    // Affinity tags are only hints, so there is nothing to reject.
+    ASSERT_TRUE(res.is_ok());
+#else
+    ASSERT_TRUE(res.is_err());
+#endif
+}
+
+// An exception from `init` fails the start with the error it carries, or `EINVAL`.
+TEST(LoopGroupTest, InitThrows) {
+    LoopGroup group{{{}}};
+    Status<None, int> res = group.start([](size_t, const std::shared_ptr<EventLoop>&) {
+        throw std::system_error(EADDRINUSE, std::generic_category(), "listen");
+    });
+    ASSERT_TRUE(res.is_err());
+    EXPECT_EQ(EADDRINUSE, res.err());
+
+    LoopGroup other{{{}}};
+    res = other.start([](size_t, const std::shared_ptr<EventLoop>&) {
+        errno = EBADF;
+        throw std::runtime_error("init failed");
+    });
+    ASSERT_TRUE(res.is_err());
+    EXPECT_EQ(EINVAL, res.err());
+}
+
+} // namespace axle
+// NOLINTEND(readability-function-cognitive-complexity)
@@ -0,0 +1,185 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "axle/proxy.h"
+
+#include <sys/socket.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "axle/event.h"
+#include "axle/socket.h"
+#include "axle/status.h"
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+namespace {
+
+std::vector<uint8_t> pattern(size_t len) {
+    std::vector<uint8_t> data(len);
+    for (size_t i = 0; i < len; ++i) {
+        data[i] = static_cast<uint8_t>(i * 7);
+    }
+
+    return data;
+}
+
+// Reads until EOF.
+std::vector<uint8_t> recv_all(const Socket& socket) {
+    std::vector<uint8_t> data;
+    std::array<uint8_t, 64 * 1024> buf{};
+    for (;;) {
+        Status<std::span<uint8_t>, int> res = socket.recv_some(buf);
+        if (res.is_err() || res.ok().empty()) {
+            return data;
+        }
+        data.insert(data.end(), res.ok().begin(), res.ok().end());
+    }
+}
+
+// Sends a request through a proxy and half-closes; the upstream answers only once it has read the
+// whole request, then closes in turn.
+void round_trip(RelayMode mode, int port, int upstream_port) {
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    const std::vector<uint8_t> request = pattern(1024 * 1024);
+    const std::vector<uint8_t> response = pattern(300 * 1024 + 1);
+
+    const ServerSocket upstream;
+    ASSERT_TRUE(upstream.listen(upstream_port, 1).is_ok());
+    ProxyServer proxy{loop, port, "127.0.0.1", upstream_port, mode};
+    proxy.start();
+
+    std::thread upstream_thread{[&] {
+        Status<Socket, int> accepted = upstream.accept();
+        ASSERT_TRUE(accepted.is_ok());
+        const Socket peer = accepted.ok();
+        EXPECT_EQ(request, recv_all(peer));
+        ASSERT_TRUE(peer.send_all(response).is_ok());
+    }};
+
+    std::thread client_thread{[&] {
+        const ClientSocket client;
+        ASSERT_TRUE(client.connect("127.0.0.1", port).is_ok());
+        ASSERT_TRUE(client.send_all(request).is_ok());
+        ASSERT_TRUE(client.shutdown_write().is_ok());
+        EXPECT_EQ(response, recv_all(client));
+
+        ASSERT_TRUE(loop->post([&] {
+                            // Both half-closes were passed on, so the relay is over.
+                            EXPECT_EQ(0, proxy.active());
+                            EXPECT_EQ(request.size(), proxy.closed_stats().upstream_bytes);
+                            EXPECT_EQ(response.size(), proxy.closed_stats().downstream_bytes);
+                            ASSERT_TRUE(loop->shutdown().is_ok());
+                        })
+                        .is_ok());
+    }};
+
+    loop->run();
+    upstream_thread.join();
+    client_thread.join();
+}
+
+} // namespace
+
+TEST(ProxyTest, CopyRoundTrip) {
+    round_trip(RelayMode::COPY, 8094, 8095);
+}
+
+TEST(ProxyTest, SpliceRoundTrip) {
+    if (!splice_supported()) {
+        GTEST_SKIP() << "splice is not supported";
+    }
+
+    round_trip(RelayMode::SPLICE, 8096, 8097);
+}
+
+TEST(ProxyTest, PipePoolReuses) {
+    if (!splice_supported()) {
+        GTEST_SKIP() << "splice is not supported";
+    }
+
+    PipePool pipes{128 * 1024, 1};
+    Status<Pipe, int> first = pipes.acquire();
+    ASSERT_TRUE(first.is_ok());
+    const Pipe pipe = first.ok();
+    ASSERT_GE(pipe.capacity, 128 * 1024);
+
+    pipes.release(pipe, true);
+    ASSERT_EQ(1, pipes.idle());
+    Status<Pipe, int> second = pipes.acquire();
+    ASSERT_TRUE(second.is_ok());
+    ASSERT_EQ(pipe.read_fd, second.ok().read_fd);
+
+    // Full, and possibly holding data: both are closed.
+    Status<Pipe, int> third = pipes.acquire();
+    ASSERT_TRUE(third.is_ok());
+    pipes.release(second.ok(), true);
+    pipes.release(third.ok(), false);
+    ASSERT_EQ(1, pipes.idle());
+}
+
+// A receiver that does not read stops the relay reading from the sender, which then blocks
+// instead of the relay buffering its data.
+TEST(ProxyTest, Backpressure) {
+    const bool splice = splice_supported();
+    for (const RelayMode mode : {RelayMode::COPY, RelayMode::SPLICE}) {
+        if (mode == RelayMode::SPLICE && !splice) {
+            continue;
+        }
+
+        const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+        const std::vector<uint8_t> data = pattern(16 * 1024 * 1024);
+        std::array<int, 2> down{};
+        std::array<int, 2> up{};
+        ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, down.data()));
+        ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, up.data()));
+        const Socket sender{down[0]};
+        const Socket receiver{up[0]};
+
+        PipePool pipes{0, 2};
+        int result = -1;
+        Relay relay{loop, Socket{down[1]}, Socket{up[1]}, mode, &pipes, [&](int err) {
+                        result = err;
+                        ASSERT_TRUE(loop->shutdown().is_ok());
+                    }};
+        ASSERT_TRUE(relay.start().is_ok());
+
+        std::atomic_bool sent{false};
+        std::thread sender_thread{[&] {
+            ASSERT_TRUE(sender.send_all(data).is_ok());
+            sent.store(true);
+            ASSERT_TRUE(sender.shutdown_write().is_ok());
+        }};
+
+        std::thread receiver_thread{[&] {
+            std::this_thread::sleep_for(std::chrono::milliseconds{100});
+            EXPECT_FALSE(sent.load());
+
+            // The other direction ends at once, leaving this one to finish the relay.
+            ASSERT_TRUE(receiver.shutdown_write().is_ok());
+            EXPECT_EQ(data, recv_all(receiver));
+        }};
+
+        loop->run();
+        sender_thread.join();
+        receiver_thread.join();
+
+        ASSERT_EQ(0, result);
+        ASSERT_EQ(data.size(), relay.stats().upstream_bytes);
+        ASSERT_EQ(0, relay.stats().downstream_bytes);
+    }
+}
+
+} // namespace axle
+// NOLINTEND(readability-function-cognitive-complexity)
@@ -0,0 +1,276 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "axle/rate_limit.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "echo.h"
+
+#include "axle/event.h"
+#include "axle/sim.h"
+#include "axle/socket.h"
+#include "axle/status.h"
+#include "axle/tcp.h"
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+namespace {
+
+// Runs a loop on a thread of its own for the length of a test, and stops it however the test
+// ends, so that a failed assertion cannot leave it running.
+class LoopThread {
+  public:
+    LoopThread(const LoopThread&) = delete;
+    LoopThread& operator=(const LoopThread&) = delete;
+    LoopThread(LoopThread&&) = delete;
+    LoopThread& operator=(LoopThread&&) = delete;
+
+    explicit LoopThread(std::shared_ptr<EventLoop> loop)
+        : loop_{std::move(loop)},
+          thread_{[this] { loop_->run(); }} {}
+
+    ~LoopThread() {
+        EXPECT_TRUE(loop_->shutdown().is_ok());
+        thread_.join();
+    }
+
+  private:
+    std::shared_ptr<EventLoop> loop_;
+    std::thread thread_;
+};
+
+// Counts newline-terminated messages for message rate limits.
+class LineSession : public EchoSession {
+  public:
+    explicit LineSession(const EchoConfig& config)
+        : EchoSession{config} {}
+
+    void post_recv(std::span<uint8_t> buf) {
+        messages_ += std::ranges::count(buf, '\n');
+        EchoSession::post_recv(buf);
+    }
+
+    size_t take_messages() {
+        return std::exchange(messages_, 0);
+    }
+
+  private:
+    size_t messages_ = 0;
+};
+
+class LineServer : public TcpServer<LineSession, LineServer> {
+  public:
+    LineServer(const std::shared_ptr<EventLoop>& event_loop, int port)
+        : TcpServer(event_loop, port) {
+        set_write_coalescing();
+    }
+
+    std::shared_ptr<LineSession> handle_connection() {
+        return std::make_shared<LineSession>(EchoConfig{});
+    }
+};
+
+} // namespace
+
+TEST(RateLimitTest, TokenBucket) {
+    const Rate rate{.per_second = 1000, .burst = 100};
+    constexpr uint64_t ms = 1000 * 1000;
+    TokenBucket bucket;
+
+    // Starts full and never holds more than the burst.
+    ASSERT_DOUBLE_EQ(100, bucket.refill(rate, 5 * ms));
+    ASSERT_DOUBLE_EQ(100, bucket.refill(rate, 50 * ms));
+
+    bucket.take(150);
+    ASSERT_DOUBLE_EQ(-50, bucket.refill(rate, 50 * ms));
+    ASSERT_EQ(60 * ms, bucket.wait_ns(rate, 10));
+
+    ASSERT_DOUBLE_EQ(10, bucket.refill(rate, 110 * ms));
+    ASSERT_EQ(0, bucket.wait_ns(rate, 10));
+}
+
+// On a simulated clock, which starts at zero and stands still while callbacks run, a bucket
+// emptied at time zero stays empty until time moves on.
+TEST(RateLimitTest, BucketOnVirtualTime) {
+    const std::shared_ptr<SimBackend> sim = std::make_shared<SimBackend>();
+    EventLoop ev_loop{sim};
+    const Rate rate{.per_second = 1000, .burst = 100};
+    constexpr size_t total = 1100;
+    const std::array<int, 2> fds =
+        sim->socket_pair(SimLinkConfig{.capacity = total, .max_read = 64});
+    ASSERT_TRUE(sim->write(fds[0], std::vector<uint8_t>(total, 'x')).is_ok());
+
+    const auto now_ns = [&] {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         ev_loop.now().time_since_epoch())
+                                         .count());
+    };
+    TokenBucket bucket;
+    size_t received = 0;
+    std::vector<uint64_t> pauses;
+
+    // Reads what the bucket allows and, once it is empty, stops reading until it has refilled.
+    FdEventIOCb on_read;
+    on_read = [&](uint64_t, Status<int64_t, uint32_t>) {
+        const double tokens = bucket.refill(rate, now_ns());
+        if (tokens < 1) {
+            pauses.push_back(now_ns());
+            EXPECT_TRUE(ev_loop.remove_fd_read(fds[1]).is_ok());
+            EXPECT_TRUE(ev_loop
+                            .register_timer(1,
+                                            bucket.wait_ns(rate, 1),
+                                            false /* periodic */,
+                                            [&](uint64_t, Status<None, int64_t>) {
+                                                EXPECT_TRUE(
+                                                    ev_loop.register_fd_read(fds[1], on_read)
+                                                        .is_ok());
+                                            })
+                            .is_ok());
+
+            return;
+        }
+
+        std::vector<uint8_t> buf(static_cast<size_t>(tokens));
+        Status<size_t, int> res = sim->read(fds[1], buf);
+        ASSERT_TRUE(res.is_ok());
+        bucket.take(static_cast<double>(res.ok()));
+        received += res.ok();
+        if (received == total) {
+            EXPECT_TRUE(ev_loop.shutdown().is_ok());
+        }
+    };
+    ASSERT_TRUE(ev_loop.register_fd_read(fds[1], on_read).is_ok());
+
+    ev_loop.run();
+
+    ASSERT_EQ(total, received);
+    // The burst at time zero and the remaining 1000 bytes at 1000 a second.
+    ASSERT_FALSE(pauses.empty());
+    EXPECT_EQ(0, pauses.front());
+    EXPECT_GE(now_ns(), uint64_t{1000} * 1000 * 1000);
+    EXPECT_LT(now_ns(), uint64_t{1100} * 1000 * 1000);
+}
+
+TEST(RateLimitTest, ConnectionBytes) {
+    constexpr int port = 8091;
+    constexpr size_t total = 8000;
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+
+    EchoServer server{loop, port, {.buf_sz = size_t{16} * 1024, .coalesce = false}};
+    RateLimits limits;
+    limits.conn_bytes = Rate{.per_second = 16000, .burst = 2000};
+    server.set_rate_limits(limits);
+    server.start();
+    const LoopThread loop_thread{loop};
+
+    const ClientSocket client;
+    ASSERT_TRUE(client.connect("127.0.0.1", port).is_ok());
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const std::string msg(total, 'x');
+    ASSERT_EQ(msg, echo(client, msg));
+
+    // The burst goes through at once and the remaining 6000 bytes at 16000 a second.
+    ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds{300});
+}
+
+// Input that arrives along with the end of input while the connection is paused is read, and
+// echoed, before the connection closes.
+TEST(RateLimitTest, EndOfInputWhilePaused) {
+    constexpr int port = 8118;
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+
+    LineServer server{loop, port};
+    RateLimits limits;
+    limits.conn_messages = Rate{.per_second = 4, .burst = 1};
+    server.set_rate_limits(limits);
+    server.start();
+    const LoopThread loop_thread{loop};
+
+    const ClientSocket client;
+    ASSERT_TRUE(client.connect("127.0.0.1", port).is_ok());
+    // Spends the burst, which pauses the connection for a quarter of a second.
+    ASSERT_EQ("m\n", echo(client, "m\n"));
+
+    const std::string last = "n\n";
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    const std::span<const uint8_t> out{reinterpret_cast<const uint8_t*>(last.data()), last.size()};
+    ASSERT_TRUE(client.send_all(out).is_ok());
+    ASSERT_TRUE(client.shutdown_write().is_ok());
+
+    std::string reply;
+    std::array<uint8_t, 1024> buf{};
+    for (;;) {
+        Status<std::span<uint8_t>, int> res = client.recv_some(buf);
+        ASSERT_TRUE(res.is_ok());
+        if (res.ok().empty()) {
+            break;
+        }
+        reply.append(res.ok().begin(), res.ok().end());
+    }
+    EXPECT_EQ(last, reply);
+}
+
+// Connections beyond the accept burst wait in the listener's backlog and are taken at the rate.
+TEST(RateLimitTest, Accepts) {
+    constexpr int port = 8119;
+    constexpr size_t client_cnt = 6;
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+
+    EchoServer server{loop, port};
+    RateLimits limits;
+    limits.accepts = Rate{.per_second = 20, .burst = 2};
+    server.set_rate_limits(limits);
+    server.start();
+    const LoopThread loop_thread{loop};
+
+    std::array<ClientSocket, client_cnt> clients;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (const ClientSocket& client : clients) {
+        ASSERT_TRUE(client.connect("127.0.0.1", port).is_ok());
+    }
+    for (const ClientSocket& client : clients) {
+        ASSERT_EQ("ping", echo(client, "ping"));
+    }
+
+    // Two at once and the other four at 20 a second.
+    ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds{150});
+}
+
+TEST(RateLimitTest, ConnectionMessages) {
+    constexpr int port = 8120;
+    constexpr size_t round_trips = 20;
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+
+    LineServer server{loop, port};
+    RateLimits limits;
+    limits.conn_messages = Rate{.per_second = 50, .burst = 5};
+    server.set_rate_limits(limits);
+    server.start();
+    const LoopThread loop_thread{loop};
+
+    const ClientSocket client;
+    ASSERT_TRUE(client.connect("127.0.0.1", port).is_ok());
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < round_trips; ++i) {
+        ASSERT_EQ("m\n", echo(client, "m\n"));
+    }
+
+    // Five at once and the other fifteen at 50 a second.
+    ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds{250});
+}
+
+} // namespace axle
+// NOLINTEND(readability-function-cognitive-complexity)
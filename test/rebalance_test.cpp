@@ -0,0 +1,146 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "axle/rebalance.h"
+
+#include <cerrno>
+#include <cstddef>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "echo.h"
+
+#include "axle/event.h"
+#include "axle/socket.h"
+#include "axle/status.h"
+#include "axle/tcp.h"
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+TEST(RebalanceTest, Migrate) {
+    constexpr int port = 8098;
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    const std::shared_ptr<EventLoop> other_loop = std::make_shared<EventLoop>();
+    EchoServer server{loop, port};
+    EchoServer target{other_loop, port + 1};
+    server.start();
+    target.start();
+
+    std::thread other_thread{[&] { other_loop->run(); }};
+    const std::thread::id other_id = other_thread.get_id();
+
+    std::thread client_thread{[&] {
+        const ClientSocket client;
+        ASSERT_TRUE(client.connect("127.0.0.1", port).is_ok());
+        ASSERT_EQ("one", echo(client, "one"));
+
+        ASSERT_TRUE(loop->post([&] {
+                            for (const ConnActivity& conn : server.take_activity()) {
+                                EXPECT_GE(conn.read_events, 1);
+                                ASSERT_TRUE(server.migrate(conn.handle, target).is_ok());
+                            }
+                            EXPECT_EQ(0, server.connections());
+                        })
+                        .is_ok());
+        // Races with the move: whether it arrives before the connection is registered on the
+        // other loop or after, it is answered from there.
+        ASSERT_EQ("two", echo(client, "two"));
+        ASSERT_EQ("three", echo(client, "three"));
+
+        // Checked while the client is still connected.
+        std::promise<void> checked;
+        ASSERT_TRUE(other_loop->post([&] {
+                                  EXPECT_EQ(1, target.connections());
+                                  ASSERT_EQ(1, target.migrated().size());
+                                  const std::vector<std::thread::id>& readers =
+                                      target.migrated()[0]->readers();
+                                  EXPECT_NE(other_id, readers.front());
+                                  EXPECT_EQ(other_id, readers.back());
+                                  checked.set_value();
+                              })
+                        .is_ok());
+        checked.get_future().wait();
+
+        ASSERT_TRUE(other_loop->shutdown().is_ok());
+        ASSERT_TRUE(loop->shutdown().is_ok());
+    }};
+
+    loop->run();
+    client_thread.join();
+    other_thread.join();
+}
+
+TEST(RebalanceTest, MigrateClosed) {
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    EchoServer server{loop, 8100};
+    EchoServer target{loop, 8101};
+
+    Status<None, int> res = server.migrate(ConnHandle{0, 0}, target);
+    ASSERT_TRUE(res.is_err());
+    ASSERT_EQ(ENOTCONN, res.err());
+}
+
+// Every connection lands on one loop and keeps it busy; the rebalancer spreads them out without
+// emptying either loop.
+TEST(RebalanceTest, ShedsLoad) {
+    constexpr int port = 8102;
+    constexpr size_t clients = 4;
+    const std::array<std::shared_ptr<EventLoop>, 2> loops{std::make_shared<EventLoop>(),
+                                                           std::make_shared<EventLoop>()};
+    const EchoConfig echo_config{.work = std::chrono::microseconds{300}};
+    EchoServer busy_server{loops[0], port, echo_config};
+    EchoServer idle_server{loops[1], port + 1, echo_config};
+    busy_server.start();
+    idle_server.start();
+
+    RebalanceConfig config;
+    config.interval = std::chrono::milliseconds{50};
+    Rebalancer<EchoServer> rebalancer{2, config};
+    ASSERT_TRUE(rebalancer.join(0, busy_server).is_ok());
+    ASSERT_TRUE(rebalancer.join(1, idle_server).is_ok());
+
+    std::thread idle_thread{[&] { loops[1]->run(); }};
+
+    std::atomic_bool done{false};
+    std::vector<std::thread> client_threads;
+    for (size_t i = 0; i < clients; ++i) {
+        client_threads.emplace_back([&] {
+            const ClientSocket client;
+            ASSERT_TRUE(client.connect("127.0.0.1", port).is_ok());
+            while (!done.load()) {
+                ASSERT_EQ("x", echo(client, "x"));
+            }
+        });
+    }
+
+    std::thread control_thread{[&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds{1000});
+        done.store(true);
+        for (std::thread& client : client_threads) {
+            client.join();
+        }
+
+        ASSERT_TRUE(loops[1]->shutdown().is_ok());
+        ASSERT_TRUE(loops[0]->shutdown().is_ok());
+    }};
+
+    loops[0]->run();
+    control_thread.join();
+    idle_thread.join();
+
+    EXPECT_GT(rebalancer.moved(0), 0);
+    // The loops fell into step instead of trading connections back and forth.
+    EXPECT_LE(rebalancer.moved(0) + rebalancer.moved(1), clients);
+    EXPECT_GT(idle_server.migrated().size(), 0);
+}
+
+} // namespace axle
+// NOLINTEND(readability-function-cognitive-complexity)
@@ -0,0 +1,350 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "axle/sim.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "axle/event.h"
+#include "axle/status.h"
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+namespace {
+
+std::span<const uint8_t> as_bytes(std::string_view str) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return {reinterpret_cast<const uint8_t*>(str.data()), str.size()};
+}
+
+// Reads what `fd` has, at most `max` bytes, as a string. Empty on `EAGAIN` and at the end of input.
+std::string read_some(SimBackend& sim, int fd, size_t max = 1024) {
+    std::vector<uint8_t> buf(max);
+    Status<size_t, int> res = sim.read(fd, buf);
+    if (res.is_err()) {
+        return {};
+    }
+
+    return {buf.begin(), buf.begin() + static_cast<ptrdiff_t>(res.ok())};
+}
+
+} // namespace
+
+TEST(SimTest, TimersRunOnVirtualTime) {
+    const std::shared_ptr<SimBackend> sim = std::make_shared<SimBackend>();
+    EventLoop ev_loop{sim};
+    const std::chrono::steady_clock::time_point start = ev_loop.now();
+    const std::chrono::steady_clock::time_point real_start = std::chrono::steady_clock::now();
+    constexpr uint64_t delay = 5e8;
+    int ticks = 0;
+
+    // The same periodic timer as the kernel-backed test, over two seconds that take no time.
+    ASSERT_TRUE(ev_loop
+                    .register_timer(1,
+                                    delay,
+                                    true /* periodic */,
+                                    [&](uint64_t, Status<None, int64_t> status) {
+                                        EXPECT_TRUE(status.is_ok());
+                                        if (++ticks == 4) {
+                                            EXPECT_TRUE(ev_loop.shutdown().is_ok());
+                                        }
+                                    })
+                    .is_ok());
+
+    ev_loop.run();
+
+    ASSERT_EQ(4, ticks);
+    ASSERT_EQ(std::chrono::nanoseconds{4 * delay}, ev_loop.now() - start);
+    ASSERT_LT(std::chrono::steady_clock::now() - real_start, std::chrono::milliseconds{400});
+    ASSERT_EQ(4, sim->stats().skips);
+}
+
+TEST(SimTest, TimerSlackSharesEveryTick) {
+    constexpr uint64_t period = 5e6;
+    constexpr size_t timer_cnt = 8;
+    constexpr int fires = 5;
+    const std::shared_ptr<SimBackend> sim = std::make_shared<SimBackend>();
+    EventLoop ev_loop{sim};
+    int callbacks = 0;
+
+    // With no time passing between registrations, every timer joins the first one's group, and
+    // every tick wakes the loop exactly once.
+    for (size_t i = 0; i < timer_cnt; ++i) {
+        const TimerEventCb cb = [&, i](uint64_t, Status<None, int64_t>) {
+            ++callbacks;
+            if (i == timer_cnt - 1 && callbacks == fires * static_cast<int>(timer_cnt)) {
+                EXPECT_TRUE(ev_loop.shutdown().is_ok());
+            }
+        };
+        ASSERT_TRUE(ev_loop.register_timer(i + 1, period, true /* periodic */, cb, period).is_ok());
+    }
+
+    ev_loop.run();
+
+    ASSERT_EQ(fires * static_cast<int>(timer_cnt), callbacks);
+    ASSERT_EQ(fires, ev_loop.stats().timer_events);
+}
+
+TEST(SimTest, DeliversAfterLatency) {
+    const std::shared_ptr<SimBackend> sim = std::make_shared<SimBackend>();
+    EventLoop ev_loop{sim};
+    constexpr std::chrono::microseconds latency{250};
+    const std::array<int, 2> fds = sim->socket_pair(SimLinkConfig{.latency = latency});
+    const std::chrono::steady_clock::time_point sent = ev_loop.now();
+    std::string received;
+    std::chrono::steady_clock::time_point arrived;
+
+    ASSERT_TRUE(sim->write(fds[0], as_bytes("hello")).is_ok());
+    ASSERT_TRUE(ev_loop
+                    .register_fd_read(fds[1],
+                                      [&](uint64_t, Status<int64_t, uint32_t> status) {
+                                          ASSERT_TRUE(status.is_ok());
+                                          EXPECT_EQ(5, status.ok());
+                                          arrived = ev_loop.now();
+                                          received = read_some(*sim, fds[1]);
+                                          EXPECT_TRUE(ev_loop.shutdown().is_ok());
+                                      })
+                    .is_ok());
+
+    ev_loop.run();
+
+    ASSERT_EQ("hello", received);
+    ASSERT_EQ(latency, arrived - sent);
+}
+
+TEST(SimTest, PartialReadsAndWrites) {
+    const std::shared_ptr<SimBackend> sim = std::make_shared<SimBackend>();
+    EventLoop ev_loop{sim};
+    const std::array<int, 2> fds = sim->socket_pair(SimLinkConfig{.max_read = 3, .max_write = 4});
+    std::string received;
+    int reads = 0;
+
+    Status<size_t, int> res = sim->write(fds[0], as_bytes("0123456789"));
+    ASSERT_TRUE(res.is_ok());
+    ASSERT_EQ(4, res.ok());
+    ASSERT_EQ(4, sim->write(fds[0], as_bytes("456789")).ok());
+    ASSERT_EQ(2, sim->write(fds[0], as_bytes("89")).ok());
+    ASSERT_TRUE(sim->shutdown_write(fds[0]).is_ok());
+
+    // One read per event; readiness is level-triggered, so the rest is reported next time round,
+    // and the end of input once more after that.
+    ASSERT_TRUE(ev_loop
+                    .register_fd_read(fds[1],
+                                      [&](uint64_t, Status<int64_t, uint32_t>) {
+                                          ++reads;
+                                          const std::string chunk = read_some(*sim, fds[1]);
+                                          EXPECT_LE(chunk.size(), 3);
+                                          received += chunk;
+                                      })
+                    .is_ok());
+    ASSERT_TRUE(ev_loop
+                    .register_fd_eof(fds[1],
+                                     [&](uint64_t, Status<int64_t, uint32_t> status) {
+                                         if (status.ok() == 0) {
+                                             EXPECT_TRUE(ev_loop.remove_fd_read(fds[1]).is_ok());
+                                             EXPECT_TRUE(ev_loop.shutdown().is_ok());
+                                         }
+                                     })
+                    .is_ok());
+
+    ev_loop.run();
+
+    ASSERT_EQ("0123456789", received);
+    ASSERT_EQ(5, reads);
+}
+
+TEST(SimTest, WritesPushBack) {
+    const std::shared_ptr<SimBackend> sim = std::make_shared<SimBackend>();
+    EventLoop ev_loop{sim};
+    constexpr size_t capacity = 16;
+    constexpr size_t total = 100;
+    constexpr std::chrono::microseconds read_cost{10};
+    const std::array<int, 2> fds = sim->socket_pair(
+        SimLinkConfig{.latency = std::chrono::microseconds{5}, .capacity = capacity});
+    const std::string payload(total, 'x');
+    size_t written = 0;
+    size_t received = 0;
+    int full = 0;
+
+    // The writer fills the link until it pushes back; the reader, slower than the link, frees
+    // a few bytes at a time.
+    ASSERT_TRUE(ev_loop
+                    .register_fd_write(fds[0],
+                                       [&](uint64_t, Status<int64_t, uint32_t> status) {
+                                           EXPECT_LE(status.ok(), capacity);
+                                           while (written < total) {
+                                               Status<size_t, int> res = sim->write(
+                                                   fds[0], as_bytes(payload).subspan(written));
+                                               if (res.is_err()) {
+                                                   EXPECT_EQ(EAGAIN, res.err());
+                                                   ++full;
+                                                   break;
+                                               }
+                                               written += res.ok();
+                                               EXPECT_LE(sim->unread(fds[0]), capacity);
+                                           }
+                                           if (written == total) {
+                                               EXPECT_TRUE(ev_loop.remove_fd_write(fds[0]).is_ok());
+                                           }
+                                       })
+                    .is_ok());
+    ASSERT_TRUE(ev_loop
+                    .register_fd_read(fds[1],
+                                      [&](uint64_t, Status<int64_t, uint32_t>) {
+                                          received += read_some(*sim, fds[1], 4).size();
+                                          sim->advance(read_cost);
+                                          if (received == total) {
+                                              EXPECT_TRUE(ev_loop.shutdown().is_ok());
+                                          }
+                                      })
+                    .is_ok());
+
+    ev_loop.run();
+
+    ASSERT_EQ(total, received);
+    ASSERT_GT(full, 0);
+    ASSERT_EQ(0, sim->unread(fds[0]));
+}
+
+TEST(SimTest, SpuriousEagain) {
+    const std::shared_ptr<SimBackend> sim = std::make_shared<SimBackend>();
+    EventLoop ev_loop{sim};
+    const std::array<int, 2> fds = sim->socket_pair();
+    int reads = 0;
+    int eagains = 0;
+    std::string received;
+
+    ASSERT_TRUE(sim->write(fds[0], as_bytes("data")).is_ok());
+    sim->fail_with_eagain(fds[1], 2, 0);
+    ASSERT_TRUE(ev_loop
+                    .register_fd_read(fds[1],
+                                      [&](uint64_t, Status<int64_t, uint32_t>) {
+                                          ++reads;
+                                          std::array<uint8_t, 16> buf{};
+                                          Status<size_t, int> res = sim->read(fds[1], buf);
+                                          if (res.is_err()) {
+                                              EXPECT_EQ(EAGAIN, res.err());
+                                              ++eagains;
+
+                                              return;
+                                          }
+                                          received.append(buf.begin(), buf.begin() + res.ok());
+                                          EXPECT_TRUE(ev_loop.shutdown().is_ok());
+                                      })
+                    .is_ok());
+
+    ev_loop.run();
+
+    ASSERT_EQ(2, eagains);
+    ASSERT_EQ("data", received);
+    ASSERT_EQ(3, reads);
+}
+
+TEST(SimTest, ReadyFdsTakeTurns) {
+    const std::shared_ptr<SimBackend> sim = std::make_shared<SimBackend>();
+    EventLoop ev_loop{sim};
+    const std::array<int, 2> first = sim->socket_pair();
+    const std::array<int, 2> second = sim->socket_pair();
+    std::string order;
+
+    ASSERT_TRUE(sim->write(first[0], as_bytes("aaaa")).is_ok());
+    ASSERT_TRUE(sim->write(second[0], as_bytes("bbbbbbbb")).is_ok());
+
+    // Each takes one byte per turn, so the same interleaving comes out on every run.
+    for (const int fd : {first[1], second[1]}) {
+        ASSERT_TRUE(ev_loop
+                        .register_fd_read(fd,
+                                          [&, fd](uint64_t, Status<int64_t, uint32_t>) {
+                                              order += read_some(*sim, fd, 1);
+                                              if (order.size() == 12) {
+                                                  EXPECT_TRUE(ev_loop.shutdown().is_ok());
+                                              }
+                                          })
+                        .is_ok());
+    }
+
+    ev_loop.run();
+
+    ASSERT_EQ("ababababbbbb", order);
+}
+
+TEST(SimTest, StaleEventDropped) {
+    const std::shared_ptr<SimBackend> sim = std::make_shared<SimBackend>();
+    EventLoop ev_loop{sim};
+    std::array<std::array<int, 2>, 2> pairs{sim->socket_pair(), sim->socket_pair()};
+    size_t reads = 0;
+    bool reused_read = false;
+
+    // As with the kernel: the first socket's callback closes the second and hands its fd to a new
+    // socket before the second's event, from the same batch, comes up.
+    const FdEventIOCb read_cb = [&](uint64_t fd, Status<int64_t, uint32_t>) {
+        ++reads;
+        ASSERT_EQ(pairs[0][0], static_cast<int>(fd));
+        ASSERT_TRUE(ev_loop.remove_fd_read(pairs[1][0]).is_ok());
+        ASSERT_TRUE(sim->close(pairs[1][0]).is_ok());
+        ASSERT_TRUE(sim->close(pairs[1][1]).is_ok());
+
+        const std::array<int, 2> reused = sim->socket_pair();
+        ASSERT_EQ(pairs[1][0], reused[0]);
+        ASSERT_TRUE(sim->write(reused[1], as_bytes("x")).is_ok());
+        ASSERT_TRUE(ev_loop
+                        .register_fd_read(reused[0],
+                                          [&](uint64_t, Status<int64_t, uint32_t>) {
+                                              reused_read = true;
+                                              EXPECT_TRUE(ev_loop.shutdown().is_ok());
+                                          })
+                        .is_ok());
+        ASSERT_TRUE(ev_loop.remove_fd_read(static_cast<int>(fd)).is_ok());
+    };
+
+    for (const std::array<int, 2>& pair : pairs) {
+        ASSERT_TRUE(sim->write(pair[1], as_bytes("x")).is_ok());
+        ASSERT_TRUE(ev_loop.register_fd_read(pair[0], read_cb).is_ok());
+    }
+
+    ev_loop.run();
+
+    ASSERT_EQ(1, reads);
+    ASSERT_EQ(1, ev_loop.stats().stale_events);
+    // The new socket is read on the next iteration.
+    ASSERT_TRUE(reused_read);
+}
+
+TEST(SimTest, WakesForOtherThreads) {
+    const std::shared_ptr<SimBackend> sim = std::make_shared<SimBackend>();
+    EventLoop ev_loop{sim};
+    bool ran = false;
+
+    // With nothing pending the loop blocks, as on a kernel queue, until a post wakes it.
+    std::thread poster{[&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        EXPECT_TRUE(ev_loop
+                        .post([&] {
+                            ran = true;
+                            EXPECT_TRUE(ev_loop.shutdown().is_ok());
+                        })
+                        .is_ok());
+    }};
+
+    ev_loop.run();
+    poster.join();
+
+    ASSERT_TRUE(ran);
+    ASSERT_EQ(0, sim->stats().skips);
+}
+
+} // namespace axle
+
+// NOLINTEND(readability-function-cognitive-complexity)
@@ -0,0 +1,92 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "axle/socket.h"
+
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+#include "axle/status.h"
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+namespace {
+
+int get_int_option(const Socket& socket, int level, int name) {
+    int val = 0;
+    socklen_t len = sizeof(val);
+    EXPECT_EQ(0, getsockopt(socket.get_fd(), level, name, &val, &len));
+
+    return val;
+}
+
+} // namespace
+
+TEST(SocketTest, OptionsInheritedOnAccept) {
+    constexpr int port = 8090;
+    constexpr int buf_sz = 64 * 1024;
+
+    SocketOptions options;
+    options.no_delay = true;
+    options.recv_buf = buf_sz;
+    ASSERT_FALSE(options.inherited().quick_ack.has_value());
+    ASSERT_TRUE(options.inherited().no_delay.value());
+    ASSERT_FALSE(options.per_connection().no_delay.has_value());
+
+    const ServerSocket server;
+    ASSERT_TRUE(server.apply(options).is_ok());
+    ASSERT_TRUE(server.listen(port, 1).is_ok());
+
+    const ClientSocket client;
+    ASSERT_TRUE(client.connect("127.0.0.1", port).is_ok());
+    Status<Socket, int> accepted = server.accept();
+    ASSERT_TRUE(accepted.is_ok());
+
+    const Socket peer = accepted.ok();
+    ASSERT_NE(0, get_int_option(peer, IPPROTO_TCP, TCP_NODELAY));
+    // Linux reports double the requested size, to account for its bookkeeping.
+    ASSERT_GE(get_int_option(peer, SOL_SOCKET, SO_RCVBUF), buf_sz);
+    ASSERT_EQ(0, get_int_option(client, IPPROTO_TCP, TCP_NODELAY));
+}
+
+TEST(SocketTest, SendSomeGathers) {
+    std::array<int, 2> fds{};
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()));
+    const Socket sender{fds[0]};
+    const Socket receiver{fds[1]};
+
+    std::array<char, 6> first{'h', 'e', 'l', 'l', 'o', ' '};
+    std::array<char, 5> second{'w', 'o', 'r', 'l', 'd'};
+    const std::array<struct iovec, 2> bufs{{{first.data(), first.size()},
+                                            {second.data(), second.size()}}};
+    Status<size_t, int> res = sender.send_some(bufs);
+    ASSERT_TRUE(res.is_ok());
+    ASSERT_EQ(first.size() + second.size(), res.ok());
+
+    std::array<char, 16> in{};
+    ASSERT_EQ(res.ok(), read(receiver.get_fd(), in.data(), in.size()));
+    ASSERT_EQ("hello world", std::string_view(in.data(), res.ok()));
+
+    // A full socket takes nothing rather than failing.
+    ASSERT_TRUE(sender.set_non_blocking().is_ok());
+    std::array<char, 4096> fill{};
+    const std::array<struct iovec, 1> fill_bufs{{{fill.data(), fill.size()}}};
+    for (;;) {
+        res = sender.send_some(fill_bufs);
+        ASSERT_TRUE(res.is_ok());
+        if (res.ok() == 0) {
+            break;
+        }
+    }
+}
+
+} // namespace axle
+// NOLINTEND(readability-function-cognitive-complexity)
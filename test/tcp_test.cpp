@@ -0,0 +1,656 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "axle/tcp.h"
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "axle/event.h"
+#include "axle/socket.h"
+#include "axle/status.h"
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+namespace {
+
+constexpr size_t k_buf_sz = 1024;
+
+// Echoes what it reads through a small buffer, which is full whenever the client reads more
+// slowly than it writes. Without `echo`, it keeps what it reads until `clear` is called. Notes
+// the end of input, and how much it had received by then.
+class Session {
+  public:
+    explicit Session(bool echo)
+        : echo_{echo} {}
+
+    std::span<uint8_t> recv_buf(size_t max_len) {
+        return std::span<uint8_t>{buf_}.subspan(tail_, std::min(buf_.size() - tail_, max_len));
+    }
+
+    void post_recv(std::span<uint8_t> buf) {
+        if (buf.empty()) {
+            empty_posts_.fetch_add(1);
+        }
+        tail_ += buf.size();
+        received_.fetch_add(buf.size());
+    }
+
+    std::span<const uint8_t> send_buf(size_t max_len) {
+        if (!echo_) {
+            return std::span<const uint8_t>{};
+        }
+
+        return std::span<const uint8_t>{buf_}.subspan(head_, std::min(tail_ - head_, max_len));
+    }
+
+    void post_send(int64_t len) {
+        head_ += len;
+        if (head_ == tail_) {
+            clear();
+        }
+    }
+
+    void end_input() {
+        received_at_end_.store(received_.load());
+        input_ended_.store(true);
+    }
+
+    void end() {
+        ended_.store(true);
+    }
+
+    void clear() {
+        head_ = 0;
+        tail_ = 0;
+    }
+
+    size_t received() const {
+        return received_.load();
+    }
+
+    size_t empty_posts() const {
+        return empty_posts_.load();
+    }
+
+    bool input_ended() const {
+        return input_ended_.load();
+    }
+
+    size_t received_at_end() const {
+        return received_at_end_.load();
+    }
+
+    bool ended() const {
+        return ended_.load();
+    }
+
+  private:
+    bool echo_;
+    std::array<uint8_t, k_buf_sz> buf_{};
+    size_t head_ = 0;
+    size_t tail_ = 0;
+    std::atomic<size_t> received_ = 0;
+    std::atomic<size_t> empty_posts_ = 0;
+    std::atomic_bool input_ended_ = false;
+    std::atomic<size_t> received_at_end_ = 0;
+    std::atomic_bool ended_ = false;
+};
+
+class Server : public TcpServer<Session, Server> {
+  public:
+    Server(const std::shared_ptr<EventLoop>& event_loop, int port, bool echo)
+        : TcpServer(event_loop, port),
+          echo_{echo} {
+        set_write_coalescing();
+    }
+
+    std::shared_ptr<Session> handle_connection() {
+        session_ = std::make_shared<Session>(echo_);
+        last_.store(session_.get());
+
+        return session_;
+    }
+
+    // The session of the latest connection, waiting for one if need be.
+    Session& last_session() const {
+        while (last_.load() == nullptr) {
+            std::this_thread::yield();
+        }
+
+        return *last_.load();
+    }
+
+  private:
+    bool echo_;
+    // Kept past the end of its connection, for checking after it closes.
+    std::shared_ptr<Session> session_;
+    std::atomic<Session*> last_ = nullptr;
+};
+
+// The read events of the server's only connection since the last call, taken on its loop.
+ConnActivity take_activity(Server& server) {
+    std::atomic_bool done = false;
+    ConnActivity activity{};
+    EXPECT_TRUE(server.event_loop()
+                    ->post([&] {
+                        const std::vector<ConnActivity> all = server.take_activity();
+                        if (!all.empty()) {
+                            activity = all.front();
+                        }
+                        done.store(true);
+                    })
+                    .is_ok());
+    while (!done.load()) {
+        std::this_thread::yield();
+    }
+
+    return activity;
+}
+
+// A send the session took part in: the loop iteration it ran in and how many pieces it gathered.
+struct Send {
+    uint64_t iteration;
+    size_t pieces;
+};
+
+// Answers every read, of at most `k_piece_sz` bytes, with a piece of output of its own and hands
+// all its pending pieces to each send. Notes the loop iteration, as counted by the test, of every
+// read and send.
+class Gatherer {
+  public:
+    static constexpr size_t k_piece_sz = 8;
+
+    Gatherer(const uint64_t& iteration, size_t reply_sz)
+        : iteration_{&iteration},
+          reply_sz_{reply_sz} {}
+
+    std::span<uint8_t> recv_buf(size_t max_len) {
+        return std::span<uint8_t>{in_}.first(std::min(in_.size(), max_len));
+    }
+
+    void post_recv(std::span<uint8_t> buf) {
+        pieces_.emplace_back(reply_sz_, buf.front());
+        reads_.push_back(*iteration_);
+    }
+
+    size_t send_bufs(std::span<struct iovec> bufs, size_t max_len) {
+        size_t cnt = 0;
+        size_t offset = offset_;
+        for (auto it = pieces_.begin(); it != pieces_.end() && cnt < bufs.size() && max_len > 0;
+             ++it) {
+            const size_t len = std::min(it->size() - offset, max_len);
+            bufs[cnt++] = {std::next(it->data(), static_cast<ptrdiff_t>(offset)), len};
+            max_len -= len;
+            offset = 0;
+        }
+        if (cnt > 0) {
+            sends_.push_back({*iteration_, cnt});
+            send_cnt_.fetch_add(1);
+        }
+
+        return cnt;
+    }
+
+    std::span<const uint8_t> send_buf(size_t max_len) {
+        if (pieces_.empty()) {
+            return {};
+        }
+
+        return std::span<const uint8_t>{pieces_.front()}.subspan(
+            offset_, std::min(pieces_.front().size() - offset_, max_len));
+    }
+
+    void post_send(int64_t len) {
+        auto left = static_cast<size_t>(len);
+        while (left > 0) {
+            const size_t taken = std::min(pieces_.front().size() - offset_, left);
+            offset_ += taken;
+            left -= taken;
+            if (offset_ == pieces_.front().size()) {
+                pieces_.pop_front();
+                offset_ = 0;
+            }
+        }
+    }
+
+    void end() {}
+
+    // Loop iterations of every read and every send, in order. Not to be read while the loop runs.
+    const std::vector<uint64_t>& reads() const {
+        return reads_;
+    }
+
+    const std::vector<Send>& sends() const {
+        return sends_;
+    }
+
+    // How many sends there have been so far.
+    size_t send_cnt() const {
+        return send_cnt_.load();
+    }
+
+  private:
+    const uint64_t* iteration_;
+    size_t reply_sz_;
+    std::array<uint8_t, k_piece_sz> in_{};
+    std::deque<std::vector<uint8_t>> pieces_;
+    size_t offset_ = 0;
+    std::vector<uint64_t> reads_;
+    std::vector<Send> sends_;
+    std::atomic<size_t> send_cnt_ = 0;
+};
+
+class GatherServer : public TcpServer<Gatherer, GatherServer> {
+  public:
+    GatherServer(const std::shared_ptr<EventLoop>& event_loop, int port, size_t reply_sz)
+        : TcpServer(event_loop, port),
+          reply_sz_{reply_sz} {
+        set_write_coalescing();
+        (void)event_loop->add_prepare_hook([this] { ++iteration_; });
+    }
+
+    std::shared_ptr<Gatherer> handle_connection() {
+        sessions_.push_back(std::make_shared<Gatherer>(iteration_, reply_sz_));
+        session_cnt_.fetch_add(1);
+
+        return sessions_.back();
+    }
+
+    // The session of the `idx`th connection, waiting for it if need be.
+    const Gatherer& session(size_t idx) const {
+        while (session_cnt_.load() <= idx) {
+            std::this_thread::yield();
+        }
+
+        return *sessions_[idx];
+    }
+
+  private:
+    size_t reply_sz_;
+    uint64_t iteration_ = 0;
+    std::vector<std::shared_ptr<Gatherer>> sessions_;
+    std::atomic<size_t> session_cnt_ = 0;
+};
+
+// Reads exactly `len` bytes; short if the connection fails or ends.
+size_t recv_exactly(const ClientSocket& client, size_t len) {
+    std::vector<uint8_t> buf(std::min(len, size_t{64} * 1024));
+    size_t got = 0;
+    while (got < len) {
+        Status<std::span<uint8_t>, int> res =
+            client.recv_some(std::span<uint8_t>{buf}.first(std::min(buf.size(), len - got)));
+        if (res.is_err() || res.ok().empty()) {
+            break;
+        }
+        got += res.ok().size();
+    }
+
+    return got;
+}
+
+} // namespace
+
+// A session that stays full is not read from, or woken for, until it makes room.
+TEST(TcpTest, StopsReadingWhileFull) {
+    constexpr int port = 8111;
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    Server server{loop, port, false};
+    server.start();
+    std::thread loop_thread{[&] { loop->run(); }};
+
+    const ClientSocket client;
+    ASSERT_TRUE(client.connect("127.0.0.1", port).is_ok());
+    const std::vector<uint8_t> out(4 * k_buf_sz, 'x');
+    ASSERT_TRUE(client.send_all(out).is_ok());
+
+    // Left alone, a connection with input waiting would be reported on every iteration.
+    Session& session = server.last_session();
+    while (session.received() < k_buf_sz) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    const ConnActivity activity = take_activity(server);
+    EXPECT_EQ(k_buf_sz, session.received());
+    EXPECT_LE(activity.read_events, 3);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{50});
+    EXPECT_EQ(0, take_activity(server).read_events);
+
+    // Making room some other way than by sending needs saying.
+    ASSERT_TRUE(loop->post([&] {
+                        session.clear();
+                        server.resume_reading(activity.handle);
+                    })
+                    .is_ok());
+    while (session.received() < 2 * k_buf_sz) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds{50});
+    EXPECT_EQ(2 * k_buf_sz, session.received());
+    EXPECT_EQ(0, session.empty_posts());
+
+    ASSERT_TRUE(loop->shutdown().is_ok());
+    loop_thread.join();
+}
+
+// A client that writes without reading fills the session with output it cannot send. The server
+// then stops reading, and the client's writes block on a closed TCP window, until the client
+// catches up.
+TEST(TcpTest, SlowReaderPushesBack) {
+    constexpr int port = 8112;
+    constexpr size_t total = size_t{32} << 20;
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    Server server{loop, port, true};
+    server.start();
+    std::thread loop_thread{[&] { loop->run(); }};
+
+    const ClientSocket client;
+    ASSERT_TRUE(client.connect("127.0.0.1", port).is_ok());
+    std::vector<uint8_t> out(total);
+    for (size_t i = 0; i < total; ++i) {
+        out[i] = static_cast<uint8_t>(i % 251);
+    }
+    std::atomic_bool sent = false;
+    std::thread send_thread{[&] {
+        EXPECT_TRUE(client.send_all(out).is_ok());
+        sent.store(true);
+    }};
+
+    // More than the kernel buffers between the two hold, so the writes stall.
+    std::this_thread::sleep_for(std::chrono::milliseconds{300});
+    EXPECT_FALSE(sent.load());
+    (void)take_activity(server);
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    EXPECT_LE(take_activity(server).read_events, 1);
+
+    std::vector<uint8_t> in(total);
+    size_t echoed = 0;
+    while (echoed < total) {
+        Status<std::span<uint8_t>, int> res =
+            client.recv_some(std::span<uint8_t>{in}.subspan(echoed));
+        ASSERT_TRUE(res.is_ok());
+        ASSERT_FALSE(res.ok().empty());
+        echoed += res.ok().size();
+    }
+    send_thread.join();
+    EXPECT_TRUE(out == in);
+    EXPECT_EQ(0, server.last_session().empty_posts());
+
+    ASSERT_TRUE(loop->shutdown().is_ok());
+    loop_thread.join();
+}
+
+// The end of input closes the connection without the session being handed an empty read.
+TEST(TcpTest, EndOfInputIsNotARead) {
+    constexpr int port = 8113;
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    Server server{loop, port, true};
+    server.start();
+    std::thread loop_thread{[&] { loop->run(); }};
+
+    const ClientSocket client;
+    ASSERT_TRUE(client.connect("127.0.0.1", port).is_ok());
+    const std::array<uint8_t, 5> msg{'h', 'e', 'l', 'l', 'o'};
+    ASSERT_TRUE(client.send_all(msg).is_ok());
+    std::array<uint8_t, 5> reply{};
+    size_t got = 0;
+    while (got < reply.size()) {
+        Status<std::span<uint8_t>, int> res =
+            client.recv_some(std::span<uint8_t>{reply}.subspan(got));
+        ASSERT_TRUE(res.is_ok());
+        ASSERT_FALSE(res.ok().empty());
+        got += res.ok().size();
+    }
+    ASSERT_TRUE(client.shutdown_write().is_ok());
+
+    // The server closes in turn, once the session has ended.
+    Status<std::span<uint8_t>, int> res = client.recv_some(reply);
+    ASSERT_TRUE(res.is_ok());
+    EXPECT_TRUE(res.ok().empty());
+
+    const Session& session = server.last_session();
+    EXPECT_TRUE(session.input_ended());
+    EXPECT_TRUE(session.ended());
+    EXPECT_EQ(msg.size(), session.received());
+    EXPECT_EQ(0, session.empty_posts());
+
+    ASSERT_TRUE(loop->shutdown().is_ok());
+    loop_thread.join();
+}
+
+// A client that half-closes while the session is full still has everything it sent read and
+// answered: the end of input waits behind the data, and the close behind the output.
+TEST(TcpTest, HalfCloseWhileFull) {
+    constexpr int port = 8116;
+    constexpr size_t total = 64 * k_buf_sz;
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    Server server{loop, port, true};
+    server.start();
+    std::thread loop_thread{[&] { loop->run(); }};
+
+    const ClientSocket client;
+    ASSERT_TRUE(client.connect("127.0.0.1", port).is_ok());
+    std::vector<uint8_t> out(total);
+    for (size_t i = 0; i < total; ++i) {
+        out[i] = static_cast<uint8_t>(i % 251);
+    }
+    ASSERT_TRUE(client.send_all(out).is_ok());
+    ASSERT_TRUE(client.shutdown_write().is_ok());
+
+    std::vector<uint8_t> in(total);
+    size_t echoed = 0;
+    for (;;) {
+        Status<std::span<uint8_t>, int> res =
+            client.recv_some(std::span<uint8_t>{in}.subspan(std::min(echoed, total)));
+        ASSERT_TRUE(res.is_ok());
+        if (res.ok().empty()) {
+            break;
+        }
+        echoed += res.ok().size();
+    }
+    EXPECT_EQ(total, echoed);
+    EXPECT_TRUE(out == in);
+
+    const Session& session = server.last_session();
+    EXPECT_TRUE(session.input_ended());
+    EXPECT_EQ(total, session.received_at_end());
+    EXPECT_TRUE(session.ended());
+    EXPECT_EQ(0, session.empty_posts());
+
+    ASSERT_TRUE(loop->shutdown().is_ok());
+    loop_thread.join();
+}
+
+// The end of input is not acted on while a full session is not being read.
+TEST(TcpTest, EndOfInputWaitsForRoom) {
+    constexpr int port = 8117;
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    Server server{loop, port, false};
+    server.start();
+    std::thread loop_thread{[&] { loop->run(); }};
+
+    const ClientSocket client;
+    ASSERT_TRUE(client.connect("127.0.0.1", port).is_ok());
+    const std::vector<uint8_t> out(2 * k_buf_sz, 'x');
+    ASSERT_TRUE(client.send_all(out).is_ok());
+    ASSERT_TRUE(client.shutdown_write().is_ok());
+
+    Session& session = server.last_session();
+    while (session.received() < k_buf_sz) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    EXPECT_EQ(k_buf_sz, session.received());
+    EXPECT_FALSE(session.input_ended());
+    EXPECT_FALSE(session.ended());
+
+    const ConnActivity activity = take_activity(server);
+    ASSERT_TRUE(loop->post([&] {
+                        session.clear();
+                        server.resume_reading(activity.handle);
+                    })
+                    .is_ok());
+
+    // Nothing to send, so the connection closes as soon as the input has ended.
+    std::array<uint8_t, 1> buf{};
+    Status<std::span<uint8_t>, int> res = client.recv_some(buf);
+    ASSERT_TRUE(res.is_ok());
+    EXPECT_TRUE(res.ok().empty());
+    EXPECT_TRUE(session.input_ended());
+    EXPECT_EQ(2 * k_buf_sz, session.received_at_end());
+    EXPECT_TRUE(session.ended());
+
+    ASSERT_TRUE(loop->shutdown().is_ok());
+    loop_thread.join();
+}
+
+// Output that several connections queue in an iteration goes out in one gathering send per
+// connection, in that same iteration.
+TEST(TcpTest, GathersOneSendPerIteration) {
+    constexpr int port = 8114;
+    constexpr size_t client_cnt = 4;
+    constexpr size_t rounds = 20;
+    constexpr size_t reply_sz = 16;
+    // Read in four pieces, which the read budget allows for in one event.
+    constexpr size_t msg_sz = 4 * Gatherer::k_piece_sz;
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    GatherServer server{loop, port, reply_sz};
+    server.start();
+    std::thread loop_thread{[&] { loop->run(); }};
+
+    std::array<ClientSocket, client_cnt> clients;
+    for (size_t i = 0; i < client_cnt; ++i) {
+        ASSERT_TRUE(clients[i].connect("127.0.0.1", port).is_ok());
+        (void)server.session(i);
+    }
+    const std::vector<uint8_t> msg(msg_sz, 'x');
+    for (size_t round = 0; round < rounds; ++round) {
+        for (const ClientSocket& client : clients) {
+            ASSERT_TRUE(client.send_all(msg).is_ok());
+        }
+        for (const ClientSocket& client : clients) {
+            ASSERT_EQ(4 * reply_sz, recv_exactly(client, 4 * reply_sz));
+        }
+    }
+
+    ASSERT_TRUE(loop->shutdown().is_ok());
+    loop_thread.join();
+
+    size_t gathered = 0;
+    for (size_t i = 0; i < client_cnt; ++i) {
+        const Gatherer& session = server.session(i);
+        const std::vector<Send>& sends = session.sends();
+        ASSERT_FALSE(sends.empty());
+        for (size_t j = 1; j < sends.size(); ++j) {
+            EXPECT_LT(sends[j - 1].iteration, sends[j].iteration);
+        }
+        // Every read is answered before the loop polls again.
+        for (const uint64_t read : session.reads()) {
+            EXPECT_TRUE(std::ranges::any_of(sends, [read](const Send& send) {
+                return send.iteration == read;
+            }));
+        }
+        gathered += std::ranges::count_if(sends, [](const Send& send) { return send.pieces > 1; });
+    }
+    EXPECT_GT(gathered, 0);
+}
+
+// What the socket does not take at the end of the iteration goes out as it becomes writable, with
+// no more input to prompt it, and the loop is not woken while it cannot.
+TEST(TcpTest, FallsBackToWriteFilter) {
+    constexpr int port = 8115;
+    constexpr size_t reply_sz = size_t{32} << 20;
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    GatherServer server{loop, port, reply_sz};
+    server.start();
+    std::thread loop_thread{[&] { loop->run(); }};
+
+    const ClientSocket client;
+    ASSERT_TRUE(client.connect("127.0.0.1", port).is_ok());
+    const std::array<uint8_t, 1> msg{'x'};
+    ASSERT_TRUE(client.send_all(msg).is_ok());
+
+    // More than the kernel buffers between the two hold.
+    const Gatherer& session = server.session(0);
+    std::this_thread::sleep_for(std::chrono::milliseconds{200});
+    const size_t stalled = session.send_cnt();
+    EXPECT_GE(stalled, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    EXPECT_EQ(stalled, session.send_cnt());
+
+    EXPECT_EQ(reply_sz, recv_exactly(client, reply_sz));
+
+    ASSERT_TRUE(loop->shutdown().is_ok());
+    loop_thread.join();
+
+    ASSERT_EQ(1, session.reads().size());
+    const std::vector<Send>& sends = session.sends();
+    ASSERT_GT(sends.size(), 1);
+    EXPECT_EQ(session.reads().front(), sends.front().iteration);
+    for (size_t j = 1; j < sends.size(); ++j) {
+        EXPECT_LT(sends[j - 1].iteration, sends[j].iteration);
+    }
+}
+
+// A client that sends more than the read budget takes in one event and then half-closes has all
+// of it read and answered: the end of input waits for the reads the budget put off.
+TEST(TcpTest, EndOfInputWaitsForBudget) {
+    constexpr int port = 8121;
+    constexpr size_t piece_cnt = 64;
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    GatherServer server{loop, port, 1};
+    server.start();
+    std::thread loop_thread{[&] { loop->run(); }};
+
+    const ClientSocket client;
+    ASSERT_TRUE(client.connect("127.0.0.1", port).is_ok());
+    // Each piece is answered with its first byte, which tells the pieces apart.
+    std::vector<uint8_t> out(piece_cnt * Gatherer::k_piece_sz);
+    for (size_t i = 0; i < out.size(); ++i) {
+        out[i] = static_cast<uint8_t>(i / Gatherer::k_piece_sz);
+    }
+    ASSERT_TRUE(client.send_all(out).is_ok());
+    ASSERT_TRUE(client.shutdown_write().is_ok());
+
+    std::vector<uint8_t> in;
+    std::array<uint8_t, 64> buf{};
+    for (;;) {
+        Status<std::span<uint8_t>, int> res = client.recv_some(buf);
+        ASSERT_TRUE(res.is_ok());
+        if (res.ok().empty()) {
+            break;
+        }
+        in.insert(in.end(), res.ok().begin(), res.ok().end());
+    }
+    ASSERT_EQ(piece_cnt, in.size());
+    for (size_t i = 0; i < piece_cnt; ++i) {
+        EXPECT_EQ(i, in[i]);
+    }
+
+    ASSERT_TRUE(loop->shutdown().is_ok());
+    loop_thread.join();
+
+    // No more than four reads went to any iteration.
+    const std::vector<uint64_t>& reads = server.session(0).reads();
+    ASSERT_EQ(piece_cnt, reads.size());
+    for (size_t j = 4; j < reads.size(); ++j) {
+        EXPECT_LT(reads[j - 4], reads[j]);
+    }
+}
+
+} // namespace axle
+// NOLINTEND(readability-function-cognitive-complexity)
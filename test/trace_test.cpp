@@ -0,0 +1,127 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "axle/trace.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "axle/event.h"
+#include "axle/status.h"
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+TEST(TraceTest, RingKeepsNewest) {
+    TraceBuffer trace{3};
+
+    for (uint64_t i = 0; i < 6; ++i) {
+        trace.record(TraceKind::READ, i, 10 * i, 10 * i + 5);
+    }
+
+    // Rounded up to four records.
+    const std::vector<TraceRecord> records = trace.records();
+    ASSERT_EQ(4, records.size());
+    ASSERT_EQ(2, trace.dropped());
+    for (size_t i = 0; i < records.size(); ++i) {
+        ASSERT_EQ(i + 2, records[i].arg);
+        ASSERT_EQ(5, records[i].duration_ns);
+    }
+}
+
+// An idle poll can block for longer than 32 bits of nanoseconds hold.
+TEST(TraceTest, LongSpans) {
+    TraceBuffer trace{1};
+    constexpr uint64_t hour_ns = uint64_t{3600} * 1000 * 1000 * 1000;
+    trace.record(TraceKind::POLL, 0, 1000, 1000 + hour_ns);
+
+    ASSERT_EQ(hour_ns, trace.records().at(0).duration_ns);
+}
+
+TEST(TraceTest, RecordsLoopActivity) {
+    EventLoop ev_loop;
+    Status<None, int> status = ev_loop.set_tracing(64);
+    if (status.is_err()) {
+        ASSERT_EQ(ENOTSUP, status.err());
+        GTEST_SKIP() << "built without tracing";
+    }
+
+    constexpr uint64_t timer_id = 7;
+    ASSERT_TRUE(ev_loop
+                    .register_timer(timer_id,
+                                    1000,
+                                    false,
+                                    [&](uint64_t, Status<None, int64_t>) {
+                                        ASSERT_TRUE(ev_loop.shutdown().is_ok());
+                                    })
+                    .is_ok());
+    ev_loop.run();
+
+    std::vector<TraceKind> kinds;
+    for (const TraceRecord& rec : ev_loop.trace()->records()) {
+        kinds.push_back(rec.kind);
+        if (rec.kind == TraceKind::TIMER || rec.kind == TraceKind::REGISTER_TIMER) {
+            ASSERT_EQ(timer_id, rec.arg);
+        }
+    }
+    ASSERT_EQ(TraceKind::REGISTER_TIMER, kinds.front());
+    ASSERT_NE(kinds.end(), std::find(kinds.begin(), kinds.end(), TraceKind::POLL));
+    ASSERT_NE(kinds.end(), std::find(kinds.begin(), kinds.end(), TraceKind::TIMER));
+    ASSERT_EQ(TraceKind::USER, kinds.back());
+
+    ASSERT_TRUE(ev_loop.set_tracing(0).is_ok());
+    ASSERT_EQ(nullptr, ev_loop.trace());
+}
+
+TEST(TraceTest, Export) {
+    const std::vector<TraceThread> threads{
+        {3,
+         "loop-0",
+         {{1500, 9, 250, TraceKind::READ}, {2000, 9, 0, TraceKind::REMOVE_READ}}},
+    };
+
+    std::ostringstream chrome;
+    write_chrome_trace(chrome, threads);
+    const std::string json = chrome.str();
+    ASSERT_NE(std::string::npos,
+              json.find("\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":3"));
+    ASSERT_NE(std::string::npos,
+              json.find("{\"name\":\"read\",\"pid\":1,\"tid\":3,\"ts\":1.500,\"ph\":\"X\","
+                        "\"dur\":0.250,\"args\":{\"fd\":9}}"));
+    ASSERT_NE(std::string::npos, json.find("\"name\":\"remove_read\""));
+
+    // Thread names are escaped.
+    const std::vector<TraceThread> odd{{4, "a \"b\" \\c\n", {}}};
+    std::ostringstream escaped;
+    write_chrome_trace(escaped, odd);
+    ASSERT_NE(std::string::npos,
+              escaped.str().find("\"args\":{\"name\":\"a \\\"b\\\" \\\\c\\u000a\"}}"));
+
+    // A track descriptor, then begin and end for the span and one packet for the instant, each
+    // framed as field 1 of the trace.
+    std::ostringstream perfetto;
+    write_perfetto_trace(perfetto, threads);
+    const std::string proto = perfetto.str();
+    size_t packets = 0;
+    for (size_t pos = 0; pos < proto.size(); ++packets) {
+        ASSERT_EQ('\x0a', proto[pos]);
+        size_t len = 0;
+        unsigned shift = 0;
+        for (++pos; (static_cast<uint8_t>(proto[pos]) & 0x80) != 0; ++pos, shift += 7) {
+            len |= (static_cast<size_t>(proto[pos]) & 0x7f) << shift;
+        }
+        len |= static_cast<size_t>(proto[pos]) << shift;
+        pos += 1 + len;
+    }
+    ASSERT_EQ(4, packets);
+    ASSERT_NE(std::string::npos, proto.find("loop-0"));
+}
+
+} // namespace axle
+// NOLINTEND(readability-function-cognitive-complexity)
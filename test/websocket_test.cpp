@@ -0,0 +1,451 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "axle/websocket.h"
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "axle/broadcast.h"
+#include "axle/event.h"
+#include "axle/socket.h"
+#include "axle/status.h"
+#include "axle/tcp.h"
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+namespace {
+
+constexpr WsMask k_mask{0x37, 0xfa, 0x21, 0x3d};
+
+const std::string k_upgrade = "GET /feed HTTP/1.1\r\n"
+                              "Host: localhost\r\n"
+                              "Upgrade: websocket\r\n"
+                              "Connection: keep-alive, Upgrade\r\n"
+                              "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                              "Sec-WebSocket-Version: 13\r\n\r\n";
+
+std::span<const uint8_t> as_bytes(const std::string& str) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return {reinterpret_cast<const uint8_t*>(str.data()), str.size()};
+}
+
+std::string as_string(std::span<const uint8_t> bytes) {
+    return {bytes.begin(), bytes.end()};
+}
+
+// A frame as a client sends it, masked.
+std::string client_frame(WsOpcode opcode, const std::string& payload, bool fin = true) {
+    std::array<uint8_t, k_ws_max_header_sz> header{};
+    const size_t len = ws_encode_header(opcode, fin, payload.size(), k_mask, header);
+    std::string frame{header.begin(), header.begin() + static_cast<ptrdiff_t>(len)};
+
+    std::vector<uint8_t> masked{payload.begin(), payload.end()};
+    ws_unmask(masked, k_mask);
+
+    return frame + as_string(masked);
+}
+
+// A frame as the server sends it, unmasked.
+std::string server_frame(WsOpcode opcode, const std::string& payload) {
+    std::array<uint8_t, k_ws_max_header_sz> header{};
+    const size_t len = ws_encode_header(opcode, true, payload.size(), std::nullopt, header);
+
+    return std::string{header.begin(), header.begin() + static_cast<ptrdiff_t>(len)} + payload;
+}
+
+struct Message {
+    WsOpcode opcode;
+    std::string payload;
+};
+
+class WsHarness {
+  public:
+    explicit WsHarness(WsConfig config = {})
+        : ws_{config, [this](WsOpcode opcode, std::span<const uint8_t> payload) {
+                  messages_.push_back({opcode, as_string(payload)});
+              }} {}
+
+    // Feeds `input` in reads of at most `chunk` bytes and returns the first error, if any.
+    std::optional<WsError> feed(const std::string& input, size_t chunk) {
+        std::span<const uint8_t> rest = as_bytes(input);
+        while (!rest.empty()) {
+            const std::span<uint8_t> buf = ws_.recv_buf(chunk);
+            EXPECT_FALSE(buf.empty());
+            const size_t len = std::min(buf.size(), rest.size());
+            std::copy_n(rest.begin(), len, buf.begin());
+            rest = rest.subspan(len);
+
+            Status<size_t, WsError> res = ws_.post_recv(buf.first(len));
+            if (res.is_err()) {
+                return res.err();
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    // Everything queued to send, in gathering writes of at most `max_len` bytes.
+    std::string drain(size_t max_len = 1 << 20) {
+        std::string out;
+        std::array<struct iovec, 4> bufs{};
+        while (size_t cnt = ws_.send_bufs(bufs, max_len)) {
+            size_t sent = 0;
+            for (const struct iovec& buf : std::span<const struct iovec>{bufs}.first(cnt)) {
+                out.append(static_cast<const char*>(buf.iov_base), buf.iov_len);
+                sent += buf.iov_len;
+            }
+            ws_.post_send(static_cast<int64_t>(sent));
+        }
+
+        return out;
+    }
+
+    WsConnection& ws() {
+        return ws_;
+    }
+
+    const std::vector<Message>& messages() const {
+        return messages_;
+    }
+
+  private:
+    WsConnection ws_;
+    std::vector<Message> messages_;
+};
+
+std::string handshake_response(WsHarness& harness) {
+    std::string out = harness.drain();
+    const size_t end = out.find("\r\n\r\n");
+    EXPECT_NE(std::string::npos, end);
+
+    return out.substr(0, end + 4);
+}
+
+// Answers every message with `reply`, sent by reference.
+class FeedSession {
+  public:
+    explicit FeedSession(SharedBuffer reply)
+        : reply_{std::move(reply)},
+          ws_{WsConfig{}, [this](WsOpcode opcode, std::span<const uint8_t> payload) {
+                  (void)payload;
+                  (void)ws_.send(opcode, reply_);
+              }} {}
+
+    std::span<uint8_t> recv_buf(size_t max_len) {
+        return ws_.recv_buf(max_len);
+    }
+
+    void post_recv(std::span<uint8_t> buf) {
+        (void)ws_.post_recv(buf);
+    }
+
+    std::span<const uint8_t> send_buf(size_t max_len) {
+        return ws_.send_buf(max_len);
+    }
+
+    size_t send_bufs(std::span<struct iovec> bufs, size_t max_len) {
+        return ws_.send_bufs(bufs, max_len);
+    }
+
+    void post_send(int64_t len) {
+        ws_.post_send(len);
+    }
+
+    bool closing() const {
+        return ws_.closing();
+    }
+
+    void end() {}
+
+  private:
+    SharedBuffer reply_;
+    WsConnection ws_;
+};
+
+class FeedServer : public TcpServer<FeedSession, FeedServer> {
+  public:
+    FeedServer(const std::shared_ptr<EventLoop>& event_loop, int port)
+        : TcpServer(event_loop, port) {
+        set_write_coalescing();
+    }
+
+    std::shared_ptr<FeedSession> handle_connection() {
+        return std::make_shared<FeedSession>(reply_);
+    }
+
+  private:
+    SharedBuffer reply_ = make_shared_buffer(as_bytes("update"));
+};
+
+} // namespace
+
+TEST(WebSocketTest, AcceptKey) {
+    // The example from RFC 6455.
+    EXPECT_EQ("s3pPLMBiTxaQ9kYGzzhZRbK+xOo=", ws_accept_key("dGhlIHNhbXBsZSBub25jZQ=="));
+}
+
+TEST(WebSocketTest, UnmaskMatchesScalar) {
+    std::vector<uint8_t> input(300);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = static_cast<uint8_t>(i * 7);
+    }
+
+    for (size_t len = 0; len <= input.size(); len += 13) {
+        for (size_t offset = 0; offset < 4; ++offset) {
+            std::vector<uint8_t> fast{input.begin(), input.begin() + static_cast<ptrdiff_t>(len)};
+            std::vector<uint8_t> slow = fast;
+            ws_unmask(fast, k_mask, offset);
+            detail::ws_unmask_scalar(slow, k_mask, offset);
+            EXPECT_EQ(slow, fast) << "len " << len << " offset " << offset;
+        }
+    }
+}
+
+TEST(WebSocketTest, UnmaskPiecewise) {
+    std::vector<uint8_t> whole(100, 0xaa);
+    std::vector<uint8_t> pieces = whole;
+    ws_unmask(whole, k_mask);
+
+    const std::span<uint8_t> buf{pieces};
+    ws_unmask(buf.subspan(0, 3), k_mask, 0);
+    ws_unmask(buf.subspan(3, 50), k_mask, 3);
+    ws_unmask(buf.subspan(53), k_mask, 53);
+    EXPECT_EQ(whole, pieces);
+}
+
+TEST(WebSocketTest, EncodeHeader) {
+    std::array<uint8_t, k_ws_max_header_sz> header{};
+    EXPECT_EQ(2, ws_encode_header(WsOpcode::TEXT, true, 125, std::nullopt, header));
+    EXPECT_EQ(0x81, header[0]);
+    EXPECT_EQ(125, header[1]);
+
+    EXPECT_EQ(4, ws_encode_header(WsOpcode::BINARY, false, 126, std::nullopt, header));
+    EXPECT_EQ(0x02, header[0]);
+    EXPECT_EQ(126, header[1]);
+    EXPECT_EQ(0, header[2]);
+    EXPECT_EQ(126, header[3]);
+
+    EXPECT_EQ(14, ws_encode_header(WsOpcode::BINARY, true, 1 << 16, k_mask, header));
+    EXPECT_EQ(0x80 | 127, header[1]);
+    EXPECT_EQ(1, header[7]);
+    EXPECT_EQ(k_mask[0], header[10]);
+}
+
+TEST(WebSocketTest, ParsesFramesByteByByte) {
+    const std::string payload(300, 'p');
+    std::string input = client_frame(WsOpcode::TEXT, payload);
+    std::vector<uint8_t> buf;
+
+    WsFrameParser parser{1024};
+    for (size_t i = 0; i < input.size(); ++i) {
+        buf.push_back(static_cast<uint8_t>(input[i]));
+        Status<size_t, WsError> res = parser.parse(buf);
+        ASSERT_TRUE(res.is_ok());
+        EXPECT_EQ(i + 1 == input.size() ? input.size() : 0, res.ok());
+    }
+
+    const WsFrame& frame = parser.frame();
+    EXPECT_EQ(WsOpcode::TEXT, frame.opcode);
+    EXPECT_TRUE(frame.fin);
+    const std::span<const uint8_t> data{buf};
+    EXPECT_EQ(payload, as_string(data.subspan(frame.header_len, frame.payload_len)));
+}
+
+TEST(WebSocketTest, RejectsBadFrames) {
+    const auto parse = [](std::string input) {
+        std::vector<uint8_t> buf{input.begin(), input.end()};
+        WsFrameParser parser{64};
+        Status<size_t, WsError> res = parser.parse(buf);
+
+        return res.is_err() ? std::optional<WsError>{res.err()} : std::nullopt;
+    };
+
+    std::string unmasked = server_frame(WsOpcode::TEXT, "hi");
+    EXPECT_EQ(WsError::UNMASKED, parse(unmasked));
+
+    std::string reserved = client_frame(WsOpcode::TEXT, "hi");
+    reserved[0] = static_cast<char>(reserved[0] | 0x40);
+    EXPECT_EQ(WsError::RESERVED_BITS, parse(reserved));
+
+    std::string opcode = client_frame(WsOpcode::TEXT, "hi");
+    opcode[0] = static_cast<char>(0x83);
+    EXPECT_EQ(WsError::BAD_OPCODE, parse(opcode));
+
+    EXPECT_EQ(WsError::BAD_CONTROL, parse(client_frame(WsOpcode::PING, "hi", false)));
+    EXPECT_EQ(WsError::BAD_CONTROL, parse(client_frame(WsOpcode::PING, std::string(126, 'x'))));
+    EXPECT_EQ(WsError::TOO_LARGE, parse(client_frame(WsOpcode::BINARY, std::string(65, 'x'))));
+}
+
+TEST(WebSocketTest, HandshakeThenMessages) {
+    // Frames right behind the handshake, in the same reads, as a client that does not wait.
+    WsHarness harness;
+    const std::string input =
+        k_upgrade + client_frame(WsOpcode::TEXT, "hello") + client_frame(WsOpcode::BINARY, "bin");
+    EXPECT_FALSE(harness.feed(input, 7));
+    EXPECT_TRUE(harness.ws().open());
+
+    const std::string response = handshake_response(harness);
+    EXPECT_NE(std::string::npos, response.find("HTTP/1.1 101 Switching Protocols\r\n"));
+    EXPECT_NE(std::string::npos,
+              response.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"));
+
+    ASSERT_EQ(2, harness.messages().size());
+    EXPECT_EQ(WsOpcode::TEXT, harness.messages()[0].opcode);
+    EXPECT_EQ("hello", harness.messages()[0].payload);
+    EXPECT_EQ(WsOpcode::BINARY, harness.messages()[1].opcode);
+    EXPECT_EQ("bin", harness.messages()[1].payload);
+}
+
+TEST(WebSocketTest, RejectsBadHandshake) {
+    WsHarness harness;
+    std::string request = k_upgrade;
+    request.replace(request.find("13"), 2, "8");
+    EXPECT_EQ(WsError::BAD_HANDSHAKE, harness.feed(request, 64));
+    EXPECT_FALSE(harness.ws().open());
+    EXPECT_EQ(0, harness.drain().find("HTTP/1.1 400 Bad Request\r\n"));
+    EXPECT_TRUE(harness.ws().closing());
+}
+
+TEST(WebSocketTest, AssemblesFragments) {
+    WsHarness harness;
+    const std::string input = k_upgrade + client_frame(WsOpcode::TEXT, "one ", false) +
+                              client_frame(WsOpcode::PING, "p") +
+                              client_frame(WsOpcode::CONTINUATION, "two ", false) +
+                              client_frame(WsOpcode::CONTINUATION, "three");
+    EXPECT_FALSE(harness.feed(input, 5));
+    ASSERT_EQ(1, harness.messages().size());
+    EXPECT_EQ("one two three", harness.messages()[0].payload);
+
+    // The ping is answered even in the middle of a message.
+    const std::string out = harness.drain();
+    EXPECT_EQ(server_frame(WsOpcode::PONG, "p"), out.substr(out.find("\r\n\r\n") + 4));
+
+    EXPECT_EQ(WsError::BAD_CONTINUATION,
+              harness.feed(client_frame(WsOpcode::CONTINUATION, "x"), 64));
+}
+
+TEST(WebSocketTest, GrowsForLargeFrames) {
+    WsHarness harness{WsConfig{64, 4096, 1 << 20}};
+    const std::string payload(3000, 'l');
+    EXPECT_FALSE(harness.feed(k_upgrade + client_frame(WsOpcode::BINARY, payload), 100));
+    ASSERT_EQ(1, harness.messages().size());
+    EXPECT_EQ(payload, harness.messages()[0].payload);
+
+    EXPECT_EQ(WsError::TOO_LARGE, harness.feed(client_frame(WsOpcode::BINARY, "x", false) +
+                                                   client_frame(WsOpcode::CONTINUATION,
+                                                                std::string(4096, 'x')),
+                                               1000));
+}
+
+TEST(WebSocketTest, ClosingHandshake) {
+    WsHarness harness;
+    EXPECT_FALSE(harness.feed(k_upgrade, 1024));
+    (void)handshake_response(harness);
+
+    // A close from the peer is echoed, and nothing after it is delivered.
+    EXPECT_FALSE(harness.feed(client_frame(WsOpcode::CLOSE, "\x03\xe8") +
+                                  client_frame(WsOpcode::TEXT, "late"),
+                              1024));
+    EXPECT_TRUE(harness.messages().empty());
+    EXPECT_FALSE(harness.ws().closing());
+    EXPECT_EQ(server_frame(WsOpcode::CLOSE, "\x03\xe8"), harness.drain());
+    EXPECT_TRUE(harness.ws().closing());
+    EXPECT_FALSE(harness.ws().send(WsOpcode::TEXT, make_shared_buffer(as_bytes("x"))));
+
+    // One started here ends when the peer's close arrives.
+    WsHarness other;
+    EXPECT_FALSE(other.feed(k_upgrade, 1024));
+    (void)handshake_response(other);
+    other.ws().close(1001);
+    EXPECT_EQ(server_frame(WsOpcode::CLOSE, "\x03\xe9"), other.drain());
+    EXPECT_FALSE(other.ws().closing());
+    EXPECT_FALSE(other.feed(client_frame(WsOpcode::CLOSE, ""), 1024));
+    EXPECT_TRUE(other.drain().empty());
+    EXPECT_TRUE(other.ws().closing());
+}
+
+TEST(WebSocketTest, SendsPayloadsByReference) {
+    WsHarness harness;
+    EXPECT_FALSE(harness.feed(k_upgrade, 1024));
+    (void)handshake_response(harness);
+
+    const SharedBuffer payload = make_shared_buffer(as_bytes(std::string(200, 'u')));
+    ASSERT_TRUE(harness.ws().send(WsOpcode::BINARY, payload));
+    ASSERT_TRUE(harness.ws().send(WsOpcode::TEXT, payload));
+    EXPECT_EQ(2 * (4 + 200), harness.ws().queued());
+
+    std::array<struct iovec, 8> bufs{};
+    ASSERT_EQ(4, harness.ws().send_bufs(bufs, 1 << 20));
+    EXPECT_EQ(4, bufs[0].iov_len);
+    EXPECT_EQ(payload->data(), bufs[1].iov_base);
+    EXPECT_EQ(payload->data(), bufs[3].iov_base);
+
+    // Partial writes pick up in the middle of a header or a payload.
+    std::string out;
+    while (!harness.ws().send_buf(1).empty()) {
+        const std::span<const uint8_t> buf = harness.ws().send_buf(3);
+        out += as_string(buf);
+        harness.ws().post_send(static_cast<int64_t>(buf.size()));
+    }
+    EXPECT_EQ(server_frame(WsOpcode::BINARY, std::string(200, 'u')) +
+                  server_frame(WsOpcode::TEXT, std::string(200, 'u')),
+              out);
+    EXPECT_EQ(0, harness.ws().queued());
+}
+
+// A server answers over a real connection, and closes it once the closing handshake is over.
+TEST(WebSocketTest, ServesConnection) {
+    constexpr int port = 8107;
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    FeedServer server{loop, port};
+    server.start();
+
+    std::string received;
+    std::thread client_thread{[&] {
+        const ClientSocket client;
+        ASSERT_TRUE(client.connect("127.0.0.1", port).is_ok());
+        ASSERT_TRUE(client
+                        .send_all(as_bytes(k_upgrade + client_frame(WsOpcode::TEXT, "sub") +
+                                           client_frame(WsOpcode::CLOSE, "\x03\xe8")))
+                        .is_ok());
+
+        std::array<uint8_t, 1024> buf{};
+        for (;;) {
+            Status<std::span<uint8_t>, int> res = client.recv_some(buf);
+            if (res.is_err() || res.ok().empty()) {
+                break;
+            }
+            received += as_string(res.ok());
+        }
+
+        ASSERT_TRUE(loop->shutdown().is_ok());
+    }};
+
+    loop->run();
+    client_thread.join();
+    EXPECT_EQ(0, server.connections());
+
+    const size_t end = received.find("\r\n\r\n");
+    ASSERT_NE(std::string::npos, end);
+    EXPECT_EQ(0, received.find("HTTP/1.1 101 "));
+    EXPECT_EQ(server_frame(WsOpcode::TEXT, "update") +
+                  server_frame(WsOpcode::CLOSE, "\x03\xe8"),
+              received.substr(end + 4));
+}
+
+} // namespace axle
+// NOLINTEND(readability-function-cognitive-complexity)
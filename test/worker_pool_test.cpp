@@ -0,0 +1,113 @@
+// NOLINTBEGIN(readability-function-cognitive-complexity)
+
+#include "axle/worker_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "axle/event.h"
+#include "axle/status.h"
+
+#include "gtest/gtest.h"
+
+namespace axle {
+
+TEST(WorkerPoolTest, RunsAllTasks) {
+    constexpr size_t task_cnt = 1000;
+    std::atomic_size_t done = 0;
+    std::mutex mu;
+    std::set<std::thread::id> threads;
+
+    {
+        WorkerPool pool{4};
+        ASSERT_EQ(4, pool.size());
+
+        // Tasks that fan out more tasks land on their own worker's deque and get stolen from there.
+        for (size_t i = 0; i < task_cnt / 10; ++i) {
+            pool.submit([&] {
+                for (size_t j = 0; j < 10; ++j) {
+                    pool.submit([&] {
+                        {
+                            const std::lock_guard<std::mutex> lock{mu};
+                            threads.insert(std::this_thread::get_id());
+                        }
+                        ++done;
+                    });
+                }
+            });
+        }
+    }
+
+    ASSERT_EQ(task_cnt, done.load());
+    ASSERT_FALSE(threads.contains(std::this_thread::get_id()));
+}
+
+TEST(WorkerPoolTest, CompletesInOrder) {
+    WorkerPool pool{4};
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    const std::thread::id loop_thread = std::this_thread::get_id();
+    std::vector<int> results;
+
+    WorkQueue queue{pool, loop};
+    for (int i = 0; i < 8; ++i) {
+        // Earlier work takes longer, so the workers finish it last.
+        queue.submit(
+            [i] {
+                std::this_thread::sleep_for(std::chrono::milliseconds{2 * (8 - i)});
+                return i;
+            },
+            [&](int res) {
+                EXPECT_EQ(loop_thread, std::this_thread::get_id());
+                results.push_back(res);
+            });
+    }
+    queue.then([&] {
+        results.push_back(-1);
+        ASSERT_TRUE(loop->shutdown().is_ok());
+    });
+    ASSERT_EQ(9, queue.pending());
+
+    loop->run();
+
+    ASSERT_EQ((std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, -1}), results);
+    ASSERT_EQ(0, queue.pending());
+}
+
+TEST(WorkerPoolTest, CancelOnClose) {
+    WorkerPool pool{2};
+    const std::shared_ptr<EventLoop> loop = std::make_shared<EventLoop>();
+    std::atomic_int started = 0;
+    int delivered = 0;
+
+    auto queue = std::make_unique<WorkQueue>(pool, loop);
+    for (int i = 0; i < 4; ++i) {
+        queue->submit(
+            [&] {
+                ++started;
+                std::this_thread::sleep_for(std::chrono::milliseconds{20});
+                return 0;
+            },
+            [&](int) { ++delivered; });
+    }
+
+    // The connection closes while its work is in flight.
+    queue.reset();
+    queue = std::make_unique<WorkQueue>(pool, loop);
+    queue->submit([] { return 0; }, [&](int) { ASSERT_TRUE(loop->shutdown().is_ok()); });
+
+    loop->run();
+
+    ASSERT_EQ(0, delivered);
+    ASSERT_LT(started.load(), 4);
+}
+
+} // namespace axle
+// NOLINTEND(readability-function-cognitive-complexity)